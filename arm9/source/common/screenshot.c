@@ -4,26 +4,34 @@
 #include "vff.h"
 #include "png.h"
 
-static void Screenshot_Transpose(u16 *dest, const u16 *fb, u32 w, u32 stride)
+typedef struct {
+    const u16 *top;
+    const u16 *bot;
+} ScreenshotSource;
+
+// top screen on top, bottom screen centered below it on a gray background
+static void Screenshot_GetRow(u16 *row, u32 y, void *data)
 {
-    for (u32 y = 0; y < SCREEN_HEIGHT; y++) {
-        for (u32 x = 0; x < w; x++)
-            *(dest++) = GetColor(fb, x, y);
-        dest += stride;
+    ScreenshotSource *src = (ScreenshotSource*) data;
+    const u32 bot_x = (SCREEN_WIDTH_TOP - SCREEN_WIDTH_BOT) / 2;
+
+    if (y < SCREEN_HEIGHT) {
+        for (u32 x = 0; x < SCREEN_WIDTH_TOP; x++)
+            *(row++) = GetColor(src->top, x, y);
+        return;
     }
+
+    y -= SCREEN_HEIGHT;
+    for (u32 x = 0; x < SCREEN_WIDTH_TOP; x++)
+        *(row++) = ((x < bot_x) || (x >= bot_x + SCREEN_WIDTH_BOT)) ?
+            RGB(0x1F, 0x1F, 0x1F) : GetColor(src->bot, x - bot_x, y); // gray background
 }
 
 void CreateScreenshot(void) {
-    u8 *png;
-    u16 *buffer;
+    u16 *buffer, *buffer_top, *buffer_bottom;
     DsTime dstime;
-    size_t png_size;
     char filename[64];
-    u32 snapbuf_size, snap_w, snap_h, bot_offset;
-
-    snapbuf_size = (SCREEN_WIDTH_TOP * SCREEN_HEIGHT * BYTES_PER_PIXEL) * 2;
-    snap_w = SCREEN_WIDTH_TOP;
-    snap_h = SCREEN_HEIGHT * 2;
+    ScreenshotSource src;
 
     fvx_rmkdir(OUTPUT_PATH);
     get_dstime(&dstime);
@@ -32,35 +40,26 @@ void CreateScreenshot(void) {
         dstime.bcd_h, dstime.bcd_m, dstime.bcd_s);
     filename[63] = '\0';
 
-    buffer = malloc(snapbuf_size);
+    // screen contents are saved and encoded from here, rows are fetched as needed
+    buffer = malloc(SCREEN_SIZE_TOP + SCREEN_SIZE_BOT);
     if (!buffer) return;
 
-    for (unsigned i = snapbuf_size/4; i < snapbuf_size/2; i++)
-        buffer[i] = RGB(0x1F, 0x1F, 0x1F); // gray background
-
-    bot_offset = (SCREEN_WIDTH_TOP * SCREEN_HEIGHT) + 40;
-
-    Screenshot_Transpose(buffer, TOP_SCREEN, SCREEN_WIDTH_TOP, 0);
-    Screenshot_Transpose(buffer + bot_offset, BOT_SCREEN, SCREEN_WIDTH_BOT, 80);
+    buffer_top = buffer;
+    buffer_bottom = buffer + (SCREEN_SIZE_TOP / BYTES_PER_PIXEL);
+    memcpy(buffer_top, TOP_SCREEN, SCREEN_SIZE_TOP);
+    memcpy(buffer_bottom, BOT_SCREEN, SCREEN_SIZE_BOT);
+    src.top = buffer_top;
+    src.bot = buffer_bottom;
 
-    png = PNG_Compress(buffer, snap_w, snap_h, &png_size);
+    // "snap effect"
+    memset(BOT_SCREEN, 0, SCREEN_SIZE_BOT);
+    memset(TOP_SCREEN, 0, SCREEN_SIZE_TOP);
 
-    if (png && png_size) {
-        u16 *buffer_top = buffer, *buffer_bottom = buffer + bot_offset;
-
-        // "snap effect"
-        memcpy(buffer_bottom, BOT_SCREEN, SCREEN_SIZE_BOT);
-        memcpy(buffer_top, TOP_SCREEN, SCREEN_SIZE_TOP);
-        memset(BOT_SCREEN, 0, SCREEN_SIZE_BOT);
-        memset(TOP_SCREEN, 0, SCREEN_SIZE_TOP);
-
-        fvx_qwrite(filename, png, 0, png_size, NULL);
-
-        memcpy(BOT_SCREEN, buffer_bottom, SCREEN_SIZE_BOT);
-        memcpy(TOP_SCREEN, buffer_top, SCREEN_SIZE_TOP);
-    }
+    PNG_CompressToFile(filename, SCREEN_WIDTH_TOP, SCREEN_HEIGHT * 2, Screenshot_GetRow, &src);
     // what to do on error...?
 
+    memcpy(BOT_SCREEN, buffer_bottom, SCREEN_SIZE_BOT);
+    memcpy(TOP_SCREEN, buffer_top, SCREEN_SIZE_TOP);
+
     free(buffer);
-    free(png);
 }
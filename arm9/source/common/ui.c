@@ -21,6 +21,8 @@
 #define FONT_MAX_WIDTH 8
 #define FONT_MAX_HEIGHT 10
 #define PROGRESS_REFRESH_RATE 30 // the progress bar is only allowed to draw to screen every X milliseconds
+#define GLYPH_CACHE_SETS 32 // the glyph cache holds (sets * ways) pre-rendered glyphs
+#define GLYPH_CACHE_WAYS 4
 
 typedef struct {
     char chunk_id[4]; // NOT null terminated
@@ -33,6 +35,15 @@ typedef struct {
     u16 count;
 } FontMeta;
 
+// glyph pre-rendered for one color combination, pixels are stored column by column in framebuffer order
+typedef struct {
+    u32 character;
+    u16 color;
+    u16 bgcolor;
+    u32 last_use; // 0 means unused
+    u16 pixels[FONT_MAX_WIDTH * FONT_MAX_HEIGHT];
+} CachedGlyph;
+
 static u32 font_width = 0;
 static u32 font_height = 0;
 static u32 font_count = 0;
@@ -40,6 +51,18 @@ static u32 line_height = 0;
 static u8* font_bin = NULL;
 static u16* font_map = NULL;
 static u16 ascii_lut[0x60];
+static CachedGlyph* glyph_cache = NULL;
+static u32 glyph_cache_tick = 0;
+
+static ProgressHook progress_hook = NULL;
+static void* progress_hook_ctx = NULL;
+static u64 progress_hook_interval = 0;
+static u64 progress_hook_last = 0;
+static u64 progress_timer = 0;
+static bool progress_on_screen = false; // what ShowProgress() last drew is still on the main screen
+
+// anything else drawn to the main screen means the progress screen has to be redrawn in full
+#define TOUCH_SCREEN(s) do { if ((s) == MAIN_SCREEN) progress_on_screen = false; } while(0)
 
 // lookup table to sort CP-437 so it can be binary searched with Unicode codepoints
 static const u8 cp437_sorted[0x100] = {
@@ -333,6 +356,9 @@ bool SetFont(const void* font, u32 font_size) {
         ascii_lut[i] = GetFontIndex(i + 0x20, false);
     }
 
+    // cached glyphs are from the old font
+    if (glyph_cache) memset(glyph_cache, 0, GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS * sizeof(CachedGlyph));
+
     line_height = min(10, font_height + 2);
     return true;
 }
@@ -344,6 +370,7 @@ void ClearScreen(u16* screen, u32 color)
     if (color == COLOR_TRANSPARENT)
         color = COLOR_BLACK;
 
+    TOUCH_SCREEN(screen);
     color |= color << 16;
     for (int i = 0; i < (width * SCREEN_HEIGHT / 2); i++)
         *(screen_wide++) = color;
@@ -362,11 +389,13 @@ u16 GetColor(const u16 *screen, int x, int y)
 
 void DrawPixel(u16 *screen, int x, int y, u32 color)
 {
+    TOUCH_SCREEN(screen);
     screen[PIXEL_OFFSET(x, y)] = color;
 }
 
 void DrawRectangle(u16 *screen, int x, int y, u32 width, u32 height, u32 color)
 {
+    TOUCH_SCREEN(screen);
     screen += PIXEL_OFFSET(x, y) - height + 1;
     while(width--) {
         for (u32 h = 0; h < height; h++)
@@ -385,6 +414,7 @@ void DrawBitmap(u16 *screen, int x, int y, u32 w, u32 h, const u16* bitmap)
     if ((x < 0) || (y < 0) || (w > SCREEN_WIDTH(screen)) || (h > SCREEN_HEIGHT))
         return;
 
+    TOUCH_SCREEN(screen);
     screen += PIXEL_OFFSET(x, y);
     while(h--) {
         for (u32 i = 0; i < w; i++)
@@ -426,8 +456,61 @@ void DrawQrCode(u16 *screen, const u8* qrcode)
     }
 }
 
+// returns the rendered glyph from the cache, renders and caches it (LRU per set) if not found
+static const u16* GetCachedGlyph(u32 character, u32 color, u32 bgcolor)
+{
+    if (!glyph_cache) {
+        glyph_cache = (CachedGlyph*) calloc(GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS, sizeof(CachedGlyph));
+        if (!glyph_cache) return NULL;
+    }
+
+    if (!++glyph_cache_tick) glyph_cache_tick = 1;
+    CachedGlyph* set = glyph_cache + (((character * 7) ^ color ^ (bgcolor >> 5)) % GLYPH_CACHE_SETS) * GLYPH_CACHE_WAYS;
+    CachedGlyph* glyph = set;
+    for (u32 i = 0; i < GLYPH_CACHE_WAYS; i++) {
+        CachedGlyph* way = set + i;
+        if (way->last_use && (way->character == character) && (way->color == color) && (way->bgcolor == bgcolor)) {
+            way->last_use = glyph_cache_tick;
+            return way->pixels;
+        }
+        if (way->last_use < glyph->last_use) glyph = way;
+    }
+
+    // expand the font bitmap, bottom to top inside each column
+    const u8* bitmap = font_bin + GetFontIndex(character, true) * font_height;
+    u16* pixels = glyph->pixels;
+    for (int xx = 7; xx >= (8 - (int) font_width); xx--) {
+        for (int yy = font_height - 1; yy >= 0; yy--)
+            *(pixels++) = ((bitmap[yy] >> xx) & 1) ? color : bgcolor;
+    }
+    glyph->character = character;
+    glyph->color = color;
+    glyph->bgcolor = bgcolor;
+    glyph->last_use = glyph_cache_tick;
+
+    return glyph->pixels;
+}
+
 void DrawCharacter(u16 *screen, u32 character, int x, int y, u32 color, u32 bgcolor)
 {
+    TOUCH_SCREEN(screen);
+    const u16* glyph = (bgcolor != COLOR_TRANSPARENT) ? GetCachedGlyph(character, color, bgcolor) : NULL;
+    if (glyph) { // blit column by column, using word writes where possible
+        u16* column = screen + (x * SCREEN_HEIGHT) + (SCREEN_HEIGHT - y - (int) font_height);
+        for (u32 xx = 0; xx < font_width; xx++, column += SCREEN_HEIGHT) {
+            u16* dst = column;
+            u32 n = font_height;
+            if ((u32) dst & 0x2) {
+                *(dst++) = *(glyph++);
+                n--;
+            }
+            for (; n >= 2; n -= 2, dst += 2, glyph += 2)
+                *(u32*) (void*) dst = glyph[0] | ((u32) glyph[1] << 16);
+            if (n) *dst = *(glyph++);
+        }
+        return;
+    }
+
     for (int yy = 0; yy < (int) font_height; yy++) {
         int xDisplacement = x * SCREEN_HEIGHT;
         int yDisplacement = SCREEN_HEIGHT - (y + yy) - 1;
@@ -454,6 +537,17 @@ void DrawString(u16 *screen, const char *str, int x, int y, u32 color, u32 bgcol
     }
 }
 
+void DrawStringDelta(u16 *screen, const char *str, const char *prev, int x, int y, u32 color, u32 bgcolor)
+{
+    size_t max_len = (((screen == TOP_SCREEN) ? SCREEN_WIDTH_TOP : SCREEN_WIDTH_BOT) - x) / font_width;
+
+    for (size_t i = 0; i < max_len && (*str || *prev); i++) {
+        u32 c = *str ? GetCharacter(&str) : ' ';
+        u32 c_prev = *prev ? GetCharacter(&prev) : 0;
+        if (c != c_prev) DrawCharacter(screen, c, x + i * font_width, y, color, bgcolor);
+    }
+}
+
 void DrawStringF(u16 *screen, int x, int y, u32 color, u32 bgcolor, const char *format, ...)
 {
     char str[STRBUF_SIZE];
@@ -1391,10 +1485,45 @@ bool ShowRtcSetterPrompt(void* time, const char *format, ...) {
     return ret;
 }
 
+void SetProgressHook(ProgressHook hook, void* ctx, u64 interval)
+{
+    progress_hook = hook;
+    progress_hook_ctx = ctx;
+    progress_hook_interval = interval;
+    progress_hook_last = 0;
+}
+
+bool ProgressHookActive(void)
+{
+    return progress_hook != NULL;
+}
+
 bool ShowProgress(u64 current, u64 total, const char* opstr)
 {
+    if (progress_hook) {
+        // start and end of an operation are always reported, anything in between only every interval
+        if (current && (current < total) && (current >= progress_hook_last) &&
+            (current - progress_hook_last < progress_hook_interval))
+            return true;
+        progress_hook_last = current;
+        return progress_hook(current, total, opstr, progress_hook_ctx);
+    }
+
     static u32 last_prog_width = 0;
-    static u64 timer = 0;
+    static u64 last_msec_elapsed = 0;
+    static u64 last_sec_remain = 0;
+    // text as currently on screen, only changed characters get redrawn
+    static char last_opstr[UTF_BUFFER_BYTESIZE(64)] = { 0 };
+    static char last_progstr[UTF_BUFFER_BYTESIZE(64)] = { 0 };
+    static char last_etastr[UTF_BUFFER_BYTESIZE(16)] = { 0 };
+
+    // fast path first, this is called once per buffer from all the processing loops
+    if (!current) {
+        progress_timer = timer_start();
+        last_sec_remain = 0;
+    } else if (timer_msec(progress_timer) < last_msec_elapsed + PROGRESS_REFRESH_RATE) return !CheckButton(BUTTON_B);
+    last_msec_elapsed = timer_msec(progress_timer);
+
     const u32 bar_width = 240;
     const u32 bar_height = 12;
     const u32 bar_pos_x = (SCREEN_WIDTH_MAIN - bar_width) / 2;
@@ -1405,44 +1534,63 @@ bool ShowProgress(u64 current, u64 total, const char* opstr)
     char tempstr[UTF_BUFFER_BYTESIZE(64)];
     char progstr[UTF_BUFFER_BYTESIZE(64)];
 
-    static u64 last_msec_elapsed = 0;
-    static u64 last_sec_remain = 0;
-    if (!current) {
-        timer = timer_start();
-        last_sec_remain = 0;
-    } else if (timer_msec(timer) < last_msec_elapsed + PROGRESS_REFRESH_RATE) return !CheckButton(BUTTON_B);
-    last_msec_elapsed = timer_msec(timer);
-    u64 sec_elapsed = (total > 0) ? timer_sec( timer ) : 0;
+    u64 sec_elapsed = (total > 0) ? timer_sec( progress_timer ) : 0;
     u64 sec_total = (current > 0) ? (sec_elapsed * total) / current : 0;
     u64 sec_remain = (!last_sec_remain) ? (sec_total - sec_elapsed) : ((last_sec_remain + (sec_total - sec_elapsed) + 1) / 2);
     if (sec_remain >= 60 * 60) sec_remain = 60 * 60 - 1;
     last_sec_remain = sec_remain;
 
-    if (!current || last_prog_width > prog_width) {
+    // static parts (frame, cancel hint) are only drawn when (re)starting or after something else was drawn
+    if (!current || !progress_on_screen || (last_prog_width > prog_width) ||
+        (strncmp(opstr, last_opstr, sizeof(last_opstr) - 1) != 0)) {
         ClearScreenF(true, false, COLOR_STD_BG);
         DrawRectangle(MAIN_SCREEN, bar_pos_x, bar_pos_y, bar_width, bar_height, COLOR_STD_FONT);
         DrawRectangle(MAIN_SCREEN, bar_pos_x + 1, bar_pos_y + 1, bar_width - 2, bar_height - 2, COLOR_STD_BG);
+        DrawString(MAIN_SCREEN, STR_HOLD_B_TO_CANCEL, bar_pos_x + 2, text_pos_y + 14, COLOR_STD_FONT, COLOR_STD_BG);
+        strncpy(last_opstr, opstr, sizeof(last_opstr) - 1);
+        *last_progstr = *last_etastr = '\0';
+        last_prog_width = 0;
     }
-    DrawRectangle(MAIN_SCREEN, bar_pos_x + 2, bar_pos_y + 2, prog_width, bar_height - 4, COLOR_STD_FONT);
-    DrawRectangle(MAIN_SCREEN, bar_pos_x + 2 + prog_width, bar_pos_y + 2, (bar_width-4) - prog_width, bar_height - 4, COLOR_STD_BG);
+
+    // only the newly filled part of the bar
+    if (prog_width > last_prog_width)
+        DrawRectangle(MAIN_SCREEN, bar_pos_x + 2 + last_prog_width, bar_pos_y + 2, prog_width - last_prog_width, bar_height - 4, COLOR_STD_FONT);
+    last_prog_width = prog_width;
 
     TruncateString(progstr, opstr, min(63, (bar_width / FONT_WIDTH_EXT) - 7), 8);
     snprintf(tempstr, sizeof(tempstr), "%s (%lu%%)", progstr, prog_percent);
     ResizeString(progstr, tempstr, bar_width / FONT_WIDTH_EXT, 8, false);
-    DrawString(MAIN_SCREEN, progstr, bar_pos_x, text_pos_y, COLOR_STD_FONT, COLOR_STD_BG);
+    DrawStringDelta(MAIN_SCREEN, progstr, last_progstr, bar_pos_x, text_pos_y, COLOR_STD_FONT, COLOR_STD_BG);
+    strncpy(last_progstr, progstr, sizeof(last_progstr) - 1);
     if (sec_elapsed >= 1) {
         snprintf(tempstr, sizeof(tempstr), STR_ETA_N_MIN_N_SEC, sec_remain / 60, sec_remain % 60);
         ResizeString(progstr, tempstr, 16, 8, true);
-        DrawString(MAIN_SCREEN, progstr, bar_pos_x + bar_width - 1 - (FONT_WIDTH_EXT * 16),
+        DrawStringDelta(MAIN_SCREEN, progstr, last_etastr, bar_pos_x + bar_width - 1 - (FONT_WIDTH_EXT * 16),
             bar_pos_y - line_height - 1, COLOR_STD_FONT, COLOR_STD_BG);
+        strncpy(last_etastr, progstr, sizeof(last_etastr) - 1);
     }
-    DrawString(MAIN_SCREEN, STR_HOLD_B_TO_CANCEL, bar_pos_x + 2, text_pos_y + 14, COLOR_STD_FONT, COLOR_STD_BG);
-
-    last_prog_width = prog_width;
+    progress_on_screen = true;
 
     return !CheckButton(BUTTON_B);
 }
 
+bool ProgressUpdate(ProgressCounter* prog)
+{
+    bool ret = ShowProgress(prog->current, prog->total, prog->opstr);
+
+    // skip ahead to the next hook interval or to about half a refresh at the rate so far,
+    // the last update (at total) always goes through
+    u64 step = 0;
+    if (progress_hook) step = progress_hook_interval;
+    else {
+        u64 msec = timer_msec(progress_timer);
+        if (msec) step = (prog->current * PROGRESS_REFRESH_RATE) / (msec * 2);
+    }
+    prog->next = min(prog->current + step, prog->total);
+
+    return ret;
+}
+
 int ShowBrightnessConfig(int set_brightness)
 {
     const int old_brightness = set_brightness;
@@ -65,6 +65,7 @@ void DrawQrCode(u16 *screen, const u8* qrcode);
 
 void DrawCharacter(u16 *screen, u32 character, int x, int y, u32 color, u32 bgcolor);
 void DrawString(u16 *screen, const char *str, int x, int y, u32 color, u32 bgcolor);
+void DrawStringDelta(u16 *screen, const char *str, const char *prev, int x, int y, u32 color, u32 bgcolor);
 void PRINTF_ARGS(6) DrawStringF(u16 *screen, int x, int y, u32 color, u32 bgcolor, const char *format, ...);
 void PRINTF_ARGS(4) DrawStringCenter(u16 *screen, u32 color, u32 bgcolor, const char *format, ...);
 
@@ -98,6 +99,27 @@ bool PRINTF_ARGS(3) ShowDataPrompt(u8* data, u32* size, const char *format, ...)
 bool PRINTF_ARGS(2) ShowRtcSetterPrompt(void* time, const char *format, ...);
 bool ShowProgress(u64 current, u64 total, const char* opstr);
 
+// a progress hook replaces the progress bar (f.e. for scripts), return false to cancel
+typedef bool (*ProgressHook)(u64 current, u64 total, const char* opstr, void* ctx);
+void SetProgressHook(ProgressHook hook, void* ctx, u64 interval);
+bool ProgressHookActive(void);
+
+// progress from tight loops: ProgressAdd() only bumps a counter, ShowProgress() (drawing, cancel check, hook)
+// runs from ProgressUpdate() at about the refresh rate, set up current, total and opstr with next at zero
+typedef struct {
+    u64 current;
+    u64 total;
+    u64 next; // counter value due for the next update
+    const char* opstr;
+} ProgressCounter;
+
+bool ProgressUpdate(ProgressCounter* prog);
+
+static inline bool ProgressAdd(ProgressCounter* prog, u64 n) {
+    prog->current += n;
+    return (prog->current < prog->next) || ProgressUpdate(prog);
+}
+
 int ShowBrightnessConfig(int set_brightness);
 
 static inline u16 rgb888_to_rgb565(u32 rgb) {
@@ -3,8 +3,25 @@
 
 // FIXME some things make assumptions about alignemnts!
 // setup_aeskey? and set_ctr do not anymore (c) d0k3
+
+// bumped whenever a keyslot is written, lets users skip reloading a key that is still in place
+static uint32_t keyslot_serial[0x40];
+
+void aes_keyslot_changed(uint8_t keyslot)
+{
+    keyslot_serial[keyslot & 0x3F]++;
+}
+
+uint32_t aes_keyslot_serial(uint8_t keyslot)
+{
+    return keyslot_serial[keyslot & 0x3F];
+}
+
+#ifndef SOFT_CRYPTO
+// hardware keyslot and FIFO access, aessoft.c replaces these in SOFT_CRYPTO builds
 void setup_aeskeyX(uint8_t keyslot, const void* keyx)
 {
+    aes_keyslot_changed(keyslot);
     uint32_t _keyx[4] __attribute__((aligned(32)));
     for (uint32_t i = 0; i < 16u; i++)
         ((uint8_t*)_keyx)[i] = ((uint8_t*)keyx)[i];
@@ -28,6 +45,7 @@ void setup_aeskeyX(uint8_t keyslot, const void* keyx)
 
 void setup_aeskeyY(uint8_t keyslot, const void* keyy)
 {
+    aes_keyslot_changed(keyslot);
     uint32_t _keyy[4] __attribute__((aligned(32)));
     for (uint32_t i = 0; i < 16u; i++)
         ((uint8_t*)_keyy)[i] = ((uint8_t*)keyy)[i];
@@ -51,6 +69,7 @@ void setup_aeskeyY(uint8_t keyslot, const void* keyy)
 
 void setup_aeskey(uint8_t keyslot, const void* key)
 {
+    aes_keyslot_changed(keyslot);
     uint32_t _key[4] __attribute__((aligned(32)));
     for (uint32_t i = 0; i < 16u; i++)
         ((uint8_t*)_key)[i] = ((uint8_t*)key)[i];
@@ -93,6 +112,8 @@ void set_ctr(void* iv)
     *(REG_AESCTR + 3) = _iv[0];
 }
 
+#endif
+
 void add_ctr(void* ctr, uint32_t carry)
 {
     uint32_t counter[4];
@@ -269,6 +290,7 @@ void ctr_decrypt(void *inbuf, void *outbuf, size_t size, uint32_t mode, uint8_t
     }
 }
 
+#ifndef SOFT_CRYPTO
 void aes_decrypt(void* inbuf, void* outbuf, size_t size, uint32_t mode)
 {
     uint8_t *in  = inbuf;
@@ -291,6 +313,8 @@ void aes_decrypt(void* inbuf, void* outbuf, size_t size, uint32_t mode)
     }
 }
 
+#endif
+
 void aes_cmac(void* inbuf, void* outbuf, size_t size)
 {
     // only works for full blocks
@@ -328,6 +352,7 @@ void aes_cmac(void* inbuf, void* outbuf, size_t size)
     }
 }
 
+#ifndef SOFT_CRYPTO
 void aes_fifos(void* inbuf, void* outbuf, size_t blocks)
 {
     if (!inbuf || !outbuf) return;
@@ -405,4 +430,4 @@ uint32_t aescnt_checkread()
     size_t ret = aes_getreadcount();
     return (ret <= 3);
 }
-
+#endif
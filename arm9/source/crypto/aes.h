@@ -46,6 +46,8 @@ extern "C" {
 #define AES_CNT_ECB_DECRYPT_MODE (AES_ECB_DECRYPT_MODE | AES_CNT_INPUT_ORDER | AES_CNT_OUTPUT_ORDER | AES_CNT_INPUT_ENDIAN | AES_CNT_OUTPUT_ENDIAN)
 #define AES_CNT_ECB_ENCRYPT_MODE (AES_ECB_ENCRYPT_MODE | AES_CNT_INPUT_ORDER | AES_CNT_OUTPUT_ORDER | AES_CNT_INPUT_ENDIAN | AES_CNT_OUTPUT_ENDIAN)
 
+void aes_keyslot_changed(uint8_t keyslot);
+uint32_t aes_keyslot_serial(uint8_t keyslot);
 void setup_aeskeyX(uint8_t keyslot, const void* keyx);
 void setup_aeskeyY(uint8_t keyslot, const void* keyy);
 void setup_aeskey(uint8_t keyslot, const void* keyy);
@@ -60,6 +62,7 @@ void ecb_decrypt(void *inbuf, void *outbuf, size_t size, uint32_t mode);
 void cbc_decrypt(void *inbuf, void *outbuf, size_t size, uint32_t mode, uint8_t *ctr);
 void cbc_encrypt(void *inbuf, void *outbuf, size_t size, uint32_t mode, uint8_t *ctr);
 void aes_cmac(void* inbuf, void* outbuf, size_t size);
+// AES engine FIFO access, not available in SOFT_CRYPTO builds
 void aes_fifos(void* inbuf, void* outbuf, size_t blocks);
 void set_aeswrfifo(uint32_t value);
 uint32_t read_aesrdfifo(void);
@@ -0,0 +1,326 @@
+// software AES backend, stands in for the AES engine when built with -DSOFT_CRYPTO
+// (host tests, emulators without AES). T-table AES-128, keyslots + key scramblers
+#include "aes.h"
+
+#ifdef SOFT_CRYPTO
+
+#include <string.h>
+#include <stdbool.h>
+
+#define GETU32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define PUTU32(p, v) { (p)[0] = (uint8_t)((v) >> 24); (p)[1] = (uint8_t)((v) >> 16); (p)[2] = (uint8_t)((v) >> 8); (p)[3] = (uint8_t)(v); }
+#define ROR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+
+typedef struct {
+    uint8_t keyx[16];
+    uint8_t keyy[16];
+    uint32_t rk_enc[44];
+    uint32_t rk_dec[44];
+    bool valid;
+} AesSoftKeySlot;
+
+static uint8_t sbox[256];
+static uint8_t inv_sbox[256];
+static uint32_t Te[4][256];
+static uint32_t Td[4][256];
+static bool tables_ready = false;
+
+static AesSoftKeySlot keyslots[0x40];
+static uint32_t cur_keyslot = 0;
+static uint8_t ctr_reg[16]; // standard byte order
+
+static uint8_t xtime(uint8_t x)
+{
+    return (uint8_t) ((x << 1) ^ ((x & 0x80) ? 0x1B : 0x00));
+}
+
+static uint8_t gmul(uint8_t a, uint8_t b)
+{
+    uint8_t p = 0;
+    for (; b; b >>= 1, a = xtime(a))
+        if (b & 1) p ^= a;
+    return p;
+}
+
+static void aes_soft_tables(void)
+{
+    if (tables_ready) return;
+
+    // sbox from multiplicative inverse (via 3^n powers) + affine transform
+    uint8_t pow[256], log[256];
+    uint8_t x = 1;
+    for (uint32_t i = 0; i < 255; i++) {
+        pow[i] = x;
+        log[x] = (uint8_t) i;
+        x ^= xtime(x);
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint8_t inv = (i) ? pow[(255 - log[i]) % 255] : 0;
+        uint8_t s = inv ^ 0x63;
+        for (uint32_t r = 1; r < 5; r++)
+            s ^= (uint8_t) ((inv << r) | (inv >> (8 - r)));
+        sbox[i] = s;
+        inv_sbox[s] = (uint8_t) i;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint8_t s = sbox[i];
+        uint8_t is = inv_sbox[i];
+        uint32_t te = ((uint32_t) gmul(s, 2) << 24) | ((uint32_t) s << 16) | ((uint32_t) s << 8) | gmul(s, 3);
+        uint32_t td = ((uint32_t) gmul(is, 14) << 24) | ((uint32_t) gmul(is, 9) << 16) |
+            ((uint32_t) gmul(is, 13) << 8) | gmul(is, 11);
+        for (uint32_t t = 0; t < 4; t++) {
+            Te[t][i] = (t) ? ROR32(te, 8 * t) : te;
+            Td[t][i] = (t) ? ROR32(td, 8 * t) : td;
+        }
+    }
+
+    tables_ready = true;
+}
+
+static void aes_soft_expand(AesSoftKeySlot* slot, const uint8_t* key)
+{
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+    uint32_t* rk = slot->rk_enc;
+
+    aes_soft_tables();
+    for (uint32_t i = 0; i < 4; i++)
+        rk[i] = GETU32(key + 4*i);
+    for (uint32_t i = 4; i < 44; i++) {
+        uint32_t t = rk[i-1];
+        if (!(i % 4)) {
+            t = ((uint32_t) sbox[(t >> 16) & 0xFF] << 24) | ((uint32_t) sbox[(t >> 8) & 0xFF] << 16) |
+                ((uint32_t) sbox[t & 0xFF] << 8) | sbox[t >> 24];
+            t ^= (uint32_t) rcon[(i/4) - 1] << 24;
+        }
+        rk[i] = rk[i-4] ^ t;
+    }
+
+    // decryption schedule: reversed rounds, InvMixColumns on the inner ones
+    uint32_t* dk = slot->rk_dec;
+    for (uint32_t r = 0; r <= 10; r++) {
+        for (uint32_t j = 0; j < 4; j++) {
+            uint32_t w = rk[4*(10-r) + j];
+            if (r && (r < 10))
+                w = Td[0][sbox[w >> 24]] ^ Td[1][sbox[(w >> 16) & 0xFF]] ^
+                    Td[2][sbox[(w >> 8) & 0xFF]] ^ Td[3][sbox[w & 0xFF]];
+            dk[4*r + j] = w;
+        }
+    }
+
+    slot->valid = true;
+}
+
+static void aes_soft_encrypt_block(const uint32_t* rk, const uint8_t* in, uint8_t* out)
+{
+    uint32_t s0 = GETU32(in     ) ^ rk[0];
+    uint32_t s1 = GETU32(in +  4) ^ rk[1];
+    uint32_t s2 = GETU32(in +  8) ^ rk[2];
+    uint32_t s3 = GETU32(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+
+    for (uint32_t r = 1; r < 10; r++) {
+        rk += 4;
+        t0 = Te[0][s0 >> 24] ^ Te[1][(s1 >> 16) & 0xFF] ^ Te[2][(s2 >> 8) & 0xFF] ^ Te[3][s3 & 0xFF] ^ rk[0];
+        t1 = Te[0][s1 >> 24] ^ Te[1][(s2 >> 16) & 0xFF] ^ Te[2][(s3 >> 8) & 0xFF] ^ Te[3][s0 & 0xFF] ^ rk[1];
+        t2 = Te[0][s2 >> 24] ^ Te[1][(s3 >> 16) & 0xFF] ^ Te[2][(s0 >> 8) & 0xFF] ^ Te[3][s1 & 0xFF] ^ rk[2];
+        t3 = Te[0][s3 >> 24] ^ Te[1][(s0 >> 16) & 0xFF] ^ Te[2][(s1 >> 8) & 0xFF] ^ Te[3][s2 & 0xFF] ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    rk += 4;
+    t0 = ((uint32_t) sbox[s0 >> 24] << 24) ^ ((uint32_t) sbox[(s1 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) sbox[(s2 >> 8) & 0xFF] << 8) ^ sbox[s3 & 0xFF] ^ rk[0];
+    t1 = ((uint32_t) sbox[s1 >> 24] << 24) ^ ((uint32_t) sbox[(s2 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) sbox[(s3 >> 8) & 0xFF] << 8) ^ sbox[s0 & 0xFF] ^ rk[1];
+    t2 = ((uint32_t) sbox[s2 >> 24] << 24) ^ ((uint32_t) sbox[(s3 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) sbox[(s0 >> 8) & 0xFF] << 8) ^ sbox[s1 & 0xFF] ^ rk[2];
+    t3 = ((uint32_t) sbox[s3 >> 24] << 24) ^ ((uint32_t) sbox[(s0 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) sbox[(s1 >> 8) & 0xFF] << 8) ^ sbox[s2 & 0xFF] ^ rk[3];
+    PUTU32(out     , t0);
+    PUTU32(out +  4, t1);
+    PUTU32(out +  8, t2);
+    PUTU32(out + 12, t3);
+}
+
+static void aes_soft_decrypt_block(const uint32_t* rk, const uint8_t* in, uint8_t* out)
+{
+    uint32_t s0 = GETU32(in     ) ^ rk[0];
+    uint32_t s1 = GETU32(in +  4) ^ rk[1];
+    uint32_t s2 = GETU32(in +  8) ^ rk[2];
+    uint32_t s3 = GETU32(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+
+    for (uint32_t r = 1; r < 10; r++) {
+        rk += 4;
+        t0 = Td[0][s0 >> 24] ^ Td[1][(s3 >> 16) & 0xFF] ^ Td[2][(s2 >> 8) & 0xFF] ^ Td[3][s1 & 0xFF] ^ rk[0];
+        t1 = Td[0][s1 >> 24] ^ Td[1][(s0 >> 16) & 0xFF] ^ Td[2][(s3 >> 8) & 0xFF] ^ Td[3][s2 & 0xFF] ^ rk[1];
+        t2 = Td[0][s2 >> 24] ^ Td[1][(s1 >> 16) & 0xFF] ^ Td[2][(s0 >> 8) & 0xFF] ^ Td[3][s3 & 0xFF] ^ rk[2];
+        t3 = Td[0][s3 >> 24] ^ Td[1][(s2 >> 16) & 0xFF] ^ Td[2][(s1 >> 8) & 0xFF] ^ Td[3][s0 & 0xFF] ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    rk += 4;
+    t0 = ((uint32_t) inv_sbox[s0 >> 24] << 24) ^ ((uint32_t) inv_sbox[(s3 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) inv_sbox[(s2 >> 8) & 0xFF] << 8) ^ inv_sbox[s1 & 0xFF] ^ rk[0];
+    t1 = ((uint32_t) inv_sbox[s1 >> 24] << 24) ^ ((uint32_t) inv_sbox[(s0 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) inv_sbox[(s3 >> 8) & 0xFF] << 8) ^ inv_sbox[s2 & 0xFF] ^ rk[1];
+    t2 = ((uint32_t) inv_sbox[s2 >> 24] << 24) ^ ((uint32_t) inv_sbox[(s1 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) inv_sbox[(s0 >> 8) & 0xFF] << 8) ^ inv_sbox[s3 & 0xFF] ^ rk[2];
+    t3 = ((uint32_t) inv_sbox[s3 >> 24] << 24) ^ ((uint32_t) inv_sbox[(s2 >> 16) & 0xFF] << 16) ^
+        ((uint32_t) inv_sbox[(s1 >> 8) & 0xFF] << 8) ^ inv_sbox[s0 & 0xFF] ^ rk[3];
+    PUTU32(out     , t0);
+    PUTU32(out +  4, t1);
+    PUTU32(out +  8, t2);
+    PUTU32(out + 12, t3);
+}
+
+// 128 bit helpers for the key scramblers, big endian byte arrays
+static void u128_rol(uint8_t* v, uint32_t n)
+{
+    uint8_t t[16];
+    uint32_t bytes = (n / 8) % 16;
+    uint32_t bits = n % 8;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint8_t hi = v[(i + bytes) % 16];
+        uint8_t lo = v[(i + bytes + 1) % 16];
+        t[i] = (bits) ? (uint8_t) ((hi << bits) | (lo >> (8 - bits))) : hi;
+    }
+    memcpy(v, t, 16);
+}
+
+static void u128_add(uint8_t* v, const uint8_t* a)
+{
+    uint32_t carry = 0;
+    for (int i = 15; i >= 0; i--) {
+        uint32_t sum = v[i] + a[i] + carry;
+        v[i] = (uint8_t) sum;
+        carry = sum >> 8;
+    }
+}
+
+static void aes_soft_scramble(uint8_t keyslot)
+{
+    // see https://www.3dbrew.org/wiki/AES_Registers#Key_Scrambler
+    static const uint8_t ctr_const[16] = {
+        0x1F, 0xF9, 0xE9, 0xAA, 0xC5, 0xFE, 0x04, 0x08, 0x02, 0x45, 0x91, 0xDC, 0x5D, 0x52, 0x76, 0x8A
+    };
+    // DSi scrambler, keyX / keyY / normal key are little endian there
+    // (not verified against hardware, nothing in the host tests depends on it)
+    static const uint8_t twl_const[16] = {
+        0xFF, 0xFE, 0xFB, 0x4E, 0x29, 0x59, 0x02, 0x58, 0x2A, 0x68, 0x0F, 0x5F, 0x1A, 0x4F, 0x3E, 0x79
+    };
+    AesSoftKeySlot* slot = &(keyslots[keyslot]);
+    uint8_t key[16];
+
+    if (keyslot > 3) {
+        memcpy(key, slot->keyx, 16);
+        u128_rol(key, 2);
+        for (uint32_t i = 0; i < 16; i++)
+            key[i] ^= slot->keyy[i];
+        u128_add(key, ctr_const);
+        u128_rol(key, 87);
+    } else {
+        for (uint32_t i = 0; i < 16; i++)
+            key[i] = slot->keyx[15-i] ^ slot->keyy[15-i];
+        u128_add(key, twl_const);
+        u128_rol(key, 42);
+    }
+
+    aes_soft_expand(slot, key);
+}
+
+void setup_aeskeyX(uint8_t keyslot, const void* keyx)
+{
+    keyslot &= 0x3F;
+    aes_keyslot_changed(keyslot);
+    memcpy(keyslots[keyslot].keyx, keyx, 16);
+}
+
+void setup_aeskeyY(uint8_t keyslot, const void* keyy)
+{
+    keyslot &= 0x3F;
+    aes_keyslot_changed(keyslot);
+    memcpy(keyslots[keyslot].keyy, keyy, 16);
+    aes_soft_scramble(keyslot); // as on hardware, writing keyY triggers the scrambler
+}
+
+void setup_aeskey(uint8_t keyslot, const void* key)
+{
+    uint8_t _key[16];
+    keyslot &= 0x3F;
+    aes_keyslot_changed(keyslot);
+    // DSi keyslots take the normal key little endian
+    for (uint32_t i = 0; i < 16; i++)
+        _key[i] = ((const uint8_t*) key)[(keyslot > 3) ? i : 15-i];
+    aes_soft_expand(&(keyslots[keyslot]), _key);
+}
+
+void use_aeskey(uint32_t keyno)
+{
+    if (keyno > 0x3F)
+        return;
+    cur_keyslot = keyno;
+}
+
+void set_ctr(void* iv)
+{
+    memcpy(ctr_reg, iv, 16);
+}
+
+// applies the AES_CNT word order / endianness flags, both set means standard order
+static void aes_soft_swizzle(uint8_t* dst, const uint8_t* src, bool endian, bool order)
+{
+    for (uint32_t w = 0; w < 4; w++) {
+        uint32_t sw = (order) ? w : 3 - w;
+        for (uint32_t b = 0; b < 4; b++)
+            dst[4*w + b] = src[4*sw + ((endian) ? b : 3 - b)];
+    }
+}
+
+void aes_decrypt(void* inbuf, void* outbuf, size_t size, uint32_t mode)
+{
+    const AesSoftKeySlot* slot = &(keyslots[cur_keyslot]);
+    uint32_t aes_mode = mode & (7u << 27);
+    bool in_endian = mode & AES_CNT_INPUT_ENDIAN;
+    bool in_order = mode & AES_CNT_INPUT_ORDER;
+    bool out_endian = mode & AES_CNT_OUTPUT_ENDIAN;
+    bool out_order = mode & AES_CNT_OUTPUT_ORDER;
+    uint8_t* in = inbuf;
+    uint8_t* out = outbuf;
+
+    for (size_t b = 0; b < size; b++, in += AES_BLOCK_SIZE, out += AES_BLOCK_SIZE) {
+        uint8_t blk[16];
+        uint8_t res[16];
+        aes_soft_swizzle(blk, in, in_endian, in_order);
+
+        if (!slot->valid) { // unset keyslot, don't make anything up
+            memset(res, 0x00, 16);
+        } else if (aes_mode == AES_CTR_MODE) {
+            aes_soft_encrypt_block(slot->rk_enc, ctr_reg, res);
+            for (uint32_t i = 0; i < 16; i++)
+                res[i] ^= blk[i];
+            for (int i = 15; (i >= 0) && !(++ctr_reg[i]); i--);
+        } else if (aes_mode == AES_CBC_DECRYPT_MODE) {
+            aes_soft_decrypt_block(slot->rk_dec, blk, res);
+            for (uint32_t i = 0; i < 16; i++)
+                res[i] ^= ctr_reg[i];
+            memcpy(ctr_reg, blk, 16);
+        } else if (aes_mode == AES_CBC_ENCRYPT_MODE) {
+            for (uint32_t i = 0; i < 16; i++)
+                blk[i] ^= ctr_reg[i];
+            aes_soft_encrypt_block(slot->rk_enc, blk, res);
+            memcpy(ctr_reg, res, 16);
+        } else if (aes_mode == AES_ECB_DECRYPT_MODE) {
+            aes_soft_decrypt_block(slot->rk_dec, blk, res);
+        } else if (aes_mode == AES_ECB_ENCRYPT_MODE) {
+            aes_soft_encrypt_block(slot->rk_enc, blk, res);
+        } else { // CCM is not emulated (and not used anywhere)
+            memset(res, 0x00, 16);
+        }
+
+        aes_soft_swizzle(out, res, out_endian, out_order);
+    }
+}
+
+#endif
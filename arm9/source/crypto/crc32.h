@@ -8,4 +8,6 @@
 
 u32 crc32_adjust(u32 crc32, u8 input);
 u32 crc32_calculate(u32 crc32, const u8* data, u32 length);
+// combine finalized CRC32s of two consecutive blocks, length2 is the size of the second block
+u32 crc32_combine(u32 crc1, u32 crc2, u64 length2);
 u32 crc32_calculate_from_file(const char* fileName, u32 offset, u32 length);
@@ -1,4 +1,6 @@
 #include "sha.h"
+
+#ifndef SOFT_CRYPTO
 #include "mmio.h"
 
 typedef struct
@@ -35,6 +37,8 @@ void sha_get(void* res) {
     if (hash_size) iomemcpy(res, (void*)REG_SHAHASH, hash_size);
 }
 
+#endif
+
 void sha_quick(void* res, const void* src, u32 size, u32 mode) {
     sha_init(mode);
     sha_update(src, size);
@@ -0,0 +1,147 @@
+// software SHA-1 / SHA-224 / SHA-256, stands in for the SHA engine when built with -DSOFT_CRYPTO
+// like the hardware, there is exactly one running hash state
+#include "sha.h"
+
+#ifdef SOFT_CRYPTO
+
+#define ROR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+#define ROL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+static struct {
+    u32 mode;
+    u32 h[8];
+    u8  buffer[64];
+    u32 buffered;
+    u64 length;
+} sha_ctx;
+
+static const u32 sha256_k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static void sha256_block(const u8* blk)
+{
+    u32 w[64];
+    u32* h = sha_ctx.h;
+
+    for (u32 i = 0; i < 16; i++)
+        w[i] = getbe32(blk + 4*i);
+    for (u32 i = 16; i < 64; i++) {
+        u32 s0 = ROR32(w[i-15], 7) ^ ROR32(w[i-15], 18) ^ (w[i-15] >> 3);
+        u32 s1 = ROR32(w[i-2], 17) ^ ROR32(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    u32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (u32 i = 0; i < 64; i++) {
+        u32 t1 = k + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        u32 t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+static void sha1_block(const u8* blk)
+{
+    u32 w[80];
+    u32* h = sha_ctx.h;
+
+    for (u32 i = 0; i < 16; i++)
+        w[i] = getbe32(blk + 4*i);
+    for (u32 i = 16; i < 80; i++)
+        w[i] = ROL32(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+
+    u32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (u32 i = 0; i < 80; i++) {
+        u32 f, k;
+        if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+        u32 t = ROL32(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = ROL32(b, 30); b = a; a = t;
+    }
+
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void sha_block(const u8* blk)
+{
+    if (sha_ctx.mode & SHA1_MODE) sha1_block(blk);
+    else sha256_block(blk);
+}
+
+void sha_init(u32 mode)
+{
+    static const u32 h256[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+    };
+    static const u32 h224[8] = {
+        0xC1059ED8, 0x367CD507, 0x3070DD17, 0xF70E5939, 0xFFC00B31, 0x68581511, 0x64F98FA7, 0xBEFA4FA4
+    };
+    static const u32 h1[8] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0, 0, 0, 0
+    };
+
+    sha_ctx.mode = mode & SHA_CNT_MODE;
+    memcpy(sha_ctx.h, (sha_ctx.mode & SHA224_MODE) ? h224 : (sha_ctx.mode & SHA1_MODE) ? h1 : h256, 8*4);
+    sha_ctx.buffered = 0;
+    sha_ctx.length = 0;
+}
+
+void sha_update(const void* src, u32 size)
+{
+    const u8* src8 = (const u8*) src;
+    sha_ctx.length += size;
+
+    if (sha_ctx.buffered) {
+        u32 fill = min(64 - sha_ctx.buffered, size);
+        memcpy(sha_ctx.buffer + sha_ctx.buffered, src8, fill);
+        sha_ctx.buffered += fill;
+        src8 += fill;
+        size -= fill;
+        if (sha_ctx.buffered < 64) return;
+        sha_block(sha_ctx.buffer);
+        sha_ctx.buffered = 0;
+    }
+
+    for (; size >= 64; src8 += 64, size -= 64)
+        sha_block(src8);
+
+    if (size) {
+        memcpy(sha_ctx.buffer, src8, size);
+        sha_ctx.buffered = size;
+    }
+}
+
+void sha_get(void* res) {
+    u32 hash_size = (sha_ctx.mode & SHA224_MODE) ? (224/8) :
+                    (sha_ctx.mode & SHA1_MODE) ? (160/8) : (256/8);
+    u64 bits = sha_ctx.length * 8;
+    u8 pad[64 + 8] = { 0x80 };
+    u32 padlen = ((sha_ctx.buffered < 56) ? 56 : 120) - sha_ctx.buffered;
+
+    for (u32 i = 0; i < 8; i++)
+        pad[padlen + i] = (u8) (bits >> (56 - 8*i));
+    sha_update(pad, padlen + 8);
+
+    for (u32 i = 0; i < hash_size / 4; i++) {
+        u8* out = ((u8*) res) + 4*i;
+        out[0] = (u8) (sha_ctx.h[i] >> 24);
+        out[1] = (u8) (sha_ctx.h[i] >> 16);
+        out[2] = (u8) (sha_ctx.h[i] >> 8);
+        out[3] = (u8) sha_ctx.h[i];
+    }
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include "fsutil.h"
 #include "image.h"
 #include "fatmbr.h"
+#include "sparse.h"
 #include "nand.h"
 #include "game.h"
 #include "disadiff.h"
@@ -49,6 +50,13 @@ u64 IdentifyFileType(const char* path) {
             return NOIMG_NAND; // on NAND, but no proper NAND image
         } else if (ValidateFatHeader(header) == 0) {
             return IMG_FAT; // FAT image file
+        } else if (ValidateSparseHeader((SparseHeader*) data) == 0) {
+            u8 ALIGN(4) sector0[0x200]; // first sector is always stored
+            SparseHeader* sparse = (SparseHeader*) data;
+            if ((fsize >= sparse->offset_data + sparse->stored_size) &&
+                (FileGetData(path, sector0, 0x200, sparse->offset_data) == 0x200) &&
+                ((ValidateFatHeader(sector0) == 0) || (ValidateMbrHeader((MbrHeader*) (void*) sector0) == 0)))
+                return IMG_FAT; // sparse FAT image, mounts read-only
         } else if (ValidateMbrHeader((MbrHeader*) data) == 0) {
             MbrHeader* mbr = (MbrHeader*) data;
             MbrPartitionInfo* partition0 = mbr->partitions;
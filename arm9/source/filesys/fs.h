@@ -8,4 +8,5 @@
 #include "fsperm.h"
 #include "fsutil.h"
 #include "image.h"
+#include "sparse.h"
 #include "vff.h"
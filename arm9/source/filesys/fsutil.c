@@ -7,6 +7,7 @@
 #include "virtual.h"
 #include "image.h"
 #include "sha.h"
+#include "crc32.h"
 #include "sdmmc.h"
 #include "ff.h"
 #include "ui.h"
@@ -18,6 +19,29 @@
 
 #define _MAX_FS_OPT     8 // max file selector options
 
+#define COPY_JOURNAL_MAGIC      "GM9COPYJ"
+#define COPY_JOURNAL_EXT        ".resume"
+#define COPY_CHECKPOINT_SIZE    (16 * 1024 * 1024) // bytes between journal updates
+
+// journal of an interrupted resumable copy, stored next to the destination
+typedef struct {
+    char magic[8];
+    u64  size;      // origin file size
+    u16  fdate;     // origin timestamp
+    u16  ftime;
+    u32  tail_crc;  // CRC32 of the last tail_size bytes before offset
+    u32  tail_size;
+    u32  reserved;
+    u64  offset;    // bytes copied and synced to the destination
+} PACKED_STRUCT CopyJournal;
+
+// state shared by all files of one (recursive) copy
+typedef struct {
+    u64 done;       // bytes processed so far
+    u64 total;      // total bytes of the tree, 0 for per file progress
+    u32 clustsize;  // destination cluster size, smaller files skip preallocation
+} CopyState;
+
 // Volume2Partition resolution table
 PARTITION VolToPart[] = {
     {0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0},
@@ -162,7 +186,10 @@ size_t FileGetSize(const char* path) {
     return fno.fsize;
 }
 
-bool FileGetSha(const char* path, u8* hash, u64 offset, u64 size, bool sha1) {
+// progress goes against the whole copy if state has a total, cancelling fails the hash and sets *cancelled
+static bool FileGetShaWorker(const char* path, u8* hash, u64 offset, u64 size, bool sha1,
+    u8* buffer, u32 bufsiz, const CopyState* state, bool* cancelled) {
+    bool tree = state && state->total;
     bool ret = true;
     FIL file;
     u64 fsize;
@@ -171,79 +198,195 @@ bool FileGetSha(const char* path, u8* hash, u64 offset, u64 size, bool sha1) {
         return false;
 
     fsize = fvx_size(&file);
-    if (offset + size > fsize) return false;
+    if (offset + size > fsize) {
+        fvx_close(&file);
+        return false;
+    }
     if (!size) size = fsize - offset;
     fvx_lseek(&file, offset);
 
-    u32 bufsiz = min(STD_BUFFER_SIZE, fsize);
-    u8* buffer = (u8*) malloc(bufsiz);
-    if (!buffer) return false;
-
-    ShowProgress(0, 0, path);
+    // callers may hash through small buffers, so progress is only a counter update per buffer
+    ProgressCounter prog = { .current = tree ? state->done : 0, .total = tree ? state->total : size, .opstr = path };
+    if (!tree) ShowProgress(0, 0, path);
     sha_init(sha1 ? SHA1_MODE : SHA256_MODE);
     for (u64 pos = 0; (pos < size) && ret; pos += bufsiz) {
         UINT read_bytes = min(bufsiz, size - pos);
         UINT bytes_read = 0;
-        if (fvx_read(&file, buffer, read_bytes, &bytes_read) != FR_OK)
-            ret = false;
-        if (!ShowProgress(pos + bytes_read, size, path))
+        if ((fvx_read(&file, buffer, read_bytes, &bytes_read) != FR_OK) || (bytes_read != read_bytes))
             ret = false;
         sha_update(buffer, bytes_read);
+        if (ret && !ProgressAdd(&prog, bytes_read)) {
+            if (cancelled) *cancelled = true;
+            ret = false;
+        }
     }
 
     sha_get(hash);
     fvx_close(&file);
-    free(buffer);
+    if (!tree) ShowProgress(1, 1, path);
+
+    return ret;
+}
+
+bool FileGetSha(const char* path, u8* hash, u64 offset, u64 size, bool sha1, u8* buffer, u32 bufsiz) {
+    if (buffer) return FileGetShaWorker(path, hash, offset, size, sha1, buffer, bufsiz, NULL, NULL);
 
-    ShowProgress(1, 1, path);
+    buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer) return false;
+    bool ret = FileGetShaWorker(path, hash, offset, size, sha1, buffer, STD_BUFFER_SIZE, NULL, NULL);
+    free(buffer);
 
     return ret;
 }
 
+#define DATA_SEARCH_BMH_MIN     4 // shorter patterns use a first byte scan instead
+
+// precomputed pattern for FileFindData() & co
+typedef struct {
+    const u8* data;
+    const u8* mask; // NULL for exact matches, else only bits set in mask are compared
+    u32 size;
+    u32 shift[256]; // Boyer-Moore-Horspool bad character table
+} DataSearch;
+
+static void DataSearchInit(DataSearch* search, const u8* data, const u8* mask, u32 size) {
+    search->data = data;
+    search->mask = mask;
+    search->size = size;
+
+    // shift by the distance from the last position the character can match at
+    for (u32 c = 0; c < 256; c++) search->shift[c] = size;
+    for (u32 j = 0; j + 1 < size; j++) {
+        if (!mask) search->shift[data[j]] = size - 1 - j;
+        else for (u32 c = 0; c < 256; c++)
+            if (((c ^ data[j]) & mask[j]) == 0) search->shift[c] = size - 1 - j;
+    }
+}
+
+static inline bool DataSearchMatch(const DataSearch* search, const u8* ptr) {
+    if (!search->mask) return (memcmp(ptr, search->data, search->size) == 0);
+    for (u32 j = 0; j < search->size; j++)
+        if ((ptr[j] ^ search->data[j]) & search->mask[j]) return false;
+    return true;
+}
+
+// first match in buffer at or after start, (u32) -1 if not found
+static u32 DataSearchBuffer(const DataSearch* search, const u8* buffer, u32 size, u32 start) {
+    u32 last = search->size - 1;
+    if (start + last >= size) return (u32) -1;
+
+    if (!search->mask && (search->size < DATA_SEARCH_BMH_MIN)) {
+        const u8* end = buffer + size - last;
+        for (const u8* ptr = buffer + start; ptr < end; ptr++) {
+            ptr = memchr(ptr, search->data[0], end - ptr);
+            if (!ptr) break;
+            if (DataSearchMatch(search, ptr)) return ptr - buffer;
+        }
+        return (u32) -1;
+    }
+
+    for (u32 i = start; i + last < size; i += search->shift[buffer[i + last]])
+        if (DataSearchMatch(search, buffer + i)) return i;
+    return (u32) -1;
+}
+
+// search [start, end) of an open file, stops once max_found matches are stored in found
+// data is read sequentially, the last (size - 1) bytes of each chunk are kept for the next one
+static bool FileSearchRange(FIL* file, const char* path, const DataSearch* search, u64 start, u64 end,
+    u8* buffer, u32 bufsiz, u32* found, u32 max_found, u32* n_found, bool* show_progress) {
+    u64 fsize = fvx_size(file);
+    u64 pos = start;
+    u32 keep = 0;
+
+    if (fvx_lseek(file, start) != FR_OK) return false;
+    while (pos < end) {
+        UINT read_bytes = min(bufsiz - keep, end - pos);
+        UINT btr;
+        if ((fvx_read(file, buffer + keep, read_bytes, &btr) != FR_OK) || (btr != read_bytes))
+            return false;
+
+        u64 base = pos - keep; // file offset of buffer[0]
+        u32 len = keep + read_bytes;
+        for (u32 i = 0; (i = DataSearchBuffer(search, buffer, len, i)) != (u32) -1; i++) {
+            found[(*n_found)++] = base + i;
+            if (*n_found >= max_found) return true;
+        }
+
+        pos += read_bytes;
+        keep = min(search->size - 1, len);
+        memmove(buffer, buffer + len - keep, keep);
+
+        if (!*show_progress && (pos < fsize)) {
+            ShowProgress(0, 0, path);
+            *show_progress = true;
+        }
+        if (*show_progress && !ShowProgress(pos, fsize, path))
+            return false;
+    }
+
+    return true;
+}
+
 u32 FileFindData(const char* path, u8* data, u32 size_data, u32 offset_file) {
+    return FileFindDataMasked(path, data, NULL, size_data, offset_file);
+}
+
+u32 FileFindDataMasked(const char* path, const u8* data, const u8* mask, u32 size_data, u32 offset_file) {
     FIL file; // used for FAT & virtual
-    u64 found = (u64) -1;
-    u64 fsize = FileGetSize(path);
+    DataSearch search;
+    bool show_progress = false;
+    u32 found = (u32) -1;
+    u32 n_found = 0;
 
+    if (!size_data || (size_data > STD_BUFFER_SIZE / 2))
+        return found;
     if (fvx_open(&file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK)
         return found;
 
     u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
-    if (!buffer) return false;
-
-    // main routine
-    for (u32 pass = 0; pass < 2; pass++) {
-        bool show_progress = false;
-        u64 pos = (pass == 0) ? offset_file : 0;
-        u64 search_end = (pass == 0) ? fsize : offset_file + size_data;
-        search_end = (search_end > fsize) ? fsize : search_end;
-        for (; (pos < search_end) && (found == (u64) -1); pos += STD_BUFFER_SIZE - (size_data - 1)) {
-            UINT read_bytes = min(STD_BUFFER_SIZE, search_end - pos);
-            UINT btr;
-            fvx_lseek(&file, pos);
-            if ((fvx_read(&file, buffer, read_bytes, &btr) != FR_OK) || (btr != read_bytes))
-                break;
-            for (u32 i = 0; i + size_data <= read_bytes; i++) {
-                if (memcmp(buffer + i, data, size_data) == 0) {
-                    found = pos + i;
-                    break;
-                }
-            }
-            if (!show_progress && (found == (u64) -1) && (pos + read_bytes < fsize)) {
-                ShowProgress(0, 0, path);
-                show_progress = true;
-            }
-            if (show_progress && (!ShowProgress(pos + read_bytes, fsize, path)))
-                break;
-        }
+    if (!buffer) {
+        fvx_close(&file);
+        return found;
     }
 
+    // search from offset to the end first, then wrap around
+    u64 fsize = fvx_size(&file);
+    DataSearchInit(&search, data, mask, size_data);
+    if (FileSearchRange(&file, path, &search, offset_file, fsize, buffer, STD_BUFFER_SIZE, &found, 1, &n_found, &show_progress) && !n_found)
+        FileSearchRange(&file, path, &search, 0, min(offset_file + size_data, fsize), buffer, STD_BUFFER_SIZE, &found, 1, &n_found, &show_progress);
+
     free(buffer);
     fvx_close(&file);
 
     return found;
 }
 
+u32 FileFindAllData(const char* path, const u8* data, const u8* mask, u32 size_data, u32* found, u32 max_found) {
+    FIL file; // used for FAT & virtual
+    DataSearch search;
+    bool show_progress = false;
+    u32 n_found = 0;
+
+    if (!size_data || !max_found || (size_data > STD_BUFFER_SIZE / 2))
+        return 0;
+    if (fvx_open(&file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return 0;
+
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer) {
+        fvx_close(&file);
+        return 0;
+    }
+
+    DataSearchInit(&search, data, mask, size_data);
+    FileSearchRange(&file, path, &search, 0, fvx_size(&file), buffer, STD_BUFFER_SIZE, found, max_found, &n_found, &show_progress);
+
+    free(buffer);
+    fvx_close(&file);
+
+    return n_found;
+}
+
 bool FileInjectFile(const char* dest, const char* orig, u64 off_dest, u64 off_orig, u64 size, u32* flags) {
     FIL ofile;
     FIL dfile;
@@ -295,11 +438,15 @@ bool FileInjectFile(const char* dest, const char* orig, u64 off_dest, u64 off_or
             (bytes_read != bytes_written))
             ret = false;
         if (ret && !ShowProgress(pos + bytes_read, size, orig)) {
-            if (flags && (*flags & NO_CANCEL)) {
-                ShowPrompt(false, "%s", STR_CANCEL_IS_NOT_ALLOWED_HERE);
-            } else ret = !ShowPrompt(true, "%s", STR_B_DETECTED_CANCEL);
-            ShowProgress(0, 0, orig);
-            ShowProgress(pos + bytes_read, size, orig);
+            if (ProgressHookActive()) { // cancelled by the hook owner, no prompt
+                if (!flags || !(*flags & NO_CANCEL)) ret = false;
+            } else {
+                if (flags && (*flags & NO_CANCEL)) {
+                    ShowPrompt(false, "%s", STR_CANCEL_IS_NOT_ALLOWED_HERE);
+                } else ret = !ShowPrompt(true, "%s", STR_B_DETECTED_CANCEL);
+                ShowProgress(0, 0, orig);
+                ShowProgress(pos + bytes_read, size, orig);
+            }
         }
     }
     ShowProgress(1, 1, orig);
@@ -345,11 +492,15 @@ bool FileSetByte(const char* dest, u64 offset, u64 size, u8 fillbyte, u32* flags
             (write_bytes != bytes_written))
             ret = false;
         if (ret && !ShowProgress(pos + bytes_written, size, dest)) {
-            if (flags && (*flags & NO_CANCEL)) {
-                ShowPrompt(false, "%s", STR_CANCEL_IS_NOT_ALLOWED_HERE);
-            } else ret = !ShowPrompt(true, "%s", STR_B_DETECTED_CANCEL);
-            ShowProgress(0, 0, dest);
-            ShowProgress(pos + bytes_written, size, dest);
+            if (ProgressHookActive()) { // cancelled by the hook owner, no prompt
+                if (!flags || !(*flags & NO_CANCEL)) ret = false;
+            } else {
+                if (flags && (*flags & NO_CANCEL)) {
+                    ShowPrompt(false, "%s", STR_CANCEL_IS_NOT_ALLOWED_HERE);
+                } else ret = !ShowPrompt(true, "%s", STR_B_DETECTED_CANCEL);
+                ShowProgress(0, 0, dest);
+                ShowProgress(pos + bytes_written, size, dest);
+            }
         }
     }
     ShowProgress(1, 1, dest);
@@ -386,57 +537,190 @@ bool DirCreate(const char* cpath, const char* dirname) {
     return (fa_stat(npath, NULL) == FR_OK);
 }
 
-bool DirInfoWorker(char* fpath, bool virtual, u64* tsize, u32* tdirs, u32* tfiles) {
+static bool TreeWalkWorker(char* fpath, TreeVisitor* visitors, u32 n_visitors, u8* buffer, bool show_progress) {
     char* fname = fpath + strnlen(fpath, 256 - 1);
     bool ret = true;
-    if (virtual) {
-        VirtualDir vdir;
-        VirtualFile vfile;
-        if (!GetVirtualDir(&vdir, fpath)) return false; // get dir reader object
-        while (ReadVirtualDir(&vfile, &vdir)) {
-            if (vfile.flags & VFLAG_DIR) {
-                (*tdirs)++;
-                *(fname++) = '/';
-                GetVirtualFilename(fname, &vfile, (256 - 1) - (fname - fpath));
-                if (!DirInfoWorker(fpath, virtual, tsize, tdirs, tfiles)) ret = false;
-                *(--fname) = '\0';
-            } else {
-                *tsize += vfile.size;
-                (*tfiles)++;
+    DIR pdir;
+    FILINFO fno;
+
+    if (fvx_opendir(&pdir, fpath) != FR_OK) return false; // get dir reader object
+    *(fname++) = '/';
+    while (ret && (fvx_readdir(&pdir, &fno) == FR_OK)) {
+        if ((strncmp(fno.fname, ".", 2) == 0) || (strncmp(fno.fname, "..", 3) == 0))
+            continue; // filter out virtual entries
+        if (fno.fname[0] == 0) break; // end of dir
+        strncpy(fname, fno.fname, (256 - 1) - (fname - fpath));
+        fpath[255] = '\0';
+
+        if (fno.fattrib & AM_DIR) {
+            u32 res = TV_NEXT;
+            for (u32 i = 0; (i < n_visitors) && (res == TV_NEXT); i++)
+                if (visitors[i].dir) res = visitors[i].dir(fpath, visitors[i].ctx);
+            if (res == TV_ABORT) ret = false;
+            else if ((res != TV_SKIP) && !TreeWalkWorker(fpath, visitors, n_visitors, buffer, show_progress))
+                ret = false;
+            continue;
+        }
+
+        // visitors decide whether they need the file contents
+        u32 n_active = n_visitors;
+        bool want_data = false;
+        bool want[TV_MAX_VISITORS];
+        for (u32 i = 0; i < n_visitors; i++) {
+            u32 res = visitors[i].file ? visitors[i].file(fpath, fno.fsize, visitors[i].ctx) : TV_NEXT;
+            want[i] = (res == TV_READ) && visitors[i].data;
+            want_data |= want[i];
+            if (res == TV_ABORT) ret = false;
+            if ((res == TV_SKIP) || (res == TV_ABORT)) {
+                n_active = i + 1;
+                break;
             }
         }
-    } else {
-        DIR pdir;
-        FILINFO fno;
-        if (fa_opendir(&pdir, fpath) != FR_OK) return false; // get dir reader object
-        while (f_readdir(&pdir, &fno) == FR_OK) {
-            if ((strncmp(fno.fname, ".", 2) == 0) || (strncmp(fno.fname, "..", 3) == 0))
-                continue; // filter out virtual entries
-            if (fno.fname[0] == 0) break; // end of dir
-            if (fno.fattrib & AM_DIR) {
-                (*tdirs)++;
-                *(fname++) = '/';
-                strncpy(fname, fno.fname, (256 - 1) - (fname - fpath));
-                if (!DirInfoWorker(fpath, virtual, tsize, tdirs, tfiles)) ret = false;
-                *(--fname) = '\0';
+        if (!ret) break;
+
+        // open and read the file only once, no matter how many visitors need its contents
+        bool read_ok = true;
+        if (want_data && buffer) {
+            FIL file;
+            if (fvx_open(&file, fpath, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+                read_ok = false;
             } else {
-                *tsize += fno.fsize;
-                (*tfiles)++;
+                u64 fsize = fvx_size(&file);
+                if (show_progress) ShowProgress(0, 0, fpath);
+                for (u64 pos = 0; (pos < fsize) && read_ok; pos += STD_BUFFER_SIZE) {
+                    UINT bytes_read = 0;
+                    if ((fvx_read(&file, buffer, min(STD_BUFFER_SIZE, fsize - pos), &bytes_read) != FR_OK) ||
+                        !bytes_read) {
+                        read_ok = false;
+                        break;
+                    }
+                    for (u32 i = 0; i < n_active; i++)
+                        if (want[i]) visitors[i].data(buffer, bytes_read, visitors[i].ctx);
+                    if (show_progress && !ShowProgress(pos + bytes_read, fsize, fpath))
+                        read_ok = ret = false;
+                }
+                fvx_close(&file);
             }
-        }
-        f_closedir(&pdir);
+        } else if (want_data) read_ok = false;
+
+        for (u32 i = 0; i < n_active; i++)
+            if (visitors[i].done) visitors[i].done(fpath, fno.fsize, read_ok, visitors[i].ctx);
     }
+    fvx_closedir(&pdir);
+    *(--fname) = '\0';
 
     return ret;
 }
 
-bool DirInfo(const char* path, u64* tsize, u32* tdirs, u32* tfiles) {
-    bool virtual = (DriveType(path) & DRV_VIRTUAL);
+static void TreeShaData(const void* data, u32 size, void* ctx);
+
+bool TreeWalk(const char* path, TreeVisitor* visitors, u32 n_visitors, bool show_progress) {
     char fpath[256];
+    u32 n_sha = 0;
+
+    // at most one SHA visitor, more would interleave their hashes on the one SHA engine
+    if (!n_visitors || (n_visitors > TV_MAX_VISITORS)) return false;
+    for (u32 i = 0; i < n_visitors; i++)
+        if (visitors[i].data == TreeShaData) n_sha++;
+    if (n_sha > 1) return false;
+
     strncpy(fpath, path, 256);
     fpath[255] = '\0';
-    *tsize = *tdirs = *tfiles = 0;
-    bool res = DirInfoWorker(fpath, virtual, tsize, tdirs, tfiles);
+
+    // strip trailing slash, separators are added back per entry
+    u32 plen = strnlen(fpath, 255);
+    if (plen && (fpath[plen - 1] == '/')) fpath[plen - 1] = '\0';
+
+    // a read buffer is only needed if any of the visitors hashes or checks file contents
+    u8* buffer = NULL;
+    for (u32 i = 0; i < n_visitors; i++) {
+        if (!visitors[i].data) continue;
+        buffer = (u8*) malloc(STD_BUFFER_SIZE);
+        if (!buffer) return false;
+        break;
+    }
+
+    bool ret = TreeWalkWorker(fpath, visitors, n_visitors, buffer, show_progress);
+    if (buffer) free(buffer);
+    return ret;
+}
+
+static u32 TreeSizeFile(const char* path, u64 size, void* ctx) {
+    (void) path;
+    TreeSizeInfo* info = (TreeSizeInfo*) ctx;
+    info->size += size;
+    info->files++;
+    return TV_NEXT;
+}
+
+static u32 TreeSizeDir(const char* path, void* ctx) {
+    (void) path;
+    ((TreeSizeInfo*) ctx)->dirs++;
+    return TV_NEXT;
+}
+
+void TreeVisitorSize(TreeVisitor* visitor, TreeSizeInfo* info) {
+    memset(visitor, 0, sizeof(TreeVisitor));
+    memset(info, 0, sizeof(TreeSizeInfo));
+    visitor->file = TreeSizeFile;
+    visitor->dir = TreeSizeDir;
+    visitor->ctx = info;
+}
+
+static u32 TreePatternFile(const char* path, u64 size, void* ctx) {
+    (void) size;
+    const char* fname = strrchr(path, '/');
+    fname = fname ? fname + 1 : path;
+    return (fvx_match_name(fname, (const char*) ctx) == FR_OK) ? TV_NEXT : TV_SKIP;
+}
+
+void TreeVisitorPattern(TreeVisitor* visitor, const char* pattern) {
+    memset(visitor, 0, sizeof(TreeVisitor));
+    visitor->file = TreePatternFile;
+    visitor->ctx = (void*) pattern;
+}
+
+static u32 TreeShaFile(const char* path, u64 size, void* ctx) {
+    (void) path;
+    TreeShaInfo* info = (TreeShaInfo*) ctx;
+    info->valid = false;
+    if (!size) return TV_NEXT; // nothing to hash
+    sha_init(info->sha1 ? SHA1_MODE : SHA256_MODE);
+    return TV_READ;
+}
+
+static void TreeShaData(const void* data, u32 size, void* ctx) {
+    (void) ctx;
+    sha_update(data, size);
+}
+
+static void TreeShaDone(const char* path, u64 size, bool read_ok, void* ctx) {
+    (void) path;
+    TreeShaInfo* info = (TreeShaInfo*) ctx;
+    if (!size) return;
+    sha_get(info->hash);
+    info->valid = read_ok;
+}
+
+void TreeVisitorSha(TreeVisitor* visitor, TreeShaInfo* info) {
+    bool sha1 = info->sha1;
+    memset(visitor, 0, sizeof(TreeVisitor));
+    memset(info, 0, sizeof(TreeShaInfo));
+    info->sha1 = sha1;
+    visitor->file = TreeShaFile;
+    visitor->data = TreeShaData;
+    visitor->done = TreeShaDone;
+    visitor->ctx = info;
+}
+
+bool DirInfo(const char* path, u64* tsize, u32* tdirs, u32* tfiles) {
+    TreeVisitor visitor;
+    TreeSizeInfo info;
+    TreeVisitorSize(&visitor, &info);
+    bool res = TreeWalk(path, &visitor, 1, false);
+    *tsize = info.size;
+    *tdirs = info.dirs;
+    *tfiles = info.files;
     return res;
 }
 
@@ -444,12 +728,143 @@ bool PathExist(const char* path) {
     return (fvx_stat(path, NULL) == FR_OK);
 }
 
-bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer, u32 bufsiz) {
+static SyncInfo sync_info = { 0 };
+
+void ResetSyncInfo(void) {
+    memset(&sync_info, 0, sizeof(SyncInfo));
+}
+
+void GetSyncInfo(SyncInfo* info) {
+    memcpy(info, &sync_info, sizeof(SyncInfo));
+}
+
+// FAT timestamp in seconds, with every month counted as 31 days (good enough for near equality)
+static u64 FatTimeSeconds(u16 fdate, u16 ftime) {
+    u32 days = (((fdate >> 9) * 12) + ((fdate >> 5) & 0xF)) * 31 + (fdate & 0x1F);
+    return ((u64) days * 86400) + ((ftime >> 11) * 3600) + (((ftime >> 5) & 0x3F) * 60) + ((ftime & 0x1F) * 2);
+}
+
+static bool PathSyncUnchanged(const char* dest, const char* orig, FILINFO* ofno, FILINFO* dfno, bool hash,
+    u8* buffer, u32 bufsiz, const CopyState* state, bool* cancelled) {
+    if (ofno->fsize != dfno->fsize) return false;
+    if (!ofno->fsize) return true; // nothing to compare
+
+    // virtual files have no meaningful timestamps, compare hashes instead
+    // otherwise the destination keeps the origin timestamp from the last sync, if either side was
+    // modified since then they differ (by more than the 2 second FAT resolution)
+    if ((ofno->fattrib | dfno->fattrib) & AM_VRT) hash = true;
+    else {
+        u64 otime = FatTimeSeconds(ofno->fdate, ofno->ftime);
+        u64 dtime = FatTimeSeconds(dfno->fdate, dfno->ftime);
+        if (((otime > dtime) ? otime - dtime : dtime - otime) > 2) return false;
+    }
+
+    if (hash) {
+        u8 ohash[0x20];
+        u8 dhash[0x20];
+        if (!FileGetShaWorker(orig, ohash, 0, 0, false, buffer, bufsiz, state, cancelled) ||
+            !FileGetShaWorker(dest, dhash, 0, 0, false, buffer, bufsiz, state, cancelled))
+            return false;
+        return (memcmp(ohash, dhash, 0x20) == 0);
+    }
+
+    return true;
+}
+
+static bool PathSyncPurge(char* dest, char* orig) {
+    DIR pdir;
+    FILINFO fno;
+    char* oname = orig + strnlen(orig, 255);
+    char* dname = dest + strnlen(dest, 255);
+    bool ret = true;
+
+    if (fvx_opendir(&pdir, dest) != FR_OK)
+        return false;
+
+    while (ret && (fvx_readdir(&pdir, &fno) == FR_OK) && *(fno.fname)) {
+        if ((strncmp(fno.fname, ".", 2) == 0) || (strncmp(fno.fname, "..", 3) == 0))
+            continue; // filter out virtual entries
+        snprintf(oname, 256 - (oname - orig), "/%s", fno.fname);
+        if (fvx_stat(orig, NULL) == FR_OK) continue; // exists in origin
+        snprintf(dname, 256 - (dname - dest), "/%s", fno.fname);
+        if (PathDelete(dest)) sync_info.deleted++;
+        else ret = false;
+    }
+
+    fvx_closedir(&pdir);
+    *oname = '\0';
+    *dname = '\0';
+    return ret;
+}
+
+static void InitCopyState(CopyState* state, const char* dest, const char* orig, bool rename) {
+    FATFS* fsobj = GetMountedFSObject(dest);
+    FILINFO fno;
+    u64 tsize = 0;
+    u32 tdirs = 0;
+    u32 tfiles = 0;
+
+    memset(state, 0, sizeof(CopyState));
+    if (!GetVirtualSource(dest) && fsobj)
+        state->clustsize = fsobj->csize * FF_MAX_SS;
+
+    // one progress bar for the whole tree, per file redraws dominate small file copies
+    // (not needed when moving by rename)
+    if (!rename && (fvx_stat(orig, &fno) == FR_OK) && (fno.fattrib & AM_DIR) &&
+        DirInfo(orig, &tsize, &tdirs, &tfiles))
+        state->total = tsize;
+}
+
+bool CopyResumable(const char* path) {
+    char jpath[256];
+    snprintf(jpath, sizeof(jpath), "%s" COPY_JOURNAL_EXT, path);
+    return (fvx_stat(jpath, NULL) == FR_OK);
+}
+
+static bool WriteCopyJournal(const char* jpath, FILINFO* ofno, u64 offset, const u8* tail, u32 tail_size) {
+    CopyJournal journal = { 0 };
+    memcpy(journal.magic, COPY_JOURNAL_MAGIC, sizeof(journal.magic));
+    journal.size = ofno->fsize;
+    journal.fdate = ofno->fdate;
+    journal.ftime = ofno->ftime;
+    journal.tail_crc = crc32_calculate(~0, tail, tail_size);
+    journal.tail_size = tail_size;
+    journal.offset = offset;
+    return FileSetData(jpath, &journal, sizeof(CopyJournal), 0, false);
+}
+
+static u64 GetCopyResumeOffset(const char* jpath, const char* dest, const char* orig, FILINFO* ofno, u8* buffer, u32 bufsiz) {
+    CopyJournal journal;
+    FILINFO dfno;
+
+    // origin has to be the same file, destination has to hold everything up to the checkpoint
+    if ((FileGetData(jpath, &journal, sizeof(CopyJournal), 0) != sizeof(CopyJournal)) ||
+        (memcmp(journal.magic, COPY_JOURNAL_MAGIC, sizeof(journal.magic)) != 0) ||
+        (journal.size != ofno->fsize) || (journal.fdate != ofno->fdate) || (journal.ftime != ofno->ftime) ||
+        (journal.offset > journal.size) || (journal.tail_size > journal.offset) || (journal.tail_size > bufsiz) ||
+        (fvx_stat(dest, &dfno) != FR_OK) || (dfno.fsize < journal.offset))
+        return 0;
+
+    // cheap check of the copied data: the last chunk before the checkpoint, in both files
+    size_t tail_offset = journal.offset - journal.tail_size;
+    if ((FileGetData(orig, buffer, journal.tail_size, tail_offset) != journal.tail_size) ||
+        (crc32_calculate(~0, buffer, journal.tail_size) != journal.tail_crc) ||
+        (FileGetData(dest, buffer, journal.tail_size, tail_offset) != journal.tail_size) ||
+        (crc32_calculate(~0, buffer, journal.tail_size) != journal.tail_crc))
+        return 0;
+
+    return journal.offset;
+}
+
+bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer, u32 bufsiz, CopyState* state) {
     bool to_virtual = GetVirtualSource(dest);
     bool silent = (flags && (*flags & SILENT));
     bool append = (flags && (*flags & APPEND_ALL));
     bool calcsha = (flags && (*flags & CALC_SHA) && !append);
     bool sha1 = (flags && (*flags & USE_SHA1));
+    bool sync = (flags && (*flags & SYNC_ALL) && !move);
+    bool resume = (flags && (*flags & ALLOW_RESUME) && !move && !append && !to_virtual);
+    bool tree = (state->total > 0);
     bool ret = false;
 
     // check destination write permission (special paths only)
@@ -466,8 +881,8 @@ bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer,
     TruncateString(deststr, dest, 36, 8);
 
     // the copy process takes place here
-    if (!ShowProgress(0, 0, orig) && !(flags && (*flags & NO_CANCEL))) {
-        if (ShowPrompt(true, "%s\n%s", deststr, STR_B_DETECTED_CANCEL)) return false;
+    if (!ShowProgress(state->done, state->total, orig) && !(flags && (*flags & NO_CANCEL))) {
+        if (ProgressHookActive() || ShowPrompt(true, "%s\n%s", deststr, STR_B_DETECTED_CANCEL)) return false;
         ShowProgress(0, 0, orig);
     }
     if (move && fvx_stat(dest, NULL) != FR_OK) { // moving if dest not existing
@@ -506,7 +921,7 @@ bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer,
                 char* dname = dest + strnlen(dest, 255);
                 if (oname == NULL) return false; // not a proper origin path
                 strncpy(dname, oname, 256 - (dname - dest)); // copy name plus preceding '/'
-                bool res = PathMoveCopyRec(dest, orig, flags, move, buffer, bufsiz);
+                bool res = PathMoveCopyRec(dest, orig, flags, move, buffer, bufsiz, state);
                 *dname = '\0';
                 if (!res) break;
             }
@@ -514,6 +929,10 @@ bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer,
 
         fvx_closedir(&pdir);
         *(--fname) = '\0';
+
+        // remove whatever is no longer in the origin folder
+        if (ret && sync && !to_virtual && (*flags & SYNC_PURGE))
+            ret = PathSyncPurge(dest, orig);
     } else if (move) { // moving if destination exists
         if (fvx_stat(dest, &fno) != FR_OK) return false;
         if (fno.fattrib & AM_DIR) {
@@ -527,6 +946,24 @@ bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer,
         FIL dfile;
         u64 osize;
         u64 dsize;
+        u64 offset = 0; // continue an interrupted copy from here
+        u64 checkpoint = 0; // last offset recorded in the journal
+        char jpath[256];
+
+        if (sync) { // leave unchanged files alone
+            FILINFO dfno;
+            bool cancelled = false;
+            if ((fvx_stat(dest, &dfno) == FR_OK) && !(dfno.fattrib & AM_DIR) &&
+                PathSyncUnchanged(dest, orig, &fno, &dfno, *flags & SYNC_HASH, buffer, bufsiz, state, &cancelled)) {
+                sync_info.skipped++;
+                state->done += fno.fsize;
+                return true;
+            }
+            // without a confirmed cancel the file counts as changed and gets copied
+            if (cancelled && !(*flags & NO_CANCEL) &&
+                (ProgressHookActive() || ShowPrompt(true, "%s\n%s", deststr, STR_B_DETECTED_CANCEL)))
+                return false;
+        }
 
         if (fvx_open(&ofile, orig, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
             if (!FileUnlock(orig) || (fvx_open(&ofile, orig, FA_READ | FA_OPEN_EXISTING) != FR_OK))
@@ -534,7 +971,14 @@ bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer,
             ShowProgress(0, 0, orig); // reinit progress bar
         }
 
-        if ((!append || (fvx_open(&dfile, dest, FA_WRITE | FA_OPEN_EXISTING) != FR_OK)) &&
+        if (resume) {
+            snprintf(jpath, sizeof(jpath), "%s" COPY_JOURNAL_EXT, dest);
+            offset = checkpoint = GetCopyResumeOffset(jpath, dest, orig, &fno, buffer, bufsiz);
+        }
+
+        if (offset && (fvx_open(&dfile, dest, FA_WRITE | FA_OPEN_EXISTING) != FR_OK))
+            offset = checkpoint = 0;
+        if (!offset && (!append || (fvx_open(&dfile, dest, FA_WRITE | FA_OPEN_EXISTING) != FR_OK)) &&
             (fvx_open(&dfile, dest, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) {
             if (!silent) ShowPrompt(false, "%s\n%s", deststr, STR_ERROR_CANNOT_OPEN_DESTINATION_FILE);
             fvx_close(&ofile);
@@ -544,50 +988,91 @@ bool PathMoveCopyRec(char* dest, char* orig, u32* flags, bool move, u8* buffer,
         ret = true; // destination file exists by now, so we need to handle deletion
         osize = fvx_size(&ofile);
         dsize = append ? fvx_size(&dfile) : 0; // always 0 if not appending to file
-        if ((fvx_lseek(&dfile, (osize + dsize)) != FR_OK) || (fvx_sync(&dfile) != FR_OK) || (fvx_tell(&dfile) != (osize + dsize))) { // check space via cluster preallocation
-            if (!silent) ShowPrompt(false, "%s\n%s", deststr, STR_ERROR_NOT_ENOUGH_SPACE_AVAILABLE);
-            ret = false;
-        }
 
-        fvx_lseek(&dfile, dsize);
-        fvx_sync(&dfile);
+        // files smaller than a cluster skip preallocation, a full volume shows up as a short write
+        // this saves two FAT & directory entry updates per file
+        if (append || (osize >= state->clustsize)) {
+            if ((fvx_lseek(&dfile, (osize + dsize)) != FR_OK) || (fvx_sync(&dfile) != FR_OK) || (fvx_tell(&dfile) != (osize + dsize))) { // check space via cluster preallocation
+                if (!silent) ShowPrompt(false, "%s\n%s", deststr, STR_ERROR_NOT_ENOUGH_SPACE_AVAILABLE);
+                ret = false;
+            }
+
+            fvx_lseek(&dfile, dsize + offset);
+            fvx_sync(&dfile);
+        }
         fvx_lseek(&ofile, 0);
         fvx_sync(&ofile);
 
-        if (calcsha) sha_init(sha1 ? SHA1_MODE : SHA256_MODE);
-        for (u64 pos = 0; (pos < osize) && ret; pos += bufsiz) {
+        if (calcsha) {
+            sha_init(sha1 ? SHA1_MODE : SHA256_MODE);
+            for (u64 pos = 0; (pos < offset) && ret; pos += bufsiz) { // rehash the part copied before
+                UINT bytes_read = 0;
+                if (fvx_read(&ofile, buffer, min(bufsiz, offset - pos), &bytes_read) != FR_OK)
+                    ret = false;
+                sha_update(buffer, bytes_read);
+                ShowProgress(pos + bytes_read, osize, orig);
+            }
+        }
+        fvx_lseek(&ofile, offset);
+
+        for (u64 pos = offset; (pos < osize) && ret; pos += bufsiz) {
             UINT bytes_read = 0;
             UINT bytes_written = 0;
             if ((fvx_read(&ofile, buffer, bufsiz, &bytes_read) != FR_OK) ||
-                (fvx_write(&dfile, buffer, bytes_read, &bytes_written) != FR_OK) ||
-                (bytes_read != bytes_written))
+                (fvx_write(&dfile, buffer, bytes_read, &bytes_written) != FR_OK)) {
+                ret = false;
+            } else if (bytes_read != bytes_written) {
+                if (!silent) ShowPrompt(false, "%s\n%s", deststr, STR_ERROR_NOT_ENOUGH_SPACE_AVAILABLE);
                 ret = false;
+            } else if (resume && (pos + bytes_read < osize) && (pos + bytes_read - checkpoint >= COPY_CHECKPOINT_SIZE)) {
+                // data has to be on disk before the journal points past it
+                if ((fvx_sync(&dfile) == FR_OK) && WriteCopyJournal(jpath, &fno, pos + bytes_read, buffer, bytes_read))
+                    checkpoint = pos + bytes_read;
+            }
 
-            u64 current = pos + bytes_read;
-            u64 total = osize;
+            u64 current = tree ? state->done + pos + bytes_read : pos + bytes_read;
+            u64 total = tree ? state->total : osize;
             if (ret && !ShowProgress(current, total, orig)) {
-                if (flags && (*flags & NO_CANCEL)) {
-                    ShowPrompt(false, "%s\n%s", deststr, STR_CANCEL_IS_NOT_ALLOWED_HERE);
-                } else ret = !ShowPrompt(true, "%s\n%s", deststr, STR_B_DETECTED_CANCEL);
-                ShowProgress(0, 0, orig);
-                ShowProgress(current, total, orig);
+                if (ProgressHookActive()) { // cancelled by the hook owner, no prompt
+                    if (!flags || !(*flags & NO_CANCEL)) ret = false;
+                } else {
+                    if (flags && (*flags & NO_CANCEL)) {
+                        ShowPrompt(false, "%s\n%s", deststr, STR_CANCEL_IS_NOT_ALLOWED_HERE);
+                    } else ret = !ShowPrompt(true, "%s\n%s", deststr, STR_B_DETECTED_CANCEL);
+                    ShowProgress(0, 0, orig);
+                    ShowProgress(current, total, orig);
+                }
             }
             if (calcsha)
                 sha_update(buffer, bytes_read);
         }
-        ShowProgress(1, 1, orig);
+        if (!tree) ShowProgress(1, 1, orig);
+        state->done += osize;
 
         fvx_close(&ofile);
+        // a failed resumable copy is kept up to the checkpoint, without the preallocated rest
+        if (!ret && checkpoint && ((fvx_lseek(&dfile, dsize + checkpoint) != FR_OK) || (f_truncate(&dfile) != FR_OK)))
+            checkpoint = 0; // can't give the space back, so don't keep it
         fvx_close(&dfile);
-        if (!ret && ((dsize == 0) || (fvx_lseek(&dfile, dsize) != FR_OK) || (f_truncate(&dfile) != FR_OK))) {
+        if (!ret && !checkpoint && ((dsize == 0) || (fvx_lseek(&dfile, dsize) != FR_OK) || (f_truncate(&dfile) != FR_OK))) {
             fvx_unlink(dest);
-        } else if (!to_virtual && calcsha) {
+        } else if (ret && !to_virtual && calcsha) {
             u8 hash[0x20];
             char* ext_sha = dest + strnlen(dest, 256);
             snprintf(ext_sha, 256 - (ext_sha - dest), ".sha%c", sha1 ? '1' : '\0');
             sha_get(hash);
             FileSetData(dest, hash, sha1 ? 20 : 32, 0, true);
         }
+
+        if (resume && (ret || !checkpoint))
+            fvx_unlink(jpath);
+
+        if (ret && sync) {
+            // keep the origin timestamp, so the next sync sees the file as unchanged
+            if (DriveType(dest) & DRV_STDFAT) f_utime(dest, &fno);
+            sync_info.copied++;
+            sync_info.bytes += osize;
+        }
     }
 
     return ret;
@@ -603,6 +1088,9 @@ bool PathMoveCopy(const char* dest, const char* orig, u32* flags, bool move) {
     // reset local flags
     if (flags) *flags = *flags & ~(SKIP_CUR|OVERWRITE_CUR);
 
+    // sync mode overwrites changed files in place
+    if (flags && (*flags & SYNC_ALL)) *flags &= ~(APPEND_ALL|CALC_SHA);
+
     // preparations
     int ddrvtype = DriveType(dest);
     int odrvtype = DriveType(orig);
@@ -638,8 +1126,9 @@ bool PathMoveCopy(const char* dest, const char* orig, u32* flags, bool move) {
                 return false;
         }
 
-        // check if destination exists
-        if (flags && !(*flags & (OVERWRITE_CUR|OVERWRITE_ALL|APPEND_ALL)) && (fa_stat(ldest, NULL) == FR_OK)) {
+        // check if destination exists (an interrupted copy is continued without asking)
+        bool resumable = (flags && (*flags & ALLOW_RESUME) && CopyResumable(ldest));
+        if (flags && !resumable && !(*flags & (OVERWRITE_CUR|OVERWRITE_ALL|APPEND_ALL|SYNC_ALL)) && (fa_stat(ldest, NULL) == FR_OK)) {
             if (*flags & SKIP_ALL) {
                 *flags |= SKIP_CUR;
                 return true;
@@ -678,8 +1167,10 @@ bool PathMoveCopy(const char* dest, const char* orig, u32* flags, bool move) {
         }
 
         // actual move / copy operation
+        CopyState state;
         bool same_drv = (strncasecmp(lorig, ldest, 2) == 0);
-        bool res = PathMoveCopyRec(ldest, lorig, flags, move && same_drv, buffer, STD_BUFFER_SIZE);
+        InitCopyState(&state, ldest, lorig, move && same_drv);
+        bool res = PathMoveCopyRec(ldest, lorig, flags, move && same_drv, buffer, STD_BUFFER_SIZE, &state);
         if (move && res && (!flags || !(*flags&SKIP_CUR))) PathDelete(lorig);
 
         free(buffer);
@@ -717,8 +1208,10 @@ bool PathMoveCopy(const char* dest, const char* orig, u32* flags, bool move) {
         }
 
         // actual virtual copy operation
+        CopyState state;
         if (force_unmount) DismountDriveType(DriveType(ldest)&(DRV_SYSNAND|DRV_EMUNAND|DRV_IMAGE));
-        bool res = PathMoveCopyRec(ldest, lorig, flags, false, buffer, STD_BUFFER_SIZE);
+        InitCopyState(&state, ldest, lorig, false);
+        bool res = PathMoveCopyRec(ldest, lorig, flags, false, buffer, STD_BUFFER_SIZE, &state);
         if (force_unmount) InitExtFS();
 
         free(buffer);
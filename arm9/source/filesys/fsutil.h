@@ -14,6 +14,17 @@
 #define SKIP_ALL        (1UL<<8)
 #define OVERWRITE_ALL   (1UL<<9)
 #define APPEND_ALL      (1UL<<10)
+#define SYNC_ALL        (1UL<<13) // only copy new or changed files
+#define SYNC_HASH       (1UL<<14) // compare file hashes in sync mode
+#define SYNC_PURGE      (1UL<<15) // delete orphans at destination in sync mode
+#define ALLOW_RESUME    (1UL<<16) // keep a journal, continue interrupted copies
+
+// tree walk visitor results
+#define TV_NEXT         0 // continue with the next visitor
+#define TV_READ         1 // file contents should be passed to data()
+#define TV_SKIP         2 // skip this entry for all following visitors
+#define TV_ABORT        3 // stop walking the tree
+#define TV_MAX_VISITORS 8 // visitors per tree walk
 
 // file selector flags
 #define NO_DIRS         (1UL<<0)
@@ -21,6 +32,34 @@
 #define HIDE_EXT        (1UL<<2)
 #define SELECT_DIRS     (1UL<<3)
 
+// tree walk visitor, all callbacks are optional
+// file() / dir() are called in visitor order, data() & done() only for visitors not skipped
+typedef struct {
+    u32  (*file)(const char* path, u64 size, void* ctx);
+    u32  (*dir)(const char* path, void* ctx);
+    void (*data)(const void* data, u32 size, void* ctx);
+    void (*done)(const char* path, u64 size, bool read_ok, void* ctx);
+    void* ctx;
+} TreeVisitor;
+
+typedef struct {
+    u64 size;
+    u32 dirs;
+    u32 files;
+} TreeSizeInfo;
+
+typedef struct {
+    u8 hash[0x20];
+    bool sha1;
+    bool valid; // false for empty or unreadable files
+} TreeShaInfo;
+
+typedef struct {
+    u64 bytes;   // bytes copied
+    u32 copied;  // new or changed files
+    u32 skipped; // unchanged files
+    u32 deleted; // orphans removed from the destination
+} SyncInfo;
 
 /** Return total size of SD card **/
 uint64_t GetSDCardSize();
@@ -43,11 +82,15 @@ size_t FileGetData(const char* path, void* data, size_t size, size_t foffset);
 /** Get size of file **/
 size_t FileGetSize(const char* path);
 
-/** Get SHA-256 of file **/
-bool FileGetSha(const char* path, u8* hash, u64 offset, u64 size, bool sha1);
+/** Get SHA-256 (or SHA-1) of file, buffer may be NULL (allocated then) **/
+bool FileGetSha(const char* path, u8* hash, u64 offset, u64 size, bool sha1, u8* buffer, u32 bufsiz);
 
-/** Find data in file **/
+/** Find data in file, mask (may be NULL) selects the bits to compare **/
 u32 FileFindData(const char* path, u8* data, u32 size_data, u32 offset_file);
+u32 FileFindDataMasked(const char* path, const u8* data, const u8* mask, u32 size_data, u32 offset_file);
+
+/** Find all offsets of data in file (up to max_found), returns # of matches **/
+u32 FileFindAllData(const char* path, const u8* data, const u8* mask, u32 size_data, u32* found, u32 max_found);
 
 /** Inject file into file @offset **/
 bool FileInjectFile(const char* dest, const char* orig, u64 off_dest, u64 off_orig, u64 size, u32* flags);
@@ -64,18 +107,35 @@ bool DirCreate(const char* cpath, const char* dirname);
 /** Get # of files, subdirs and total size for directory **/
 bool DirInfo(const char* path, u64* tsize, u32* tdirs, u32* tfiles);
 
+/** Walk a directory tree once, running all visitors (1 ... TV_MAX_VISITORS) on each entry **/
+bool TreeWalk(const char* path, TreeVisitor* visitors, u32 n_visitors, bool show_progress);
+
+/** Stock tree walk visitors: size accounting, name pattern filter, SHA hashing
+ *  The SHA visitor holds the one SHA engine from file() to done(), so a walk takes only one of
+ *  them, and it goes after visitors that use the engine in their own file() callback **/
+void TreeVisitorSize(TreeVisitor* visitor, TreeSizeInfo* info);
+void TreeVisitorPattern(TreeVisitor* visitor, const char* pattern);
+void TreeVisitorSha(TreeVisitor* visitor, TreeShaInfo* info);
+
 /** True if path exists **/
 bool PathExist(const char* path);
 
 /** Direct recursive move / copy of files or directories **/
 bool PathMoveCopy(const char* dest, const char* orig, u32* flags, bool move);
 
+/** True if an interrupted copy to path can be resumed **/
+bool CopyResumable(const char* path);
+
 /** Recursively copy a file or directory **/
 bool PathCopy(const char* destdir, const char* orig, u32* flags);
 
 /** Recursively move a file or directory **/
 bool PathMove(const char* destdir, const char* orig, u32* flags);
 
+/** Reset / get the file counters of copies in sync mode **/
+void ResetSyncInfo(void);
+void GetSyncInfo(SyncInfo* info);
+
 /** Recursively delete a file or directory **/
 bool PathDelete(const char* path);
 
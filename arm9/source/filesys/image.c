@@ -1,9 +1,11 @@
 #include "image.h"
 #include "vff.h"
 #include "nandcmac.h"
+#include "sparse.h"
 
 static FIL mount_file;
 static u64 mount_state = 0;
+static SparseImage* mount_sparse = NULL; // sparse images are mounted read-only
 
 static char mount_path[256] = { 0 };
 
@@ -15,6 +17,7 @@ int ReadImageBytes(void* buffer, u64 offset, u64 count) {
     UINT ret;
     if (!count) return -1;
     if (!mount_state) return FR_INVALID_OBJECT;
+    if (mount_sparse) return ReadSparseImageBytes(&mount_file, mount_sparse, buffer, offset, count);
     if (fvx_tell(&mount_file) != offset) {
         if (fvx_size(&mount_file) < offset) return -1;
         fvx_lseek(&mount_file, offset);
@@ -28,6 +31,7 @@ int WriteImageBytes(const void* buffer, u64 offset, u64 count) {
     UINT ret;
     if (!count) return -1;
     if (!mount_state) return FR_INVALID_OBJECT;
+    if (mount_sparse) return FR_WRITE_PROTECTED;
     if (fvx_tell(&mount_file) != offset)
         fvx_lseek(&mount_file, offset);
     ret = fvx_write(&mount_file, buffer, count, &bytes_written);
@@ -48,7 +52,7 @@ int SyncImage(void) {
 }
 
 u64 GetMountSize(void) {
-    return mount_state ? fvx_size(&mount_file) : 0;
+    return !mount_state ? 0 : mount_sparse ? mount_sparse->header.image_size : fvx_size(&mount_file);
 }
 
 u64 GetMountState(void) {
@@ -62,6 +66,8 @@ const char* GetMountPath(void) {
 u64 MountImage(const char* path) {
     if (mount_state) {
         fvx_close(&mount_file);
+        CloseSparseImage(mount_sparse);
+        mount_sparse = NULL;
         if (fix_cmac) FixFileCmac(mount_path, false);
         fix_cmac = false;
         mount_state = 0;
@@ -72,6 +78,7 @@ u64 MountImage(const char* path) {
     if ((fvx_open(&mount_file, path, FA_READ | FA_WRITE | FA_OPEN_EXISTING) != FR_OK) &&
         (fvx_open(&mount_file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK))
         return 0;
+    mount_sparse = OpenSparseImage(&mount_file);
     fvx_lseek(&mount_file, 0);
     fvx_sync(&mount_file);
     strncpy(mount_path, path, 256);
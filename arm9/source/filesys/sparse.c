@@ -0,0 +1,300 @@
+#include "sparse.h"
+#include "fatmbr.h"
+#include "ui.h"
+
+#define SPARSE_BITMAP_WORDS(n)  (((n) + 31) / 32)
+
+static inline bool SparseBlockUsed(const u32* bitmap, u32 block) {
+    return (bitmap[block >> 5] >> (block & 0x1F)) & 1;
+}
+
+// marks all blocks touching [start, end) as used
+static void SparseMarkUsed(u32* bitmap, u32 block_count, u64 start, u64 end) {
+    if (end <= start) return;
+    u32 b0 = start / SPARSE_BLOCK_SIZE;
+    u32 b1 = min((end + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE, block_count);
+    for (u32 b = b0; b < b1; b++)
+        bitmap[b >> 5] |= 1u << (b & 0x1F);
+}
+
+u32 ValidateSparseHeader(SparseHeader* header) {
+    const u8 magic[8] = { SPARSE_MAGIC };
+    if ((memcmp(header->magic, magic, 8) != 0) || (header->version != SPARSE_VERSION) ||
+        (header->block_size != SPARSE_BLOCK_SIZE) ||
+        (header->block_count != (header->image_size + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE) ||
+        (header->offset_data < sizeof(SparseHeader) + (SPARSE_BITMAP_WORDS(header->block_count) * 4)))
+        return 1;
+    return 0;
+}
+
+// marks the system area and all allocated clusters of the FAT partition at offset
+// anything that can't be parsed is left for the caller to keep
+static u32 SparseMarkFatPartition(FIL* file, u32* bitmap, u32 block_count, u64 offset, u64 size, u8* buffer) {
+    UINT br;
+
+    fvx_lseek(file, offset);
+    if ((fvx_read(file, buffer, 0x200, &br) != FR_OK) || (br != 0x200) || (ValidateFatHeader(buffer) != 0))
+        return 1;
+
+    u32 sct_size = getle16(buffer + 0x0B);
+    u32 clr_size = buffer[0x0D];
+    u32 sct_reserved = getle16(buffer + 0x0E);
+    u32 fat_n = buffer[0x10];
+    u32 root_n = getle16(buffer + 0x11);
+    u32 sct_total = getle16(buffer + 0x13);
+    u32 fat_size = getle16(buffer + 0x16);
+    if (!sct_total) sct_total = getle32(buffer + 0x20);
+    if (!fat_size) fat_size = getle32(buffer + 0x24); // FAT32
+    if ((sct_size < 0x200) || (sct_size > 0x1000) || (sct_size & (sct_size - 1)) ||
+        !clr_size || !fat_n || !fat_size || ((u64) sct_total * sct_size > size))
+        return 1;
+
+    u32 sct_data = sct_reserved + (fat_n * fat_size) + (((root_n * 32) + sct_size - 1) / sct_size);
+    if (sct_data >= sct_total) return 1;
+    u32 n_clusters = (sct_total - sct_data) / clr_size;
+    u32 fat_bits = (n_clusters < 4085) ? 12 : (n_clusters < 65525) ? 16 : 32;
+    if ((((u64) (n_clusters + 2) * fat_bits) + 7) / 8 > (u64) fat_size * sct_size) return 1;
+
+    u64 clr_bytes = (u64) clr_size * sct_size;
+    u64 data_start = offset + ((u64) sct_data * sct_size);
+    u64 data_end = data_start + (n_clusters * clr_bytes);
+
+    // reserved sectors, FATs, root dir and whatever is behind the last cluster
+    SparseMarkUsed(bitmap, block_count, offset, data_start);
+    SparseMarkUsed(bitmap, block_count, data_end, offset + size);
+
+    // walk the first FAT, entries are handled in chunks that never split one
+    u32 fat_bytes = (((n_clusters + 2) * fat_bits) + 7) / 8;
+    u32 chunk_size = (fat_bits == 12) ? fat_bytes : STD_BUFFER_SIZE;
+    if (chunk_size > STD_BUFFER_SIZE) return 1;
+    fvx_lseek(file, offset + ((u64) sct_reserved * sct_size));
+    for (u32 pos = 0; pos < fat_bytes; pos += chunk_size) {
+        u32 count = min(chunk_size, fat_bytes - pos);
+        if ((fvx_read(file, buffer, count, &br) != FR_OK) || (br != count)) return 1;
+
+        u32 c0 = (pos * 8) / fat_bits;
+        u32 c1 = min(((pos + count) * 8) / fat_bits, n_clusters + 2);
+        for (u32 c = max(c0, 2); c < c1; c++) {
+            u32 i = c - c0;
+            u32 entry;
+            if (fat_bits == 32) entry = getle32(buffer + (i * 4)) & 0x0FFFFFFF;
+            else if (fat_bits == 16) entry = getle16(buffer + (i * 2));
+            else entry = (getle16(buffer + ((c * 3) / 2)) >> ((c & 1) ? 4 : 0)) & 0xFFF;
+            if (!entry) continue; // free cluster
+            u64 clr_start = data_start + ((u64) (c - 2) * clr_bytes);
+            SparseMarkUsed(bitmap, block_count, clr_start, clr_start + clr_bytes);
+        }
+    }
+
+    return 0;
+}
+
+// marks everything to keep in a FAT image or an MBR image with FAT partitions
+static u32 SparseMarkImage(FIL* file, u32* bitmap, u32 block_count, u64 image_size, u8* buffer) {
+    UINT br;
+
+    fvx_lseek(file, 0);
+    if ((fvx_read(file, buffer, 0x200, &br) != FR_OK) || (br != 0x200))
+        return 1;
+
+    if (ValidateFatHeader(buffer) == 0) {
+        if (SparseMarkFatPartition(file, bitmap, block_count, 0, image_size, buffer) != 0)
+            SparseMarkUsed(bitmap, block_count, 0, image_size);
+    } else if (ValidateMbrHeader((MbrHeader*) (void*) buffer) == 0) {
+        MbrPartitionInfo partitions[4];
+        memcpy(partitions, ((MbrHeader*) (void*) buffer)->partitions, sizeof(partitions));
+        u64 covered = 0;
+        for (u32 p = 0; p < 4; p++) {
+            u64 p_offset = (u64) partitions[p].sector * 0x200;
+            u64 p_size = (u64) partitions[p].count * 0x200;
+            if (!p_size) continue;
+            if (p_offset + p_size > image_size) p_size = (p_offset < image_size) ? image_size - p_offset : 0;
+            SparseMarkUsed(bitmap, block_count, covered, p_offset); // MBR and gaps
+            if (SparseMarkFatPartition(file, bitmap, block_count, p_offset, p_size, buffer) != 0)
+                SparseMarkUsed(bitmap, block_count, p_offset, p_offset + p_size);
+            covered = p_offset + p_size;
+        }
+        SparseMarkUsed(bitmap, block_count, covered, image_size);
+    } else return 1; // not a FAT image
+
+    return 0;
+}
+
+SparseImage* OpenSparseImage(FIL* file) {
+    SparseHeader header;
+    UINT br;
+
+    fvx_lseek(file, 0);
+    if ((fvx_read(file, &header, sizeof(SparseHeader), &br) != FR_OK) || (br != sizeof(SparseHeader)) ||
+        (ValidateSparseHeader(&header) != 0) || (fvx_size(file) < header.offset_data + header.stored_size))
+        return NULL;
+
+    u32 n_words = SPARSE_BITMAP_WORDS(header.block_count);
+    SparseImage* sparse = (SparseImage*) malloc(sizeof(SparseImage) + (n_words * 4 * 2));
+    if (!sparse) return NULL;
+    memcpy(&(sparse->header), &header, sizeof(SparseHeader));
+    sparse->bitmap = (u32*) (void*) (sparse + 1);
+    sparse->rank = sparse->bitmap + n_words;
+
+    if ((fvx_read(file, sparse->bitmap, n_words * 4, &br) != FR_OK) || (br != n_words * 4)) {
+        free(sparse);
+        return NULL;
+    }
+
+    // stored blocks before each word, gives the data offset of any block
+    u32 rank = 0;
+    for (u32 i = 0; i < n_words; i++) {
+        sparse->rank[i] = rank;
+        rank += __builtin_popcount(sparse->bitmap[i]);
+    }
+    if ((u64) rank * SPARSE_BLOCK_SIZE < header.stored_size) { // last block may be short
+        free(sparse);
+        return NULL;
+    }
+
+    return sparse;
+}
+
+void CloseSparseImage(SparseImage* sparse) {
+    free(sparse);
+}
+
+int ReadSparseImageBytes(FIL* file, SparseImage* sparse, void* buffer, u64 offset, u64 count) {
+    u8* buffer8 = (u8*) buffer;
+    if (offset + count > sparse->header.image_size) return -1;
+
+    while (count) {
+        u32 block = offset / SPARSE_BLOCK_SIZE;
+        u32 off_block = offset % SPARSE_BLOCK_SIZE;
+        bool used = SparseBlockUsed(sparse->bitmap, block);
+
+        // stored blocks in a run are also stored back to back
+        u32 run = 1;
+        u64 run_bytes = SPARSE_BLOCK_SIZE - off_block;
+        while ((run_bytes < count) && (SparseBlockUsed(sparse->bitmap, block + run) == used)) {
+            run_bytes += SPARSE_BLOCK_SIZE;
+            run++;
+        }
+        if (run_bytes > count) run_bytes = count;
+
+        if (used) {
+            u32 word = sparse->bitmap[block >> 5] & ((1u << (block & 0x1F)) - 1);
+            u64 index = sparse->rank[block >> 5] + __builtin_popcount(word);
+            u64 pos = sparse->header.offset_data + (index * SPARSE_BLOCK_SIZE) + off_block;
+            UINT br;
+            if (fvx_tell(file) != pos) fvx_lseek(file, pos);
+            if ((fvx_read(file, buffer8, run_bytes, &br) != FR_OK) || (br != run_bytes))
+                return -1;
+        } else memset(buffer8, 0x00, run_bytes);
+
+        buffer8 += run_bytes;
+        offset += run_bytes;
+        count -= run_bytes;
+    }
+
+    return 0;
+}
+
+u32 DumpSparseImage(const char* path_src, const char* path_dst, u64* stored) {
+    const u8 magic[8] = { SPARSE_MAGIC };
+    SparseHeader header;
+    FIL src, dst;
+    UINT br, bw;
+    u32 ret = 0;
+
+    if (fvx_open(&src, path_src, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return 1;
+    u64 image_size = fvx_size(&src);
+    u32 block_count = (image_size + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE;
+    u32 bitmap_size = SPARSE_BITMAP_WORDS(block_count) * 4;
+
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    u32* bitmap = (u32*) malloc(bitmap_size);
+    if (!buffer || !bitmap) ret = 1;
+    else memset(bitmap, 0x00, bitmap_size);
+
+    // find what needs to be kept
+    if (!ShowProgress(0, 0, path_src)) ret = 1;
+    if ((ret == 0) && (SparseMarkImage(&src, bitmap, block_count, image_size, buffer) != 0)) ret = 1;
+
+    // header, bitmap, then the used blocks in order
+    memset(&header, 0x00, sizeof(SparseHeader));
+    memcpy(header.magic, magic, 8);
+    header.version = SPARSE_VERSION;
+    header.block_size = SPARSE_BLOCK_SIZE;
+    header.image_size = image_size;
+    header.block_count = block_count;
+    header.offset_data = align(sizeof(SparseHeader) + bitmap_size, 0x200);
+    if ((ret == 0) && (fvx_open(&dst, path_dst, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) ret = 1;
+    else if (ret == 0) {
+        fvx_lseek(&dst, sizeof(SparseHeader));
+        if ((fvx_write(&dst, bitmap, bitmap_size, &bw) != FR_OK) || (bw != bitmap_size)) ret = 1;
+        fvx_lseek(&dst, header.offset_data);
+
+        for (u32 b = 0; (b < block_count) && (ret == 0);) {
+            if (!SparseBlockUsed(bitmap, b)) {
+                b++;
+                continue;
+            }
+            u32 n = 1;
+            while ((b + n < block_count) && (n < STD_BUFFER_SIZE / SPARSE_BLOCK_SIZE) && SparseBlockUsed(bitmap, b + n)) n++;
+            u64 pos = (u64) b * SPARSE_BLOCK_SIZE;
+            u32 count = min((u64) n * SPARSE_BLOCK_SIZE, image_size - pos);
+            fvx_lseek(&src, pos);
+            if ((fvx_read(&src, buffer, count, &br) != FR_OK) || (br != count) ||
+                (fvx_write(&dst, buffer, count, &bw) != FR_OK) || (bw != count))
+                ret = 1;
+            header.stored_size += count;
+            b += n;
+            if (!ShowProgress(pos + count, image_size, path_dst)) ret = 1;
+        }
+
+        fvx_lseek(&dst, 0);
+        if ((fvx_write(&dst, &header, sizeof(SparseHeader), &bw) != FR_OK) || (bw != sizeof(SparseHeader)))
+            ret = 1;
+        fvx_close(&dst);
+        if (ret != 0) fvx_unlink(path_dst);
+    }
+
+    fvx_close(&src);
+    free(bitmap);
+    free(buffer);
+
+    if ((ret == 0) && stored) *stored = header.stored_size;
+    return ret;
+}
+
+u32 ExpandSparseImage(const char* path_src, const char* path_dst) {
+    FIL src, dst;
+    UINT bw;
+    u32 ret = 0;
+
+    if (fvx_open(&src, path_src, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return 1;
+    SparseImage* sparse = OpenSparseImage(&src);
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!sparse || !buffer || (fvx_open(&dst, path_dst, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) {
+        free(buffer);
+        CloseSparseImage(sparse);
+        fvx_close(&src);
+        return 1;
+    }
+
+    u64 image_size = sparse->header.image_size;
+    if (!ShowProgress(0, 0, path_dst)) ret = 1;
+    for (u64 pos = 0; (pos < image_size) && (ret == 0); pos += STD_BUFFER_SIZE) {
+        u32 count = min(STD_BUFFER_SIZE, image_size - pos);
+        if ((ReadSparseImageBytes(&src, sparse, buffer, pos, count) != 0) ||
+            (fvx_write(&dst, buffer, count, &bw) != FR_OK) || (bw != count))
+            ret = 1;
+        if (!ShowProgress(pos + count, image_size, path_dst)) ret = 1;
+    }
+
+    fvx_close(&dst);
+    fvx_close(&src);
+    free(buffer);
+    CloseSparseImage(sparse);
+
+    if (ret != 0) fvx_unlink(path_dst);
+    return ret;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common.h"
+#include "vff.h"
+
+#define SPARSE_MAGIC        'G', 'M', '9', 'S', 'P', 'A', 'R', 'S'
+#define SPARSE_VERSION      1
+#define SPARSE_BLOCK_SIZE   0x1000
+
+// sparse FAT image container: only blocks holding FAT structures or allocated
+// clusters are stored, everything else reads back as zeroes
+typedef struct {
+    u8  magic[8];
+    u32 version;
+    u32 block_size;
+    u64 image_size;
+    u32 block_count;
+    u32 offset_data;    // start of block data, allocation bitmap is in between
+    u64 stored_size;    // bytes of block data
+    u8  reserved[0x18];
+} PACKED_STRUCT SparseHeader; // followed by allocation bitmap (1 bit per block, LSB first)
+
+typedef struct {
+    SparseHeader header;
+    u32* bitmap;
+    u32* rank;          // stored blocks before each bitmap word
+} SparseImage;
+
+u32 ValidateSparseHeader(SparseHeader* header);
+SparseImage* OpenSparseImage(FIL* file);
+void CloseSparseImage(SparseImage* sparse);
+int ReadSparseImageBytes(FIL* file, SparseImage* sparse, void* buffer, u64 offset, u64 count);
+u32 DumpSparseImage(const char* path_src, const char* path_dst, u64* stored);
+u32 ExpandSparseImage(const char* path_src, const char* path_dst);
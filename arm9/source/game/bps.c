@@ -31,12 +31,12 @@
 #define BEAT_VLIBUFSZ	(8)
 #define BEAT_MAXPATH	(256)
 #define BEAT_FILEBUFSZ	(256 * 1024)
+#define BEAT_WINBUFSZ	(64 * 1024) // read-ahead window for patch and source
+#define BEAT_RINGBUFSZ	(256 * 1024) // write-behind ring, also serves TargetCopy
 
 #define BEAT_RANGE(c, i)	((c)->ranges[1][i] - (c)->ranges[0][i])
 #define BEAT_UPDATEDELAYMS	(1000 / 4)
 
-#define BEAT_ABSPOS(c, i)	((c)->foff[i] + (c)->ranges[0][i])
-
 #define BEAT_READONLY	(FA_READ | FA_OPEN_EXISTING)
 #define BEAT_RWCREATE	(FA_READ | FA_WRITE | FA_CREATE_ALWAYS)
 
@@ -104,9 +104,19 @@ static const u8 bps_chksumoffs[BEAT_FILENUM] = {
 };
 static const u8 bpm_signature[] = { 'B', 'P', 'M', '1' };
 
+/** Read-ahead window, offsets are relative to the start of the file range */
+typedef struct {
+	u8 *buf;
+	size_t off, len;
+	size_t next; // end of the last read that bypassed the window
+} BEAT_Window;
+
 /** BEAT STATE STORAGE */
 typedef struct {
 	u8 *copybuf;
+	u8 *ringbuf; // most recent output, everything past oflushed is not yet written
+	size_t oflushed;
+	BEAT_Window win[BEAT_OF]; // BEAT_PF and BEAT_IF only
 	size_t foff[BEAT_FILENUM], eoal_offset;
 	size_t ranges[2][BEAT_FILENUM];
 	u32 ocrc; // Output crc
@@ -159,32 +169,131 @@ static const char *BEAT_ErrString(int error)
 	}
 }
 
-static int BEAT_Read(BEAT_Context *ctx, int id, void *out, size_t len, int fwd)
-{ // Read up to `len` bytes from the context file `id` to the `out` buffer
+static int BEAT_ReadRaw(BEAT_Context *ctx, int id, size_t pos, void *out, size_t len)
+{ // Read `len` bytes at range offset `pos` straight from the context file `id`
 	UINT br;
 	FRESULT res;
+	fvx_lseek(&ctx->file[id], ctx->ranges[0][id] + pos);
+	res = fvx_read(&ctx->file[id], out, len, &br);
+	return (res == FR_OK && br == len) ? BEAT_OK : BEAT_IO_ERROR;
+}
+
+static int BEAT_FlushOut(BEAT_Context *ctx)
+{ // Write back everything in the output ring that is not on disk yet
+	while (ctx->oflushed < ctx->foff[BEAT_OF]) {
+		UINT bw;
+		size_t idx = ctx->oflushed % BEAT_RINGBUFSZ;
+		size_t len = min(ctx->foff[BEAT_OF] - ctx->oflushed, BEAT_RINGBUFSZ - idx);
+
+		fvx_lseek(&ctx->file[BEAT_OF], ctx->ranges[0][BEAT_OF] + ctx->oflushed);
+		if ((fvx_write(&ctx->file[BEAT_OF], ctx->ringbuf + idx, len, &bw) != FR_OK) || (bw != len))
+			return BEAT_IO_ERROR;
+		ctx->oflushed += len;
+	}
+	return BEAT_OK;
+}
+
+static int BEAT_Read(BEAT_Context *ctx, int id, void *out, size_t len, int fwd)
+{ // Read up to `len` bytes from the context file `id` to the `out` buffer
+	BEAT_Window *win;
+	size_t pos = ctx->foff[id];
+	u8 *dst = out;
+	int res = BEAT_OK;
+
 	if ((len + ctx->foff[id]) > BEAT_RANGE(ctx, id))
 		return BEAT_OVERFLOW;
-
-	fvx_lseek(&ctx->file[id], BEAT_ABSPOS(ctx, id)); // ALWAYS use the state offset + start range
 	ctx->foff[id] += len * fwd;
-	res = fvx_read(&ctx->file[id], out, len, &br);
-	return (res == FR_OK && br == len) ? BEAT_OK : BEAT_IO_ERROR;
+
+	if (id == BEAT_OF) { // reading back output, needs to be on disk first
+		res = BEAT_FlushOut(ctx);
+		return (res == BEAT_OK) ? BEAT_ReadRaw(ctx, id, pos, out, len) : res;
+	}
+
+	// patch and source are read through a sequential window
+	win = &ctx->win[id];
+	while ((len > 0) && (res == BEAT_OK)) {
+		if ((pos >= win->off) && (pos < win->off + win->len)) {
+			size_t cpy = min(len, win->off + win->len - pos);
+			memcpy(dst, win->buf + (pos - win->off), cpy);
+			dst += cpy;
+			pos += cpy;
+			len -= cpy;
+		} else if (!win->buf || (len >= BEAT_WINBUFSZ) ||
+			((pos != win->off + win->len) && (pos != win->next))) {
+			// big and random reads bypass the window, read-ahead only pays off once reads turn sequential
+			res = BEAT_ReadRaw(ctx, id, pos, dst, len);
+			win->next = pos + len;
+			len = 0;
+		} else {
+			win->off = pos;
+			win->len = min(BEAT_WINBUFSZ, BEAT_RANGE(ctx, id) - pos);
+			res = BEAT_ReadRaw(ctx, id, pos, win->buf, win->len);
+			if (res != BEAT_OK) win->len = 0;
+		}
+	}
+
+	return res;
 }
 
-static int BEAT_WriteOut(BEAT_Context *ctx, const u8 *in, size_t len, int fwd)
+static int BEAT_WriteOut(BEAT_Context *ctx, const u8 *in, size_t len)
 { // Write `len` bytes from `in` to BEAT_OF, updates the output CRC
-	UINT bw;
-	FRESULT res;
 	if ((len + ctx->foff[BEAT_OF]) > BEAT_RANGE(ctx, BEAT_OF))
 		return BEAT_OVERFLOW;
 
 	// Blindly assume all writes will be done linearly
 	ctx->ocrc = ~crc32_calculate(~ctx->ocrc, in, len);
-	fvx_lseek(&ctx->file[BEAT_OF], BEAT_ABSPOS(ctx, BEAT_OF));
-	ctx->foff[BEAT_OF] += len * fwd;
-	res = fvx_write(&ctx->file[BEAT_OF], in, len, &bw);
-	return (res == FR_OK && bw == len) ? BEAT_OK : BEAT_IO_ERROR;
+
+	// collect output in the ring, write back only when it is full
+	while (len > 0) {
+		size_t idx = ctx->foff[BEAT_OF] % BEAT_RINGBUFSZ;
+		size_t cpy = min(len, BEAT_RINGBUFSZ - idx);
+		if (ctx->foff[BEAT_OF] - ctx->oflushed + cpy > BEAT_RINGBUFSZ) {
+			int res = BEAT_FlushOut(ctx);
+			if (res != BEAT_OK) return res;
+		}
+		memcpy(ctx->ringbuf + idx, in, cpy);
+		ctx->foff[BEAT_OF] += cpy;
+		in += cpy;
+		len -= cpy;
+	}
+	return BEAT_OK;
+}
+
+static int BEAT_ReadOut(BEAT_Context *ctx, size_t pos, u8 *out, size_t len)
+{ // Read back already written output, from the ring as far as it is still there
+	size_t end = ctx->foff[BEAT_OF];
+	size_t ring_start = (end > BEAT_RINGBUFSZ) ? end - BEAT_RINGBUFSZ : 0;
+	if (pos + len > end) return BEAT_OVERFLOW;
+
+	if (pos < ring_start) { // too old for the ring, but certainly on disk
+		size_t rd = min(len, ring_start - pos);
+		int res = BEAT_ReadRaw(ctx, BEAT_OF, pos, out, rd);
+		if (res != BEAT_OK) return res;
+		out += rd;
+		pos += rd;
+		len -= rd;
+	}
+
+	while (len > 0) {
+		size_t idx = pos % BEAT_RINGBUFSZ;
+		size_t cpy = min(len, BEAT_RINGBUFSZ - idx);
+		memcpy(out, ctx->ringbuf + idx, cpy);
+		out += cpy;
+		pos += cpy;
+		len -= cpy;
+	}
+	return BEAT_OK;
+}
+
+static int BEAT_AllocBuffers(BEAT_Context *ctx)
+{ // Allocate the block copy buffer, the output ring and the read windows in one go
+	u8 *buf = malloc(BEAT_FILEBUFSZ + BEAT_RINGBUFSZ + (BEAT_OF * BEAT_WINBUFSZ));
+	if (buf == NULL) return BEAT_OUT_OF_MEMORY;
+	ctx->copybuf = buf;
+	ctx->ringbuf = buf + BEAT_FILEBUFSZ;
+	for (int i = 0; i < BEAT_OF; i++)
+		ctx->win[i].buf = buf + BEAT_FILEBUFSZ + BEAT_RINGBUFSZ + (i * BEAT_WINBUFSZ);
+	return BEAT_OK;
 }
 
 static void BEAT_SeekOff(BEAT_Context *ctx, int id, ssize_t offset)
@@ -242,7 +351,8 @@ static int BEAT_RunActions(BEAT_Context *ctx, const BEAT_Action *acts)
 
 static void BEAT_ReleaseCTX(BEAT_Context *ctx)
 { // Release any resources associated to the context
-	free(ctx->copybuf);
+	if (fvx_opened(&ctx->file[BEAT_OF])) BEAT_FlushOut(ctx);
+	free(ctx->copybuf); // also holds the ring and window buffers
 	for (int i = 0; i < BEAT_FILENUM; i++) {
 		if (fvx_opened(&ctx->file[i])) fvx_close(&ctx->file[i]);
 	}
@@ -264,9 +374,12 @@ static int BPS_InitCTX_Advanced(BEAT_Context *ctx, const char *bps_path, const c
 	u32 vli, in_sz, metaend_off;
 	u32 chksum[BEAT_FILENUM], expected_chksum[BEAT_FILENUM];
 
-	// Clear stackbuf
+	// Clear stackbuf, allocate buffers
 	memset(ctx, 0, sizeof(*ctx));
+	progress_refcnt++; // BEAT_ReleaseCTX() drops it again, also after a failed init
 	ctx->eoal_offset = 12;
+	res = BEAT_AllocBuffers(ctx);
+	if (res != BEAT_OK) return res;
 
 	if (end == 0) {
 		start = 0;
@@ -326,13 +439,8 @@ static int BPS_InitCTX_Advanced(BEAT_Context *ctx, const char *bps_path, const c
 	ctx->ocrc = 0;
 	ctx->xocrc = expected_chksum[BEAT_OF];
 
-	// Allocate temporary block copy buffer
-	ctx->copybuf = malloc(BEAT_FILEBUFSZ);
-	if (ctx->copybuf == NULL) return BEAT_OUT_OF_MEMORY;
-
 	// Seek back to the start of action stream / end of metadata
 	BEAT_SeekAbs(ctx, BEAT_PF, metaend_off);
-	progress_refcnt++;
 	return BEAT_OK;
 }
 
@@ -350,7 +458,7 @@ static int BEAT_BlkCopy(BEAT_Context *ctx, int src_id, u32 len)
 		int res = BEAT_Read(ctx, src_id, ctx->copybuf, blksz, 1);
 		if (res != BEAT_OK) return res;
 
-		res = BEAT_WriteOut(ctx, ctx->copybuf, blksz, 1);
+		res = BEAT_WriteOut(ctx, ctx->copybuf, blksz);
 		if (res != BEAT_OK) return res;
 
 		if (!BEAT_UpdateProgress(ctx)) return BEAT_ABORTED;
@@ -390,7 +498,7 @@ static int BPS_SourceCopy(BEAT_Context *ctx, u32 len)
 
 	offset = BEAT_DecodeSigned(vli);
 	BEAT_SeekAbs(ctx, BEAT_IF, ctx->source_relative + offset);
-	ctx->source_relative += offset + len;
+	ctx->source_relative = ctx->foff[BEAT_IF] + len; // not `offset + len`, that is unsigned and breaks with a wider size_t
 
 	return BEAT_BlkCopy(ctx, BEAT_IF, len);
 }
@@ -408,30 +516,22 @@ static int BPS_TargetCopy(BEAT_Context *ctx, u32 len)
 	offset = BEAT_DecodeSigned(vli);
 	out_off = ctx->foff[BEAT_OF];
 	rel_off = ctx->target_relative + offset;
-	if (rel_off > out_off) return BEAT_BADPATCH; // Illegal
+	if (rel_off >= out_off) return BEAT_BADPATCH; // Illegal
 
 	while(len != 0) {
-		u8 *remfill;
-		ssize_t blksz, distance, remainder;
+		ssize_t blksz, distance, filled;
 
 		blksz = min(len, BEAT_FILEBUFSZ);
 		distance = min((ssize_t)(out_off - rel_off), blksz);
 
-		BEAT_SeekAbs(ctx, BEAT_OF, rel_off);
-		res = BEAT_Read(ctx, BEAT_OF, ctx->copybuf, distance, 0);
+		res = BEAT_ReadOut(ctx, rel_off, ctx->copybuf, distance);
 		if (res != BEAT_OK) return res;
 
-		remfill = ctx->copybuf + distance;
-		remainder = blksz - distance;
-		while(remainder > 0) { // fill the buffer with repeats
-			ssize_t remblk = min(distance, remainder);
-			memcpy(remfill, ctx->copybuf, remblk);
-			remfill += remblk;
-			remainder -= remblk;
-		}
+		// fill the buffer with repeats, doubling the copied pattern each round
+		for (filled = distance; filled < blksz; filled *= 2)
+			memcpy(ctx->copybuf + filled, ctx->copybuf, min(filled, blksz - filled));
 
-		BEAT_SeekAbs(ctx, BEAT_OF, out_off);
-		res = BEAT_WriteOut(ctx, ctx->copybuf, blksz, 0);
+		res = BEAT_WriteOut(ctx, ctx->copybuf, blksz);
 		if (res != BEAT_OK) return res;
 
 		if (!BEAT_UpdateProgress(ctx)) return BEAT_ABORTED;
@@ -440,7 +540,6 @@ static int BPS_TargetCopy(BEAT_Context *ctx, u32 len)
 		len -= blksz;
 	}
 
-	BEAT_SeekAbs(ctx, BEAT_OF, out_off);
 	ctx->target_relative = rel_off;
 	return BEAT_OK;
 }
@@ -455,7 +554,11 @@ static int BPS_RunActions(BEAT_Context *ctx)
 	};
 	int res = BEAT_RunActions(ctx, BPS_Actions);
 	if (res == BEAT_ABORTED) return BEAT_ABORTED;
-	if (res == BEAT_EOAL) // Verify hashes
+	if ((res == BEAT_OK) || (res == BEAT_EOAL)) { // write back what is left
+		int wres = BEAT_FlushOut(ctx);
+		if (wres != BEAT_OK) return wres;
+	}
+	if ((res == BEAT_OK) || (res == BEAT_EOAL)) // Verify hashes (the action list just runs out, EOAL is never set)
 		return (ctx->ocrc == ctx->xocrc) ? BEAT_OK : BEAT_BADOUTPUT;
 	return res; // some kind of error
 }
@@ -467,7 +570,10 @@ static int BPM_OpenFile(BEAT_Context *ctx, int id, const char *path, size_t max_
 {
 	FRESULT res;
 
-	if (fvx_opened(&ctx->file[id])) fvx_close(&ctx->file[id]);
+	if (fvx_opened(&ctx->file[id])) {
+		if ((id == BEAT_OF) && (BEAT_FlushOut(ctx) != BEAT_OK)) return BEAT_IO_ERROR;
+		fvx_close(&ctx->file[id]);
+	}
 	res = fvx_open(&ctx->file[id], path, max_sz ? BEAT_RWCREATE : BEAT_READONLY);
 	if (res != FR_OK) return BEAT_IO_ERROR;
 
@@ -482,6 +588,8 @@ static int BPM_OpenFile(BEAT_Context *ctx, int id, const char *path, size_t max_
 	// a single outfile wont be created from more than one infile (& patch)
 	ctx->ocrc = 0;
 	ctx->foff[id] = 0;
+	if (id == BEAT_OF) ctx->oflushed = 0;
+	else ctx->win[id].len = 0;
 	return BEAT_OK;
 }
 
@@ -493,11 +601,14 @@ static int BPM_InitCTX(BEAT_Context *ctx, const char *bpm_path, const char *src_
 	u32 chksum, expected_chksum;
 
 	memset(ctx, 0, sizeof(*ctx));
+	progress_refcnt++;
 
 	ctx->bpm_path = bpm_path;
 	ctx->source_dir = src_dir;
 	ctx->target_dir = dst_dir;
 	ctx->eoal_offset = 4;
+	res = BEAT_AllocBuffers(ctx);
+	if (res != BEAT_OK) return res;
 
 	chksum = crc32_calculate_from_file(bpm_path, 0, fs_size(bpm_path) - 4);
 	res = BPM_OpenFile(ctx, BEAT_PF, bpm_path, 0);
@@ -518,13 +629,8 @@ static int BPM_InitCTX(BEAT_Context *ctx, const char *bpm_path, const char *src_
 	if (res != BEAT_OK) return res;
 	if (expected_chksum != chksum) return BEAT_BADCHKSUM;
 
-	// Allocate temporary block copy buffer
-	ctx->copybuf = malloc(BEAT_FILEBUFSZ);
-	if (ctx->copybuf == NULL) return BEAT_OUT_OF_MEMORY;
-
 	// Seek back to the start of action stream / end of metadata
 	BEAT_SeekAbs(ctx, BEAT_PF, metaend_off);
-	progress_refcnt++;
 	return BEAT_OK;
 }
 
@@ -577,6 +683,7 @@ static int BPM_CreateFile(BEAT_Context *ctx, u32 name_len)
 	res = BPM_OpenFile(ctx, BEAT_OF, path, file_sz); // open file as RW
 	if (res != BEAT_OK) return res;
 	res = BEAT_BlkCopy(ctx, BEAT_PF, file_sz); // copy data to new file
+	if (res == BEAT_OK) res = BEAT_FlushOut(ctx);
 	if (res != BEAT_OK) return res;
 
 	res = BEAT_Read(ctx, BEAT_PF, &checksum, sizeof(u32), 1);
@@ -631,6 +738,7 @@ static int BPM_MirrorFile(BEAT_Context *ctx, u32 name_len)
 
 	// copy straight from source to destination
 	res = BEAT_BlkCopy(ctx, BEAT_IF, ctx->ranges[1][BEAT_IF]);
+	if (res == BEAT_OK) res = BEAT_FlushOut(ctx);
 	if (res != BEAT_OK) return res;
 
 	res = BEAT_Read(ctx, BEAT_PF, &checksum, sizeof(u32), 1);
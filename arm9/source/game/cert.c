@@ -1,6 +1,7 @@
 #include "cert.h"
 #include "disadiff.h"
 #include "rsa.h"
+#include "sha.h"
 
 typedef struct {
     char magic[4]; // "CERT"
@@ -66,6 +67,23 @@ static struct {
     }
 };
 
+#define CERT_CACHE_ENTRIES 8  // other issuers, least recently used gets replaced
+#define CERT_MEMO_ENTRIES  32 // verified signature blocks, oldest gets replaced
+
+static struct {
+    char issuer[0x41];
+    u32 last_used; // 0 if unused
+    Certificate cert;
+} _CertCache[CERT_CACHE_ENTRIES];
+
+static u32 _CertCacheTick = 0;
+
+static struct {
+    u32 next;
+    u32 count;
+    u8 hash[CERT_MEMO_ENTRIES][0x20];
+} _VerifiedMemo;
+
 static inline void _Certificate_CleanupImpl(Certificate* cert);
 
 bool Certificate_IsValid(const Certificate* cert) {
@@ -263,7 +281,7 @@ static inline u32 _Certificate_VerifyRSA2048(const Certificate* cert, const void
 
     int ret;
 
-    if (((u32)&cert->data->pub_key_data[0]) & 0x3)
+    if (((uintptr_t)&cert->data->pub_key_data[0]) & 0x3)
         ret = !_Certificate_SetKey2048Misaligned(cert);
     else
         ret = !RSA_setKey2048(3, (const u32*)(const void*)&cert->data->pub_key_data[0], getle32(&cert->data->pub_key_data[2048/8]));
@@ -302,7 +320,7 @@ static inline void* _Certificate_SafeRealloc(void* ptr, size_t size, size_t olds
     void* new_ptr;
     size_t min_size = min(oldsize, size);
 
-    if ((u32)ptr >= (u32)&_CommonCertsStorage && (u32)ptr < (u32)&_CommonCertsStorage + sizeof(_CommonCertsStorage)) {
+    if ((uintptr_t)ptr >= (uintptr_t)&_CommonCertsStorage && (uintptr_t)ptr < (uintptr_t)&_CommonCertsStorage + sizeof(_CommonCertsStorage)) {
         new_ptr = malloc(size);
         if (new_ptr) memcpy(new_ptr, ptr, min_size);
     } else {
@@ -388,7 +406,7 @@ u32 Certificate_RawCopy(const Certificate* cert, void* raw) {
 
 // ptr free check, to not free if ptr is pointing to static storage!!
 static inline void _Certificate_SafeFree(void* ptr) {
-    if ((u32)ptr >= (u32)&_CommonCertsStorage && (u32)ptr < (u32)&_CommonCertsStorage + sizeof(_CommonCertsStorage))
+    if ((uintptr_t)ptr >= (uintptr_t)&_CommonCertsStorage && (uintptr_t)ptr < (uintptr_t)&_CommonCertsStorage + sizeof(_CommonCertsStorage))
         return;
 
     free(ptr);
@@ -552,6 +570,40 @@ static void _SaveToCertStorage(const Certificate* cert, u32 ident) {
     }
 }
 
+// cache copies are handed out, so cleanup after use stays the same for callers
+static bool _LoadFromCertCache(Certificate* cert, const char* issuer) {
+    for (u32 i = 0; i < CERT_CACHE_ENTRIES; i++) {
+        if (!_CertCache[i].last_used || strcmp(_CertCache[i].issuer, issuer))
+            continue;
+        if (_Certificate_AllocCopyOutImpl(&_CertCache[i].cert, cert))
+            return false;
+        _CertCache[i].last_used = ++_CertCacheTick;
+        return true;
+    }
+
+    return false;
+}
+
+static void _SaveToCertCache(const Certificate* cert, const char* issuer) {
+    if (strnlen(issuer, 0x41) > 0x40)
+        return;
+
+    u32 slot = 0;
+    for (u32 i = 0; i < CERT_CACHE_ENTRIES; i++) {
+        if (_CertCache[i].last_used && !strcmp(_CertCache[i].issuer, issuer))
+            return; // already in there
+        if (_CertCache[i].last_used < _CertCache[slot].last_used)
+            slot = i;
+    }
+
+    _Certificate_CleanupImpl(&_CertCache[slot].cert);
+    _CertCache[slot].last_used = 0;
+    if (_Certificate_AllocCopyOutImpl(cert, &_CertCache[slot].cert))
+        return;
+    strcpy(_CertCache[slot].issuer, issuer);
+    _CertCache[slot].last_used = ++_CertCacheTick;
+}
+
 // grumble grumble, gotta avoid repeated code when possible or at least if significant enough
 
 static u32 _DisaOpenCertDb(char (*path)[16], bool emunand, DisaDiffRWInfo* info, u8** cache, u32* offset, u32* max_offset) {
@@ -648,6 +700,9 @@ u32 LoadCertFromCertDb(Certificate* cert, const char* issuer) {
     if (_LoadFromCertStorage(cert, _ident)) {
         return 0;
     }
+    if ((_ident == CERT_NO_STORE_SPACE) && _LoadFromCertCache(cert, issuer)) {
+        return 0;
+    }
 
     int ret = 1;
 
@@ -688,6 +743,8 @@ u32 LoadCertFromCertDb(Certificate* cert, const char* issuer) {
         } else {
             *cert = cert_local;
             _SaveToCertStorage(&cert_local, _ident);
+            if (_ident == CERT_NO_STORE_SPACE)
+                _SaveToCertCache(&cert_local, issuer);
         }
 
         free(cache);
@@ -696,6 +753,39 @@ u32 LoadCertFromCertDb(Certificate* cert, const char* issuer) {
     return ret;
 }
 
+// signature blocks that passed once are remembered (by hash), checking them again is free
+// (the issuer is part of the signed data for tickets and TMDs, so signature and data cover it)
+u32 VerifySignatureFromCertDb(const char* issuer, const void* sig, u32 sig_size, const void* data, u32 data_size) {
+    if (!issuer || !sig || (!data && data_size)) return 1;
+
+    u8 hash[0x20];
+    sha_init(SHA256_MODE);
+    sha_update(sig, sig_size);
+    if (data_size) sha_update(data, data_size);
+    sha_get(hash);
+
+    for (u32 i = 0; i < _VerifiedMemo.count; i++) {
+        if (memcmp(_VerifiedMemo.hash[i], hash, 0x20) == 0)
+            return 0;
+    }
+
+    Certificate cert;
+    if (LoadCertFromCertDb(&cert, issuer) != 0)
+        return 1;
+
+    u32 ret = Certificate_VerifySignatureBlock(&cert, sig, sig_size, data, data_size, true);
+
+    Certificate_Cleanup(&cert);
+
+    if (ret == 0) { // only successful checks are remembered
+        memcpy(_VerifiedMemo.hash[_VerifiedMemo.next], hash, 0x20);
+        _VerifiedMemo.next = (_VerifiedMemo.next + 1) % CERT_MEMO_ENTRIES;
+        if (_VerifiedMemo.count < CERT_MEMO_ENTRIES) _VerifiedMemo.count++;
+    }
+
+    return ret;
+}
+
 // I dont expect many certs on a cert bundle, so I'll cap it to 8
 u32 BuildRawCertBundleFromCertDb(void* rawout, size_t* size, const char* const* cert_issuers, int count) {
     if (!rawout || !size || !cert_issuers || count < 0 || count > 8) return 1;
@@ -720,7 +810,8 @@ u32 BuildRawCertBundleFromCertDb(void* rawout, size_t* size, const char* const*
     // search static storage first
     for (int i = 0; i < count; ++i) {
         u32 _ident = _Issuer_To_StorageIdent(cert_issuers[i]);
-        if (_LoadFromCertStorage(&certs[i], _ident)) {
+        if (_LoadFromCertStorage(&certs[i], _ident) ||
+            ((_ident == CERT_NO_STORE_SPACE) && _LoadFromCertCache(&certs[i], cert_issuers[i]))) {
             certs_loaded |= BIT(i);
             ++loaded_count;
         }
@@ -747,6 +838,7 @@ u32 BuildRawCertBundleFromCertDb(void* rawout, size_t* size, const char* const*
             if (_ProcessNextCertDbEntry(path, &info, &cert_local, &full_size, &full_issuer, &offset, max_offset))
                 break;
 
+            bool wanted = false;
             for (int j = 0; j < count; j++) {
                 if (certs_loaded & BIT(j)) continue;
                 if (!strcmp(full_issuer, cert_issuers[j])) {
@@ -754,12 +846,15 @@ u32 BuildRawCertBundleFromCertDb(void* rawout, size_t* size, const char* const*
                     if (ret) break;
                     certs_loaded |= BIT(j);
                     ++loaded_count;
+                    wanted = true;
                 }
             }
 
             // while at it, try to save to static storage, if applicable
             u32 _ident = _Issuer_To_StorageIdent(full_issuer);
             _SaveToCertStorage(&cert_local, _ident);
+            if (wanted && (_ident == CERT_NO_STORE_SPACE))
+                _SaveToCertCache(&cert_local, full_issuer);
 
             _Certificate_CleanupImpl(&cert_local);
 
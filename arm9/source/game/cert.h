@@ -52,4 +52,5 @@ u32 Certificate_RawCopy(const Certificate* cert, void* raw);
 u32 Certificate_Cleanup(Certificate* cert);
 
 u32 LoadCertFromCertDb(Certificate* cert, const char* issuer);
+u32 VerifySignatureFromCertDb(const char* issuer, const void* sig, u32 sig_size, const void* data, u32 data_size);
 u32 BuildRawCertBundleFromCertDb(void* rawout, size_t* size, const char* const* cert_issuers, int count);
@@ -50,6 +50,9 @@ u32 FixCiaHeaderForTmd(CiaHeader* header, TitleMetaData* tmd) {
     return 0;
 }
 
+// validated CIA cert bundle, kept between builds while held (see HoldCiaCert())
+static u8* ciacert_resident = NULL;
+
 u32 BuildCiaCert(u8* ciacert) {
     static const u8 cert_hash_expected[0x20] = {
         0xC7, 0x2E, 0x1C, 0xA5, 0x61, 0xDC, 0x9B, 0xC8, 0x05, 0x58, 0x58, 0x9C, 0x63, 0x08, 0x1C, 0x8A,
@@ -63,6 +66,12 @@ u32 BuildCiaCert(u8* ciacert) {
     static const char* const retail_issuers[] = {"Root-CA00000003", "Root-CA00000003-XS0000000c", "Root-CA00000003-CP0000000b"};
     static const char* const dev_issuers[] = {"Root-CA00000004", "Root-CA00000004-XS00000009", "Root-CA00000004-CP0000000a"};
 
+    // the bundle never changes, no need to go through certs.db again
+    if (ciacert_resident) {
+        memcpy(ciacert, ciacert_resident, CIA_CERT_SIZE);
+        return 0;
+    }
+
     size_t size = CIA_CERT_SIZE;
     if (BuildRawCertBundleFromCertDb(ciacert, &size, !IS_DEVKIT ? retail_issuers : dev_issuers, 3) ||
         size != CIA_CERT_SIZE) {
@@ -78,6 +87,17 @@ u32 BuildCiaCert(u8* ciacert) {
     return 0;
 }
 
+void HoldCiaCert(bool hold) {
+    if (!hold) {
+        free(ciacert_resident);
+        ciacert_resident = NULL;
+    } else if (!ciacert_resident) {
+        u8* ciacert = (u8*) malloc(CIA_CERT_SIZE);
+        if (ciacert && (BuildCiaCert(ciacert) == 0)) ciacert_resident = ciacert;
+        else free(ciacert);
+    }
+}
+
 u32 BuildCiaMeta(CiaMeta* meta, void* exthdr, void* smdh) {
     // init metadata with all zeroes and core version
     memset(meta, 0x00, sizeof(CiaMeta));
@@ -65,6 +65,7 @@ u32 GetCiaInfo(CiaInfo* info, CiaHeader* header);
 u32 FixCiaHeaderForTmd(CiaHeader* header, TitleMetaData* tmd);
 
 u32 BuildCiaCert(u8* ciacert);
+void HoldCiaCert(bool hold);
 u32 BuildCiaMeta(CiaMeta* meta, void* exthdr, void* smdh);
 u32 BuildCiaHeader(CiaHeader* header, u32 ticket_size);
 
@@ -9,6 +9,8 @@
 #define CODE_SEG_OFFSET(s)  (((s) & 0x0FFF) + 2)
 #define CODE_SEG_SIZE(s)    ((((s) >> 12) & 0xF) + 3)
 
+#define CODE_LZSS_PROGRESS_STEP (64 * 1024)
+
 typedef struct {
     u32 off_size_comp; // 0xOOSSSSSS, where O == reverse offset and S == size
     u32 addsize_dec; // decompressed size - compressed size
@@ -43,20 +45,53 @@ u32 DecompressCodeLzss(u8* code, u32* code_size, u32 max_size) {
     u8* data_end = (u8*) comp_start + CODE_DEC_SIZE(footer);
     u8* ptr_in = (u8*) comp_start + CODE_COMP_END(footer);
     u8* ptr_out = data_end;
+    u8* ptr_progress = data_end; // progress is only updated once per CODE_LZSS_PROGRESS_STEP output
 
     // main decompression loop
     while ((ptr_in > comp_start) && (ptr_out > comp_start)) {
-        if (!ShowProgress(data_end - ptr_out, data_end - data_start, STR_DECOMPRESSING_DOT_CODE)) {
-            if (ShowPrompt(true, "%s", STR_DECOMPRESSING_DOT_CODE_B_DETECTED_CANCEL)) return 1;
-            ShowProgress(0, data_end - data_start, STR_DECOMPRESSING_DOT_CODE);
-            ShowProgress(data_end - ptr_out, data_end - data_start, STR_DECOMPRESSING_DOT_CODE);
+        if (ptr_out <= ptr_progress) {
+            if (!ShowProgress(data_end - ptr_out, data_end - data_start, STR_DECOMPRESSING_DOT_CODE)) {
+                if (ShowPrompt(true, "%s", STR_DECOMPRESSING_DOT_CODE_B_DETECTED_CANCEL)) return 1;
+                ShowProgress(0, data_end - data_start, STR_DECOMPRESSING_DOT_CODE);
+                ShowProgress(data_end - ptr_out, data_end - data_start, STR_DECOMPRESSING_DOT_CODE);
+            }
+            ptr_progress = (ptr_out - comp_start > CODE_LZSS_PROGRESS_STEP) ?
+                ptr_out - CODE_LZSS_PROGRESS_STEP : comp_start;
         }
 
         // sanity check
         if (ptr_out < ptr_in) return 1;
 
         // read and process control byte
-        u8 ctrlbyte = *(--ptr_in);
+        u32 ctrlbyte = *(--ptr_in);
+
+        // fast path: a full control block (at most 8 * 2 input bytes, 8 * 18 output bytes)
+        // cannot run into comp_start, so the per-segment end checks can be skipped
+        if ((ptr_in - comp_start > 16) && (ptr_out - comp_start > 8 * CODE_SEG_SIZE(0xFFFF))) {
+            for (u32 mask = 0x80; mask; mask >>= 1) {
+                if (!(ctrlbyte & mask)) { // control bit not set, copy byte verbatim
+                    *(--ptr_out) = *(--ptr_in);
+                    continue;
+                }
+
+                // control bit set, read segment code
+                ptr_in -= 2;
+                u32 seg_code = ptr_in[0] | (ptr_in[1] << 8);
+                u32 seg_off = CODE_SEG_OFFSET(seg_code);
+                u32 seg_len = CODE_SEG_SIZE(seg_code);
+                if (ptr_out + seg_off >= data_end) return 1;
+
+                // each output byte is taken from (seg_off + 1) bytes above it,
+                // non overlapping segments are copied in one go
+                if (seg_off + 1 >= seg_len) {
+                    ptr_out -= seg_len;
+                    memcpy(ptr_out, ptr_out + seg_off + 1, seg_len);
+                } else for (u32 c = 0; c < seg_len; c++, ptr_out--)
+                    *(ptr_out - 1) = *(ptr_out + seg_off);
+            }
+            continue;
+        }
+
         for (int i = 7; i >= 0; i--) {
             // end conditions met?
             if ((ptr_in <= comp_start) || (ptr_out <= comp_start))
@@ -66,8 +101,8 @@ u32 DecompressCodeLzss(u8* code, u32* code_size, u32 max_size) {
             if ((ctrlbyte >> i) & 0x1) {
                 // control bit set, read segment code
                 ptr_in -= 2;
-                u16 seg_code = getle16(ptr_in);
                 if (ptr_in < comp_start) return 1; // corrupted code
+                u16 seg_code = getle16(ptr_in);
                 u32 seg_off = CODE_SEG_OFFSET(seg_code);
                 u32 seg_len = CODE_SEG_SIZE(seg_code);
 
@@ -100,208 +135,213 @@ u32 DecompressCodeLzss(u8* code, u32* code_size, u32 max_size) {
     return 0;
 }
 
-// see https://github.com/dnasdw/3dstool/blob/master/src/backwardlz77.cpp (GPLv3)
+// match finder: hash chains over the 3 bytes below each position
+// positions are stored + 0, position 0 can never be a match source
+#define CODE_HASH_BITS      14
+#define CODE_HASH_SIZE      (1 << CODE_HASH_BITS)
+#define CODE_CHAIN_SIZE     0x2000 // must be a power of two > CODE_DIST_MAX
+#define CODE_MATCH_MIN      3
+#define CODE_MATCH_MAX      (0xF + 3)
+#define CODE_DIST_MIN       3
+#define CODE_DIST_MAX       (0xFFF + 3)
+
+#define CODE_LZSS_HASH(p)   (((((p)[-1] << 16) | ((p)[-2] << 8) | (p)[-3]) * 0x9E3779B1) >> (32 - CODE_HASH_BITS))
+
 typedef struct {
-    u16 WindowPos;
-    u16 WindowLen;
-    s16* OffsetTable;
-    s16* ReversedOffsetTable;
-    s16* ByteTable;
-    s16* EndTable;
-} sCompressInfo;
-
-void initTable(sCompressInfo* a_pInfo, void* a_pWork) {
-    a_pInfo->WindowPos = 0;
-    a_pInfo->WindowLen = 0;
-    a_pInfo->OffsetTable = (s16*)(a_pWork);
-    a_pInfo->ReversedOffsetTable = (s16*)(a_pWork) + 4098;
-    a_pInfo->ByteTable = (s16*)(a_pWork) + 4098 + 4098;
-    a_pInfo->EndTable = (s16*)(a_pWork) + 4098 + 4098 + 256;
-
-    for (int i = 0; i < 256; i++) {
-        a_pInfo->ByteTable[i] = -1;
-        a_pInfo->EndTable[i] = -1;
-    }
+    const u8* src;
+    u32 next_ins; // positions above this are already in the chains
+    u32 max_chain;
+    u32 head[CODE_HASH_SIZE];
+    u32 prev[CODE_CHAIN_SIZE];
+} CodeMatchFinder;
+
+static void InitCodeMatchFinder(CodeMatchFinder* mf, const u8* src, u32 size, u32 max_chain) {
+    memset(mf->head, 0, sizeof(mf->head));
+    mf->src = src;
+    mf->next_ins = size;
+    mf->max_chain = max_chain;
 }
 
-int search(sCompressInfo* a_pInfo, const u8* a_pSrc, int* a_nOffset, int a_nMaxSize) {
-    if (a_nMaxSize < 3) {
-        return 0;
+// longest match for the bytes directly below pos, returns 0 if there is none
+// (matches never overlap their source, same as the original 3dstool compressor)
+static u32 FindCodeMatch(CodeMatchFinder* mf, u32 pos, u32* dist) {
+    const u8* src = mf->src;
+
+    // everything above pos may be referenced
+    for (; mf->next_ins > pos; mf->next_ins--) {
+        u32 q = mf->next_ins;
+        if (q < CODE_MATCH_MIN) break;
+        u32 h = CODE_LZSS_HASH(src + q);
+        mf->prev[q & (CODE_CHAIN_SIZE-1)] = mf->head[h];
+        mf->head[h] = q;
     }
 
-    const u8* pSearch = NULL;
-    int nSize = 2;
-    const u16 uWindowPos = a_pInfo->WindowPos;
-    const u16 uWindowLen = a_pInfo->WindowLen;
-    s16* pReversedOffsetTable = a_pInfo->ReversedOffsetTable;
-
-    for (s16 nOffset = a_pInfo->EndTable[*(a_pSrc - 1)]; nOffset != -1; nOffset = pReversedOffsetTable[nOffset]) {
-        if (nOffset < uWindowPos) {
-            pSearch = a_pSrc + uWindowPos - nOffset;
-        } else {
-            pSearch = a_pSrc + uWindowLen + uWindowPos - nOffset;
-        }
-
-        if (pSearch - a_pSrc < 3) {
-            continue;
-        }
-
-        if (*(pSearch - 2) != *(a_pSrc - 2) || *(pSearch - 3) != *(a_pSrc - 3)) {
-            continue;
-        }
-
-        int nMaxSize = (int)((s64)min(a_nMaxSize, pSearch - a_pSrc));
-        int nCurrentSize = 3;
-
-        while (nCurrentSize < nMaxSize && *(pSearch - nCurrentSize - 1) == *(a_pSrc - nCurrentSize - 1)) {
-            nCurrentSize++;
+    u32 max_len = min(pos, CODE_MATCH_MAX);
+    if (max_len < CODE_MATCH_MIN) return 0;
+
+    u32 best_len = CODE_MATCH_MIN - 1;
+    u32 chain = mf->max_chain;
+    const u8* ptr = src + pos;
+    for (u32 q = mf->head[CODE_LZSS_HASH(ptr)]; q && chain; q = mf->prev[q & (CODE_CHAIN_SIZE-1)], chain--) {
+        u32 d = q - pos;
+        if (d > CODE_DIST_MAX) break; // chains are sorted by distance
+        u32 lim = min(max_len, d);
+        if ((d < CODE_DIST_MIN) || (lim <= best_len)) continue;
+
+        const u8* cmp = src + q;
+        if (*(cmp - 1 - best_len) != *(ptr - 1 - best_len)) continue; // can't beat the current best
+        u32 len = 0;
+        while ((len < lim) && (*(cmp - 1 - len) == *(ptr - 1 - len))) len++;
+        if (len > best_len) {
+            best_len = len;
+            *dist = d;
+            if (len == max_len) break;
         }
-
-        if (nCurrentSize > nSize) {
-            nSize = nCurrentSize;
-            *a_nOffset = (int)(pSearch - a_pSrc);
-            if (nSize == a_nMaxSize) {
-                break;
-            }
-        }
-    }
-
-    if (nSize < 3) {
-        return 0;
     }
 
-    return nSize;
+    return (best_len >= CODE_MATCH_MIN) ? best_len : 0;
 }
 
-void slideByte(sCompressInfo* a_pInfo, const u8* a_pSrc) {
-    u8 uInData = *(a_pSrc - 1);
-    u16 uInsertOffset = 0;
-    const u16 uWindowPos = a_pInfo->WindowPos;
-    const u16 uWindowLen = a_pInfo->WindowLen;
-    s16* pOffsetTable = a_pInfo->OffsetTable;
-    s16* pReversedOffsetTable = a_pInfo->ReversedOffsetTable;
-    s16* pByteTable = a_pInfo->ByteTable;
-    s16* pEndTable = a_pInfo->EndTable;
-
-    if (uWindowLen == 4098) {
-        u8 uOutData = *(a_pSrc + 4097);
-
-        if ((pByteTable[uOutData] = pOffsetTable[pByteTable[uOutData]]) == -1) {
-            pEndTable[uOutData] = -1;
-        } else {
-            pReversedOffsetTable[pByteTable[uOutData]] = -1;
-        }
-
-        uInsertOffset = uWindowPos;
-    } else {
-        uInsertOffset = uWindowLen;
+static bool ShowCodeLzssProgress(u32 current, u32 total) {
+    if (!ShowProgress(current, total, STR_COMPRESSING_DOT_CODE)) {
+        if (ShowPrompt(true, "%s", STR_COMPRESSING_DOT_CODE_B_DETECTED_CANCEL)) return false;
+        ShowProgress(0, total, STR_COMPRESSING_DOT_CODE);
+        ShowProgress(current, total, STR_COMPRESSING_DOT_CODE);
     }
+    return true;
+}
 
-    s16 nOffset = pEndTable[uInData];
-
-    if (nOffset == -1) {
-        pByteTable[uInData] = uInsertOffset;
-    } else {
-        pOffsetTable[nOffset] = uInsertOffset;
+// optimal parse: match lengths / distances for every position, then pick the
+// cheapest path (literal 9 bit, match 17 bit) from the bottom up
+// on return, len[pos] is the length to use at pos (0 for literal)
+static bool ParseCodeLzssOptimal(CodeMatchFinder* mf, u32 size, u8* len, u16* dist) {
+    u32 cost[CODE_MATCH_MAX + 1]; // ring buffer, cost to encode everything below pos
+
+    for (u32 pos = size; pos > 0; pos--) {
+        if (((size - pos) % CODE_LZSS_PROGRESS_STEP == 0) && !ShowCodeLzssProgress(size - pos, size))
+            return false;
+        u32 d = 0;
+        len[pos-1] = FindCodeMatch(mf, pos, &d);
+        dist[pos-1] = d;
     }
 
-    pEndTable[uInData] = uInsertOffset;
-    pOffsetTable[uInsertOffset] = -1;
-    pReversedOffsetTable[uInsertOffset] = nOffset;
-
-    if (uWindowLen == 4098) {
-        a_pInfo->WindowPos = (uWindowPos + 1) % 4098;
-    } else {
-        a_pInfo->WindowLen++;
+    cost[0] = 0;
+    for (u32 pos = 1; pos <= size; pos++) {
+        u32 best = cost[(pos-1) % (CODE_MATCH_MAX + 1)] + 9;
+        u32 best_len = 0;
+        for (u32 l = CODE_MATCH_MIN; l <= len[pos-1]; l++) {
+            u32 c = cost[(pos-l) % (CODE_MATCH_MAX + 1)] + 17;
+            if (c <= best) {
+                best = c;
+                best_len = l;
+            }
+        }
+        cost[pos % (CODE_MATCH_MAX + 1)] = best;
+        len[pos-1] = best_len;
     }
-}
 
-static inline void slide(sCompressInfo* a_pInfo, const u8* a_pSrc, int a_nSize) {
-    for (int i = 0; i < a_nSize; i++) {
-        slideByte(a_pInfo, a_pSrc--);
-    }
+    return true;
 }
 
+// see https://github.com/dnasdw/3dstool/blob/master/src/backwardlz77.cpp (GPLv3)
 s64 alignBytes(s64 a_nData, s64 a_nAlignment) {
     return (a_nData + a_nAlignment - 1) / a_nAlignment * a_nAlignment;
 }
 
 bool CompressCodeLzss(const u8* a_pUncompressed, u32 a_uUncompressedSize, u8* a_pCompressed, u32* a_uCompressedSize) {
-    const int s_nCompressWorkSize = (4098 + 4098 + 256 + 256) * sizeof(s16);
-    bool bResult = true;
-
-    if (a_uUncompressedSize > sizeof(CodeLzssFooter) && *a_uCompressedSize >= a_uUncompressedSize) {
-        u8* pWork = malloc(s_nCompressWorkSize * sizeof(u8));
-        if (!pWork) return false;
-
-        do {
-            sCompressInfo info;
-            initTable(&info, pWork);
+    return CompressCodeLzssLevel(a_pUncompressed, a_uUncompressedSize, a_pCompressed, a_uCompressedSize, CODE_LZSS_DEFAULT);
+}
 
-            const int nMaxSize = 0xF + 3;
-            const u8* pSrc = a_pUncompressed + a_uUncompressedSize;
-            u8* pDest = a_pCompressed + a_uUncompressedSize;
+bool CompressCodeLzssLevel(const u8* a_pUncompressed, u32 a_uUncompressedSize, u8* a_pCompressed, u32* a_uCompressedSize, u32 level) {
+    static const u32 max_chain[] = { 8, 64, 512 };
+    bool bResult = true;
 
-            while (pSrc - a_pUncompressed > 0 && pDest - a_pCompressed > 0) {
-                if (!ShowProgress((u32)(a_pUncompressed + a_uUncompressedSize - pSrc), a_uUncompressedSize, STR_COMPRESSING_DOT_CODE)) {
-                    if (ShowPrompt(true, "%s", STR_COMPRESSING_DOT_CODE_B_DETECTED_CANCEL)) {
-                        bResult = false;
-                        break;
-                    }
-                    ShowProgress(0, a_uUncompressedSize, STR_COMPRESSING_DOT_CODE);
-                    ShowProgress((u32)(a_pUncompressed + a_uUncompressedSize - pSrc), a_uUncompressedSize, STR_COMPRESSING_DOT_CODE);
-                }
+    if ((a_uUncompressedSize <= sizeof(CodeLzssFooter)) || (*a_uCompressedSize < a_uUncompressedSize))
+        return false;
+    if (level > CODE_LZSS_OPTIMAL) level = CODE_LZSS_OPTIMAL;
+
+    CodeMatchFinder* mf = (CodeMatchFinder*) malloc(sizeof(CodeMatchFinder));
+    if (!mf) return false;
+    InitCodeMatchFinder(mf, a_pUncompressed, a_uUncompressedSize, max_chain[level]);
+
+    // optimal parse needs 3 byte per input byte, falls back to default if not available
+    u8* opt_len = NULL;
+    u16* opt_dist = NULL;
+    if (level == CODE_LZSS_OPTIMAL) {
+        opt_len = (u8*) malloc(a_uUncompressedSize);
+        opt_dist = (u16*) malloc(a_uUncompressedSize * sizeof(u16));
+        if (!opt_len || !opt_dist) {
+            if (opt_len) free(opt_len);
+            if (opt_dist) free(opt_dist);
+            opt_len = NULL;
+            opt_dist = NULL;
+            level = CODE_LZSS_DEFAULT;
+        } else if (!ParseCodeLzssOptimal(mf, a_uUncompressedSize, opt_len, opt_dist)) {
+            bResult = false;
+        }
+    }
 
-                u8* pFlag = --pDest;
-                *pFlag = 0;
-
-                for (int i = 0; i < 8; i++) {
-                    int nOffset = 0;
-                    int nSize = search(&info, pSrc, &nOffset, (int)((s64)min((s64)min(nMaxSize, pSrc - a_pUncompressed), a_pUncompressed + a_uUncompressedSize - pSrc)));
-
-                    if (nSize < 3) {
-                        if (pDest - a_pCompressed < 1) {
-                            bResult = false;
-                            break;
-                        }
-
-                        slide(&info, pSrc, 1);
-                        *--pDest = *--pSrc;
-                    } else {
-                        if (pDest - a_pCompressed < 2) {
-                            bResult = false;
-                            break;
-                        }
-
-                        *pFlag |= 0x80 >> i;
-                        slide(&info, pSrc, nSize);
-                        pSrc -= nSize;
-                        nSize -= 3;
-                        *--pDest = (nSize << 4 & 0xF0) | ((nOffset - 3) >> 8 & 0x0F);
-                        *--pDest = (nOffset - 3) & 0xFF;
-                    }
+    // encode, from the end of the input to the start (output is also written backwards)
+    u32 pos = a_uUncompressedSize;
+    u8* pDest = a_pCompressed + a_uUncompressedSize;
+    u32 next_len = 0, next_dist = 0; // lazy matching lookahead
+    bool have_next = false;
+    u32 next_progress = 0;
+    while (bResult && (pos > 0)) {
+        if (!opt_len && (a_uUncompressedSize - pos >= next_progress)) {
+            if (!ShowCodeLzssProgress(a_uUncompressedSize - pos, a_uUncompressedSize)) {
+                bResult = false;
+                break;
+            }
+            next_progress += CODE_LZSS_PROGRESS_STEP;
+        }
 
-                    if (pSrc - a_pUncompressed <= 0) {
-                        break;
+        // room for one flag byte and eight segments
+        if (pDest - a_pCompressed < 1 + (8 * 2)) {
+            bResult = false; // not compressible
+            break;
+        }
+        u8* pFlag = --pDest;
+        *pFlag = 0;
+
+        for (u32 i = 0; (i < 8) && (pos > 0); i++) {
+            u32 len = 0, dist = 0;
+            if (opt_len) {
+                len = opt_len[pos-1];
+                dist = opt_dist[pos-1];
+            } else {
+                if (have_next) {
+                    len = next_len;
+                    dist = next_dist;
+                } else len = FindCodeMatch(mf, pos, &dist);
+                have_next = false;
+
+                // lazy matching: emit a literal if the match one byte further down is longer
+                if ((level >= CODE_LZSS_DEFAULT) && len && (len < CODE_MATCH_MAX) && (pos > 1)) {
+                    next_len = FindCodeMatch(mf, pos - 1, &next_dist);
+                    if (next_len > len) {
+                        len = 0;
+                        have_next = true;
                     }
                 }
-
-                if (!bResult) {
-                    break;
-                }
             }
 
-            if (!bResult) {
-                break;
+            if (len < CODE_MATCH_MIN) {
+                *--pDest = a_pUncompressed[--pos];
+            } else {
+                *pFlag |= 0x80 >> i;
+                pos -= len;
+                *--pDest = ((len - 3) << 4 & 0xF0) | ((dist - 3) >> 8 & 0x0F);
+                *--pDest = (dist - 3) & 0xFF;
             }
+        }
+    }
 
-            *a_uCompressedSize = (u32)(a_pCompressed + a_uUncompressedSize - pDest);
-        } while (false);
+    if (opt_len) free(opt_len);
+    if (opt_dist) free(opt_dist);
+    free(mf);
 
-        free(pWork);
-    } else {
-        bResult = false;
-    }
+    if (bResult) *a_uCompressedSize = (u32)(a_pCompressed + a_uUncompressedSize - pDest);
 
     if (bResult) {
         u32 uOrigSize = a_uUncompressedSize;
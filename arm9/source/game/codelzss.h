@@ -4,6 +4,12 @@
 
 #define EXEFS_CODE_NAME  ".code"
 
+// compression levels for CompressCodeLzssLevel()
+#define CODE_LZSS_FAST      0
+#define CODE_LZSS_DEFAULT   1
+#define CODE_LZSS_OPTIMAL   2
+
 u32 GetCodeLzssUncompressedSize(void* footer, u32 comp_size);
 u32 DecompressCodeLzss(u8* code, u32* code_size, u32 max_size);
 bool CompressCodeLzss(const u8* a_pUncompressed, u32 a_uUncompressedSize, u8* a_pCompressed, u32* a_uCompressedSize);
+bool CompressCodeLzssLevel(const u8* a_pUncompressed, u32 a_uUncompressedSize, u8* a_pCompressed, u32* a_uCompressedSize, u32 level);
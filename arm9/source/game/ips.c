@@ -21,11 +21,17 @@ typedef enum {
     IPS_MEMORY
 } IPSERROR;
 
+#define IPS_WINDOW_SIZE (64 * 1024)
+
 static FIL patchFile, inFile, outFile;
 static size_t patchSize;
-static u8 *patch;
 static u32 patchOffset;
 
+// the patch is streamed through a small window, copies share a single buffer
+static u8 *patchWindow = NULL;
+static u32 windowOffset, windowSize;
+static u8 *copyBuffer = NULL;
+
 char errName[256];
 
 int displayError(int errcode) {
@@ -50,6 +56,9 @@ int displayError(int errcode) {
     fvx_close(&patchFile);
     fvx_close(&inFile);
     fvx_close(&outFile);
+    free(patchWindow);
+    free(copyBuffer);
+    patchWindow = copyBuffer = NULL;
     return errcode;
 }
 
@@ -59,55 +68,68 @@ typedef enum {
     COPY_RLE
 } COPYMODE;
 
+// make sure the window holds `need` bytes at patchOffset
+bool IPSfill(u32 need) {
+    if ((patchOffset >= windowOffset) && (patchOffset + need <= windowOffset + windowSize))
+        return true;
+    UINT bytes_read = 0;
+    windowOffset = patchOffset;
+    windowSize = 0;
+    if ((patchOffset >= patchSize) || (fvx_lseek(&patchFile, patchOffset) != FR_OK) ||
+        (fvx_read(&patchFile, patchWindow, min(IPS_WINDOW_SIZE, patchSize - patchOffset), &bytes_read) != FR_OK))
+        return false;
+    windowSize = bytes_read;
+    return (need <= windowSize);
+}
+
 bool IPScopy(u8 mode, u32 size, u8 rle) {
     bool ret = true;
-    if (mode == COPY_PATCH) {
-        UINT bytes_written = size;
-        if ((fvx_write(&outFile, &patch[patchOffset], size, &bytes_written) != FR_OK) ||
-            (size != bytes_written))
-            ret = false;
-        patchOffset += size;
+    if (mode == COPY_PATCH) { // written straight from the patch window
+        while ((size > 0) && ret) {
+            if (!IPSfill(1)) return false;
+            UINT write_bytes = min(size, windowOffset + windowSize - patchOffset);
+            UINT bytes_written = write_bytes;
+            if ((fvx_write(&outFile, patchWindow + (patchOffset - windowOffset), write_bytes, &bytes_written) != FR_OK) ||
+                (write_bytes != bytes_written))
+                ret = false;
+            patchOffset += write_bytes;
+            size -= write_bytes;
+        }
     } else {
         u32 bufsiz = min(STD_BUFFER_SIZE, size);
-        u8* buffer = malloc(bufsiz);
-        if (!buffer) return false;
-        if (mode == COPY_RLE) memset(buffer, rle, bufsiz);
+        if (mode == COPY_RLE) memset(copyBuffer, rle, bufsiz); // filled once for the whole record
 
         for (u64 pos = 0; (pos < size) && ret; pos += bufsiz) {
             UINT read_bytes = min(bufsiz, size - pos);
             UINT bytes_written = read_bytes;
-            if (((mode == COPY_IN) && (fvx_read(&inFile, buffer, read_bytes, &bytes_written) != FR_OK)) ||
-                ((mode == COPY_PATCH) && (fvx_read(&patchFile, buffer, read_bytes, &bytes_written) != FR_OK)) ||
+            if (((mode == COPY_IN) && (fvx_read(&inFile, copyBuffer, read_bytes, &bytes_written) != FR_OK)) ||
                 (read_bytes != bytes_written))
                 ret = false;
-            if ((ret && (fvx_write(&outFile, buffer, read_bytes, &bytes_written) != FR_OK)) ||
+            if ((ret && (fvx_write(&outFile, copyBuffer, read_bytes, &bytes_written) != FR_OK)) ||
                 (read_bytes != bytes_written))
                 ret = false;
         }
-
-        free(buffer);
     }
     return ret;
 }
 
 u8 read8() {
-    if (patchOffset >= patchSize) return 0;
-    return patch[patchOffset++];
+    if ((patchOffset >= patchSize) || !IPSfill(1)) return 0;
+    return patchWindow[patchOffset++ - windowOffset];
 }
 
 UINT read16() {
-    if (patchOffset+1 >= patchSize) return 0;
-    UINT buf = patch[patchOffset++] << 8;
-    buf |= patch[patchOffset++];
-    return buf;
+    if ((patchOffset+1 >= patchSize) || !IPSfill(2)) return 0;
+    u8* buf = patchWindow + (patchOffset - windowOffset);
+    patchOffset += 2;
+    return (buf[0] << 8) | buf[1];
 }
 
 UINT read24() {
-    if (patchOffset+2 >= patchSize) return 0;
-    UINT buf = patch[patchOffset++] << 16;
-    buf |= patch[patchOffset++] << 8;
-    buf |= patch[patchOffset++];
-    return buf;
+    if ((patchOffset+2 >= patchSize) || !IPSfill(3)) return 0;
+    u8* buf = patchWindow + (patchOffset - windowOffset);
+    patchOffset += 3;
+    return (buf[0] << 16) | (buf[1] << 8) | buf[2];
 }
 
 int ApplyIPSPatch(const char* patchName, const char* inName, const char* outName) {
@@ -117,10 +139,13 @@ int ApplyIPSPatch(const char* patchName, const char* inName, const char* outName
 
     if (fvx_open(&patchFile, patchName, FA_READ) != FR_OK) return displayError(IPS_INVALID_FILE_PATH);
     patchSize = fvx_size(&patchFile);
+    patchOffset = 0;
+    windowOffset = windowSize = 0;
     ShowProgress(0, patchSize, patchName);
 
-    patch = malloc(patchSize);
-    if (!patch || fvx_read(&patchFile, patch, patchSize, NULL) != FR_OK) return displayError(IPS_MEMORY);
+    patchWindow = malloc(IPS_WINDOW_SIZE);
+    copyBuffer = malloc(STD_BUFFER_SIZE);
+    if (!patchWindow || !copyBuffer) return displayError(IPS_MEMORY);
 
     // Check validity of patch
     if (patchSize < 8) return displayError(IPS_INVALID);
@@ -207,7 +232,7 @@ int ApplyIPSPatch(const char* patchName, const char* inName, const char* outName
     fvx_lseek(&outFile, inSize);
     if (outSize > inSize && !IPScopy(COPY_RLE, outSize - inSize, 0)) return displayError(IPS_MEMORY);
 
-    fvx_lseek(&patchFile, 5);
+    patchOffset = 5;
     offset = read24();
     while (offset != 0x454F46)
     {
@@ -219,8 +244,11 @@ int ApplyIPSPatch(const char* patchName, const char* inName, const char* outName
 
         fvx_lseek(&outFile, offset);
         unsigned int size = read16();
-        if (size == 0 && !IPScopy(COPY_RLE, read16(), read8())) return displayError(IPS_MEMORY);
-        else if (size != 0 && !IPScopy(COPY_PATCH, size, 0)) return displayError(IPS_MEMORY);
+        if (size == 0) { // RLE record, size and value have to be read in that order
+            size = read16();
+            u8 rle = read8();
+            if (!IPScopy(COPY_RLE, size, rle)) return displayError(IPS_MEMORY);
+        } else if (!IPScopy(COPY_PATCH, size, 0)) return displayError(IPS_MEMORY);
         offset = read24();
     }
 
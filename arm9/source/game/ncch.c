@@ -4,6 +4,50 @@
 #include "sha.h"
 
 #define EXEFS_KEYID(name) (((strncmp(name, "banner", 8) == 0) || (strncmp(name, "icon", 8) == 0)) ? 0 : 1)
+#define NCCH_KEY_CACHE_SIZE 4
+
+// keys last set up by SetNcchKey(), valid as long as the keyslot was not touched since
+typedef struct {
+    u8  key[16];
+    u32 keyslot;
+    u32 serial;
+    char type;
+} NcchKeyCacheEntry;
+
+static NcchKeyCacheEntry ncch_key_cache[NCCH_KEY_CACHE_SIZE] = { 0 };
+static NcchCryptoStats ncch_crypto_stats = { 0 };
+
+static void SetupNcchKeyCached(u32 keyslot, const u8* key, char type) {
+    static u32 next_entry = 0;
+    NcchKeyCacheEntry* entry = NULL;
+
+    for (u32 i = 0; i < NCCH_KEY_CACHE_SIZE; i++) {
+        if (ncch_key_cache[i].type && (ncch_key_cache[i].keyslot == keyslot)) {
+            entry = ncch_key_cache + i;
+            break;
+        }
+    }
+
+    if (entry && (entry->type == type) && (entry->serial == aes_keyslot_serial(keyslot)) &&
+        (memcmp(entry->key, key, 16) == 0))
+        return; // key already in place
+
+    if (!entry) {
+        entry = ncch_key_cache + next_entry;
+        next_entry = (next_entry + 1) % NCCH_KEY_CACHE_SIZE;
+    }
+
+    u8 key_al[16] __attribute__((aligned(32)));
+    memcpy(key_al, key, 16);
+    ncch_crypto_stats.key_setups++;
+    if (type == 'Y') setup_aeskeyY(keyslot, key_al);
+    else setup_aeskey(keyslot, key_al);
+
+    memcpy(entry->key, key, 16);
+    entry->keyslot = keyslot;
+    entry->serial = aes_keyslot_serial(keyslot);
+    entry->type = type;
+}
 
 u32 ValidateNcchHeader(NcchHeader* header) {
     if (memcmp(header->magic, "NCCH", 4) != 0) // check magic number
@@ -48,14 +92,17 @@ u32 GetNcchCtr(u8* ctr, NcchHeader* ncch, u8 section) {
     return 0;
 }
 
-u32 SetNcchKey(NcchHeader* ncch, u16 crypto, u32 keyid) {
+// derives the key for keyid (key X loaded, seed looked up), without setting it up
+static u32 GetNcchKey(u8* key, u32* keyslot, char* type, const u8* signature, u64 programId, u32 hash_seed,
+    u16 crypto, u32 keyid) {
     u8 flags3 = (crypto >> 8) & 0xFF;
     u8 flags7 = crypto & 0xFF;
-    u32 keyslot = (!keyid || !flags3) ? 0x2C : // standard / secure3 / secure4 / 7.x crypto
+    *keyslot = (!keyid || !flags3) ? 0x2C : // standard / secure3 / secure4 / 7.x crypto
         (flags3 == 0x0A) ? 0x18 : (flags3 == 0x0B) ? 0x1B : 0x25;
 
     if (flags7 & 0x04)
         return 1;
+    ncch_crypto_stats.key_derivations++;
 
     if (flags7 & 0x01) { // fixed key crypto
         // from https://github.com/profi200/Project_CTR/blob/master/makerom/pki/dev.h
@@ -63,13 +110,14 @@ u32 SetNcchKey(NcchHeader* ncch, u16 crypto, u32 keyid) {
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }; // zero key
         u8 sysKey[16]  = { 0x52, 0x7C, 0xE6, 0x30, 0xA9, 0xCA, 0x30, 0x5F,
             0x36, 0x96, 0xF3, 0xCD, 0xE9, 0x54, 0x19, 0x4B }; // fixed sys key
-        setup_aeskey(0x11, (ncch->programId & ((u64) 0x10 << 32)) ? sysKey : zeroKey);
-        use_aeskey(0x11);
+        memcpy(key, (programId & ((u64) 0x10 << 32)) ? sysKey : zeroKey, 16);
+        *keyslot = 0x11;
+        *type = 'N';
         return 0;
     }
 
     // load key X from file if required
-    if ((keyslot != 0x2C) && (LoadKeyFromFile(NULL, keyslot, 'X', NULL) != 0))
+    if ((*keyslot != 0x2C) && (LoadKeyFromFile(NULL, *keyslot, 'X', NULL) != 0))
         return 1;
 
     // key Y for seed and non seed
@@ -77,19 +125,32 @@ u32 SetNcchKey(NcchHeader* ncch, u16 crypto, u32 keyid) {
         static u8 seedkeyY[16+16] __attribute__((aligned(32))) = { 0 };
         static u8 lsignature[16] = { 0 };
         static u64 ltitleId = 0;
-        if ((memcmp(lsignature, ncch->signature, 16) != 0) || (ltitleId != ncch->programId)) {
+        if ((memcmp(lsignature, signature, 16) != 0) || (ltitleId != programId)) {
             u8 keydata[16+16] __attribute__((aligned(4)));
-            memcpy(keydata, ncch->signature, 16);
-            if (FindSeed(keydata + 16, ncch->programId, ncch->hash_seed) != 0)
+            memcpy(keydata, signature, 16);
+            if (FindSeed(keydata + 16, programId, hash_seed) != 0)
                 return 1;
             sha_quick(seedkeyY, keydata, 32, SHA256_MODE);
-            memcpy(lsignature, ncch->signature, 16);
-            ltitleId = ncch->programId;
+            memcpy(lsignature, signature, 16);
+            ltitleId = programId;
         }
-        setup_aeskeyY(keyslot, seedkeyY);
+        memcpy(key, seedkeyY, 16);
     } else { // no seed crypto
-        setup_aeskeyY(keyslot, ncch->signature);
+        memcpy(key, signature, 16);
     }
+    *type = 'Y';
+
+    return 0;
+}
+
+u32 SetNcchKey(NcchHeader* ncch, u16 crypto, u32 keyid) {
+    u8 key[16];
+    u32 keyslot;
+    char type;
+
+    if (GetNcchKey(key, &keyslot, &type, ncch->signature, ncch->programId, ncch->hash_seed, crypto, keyid) != 0)
+        return 1;
+    SetupNcchKeyCached(keyslot, key, type);
     use_aeskey(keyslot);
 
     return 0;
@@ -106,9 +167,63 @@ u32 SetupNcchCrypto(NcchHeader* ncch, u16 crypt_to) {
     return res_from | res_to;
 }
 
-u32 CryptNcchSection(void* data, u32 offset_data, u32 size_data, u32 offset_section, u32 size_section,
-    u32 offset_ctr, NcchHeader* ncch, u32 snum, u16 crypt_to, u32 keyid) {
-    u16 crypt_from = NCCH_GET_CRYPTO(ncch);
+// section offsets, CTRs and ExeFS file boundaries, keys are derived on first use
+static void InitNcchCryptoContext(NcchCryptoContext* ctx, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypto) {
+    memset(ctx, 0, sizeof(NcchCryptoContext));
+    ctx->crypto = crypto;
+    memcpy(ctx->signature, ncch->signature, 16);
+    ctx->programId = ncch->programId;
+    ctx->hash_seed = ncch->hash_seed;
+    for (u32 snum = 1; snum <= 3; snum++)
+        GetNcchCtr(ctx->ctr[snum], ncch, snum);
+
+    ctx->size_exthdr = ncch->size_exthdr;
+    ctx->offset_exefs = ncch->offset_exefs * NCCH_MEDIA_UNIT;
+    ctx->size_exefs = ncch->size_exefs * NCCH_MEDIA_UNIT;
+    ctx->offset_romfs = ncch->offset_romfs * NCCH_MEDIA_UNIT;
+    ctx->size_romfs = ncch->size_romfs * NCCH_MEDIA_UNIT;
+
+    if (!exefs) return;
+    ctx->has_exefs = true;
+    for (u32 i = 0; i < 10; i++) {
+        ExeFsFileHeader* file = exefs->files + i;
+        ctx->exefs_files[i].offset = file->offset;
+        ctx->exefs_files[i].size = file->size;
+        ctx->exefs_files[i].keyid = EXEFS_KEYID(file->name);
+    }
+}
+
+static u32 UseNcchContextKey(NcchCryptoContext* ctx, u32 keyid) {
+    if (!ctx->keytype[keyid] && (GetNcchKey(ctx->key[keyid], ctx->keyslot + keyid, ctx->keytype + keyid,
+        ctx->signature, ctx->programId, ctx->hash_seed, ctx->crypto, keyid) != 0))
+        ctx->keytype[keyid] = 'X';
+    if (ctx->keytype[keyid] == 'X')
+        return 1;
+
+    SetupNcchKeyCached(ctx->keyslot[keyid], ctx->key[keyid], ctx->keytype[keyid]);
+    use_aeskey(ctx->keyslot[keyid]);
+    return 0;
+}
+
+// builds the context for crypto, exefs may be NULL, fails if a key is not available
+u32 BuildNcchCryptoContext(NcchCryptoContext* ctx, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypto) {
+    InitNcchCryptoContext(ctx, ncch, exefs, crypto);
+    if (crypto & NCCH_NOCRYPTO) return 0;
+
+    u32 res = 0;
+    for (u32 keyid = 0; keyid <= 1; keyid++) {
+        if (GetNcchKey(ctx->key[keyid], ctx->keyslot + keyid, ctx->keytype + keyid,
+            ctx->signature, ctx->programId, ctx->hash_seed, crypto, keyid) != 0) {
+            ctx->keytype[keyid] = 'X';
+            res = 1;
+        }
+    }
+
+    return res;
+}
+
+static u32 CryptNcchSection(void* data, u32 offset_data, u32 size_data, u32 offset_section, u32 size_section,
+    u32 offset_ctr, u32 snum, u32 keyid, NcchCryptoContext* from, NcchCryptoContext* to) {
     const u32 mode = AES_CNT_CTRNAND_MODE;
 
     // check if section in data
@@ -131,25 +246,31 @@ u32 CryptNcchSection(void* data, u32 offset_data, u32 size_data, u32 offset_sect
         size_i = size_data - (data_i - data8);
 
     // actual decryption stuff
-    u8 ctr[16];
-    GetNcchCtr(ctr, ncch, snum);
-    if (!(crypt_from & NCCH_NOCRYPTO)) {
-        if (SetNcchKey(ncch, crypt_from, keyid) != 0) return 1;
+    if (!(from->crypto & NCCH_NOCRYPTO)) {
+        u8 ctr[16];
+        memcpy(ctr, from->ctr[snum], 16);
+        if (UseNcchContextKey(from, keyid) != 0) return 1;
         ctr_decrypt_byte(data_i, data_i, size_i, offset_i + offset_ctr, mode, ctr);
+        ncch_crypto_stats.bytes += size_i;
     }
-    if (!(crypt_to & NCCH_NOCRYPTO)) {
-        if (SetNcchKey(ncch, crypt_to, keyid) != 0) return 1;
+    if (to && !(to->crypto & NCCH_NOCRYPTO)) {
+        u8 ctr[16];
+        memcpy(ctr, to->ctr[snum], 16);
+        if (UseNcchContextKey(to, keyid) != 0) return 1;
         ctr_decrypt_byte(data_i, data_i, size_i, offset_i + offset_ctr, mode, ctr);
+        ncch_crypto_stats.bytes += size_i;
     }
 
     return 0;
 }
 
-// on the fly de-/encryptor for NCCH
-u32 CryptNcch(void* data, u32 offset, u32 size, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypt_to) {
+// on the fly de-/encryptor for NCCH, with contexts built for the current and the
+// desired crypto of the same NCCH (to == NULL: decrypt)
+u32 CryptNcchContext(void* data, u32 offset, u32 size, NcchCryptoContext* from, NcchCryptoContext* to) {
     const u32 offset_flag3 = 0x188 + 3;
     const u32 offset_flag7 = 0x188 + 7;
-    u16 crypt_from = NCCH_GET_CRYPTO(ncch);
+    u16 crypt_from = from->crypto;
+    u16 crypt_to = (to) ? to->crypto : NCCH_NOCRYPTO;
 
     // check for encryption
     if ((crypt_to & crypt_from & NCCH_NOCRYPTO) || (crypt_to == crypt_from))
@@ -164,48 +285,62 @@ u32 CryptNcch(void* data, u32 offset, u32 size, NcchHeader* ncch, ExeFsHeader* e
     }
 
     // exthdr handling
-    if (ncch->size_exthdr) {
+    if (from->size_exthdr) {
         if (CryptNcchSection(data, offset, size,
             NCCH_EXTHDR_OFFSET,
             NCCH_EXTHDR_SIZE,
-            0, ncch, 1, crypt_to, 0) != 0) return 1;
+            0, 1, 0, from, to) != 0) return 1;
     }
 
     // exefs handling
-    if (ncch->size_exefs) {
+    if (from->size_exefs) {
         // exefs header handling
         if (CryptNcchSection(data, offset, size,
-            ncch->offset_exefs * NCCH_MEDIA_UNIT,
-            0x200, 0, ncch, 2, crypt_to, 0) != 0) return 1;
+            from->offset_exefs,
+            0x200, 0, 2, 0, from, to) != 0) return 1;
 
         // exefs file handling
-        if (exefs) for (u32 i = 0; i < 10; i++) {
-            ExeFsFileHeader* file = exefs->files + i;
-            if (!file->size) continue;
+        if (from->has_exefs) for (u32 i = 0; i < 10; i++) {
+            u32 offset_in_exefs = from->exefs_files[i].offset;
+            u32 size_file = from->exefs_files[i].size;
+            if (!size_file) continue;
 
-            u32 offset_file = (ncch->offset_exefs * NCCH_MEDIA_UNIT) + 0x200 + file->offset;
-            u32 size_file = file->size;
+            u32 offset_file = from->offset_exefs + 0x200 + offset_in_exefs;
             u32 offset_pad = offset_file + size_file;
             u32 size_pad = align(size_file, NCCH_MEDIA_UNIT) - size_file;
 
-            if (CryptNcchSection(data, offset, size, offset_file, size_file, 0x200 + file->offset,
-                ncch, 2, crypt_to, EXEFS_KEYID(file->name)) != 0) return 1;
-            if (CryptNcchSection(data, offset, size, offset_pad, size_pad, 0x200 + file->offset + file->size,
-                ncch, 2, crypt_to, 0) != 0) return 1;
+            if (CryptNcchSection(data, offset, size, offset_file, size_file, 0x200 + offset_in_exefs,
+                2, from->exefs_files[i].keyid, from, to) != 0) return 1;
+            if (CryptNcchSection(data, offset, size, offset_pad, size_pad, 0x200 + offset_in_exefs + size_file,
+                2, 0, from, to) != 0) return 1;
         }
     }
 
     // romfs handling
-    if (ncch->size_romfs) {
+    if (from->size_romfs) {
         if (CryptNcchSection(data, offset, size,
-            ncch->offset_romfs * NCCH_MEDIA_UNIT,
-            ncch->size_romfs * NCCH_MEDIA_UNIT,
-            0, ncch, 3, crypt_to, 1) != 0) return 1;
+            from->offset_romfs,
+            from->size_romfs,
+            0, 3, 1, from, to) != 0) return 1;
     }
 
     return 0;
 }
 
+// on the fly de-/encryptor for NCCH, derives everything for this one call
+u32 CryptNcch(void* data, u32 offset, u32 size, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypt_to) {
+    NcchCryptoContext from, to;
+    u16 crypt_from = NCCH_GET_CRYPTO(ncch);
+
+    // check for encryption
+    if ((crypt_to & crypt_from & NCCH_NOCRYPTO) || (crypt_to == crypt_from))
+        return 0; // desired end result already met
+
+    InitNcchCryptoContext(&from, ncch, exefs, crypt_from);
+    InitNcchCryptoContext(&to, ncch, exefs, crypt_to);
+    return CryptNcchContext(data, offset, size, &from, &to);
+}
+
 // on the fly de- / encryptor for NCCH - sequential
 u32 CryptNcchSequential(void* data, u32 offset, u32 size, u16 crypt_to) {
     // warning: this will only work for sequential processing
@@ -214,12 +349,16 @@ u32 CryptNcchSequential(void* data, u32 offset, u32 size, u16 crypt_to) {
     static ExeFsHeader exefs = { 0 };
     static NcchHeader* ncchptr = NULL;
     static ExeFsHeader* exefsptr = NULL;
+    static NcchCryptoContext ctx_from, ctx_to; // valid while ctx_ncch / ctx_exefs match
+    static NcchHeader* ctx_ncch = NULL;
+    static ExeFsHeader* ctx_exefs = NULL;
 
     // fetch ncch header from data
     if ((offset == 0) && (size >= sizeof(NcchHeader))) {
         memcpy(&ncch, data, sizeof(NcchHeader));
         ncchptr = (ValidateNcchHeader(&ncch) == 0) ? &ncch : NULL;
         exefsptr = NULL;
+        ctx_ncch = NULL;
     }
 
     // safety check, ncch pointer
@@ -239,7 +378,15 @@ u32 CryptNcchSequential(void* data, u32 offset, u32 size, u16 crypt_to) {
         }
     }
 
-    return CryptNcch(data, offset, size, ncchptr, exefsptr, crypt_to);
+    // keys and CTRs once per NCCH, not once per chunk
+    if ((ctx_ncch != ncchptr) || (ctx_exefs != exefsptr) || (ctx_to.crypto != crypt_to)) {
+        InitNcchCryptoContext(&ctx_from, ncchptr, exefsptr, NCCH_GET_CRYPTO(ncchptr));
+        InitNcchCryptoContext(&ctx_to, ncchptr, exefsptr, crypt_to);
+        ctx_ncch = ncchptr;
+        ctx_exefs = exefsptr;
+    }
+
+    return CryptNcchContext(data, offset, size, &ctx_from, &ctx_to);
 }
 
 u32 SetNcchSdFlag(void* data) { // data must be at least 0x600 byte and start with NCCH header
@@ -269,3 +416,11 @@ u32 SetupSystemForNcch(NcchHeader* ncch, bool to_emunand) {
         return 1;
     return 0;
 }
+
+void GetNcchCryptoStats(NcchCryptoStats* stats) {
+    memcpy(stats, &ncch_crypto_stats, sizeof(NcchCryptoStats));
+}
+
+void ResetNcchCryptoStats(void) {
+    memset(&ncch_crypto_stats, 0, sizeof(NcchCryptoStats));
+}
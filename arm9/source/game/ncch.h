@@ -83,10 +83,45 @@ typedef struct {
     u8  hash_romfs[0x20];
 } __attribute__((packed, aligned(16))) NcchHeader;
 
+// crypto state of one NCCH for one crypto setting, derived once from its headers
+// and reused for every chunk (see BuildNcchCryptoContext())
+typedef struct {
+    u16 crypto;
+    u8  signature[16]; // key Y source
+    u64 programId;
+    u32 hash_seed;
+    u32 keyslot[2]; // for keyid 0 / 1
+    u8  key[2][16]; // key Y, normal key for fixed key crypto
+    char keytype[2]; // 'Y' / 'N', 'X' if not available, zero if not derived yet
+    u8  ctr[4][16]; // base CTRs by section number (1: ExtHeader, 2: ExeFS, 3: RomFS)
+    u32 size_exthdr;
+    u32 offset_exefs; // in byte
+    u32 size_exefs;
+    u32 offset_romfs;
+    u32 size_romfs;
+    bool has_exefs; // ExeFS file boundaries below are known
+    struct {
+        u32 offset; // relative to the ExeFS
+        u32 size;
+        u32 keyid;
+    } exefs_files[10];
+} NcchCryptoContext;
+
+// key work done for NCCH crypto, see GetNcchCryptoStats()
+typedef struct {
+    u32 key_derivations; // key X loads, seed lookups, key Y selection
+    u32 key_setups; // actual keyslot writes
+    u64 bytes; // bytes de- / encrypted
+} NcchCryptoStats;
+
 u32 ValidateNcchHeader(NcchHeader* header);
 u32 SetNcchKey(NcchHeader* ncch, u16 crypto, u32 keyid);
 u32 SetupNcchCrypto(NcchHeader* ncch, u16 crypt_to);
+u32 BuildNcchCryptoContext(NcchCryptoContext* ctx, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypto);
+u32 CryptNcchContext(void* data, u32 offset, u32 size, NcchCryptoContext* from, NcchCryptoContext* to);
 u32 CryptNcch(void* data, u32 offset, u32 size, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypto);
 u32 CryptNcchSequential(void* data, u32 offset, u32 size, u16 crypto);
 u32 SetNcchSdFlag(void* data);
 u32 SetupSystemForNcch(NcchHeader* ncch, bool to_emunand);
+void GetNcchCryptoStats(NcchCryptoStats* stats);
+void ResetNcchCryptoStats(void);
@@ -7,6 +7,12 @@
 #define TITLETAG_MAX_ENTRIES  2000 // same as SEEDSAVE_MAX_ENTRIES
 #define TITLETAG_AREA_OFFSET  0x10000 // thanks @luigoalma
 
+// SysNAND / EmuNAND SEEDDB and seeddb.bin, kept in memory while held (see HoldSeedDbs())
+static SeedDb* seeddb_resident[2] = { NULL };
+static SeedInfo* seedinfo_resident = NULL;
+static size_t seedinfo_resident_len = 0;
+static bool seeddbs_held = false;
+
 // this structure is 0x80 bytes, thanks @luigoalma
 typedef struct {
     char magic[4]; // "PREP" for prepurchase install. NIM excepts "PREP" to do seed downloads on the background.
@@ -58,6 +64,44 @@ u32 GetSeedPath(char* path, const char* drv) {
     return 0;
 }
 
+void HoldSeedDbs(bool hold) {
+    const char* nand_drv[] = {"1:", "4:"}; // SysNAND and EmuNAND
+
+    for (u32 i = 0; i < countof(nand_drv); i++) {
+        free(seeddb_resident[i]);
+        seeddb_resident[i] = NULL;
+    }
+    free(seedinfo_resident);
+    seedinfo_resident = NULL;
+    seedinfo_resident_len = 0;
+    seeddbs_held = false;
+    if (!hold) return;
+
+    // NAND databases, missing ones stay NULL
+    for (u32 i = 0; i < countof(nand_drv); i++) {
+        char path[128];
+        SeedDb* seeddb = (SeedDb*) malloc(sizeof(SeedDb));
+        if (!seeddb) return;
+        if ((GetSeedPath(path, nand_drv[i]) != 0) ||
+            (ReadDisaDiffIvfcLvl4(path, NULL, SEEDSAVE_AREA_OFFSET, sizeof(SeedDb), seeddb) != sizeof(SeedDb)) ||
+            (seeddb->n_entries > SEEDSAVE_MAX_ENTRIES)) {
+            free(seeddb);
+            continue;
+        }
+        seeddb_resident[i] = seeddb;
+    }
+
+    // seeddb.bin, trimmed to its actual size
+    SeedInfo* seedinfo = (SeedInfo*) malloc(STD_BUFFER_SIZE);
+    if (!seedinfo) return;
+    size_t len = LoadSupportFile(SEEDINFO_NAME, seedinfo, STD_BUFFER_SIZE);
+    SeedInfo* seedinfo_fit = (SeedInfo*) realloc(seedinfo, max(len, 16));
+    seedinfo_resident = (seedinfo_fit) ? seedinfo_fit : seedinfo;
+    seedinfo_resident_len = len;
+
+    seeddbs_held = true;
+}
+
 u32 FindSeed(u8* seed, u64 titleId, u32 hash_seed) {
     static u8 lseed[16+8] __attribute__((aligned(4))) = { 0 }; // seed plus title ID for easy validation
     u32 sha256sum[8];
@@ -69,9 +113,12 @@ u32 FindSeed(u8* seed, u64 titleId, u32 hash_seed) {
         return 0;
     }
 
-    // setup a large enough buffer
-    u8* buffer = (u8*) malloc(max(STD_BUFFER_SIZE, sizeof(SeedDb)));
-    if (!buffer) return 1;
+    // setup a large enough buffer (not needed with resident databases)
+    u8* buffer = NULL;
+    if (!seeddbs_held) {
+        buffer = (u8*) malloc(max(STD_BUFFER_SIZE, sizeof(SeedDb)));
+        if (!buffer) return 1;
+    }
     
     // try to grab the seed from NAND database
     const char* nand_drv[] = {"1:", "4:"}; // SysNAND and EmuNAND
@@ -80,10 +127,14 @@ u32 FindSeed(u8* seed, u64 titleId, u32 hash_seed) {
         SeedDb* seeddb = (SeedDb*) (void*) buffer;
 
         // read SEEDDB from file
-        if (GetSeedPath(path, nand_drv[i]) != 0) continue;
-        if ((ReadDisaDiffIvfcLvl4(path, NULL, SEEDSAVE_AREA_OFFSET, sizeof(SeedDb), seeddb) != sizeof(SeedDb)) ||
-            (seeddb->n_entries > SEEDSAVE_MAX_ENTRIES))
-            continue;
+        if (seeddbs_held) {
+            if (!(seeddb = seeddb_resident[i])) continue;
+        } else {
+            if (GetSeedPath(path, nand_drv[i]) != 0) continue;
+            if ((ReadDisaDiffIvfcLvl4(path, NULL, SEEDSAVE_AREA_OFFSET, sizeof(SeedDb), seeddb) != sizeof(SeedDb)) ||
+                (seeddb->n_entries > SEEDSAVE_MAX_ENTRIES))
+                continue;
+        }
 
         // search for the seed
         for (u32 s = 0; s < seeddb->n_entries; s++) {
@@ -99,8 +150,8 @@ u32 FindSeed(u8* seed, u64 titleId, u32 hash_seed) {
     }
     
     // not found -> try seeddb.bin
-    SeedInfo* seeddb = (SeedInfo*) (void*) buffer;
-    size_t len = LoadSupportFile(SEEDINFO_NAME, seeddb, STD_BUFFER_SIZE);
+    SeedInfo* seeddb = (seeddbs_held) ? seedinfo_resident : (SeedInfo*) (void*) buffer;
+    size_t len = (seeddbs_held) ? seedinfo_resident_len : LoadSupportFile(SEEDINFO_NAME, seeddb, STD_BUFFER_SIZE);
     if (len && (seeddb->n_entries <= (len - 16) / 32)) { // check filesize / seeddb size
         for (u32 s = 0; s < seeddb->n_entries; s++) {
             if (titleId != seeddb->entries[s].titleId)
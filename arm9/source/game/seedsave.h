@@ -35,6 +35,7 @@ typedef struct {
 
 u32 GetSeedPath(char* path, const char* drv);
 u32 FindSeed(u8* seed, u64 titleId, u32 hash_seed);
+void HoldSeedDbs(bool hold);
 u32 AddSeedToDb(SeedInfo* seed_info, SeedInfoEntry* seed_entry);
 u32 InstallSeedDbToSystem(SeedInfo* seed_info, bool to_emunand);
 u32 SetupSeedPrePurchase(u64 titleId, bool to_emunand);
@@ -28,17 +28,9 @@ u32 ValidateTwlTicket(Ticket* ticket) {
 }
 
 u32 ValidateTicketSignature(Ticket* ticket) {
-    Certificate cert;
-
-    // grab cert from certs.db
-    if (LoadCertFromCertDb(&cert, (char*)(ticket->issuer)) != 0)
-        return 1;
-
-    int ret = Certificate_VerifySignatureBlock(&cert, &(ticket->signature), 0x100, (void*)&(ticket->issuer), GetTicketSize(ticket) - 0x140, true);
-
-    Certificate_Cleanup(&cert);
-
-    return ret;
+    // cert comes from certs.db, already verified tickets are not checked again
+    return VerifySignatureFromCertDb((char*)(ticket->issuer), &(ticket->signature), 0x100,
+        (void*)&(ticket->issuer), GetTicketSize(ticket) - 0x140);
 }
 
 u32 BuildVariableFakeTicket(Ticket** ticket, u32* ticket_size, const u8* title_id, u32 index_max) {
@@ -7,6 +7,10 @@
 
 #define PART_PATH "D:/partitionA.bin"
 
+// decTitleKeys.bin / encTitleKeys.bin, kept in memory while held (see HoldTitleKeyDbs())
+static TitleKeysInfo* tikdb_resident[2] = { NULL };
+static u32 tikdb_resident_len[2] = { 0 };
+
 u32 CryptTitleKey(TitleKeyEntry* tik, bool encrypt, bool devkit) {
     // From https://github.com/profi200/Project_CTR/blob/master/makerom/pki/prod.h#L19
     static const u8 common_keyy[6][16] __attribute__((aligned(16))) = {
@@ -103,32 +107,55 @@ u32 FindTicket(Ticket** ticket, u8* title_id, bool force_legit, bool emunand) {
     return 0;
 }
 
+void HoldTitleKeyDbs(bool hold) {
+    for (u32 enc = 0; enc <= 1; enc++) {
+        free(tikdb_resident[enc]);
+        tikdb_resident[enc] = NULL;
+        tikdb_resident_len[enc] = 0;
+        if (!hold) continue;
+
+        TitleKeysInfo* tikdb = (TitleKeysInfo*) malloc(STD_BUFFER_SIZE);
+        if (!tikdb) continue;
+        u32 len = LoadSupportFile((enc) ? TIKDB_NAME_ENC : TIKDB_NAME_DEC, tikdb, STD_BUFFER_SIZE);
+        TitleKeysInfo* tikdb_fit = (TitleKeysInfo*) realloc(tikdb, max(len, 16));
+        tikdb_resident[enc] = (tikdb_fit) ? tikdb_fit : tikdb;
+        tikdb_resident_len[enc] = len;
+    }
+}
+
 u32 FindTitleKey(Ticket* ticket, u8* title_id) {
+    TitleKeysInfo* tikdb_buffer = NULL;
     bool found = false;
 
     // search for a titlekey inside encTitleKeys.bin / decTitleKeys.bin
     // when found, add it to the ticket
-    TitleKeysInfo* tikdb = (TitleKeysInfo*) malloc(STD_BUFFER_SIZE); // more than enough
-    if (!tikdb) return 1;
     for (u32 enc = 0; (enc <= 1) && !found; enc++) {
-        u32 len = LoadSupportFile((enc) ? TIKDB_NAME_ENC : TIKDB_NAME_DEC, tikdb, STD_BUFFER_SIZE);
+        TitleKeysInfo* tikdb = tikdb_resident[enc];
+        u32 len = tikdb_resident_len[enc];
+        if (!tikdb) {
+            if (!tikdb_buffer) tikdb_buffer = (TitleKeysInfo*) malloc(STD_BUFFER_SIZE); // more than enough
+            if (!tikdb_buffer) return 1;
+            tikdb = tikdb_buffer;
+            len = LoadSupportFile((enc) ? TIKDB_NAME_ENC : TIKDB_NAME_DEC, tikdb, STD_BUFFER_SIZE);
+        }
 
         if (len == 0) continue; // file not found
         if (tikdb->n_entries > (len - 16) / 32)
             continue; // filesize / titlekey db size mismatch
         for (u32 t = 0; t < tikdb->n_entries; t++) {
-            TitleKeyEntry* tik = tikdb->entries + t;
-            if (memcmp(title_id, tik->title_id, 8) != 0)
+            TitleKeyEntry tik;
+            if (memcmp(title_id, tikdb->entries[t].title_id, 8) != 0)
                 continue;
-            if (!enc && (CryptTitleKey(tik, true, TICKET_DEVKIT(ticket)) != 0)) // encrypt the key first
+            memcpy(&tik, tikdb->entries + t, sizeof(TitleKeyEntry)); // keep the database untouched
+            if (!enc && (CryptTitleKey(&tik, true, TICKET_DEVKIT(ticket)) != 0)) // encrypt the key first
                 continue;
-            memcpy(ticket->titlekey, tik->titlekey, 16);
-            ticket->commonkey_idx = tik->commonkey_idx;
+            memcpy(ticket->titlekey, tik.titlekey, 16);
+            ticket->commonkey_idx = tik.commonkey_idx;
             found = true; // found, inserted
             break;
         }
     }
-    free(tikdb);
+    free(tikdb_buffer);
 
     // desperate measures - search in the internal ticket database
     Ticket* ticket_tmp = NULL;
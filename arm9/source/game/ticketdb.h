@@ -38,6 +38,7 @@ u32 GetTitleKey(u8* titlekey, Ticket* ticket);
 u32 SetTitleKey(const u8* titlekey, Ticket* ticket);
 u32 FindTicket(Ticket** ticket, u8* title_id, bool force_legit, bool emunand);
 u32 FindTitleKey(Ticket* ticket, u8* title_id);
+void HoldTitleKeyDbs(bool hold);
 u32 FindTitleKeyForId(u8* titlekey, u8* title_id);
 u32 AddTitleKeyToInfo(TitleKeysInfo* tik_info, TitleKeyEntry* tik_entry, bool decrypted_in, bool decrypted_out, bool devkit);
 u32 AddTicketToInfo(TitleKeysInfo* tik_info, Ticket* ticket, bool decrypt);
@@ -24,17 +24,8 @@ u32 ValidateTwlTmd(TitleMetaData* tmd) {
 }
 
 u32 ValidateTmdSignature(TitleMetaData* tmd) {
-    Certificate cert;
-
-    // grab cert from certs.db
-    if (LoadCertFromCertDb(&cert, (char*)(tmd->issuer)) != 0)
-        return 1;
-
-    int ret = Certificate_VerifySignatureBlock(&cert, &(tmd->signature), 0x100, (void*)&(tmd->issuer), 0xC4, true);
-
-    Certificate_Cleanup(&cert);
-
-    return ret;
+    // cert comes from certs.db, already verified TMDs are not checked again
+    return VerifySignatureFromCertDb((char*)(tmd->issuer), &(tmd->signature), 0x100, (void*)&(tmd->issuer), 0xC4);
 }
 
 u32 VerifyTmd(TitleMetaData* tmd) {
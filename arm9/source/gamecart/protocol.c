@@ -30,6 +30,9 @@
 #define REG_AESKEYXFIFO (*(vu32*)0x10009104)
 #define REG_AESKEYYFIFO (*(vu32*)0x10009108)
 
+// from aes.h, which can't be included here because of the above
+void aes_keyslot_changed(uint8_t keyslot);
+
 u32 CartID = 0xFFFFFFFFu;
 u32 CartType = 0;
 
@@ -128,6 +131,7 @@ static u8 card_aes(u32 *out, u32 *buff, size_t size) { // note size param ignore
         REG_AESKEYFIFO = 0;
         REG_AESKEYFIFO = 0;
         REG_AESKEYFIFO = 0;
+        aes_keyslot_changed(0x11);
         REG_AESKEYSEL = 0x11;
     }
     else
@@ -137,6 +141,7 @@ static u8 card_aes(u32 *out, u32 *buff, size_t size) { // note size param ignore
         REG_AESKEYYFIFO = buff[1];
         REG_AESKEYYFIFO = buff[2];
         REG_AESKEYYFIFO = buff[3];
+        aes_keyslot_changed(0x3B);
         REG_AESKEYSEL = 0x3B;
     }
 
@@ -858,7 +858,7 @@ u32 ShaCalculator(const char* path, bool sha1) {
     char pathstr[UTF_BUFFER_BYTESIZE(32)];
     u8 hash[32];
     TruncateString(pathstr, path, 32, 8);
-    if (!FileGetSha(path, hash, 0, 0, sha1)) {
+    if (!FileGetSha(path, hash, 0, 0, sha1, NULL, 0)) {
         ShowPrompt(false, STR_CALCULATING_SHA_FAILED, sha1 ? "1" : "256");
         return 1;
     } else {
@@ -979,8 +979,17 @@ u32 CartRawDump(void) {
         return 1;
     }
 
-    // input dump size
+    // trimmed dumps stop where the header says the game data ends
     dsize = cdata->cart_size;
+    if (cdata->data_size && (cdata->data_size < dsize)) {
+        char fullstr[32];
+        FormatBytes(fullstr, dsize);
+        FormatBytes(bytestr, cdata->data_size);
+        if (ShowPrompt(true, STR_CART_DUMP_TRIMMED, cname, bytestr, fullstr))
+            dsize = cdata->data_size;
+    }
+
+    // input dump size
     FormatBytes(bytestr, dsize);
     dsize = ShowHexPrompt(dsize, 8, STR_CART_DETECTED_SIZE_INPUT_BELOW, cname, bytestr);
     if (!dsize || (dsize == (u64) -1)) {
@@ -997,32 +1006,16 @@ u32 CartRawDump(void) {
     snprintf(dest, sizeof(dest), "%s/%s_%08llX.%s",
         OUTPUT_PATH, cname, dsize, (cdata->cart_type & CART_CTR) ? "3ds" : "nds");
 
-    // buffer allocation
-    u8* buf = (u8*) malloc(STD_BUFFER_SIZE);
-    if (!buf) { // this will not happen
-        free(cdata);
-        return 1;
-    }
-
-    // actual cart dump
-    u32 ret = 0;
+    // actual cart dump, hashes are calculated on the fly
+    u8 sha256[0x20];
+    u32 crc32;
     PathDelete(dest);
-    ShowProgress(0, 0, cname);
-    for (u64 p = 0; p < dsize; p += STD_BUFFER_SIZE) {
-        u64 len = min((dsize - p), STD_BUFFER_SIZE);
-        if ((ReadCartBytes(buf, p, len, cdata, false) != 0) ||
-            (fvx_qwrite(dest, buf, p, len, NULL) != FR_OK) ||
-            !ShowProgress(p, dsize, cname)) {
-            PathDelete(dest);
-            ret = 1;
-            break;
-        }
-    }
+    u32 ret = DumpGameCart(dest, cdata, dsize, true, sha256, &crc32);
 
     if (ret) ShowPrompt(false, STR_FAILED_DUMPING_CART, cname);
-    else ShowPrompt(false, STR_PATH_DUMPED_TO_OUT, cname, OUTPUT_PATH);
-    
-    free(buf);
+    else ShowPrompt(false, STR_PATH_DUMPED_TO_OUT_HASHES, cname, OUTPUT_PATH,
+        getbe64(sha256 + 0), getbe64(sha256 + 8), getbe64(sha256 + 16), getbe64(sha256 + 24), crc32);
+
     free(cdata);
     return ret;
 }
@@ -1657,6 +1650,10 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         if ((n_marked > 1) && ShowPrompt(true, STR_TRY_TO_PROCESS_N_SELECTED_FILES, n_marked)) {
             u32 n_success = 0;
             u32 n_other = 0;
+            u64 msec_total = 0;
+            u64 msec_slowest = 0;
+            char slowest[UTF_BUFFER_BYTESIZE(32)] = { 0 };
+            bool batch = (user_select != cxi_dump) && (BeginCiaBatch() == 0);
             for (u32 i = 0; i < current_dir->n_entries; i++) {
                 const char* path = current_dir->entry[i].path;
                 if (!current_dir->entry[i].marked)
@@ -1666,9 +1663,17 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                     continue;
                 }
                 DrawDirContents(current_dir, (*cursor = i), scroll);
+                u64 timer = timer_start();
                 if (((user_select != cxi_dump) && (BuildCiaFromGameFile(path, force_legit) == 0)) ||
-                    ((user_select == cxi_dump) && (DumpCxiSrlFromGameFile(path) == 0))) n_success++;
-                else { // on failure: show error, continue
+                    ((user_select == cxi_dump) && (DumpCxiSrlFromGameFile(path) == 0))) {
+                    u64 msec = timer_msec(timer);
+                    msec_total += msec;
+                    if (msec >= msec_slowest) {
+                        msec_slowest = msec;
+                        TruncateString(slowest, path, 32, 8);
+                    }
+                    n_success++;
+                } else { // on failure: show error, continue
                     char lpathstr[UTF_BUFFER_BYTESIZE(32)];
                     TruncateString(lpathstr, path, 32, 8);
                     if (ShowPrompt(true, STR_PATH_BUILD_TYPE_FAILED_CONTINUE, lpathstr, type)) continue;
@@ -1676,6 +1681,10 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
                 }
                 current_dir->entry[i].marked = false;
             }
+            if (batch) EndCiaBatch();
+            if (n_success) ShowPrompt(false, STR_N_TYPES_BUILT_IN_N_SECONDS_SLOWEST, n_success, type,
+                (u32) (msec_total / 1000), (u32) (msec_total % 1000), (u32) (msec_total / n_success),
+                slowest, (u32) msec_slowest);
             if (n_other) ShowPrompt(false, STR_N_OF_N_TYPES_BUILT_N_OF_N_NOT_SAME_TYPE,
                 n_success, n_marked, type, n_other, n_marked);
             else ShowPrompt(false, STR_N_OF_N_TYPES_BUILT, n_success, n_marked, type);
@@ -2077,8 +2086,14 @@ u32 FileHandlerMenu(char* current_path, u32* cursor, u32* scroll, PaneData** pan
         return 0;
     }
     else if (user_select == restore) { // -> restore SysNAND (A9LH preserving)
-        ShowPrompt(false, "%s\n%s", pathstr, (SafeRestoreNandDump(file_path) == 0) ?
-            STR_NAND_RESTORE_SUCCESS : STR_NAND_RESTORE_FAILED);
+        u64 written = 0;
+        if (SafeRestoreNandDump(file_path, &written) == 0) {
+            char bytestr[32];
+            char writtenstr[64];
+            FormatBytes(bytestr, written);
+            snprintf(writtenstr, sizeof(writtenstr), STR_NAND_RESTORE_N_WRITTEN, bytestr);
+            ShowPrompt(false, "%s\n%s\n%s", pathstr, STR_NAND_RESTORE_SUCCESS, writtenstr);
+        } else ShowPrompt(false, "%s\n%s", pathstr, STR_NAND_RESTORE_FAILED);
         return 0;
     }
     else if (user_select == ncsdfix) { // -> inject sighaxed NCSD
@@ -2860,7 +2875,7 @@ u32 GodMode(int entrypoint) {
             } else if ((curr_drvtype & DRV_CART) && (pad_state & BUTTON_Y)) {
                 ShowPrompt(false, "%s", STR_NOT_ALLOWED_IN_GAMECART_DRIVE);
             } else if (pad_state & BUTTON_Y) { // paste files
-                const char* optionstr[2] = { STR_COPY_PATHS, STR_MOVE_PATHS };
+                const char* optionstr[4] = { STR_COPY_PATHS, STR_MOVE_PATHS, STR_SYNC_PATHS, STR_COPY_PATHS_RESUMABLE };
                 char promptstr[UTF_BUFFER_BYTESIZE(64)];
                 u32 flags = 0;
                 u32 user_select;
@@ -2869,8 +2884,22 @@ u32 GodMode(int entrypoint) {
                     TruncateString(namestr, clipboard->entry[0].name, 20, 12);
                     snprintf(promptstr, sizeof(promptstr), STR_PASTE_FILE_HERE, namestr);
                 } else snprintf(promptstr, sizeof(promptstr), STR_PASTE_N_PATHS_HERE, clipboard->n_entries);
-                user_select = ((DriveType(clipboard->entry[0].path) & curr_drvtype & DRV_STDFAT)) ?
-                    ShowSelectPrompt(2, optionstr, "%s", promptstr) : (ShowPrompt(true, "%s", promptstr) ? 1 : 0);
+                if (DriveType(clipboard->entry[0].path) & curr_drvtype & DRV_STDFAT) {
+                    user_select = ShowSelectPrompt(4, optionstr, "%s", promptstr);
+                } else if (!(curr_drvtype & DRV_VIRTUAL)) { // copy only, but may be resumable
+                    const char* optionstr_copy[2] = { STR_COPY_PATHS, STR_COPY_PATHS_RESUMABLE };
+                    user_select = ShowSelectPrompt(2, optionstr_copy, "%s", promptstr);
+                    if (user_select == 2) user_select = 4;
+                } else user_select = ShowPrompt(true, "%s", promptstr) ? 1 : 0;
+                if (user_select == 3) { // sync is a copy that skips unchanged files
+                    flags |= SYNC_ALL;
+                    if (ShowPrompt(true, "%s", STR_SYNC_DELETE_ORPHANS)) flags |= SYNC_PURGE;
+                    ResetSyncInfo();
+                    user_select = 1;
+                } else if (user_select == 4) { // resumable copy keeps a journal next to large files
+                    flags |= ALLOW_RESUME;
+                    user_select = 1;
+                }
                 if (user_select) {
                     for (u32 c = 0; c < clipboard->n_entries; c++) {
                         char namestr[UTF_BUFFER_BYTESIZE(36)];
@@ -2887,6 +2916,14 @@ u32 GodMode(int entrypoint) {
                             } else ShowPrompt(false, STR_FAILED_MOVING_PATH, namestr);
                         }
                     }
+                    if (flags & SYNC_ALL) {
+                        SyncInfo info;
+                        char bytestr[32];
+                        GetSyncInfo(&info);
+                        FormatBytes(bytestr, info.bytes);
+                        ShowPrompt(false, STR_SYNC_N_COPIED_N_SKIPPED_N_DELETED,
+                            info.copied, bytestr, info.skipped, info.deleted);
+                    }
                     clipboard->n_entries = 0;
                     GetDirContents(current_dir, current_path);
                 }
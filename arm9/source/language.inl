@@ -813,3 +813,11 @@ STRING(SYSINFO_SYSTEM_ID0, "System ID0: %s\r\n")
 STRING(SYSINFO_SYSTEM_ID1, "System ID1: %s\r\n")
 STRING(SORTING_TICKETS_PLEASE_WAIT, "Sorting tickets, please wait ...")
 STRING(LUA_NOT_INCLUDED, "This build of GodMode9 was\ncompiled without Lua support.")
+STRING(NAND_RESTORE_N_WRITTEN, "%s written (unchanged sectors skipped)")
+STRING(SYNC_PATHS, "Sync path(s)")
+STRING(SYNC_DELETE_ORPHANS, "Also delete items at the destination\nthat are missing from the origin?")
+STRING(SYNC_N_COPIED_N_SKIPPED_N_DELETED, "Sync done:\n%lu copied (%s)\n%lu unchanged\n%lu deleted")
+STRING(COPY_PATHS_RESUMABLE, "Copy path(s) (resumable)")
+STRING(CART_DUMP_TRIMMED, "Cart: %s\nGame data ends at %s (of %s).\n \nDump trimmed to the game data?")
+STRING(PATH_DUMPED_TO_OUT_HASHES, "%s\nDumped to %s\n \nSHA-256: %016llX%016llX\n%016llX%016llX\nCRC32: %08lX")
+STRING(N_TYPES_BUILT_IN_N_SECONDS_SLOWEST, "%lu %s built in %lu.%03lus\n%lums per title on average\n \nSlowest: %s (%lums)")
@@ -1,5 +1,6 @@
 #ifndef NO_LUA
 #include "gm9fs.h"
+#include "gm9progress.h"
 #include "fs.h"
 #include "ui.h"
 #include "utils.h"
@@ -7,10 +8,24 @@
 #include "nand.h"
 #include "language.h"
 #include "hid.h"
+#include "timer.h"
 
 static u8 no_data_hash_256[32] = { SHA256_EMPTY_HASH };
 static u8 no_data_hash_1[32] = { SHA1_EMPTY_HASH };
 
+#define GM9LUA_DIRITER_MT   "GM9FS_DIRITER"
+#define GM9LUA_MANIFEST_MT  "GM9FS_MANIFEST"
+#define DIRITER_MAX_DEPTH   16 // every level keeps a dir open (see FF_FS_LOCK)
+
+// state for fs.dir / fs.walk, only the dirs on the current branch stay open
+typedef struct {
+    DIR dirs[DIRITER_MAX_DEPTH];
+    u16 pathlen[DIRITER_MAX_DEPTH];
+    u32 depth;
+    bool recursive;
+    char path[256];
+} DirIter;
+
 static bool PathIsDirectory(const char* path) {
     DIR fdir;
     if (fvx_opendir(&fdir, path) == FR_OK) {
@@ -21,8 +36,7 @@ static bool PathIsDirectory(const char* path) {
     }
 }
 
-static void CreateStatTable(lua_State* L, FILINFO* fno) {
-    lua_createtable(L, 0, 4); // create nested table
+static void SetStatFields(lua_State* L, FILINFO* fno) {
     lua_pushstring(L, fno->fname);
     lua_setfield(L, -2, "name");
     lua_pushstring(L, (fno->fattrib & AM_DIR) ? "dir" : "file");
@@ -31,6 +45,11 @@ static void CreateStatTable(lua_State* L, FILINFO* fno) {
     lua_setfield(L, -2, "size");
     lua_pushboolean(L, fno->fattrib & AM_RDO);
     lua_setfield(L, -2, "read_only");
+}
+
+static void CreateStatTable(lua_State* L, FILINFO* fno) {
+    lua_createtable(L, 0, 4); // create nested table
+    SetStatFields(L, fno);
     // ... and leave this table on the stack for the caller to deal with
 }
 
@@ -110,8 +129,9 @@ static int fs_copy(lua_State* L) {
 
     u32 flags = BUILD_PATH;
     if (extra) {
-        flags = GetFlagsFromTable(L, 3, flags, CALC_SHA | USE_SHA1 | NO_CANCEL | SILENT | OVERWRITE_ALL | SKIP_ALL | APPEND_ALL | RECURSIVE);
+        flags = GetFlagsFromTable(L, 3, flags, CALC_SHA | USE_SHA1 | NO_CANCEL | SILENT | OVERWRITE_ALL | SKIP_ALL | APPEND_ALL | RECURSIVE | SYNC_ALL | SYNC_HASH | SYNC_PURGE | ALLOW_RESUME);
     }
+    if (!(flags & SYNC_ALL)) flags &= ~(SYNC_HASH | SYNC_PURGE);
 
     if (!(flags & RECURSIVE)) {
         if (PathIsDirectory(path_src)) {
@@ -119,15 +139,36 @@ static int fs_copy(lua_State* L) {
         }
     }
 
-    if (!(flags & OVERWRITE_ALL) && (fvx_stat(path_dst, &fno) == FR_OK)) {
+    if (!(flags & (OVERWRITE_ALL | SYNC_ALL)) && !((flags & ALLOW_RESUME) && CopyResumable(path_dst)) &&
+        (fvx_stat(path_dst, &fno) == FR_OK)) {
         return luaL_error(L, "destination already exists on %s -> %s and {overwrite_all=true} was not used", path_src, path_dst);
     }
 
-    if (!(PathMoveCopy(path_dst, path_src, &flags, false))) {
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 3 : 0, &prog);
+    ResetSyncInfo();
+    bool res = PathMoveCopy(path_dst, path_src, &flags, false);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, false);
+    } else if (!res) {
         return luaL_error(L, "PathMoveCopy failed on %s -> %s", path_src, path_dst);
     }
 
-    return 0;
+    lua_pushboolean(L, true);
+    if (!(flags & SYNC_ALL)) return 1;
+
+    SyncInfo info;
+    GetSyncInfo(&info);
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, info.copied);
+    lua_setfield(L, -2, "copied");
+    lua_pushinteger(L, info.skipped);
+    lua_setfield(L, -2, "skipped");
+    lua_pushinteger(L, info.deleted);
+    lua_setfield(L, -2, "deleted");
+    lua_pushinteger(L, info.bytes);
+    lua_setfield(L, -2, "bytes");
+    return 2;
 }
 
 static int fs_mkdir(lua_State* L) {
@@ -164,6 +205,7 @@ static int fs_list_dir(lua_State* L) {
     for (int i = 1; true; i++) {
         res = fvx_readdir(&dir, &fno);
         if (res != FR_OK) {
+            fvx_closedir(&dir);
             lua_pop(L, 1); // remove final table from stack
             return luaL_error(L, "could not readdir %s (%d)", path, res);
         }
@@ -172,9 +214,137 @@ static int fs_list_dir(lua_State* L) {
         lua_seti(L, -2, i); // add nested table to final table
     }
 
+    fvx_closedir(&dir);
     return 1;
 }
 
+static void CloseDirIter(DirIter* iter) {
+    while (iter->depth)
+        fvx_closedir(&(iter->dirs[--(iter->depth)]));
+}
+
+static int DirIterClose(lua_State* L) {
+    CloseDirIter((DirIter*) luaL_checkudata(L, 1, GM9LUA_DIRITER_MT));
+    return 0;
+}
+
+// upvalues: 1 = DirIter userdata, 2 = pattern (or nil), 3 = reused entry table (or nil)
+static int DirIterNext(lua_State* L) {
+    DirIter* iter = (DirIter*) lua_touserdata(L, lua_upvalueindex(1));
+    const char* pattern = lua_tostring(L, lua_upvalueindex(2));
+    FILINFO fno;
+
+    while (iter->depth) {
+        DIR* pdir = &(iter->dirs[iter->depth - 1]);
+        u32 plen = iter->pathlen[iter->depth - 1];
+        FRESULT res = fvx_readdir(pdir, &fno);
+        if (res != FR_OK) {
+            iter->path[plen] = '\0';
+            CloseDirIter(iter);
+            return luaL_error(L, "could not readdir %s (%d)", iter->path, res);
+        }
+        if (fno.fname[0] == 0) { // end of this dir, continue with the parent
+            fvx_closedir(pdir);
+            iter->depth--;
+            continue;
+        }
+        if ((strncmp(fno.fname, ".", 2) == 0) || (strncmp(fno.fname, "..", 3) == 0))
+            continue; // filter out virtual entries
+
+        // build full path of this entry on top of the current dir
+        if (plen + 1 + strnlen(fno.fname, 256) > 255) {
+            CloseDirIter(iter);
+            return luaL_error(L, "path too long in %s", iter->path);
+        }
+        iter->path[plen] = '/';
+        strcpy(iter->path + plen + 1, fno.fname);
+
+        // dirs are descended into even if they don't match the pattern
+        if (iter->recursive && (fno.fattrib & AM_DIR)) {
+            if (iter->depth >= DIRITER_MAX_DEPTH) {
+                CloseDirIter(iter);
+                return luaL_error(L, "maximum depth exceeded at %s", iter->path);
+            }
+            res = fvx_opendir(&(iter->dirs[iter->depth]), iter->path);
+            if (res != FR_OK) {
+                CloseDirIter(iter);
+                return luaL_error(L, "could not opendir %s (%d)", iter->path, res);
+            }
+            iter->pathlen[iter->depth++] = strnlen(iter->path, 255);
+        }
+
+        if (pattern && (fvx_match_name(fno.fname, pattern) != FR_OK))
+            continue;
+
+        if (lua_istable(L, lua_upvalueindex(3))) lua_pushvalue(L, lua_upvalueindex(3));
+        else lua_createtable(L, 0, 5);
+        SetStatFields(L, &fno);
+        lua_pushstring(L, iter->path);
+        lua_setfield(L, -2, "path");
+        return 1;
+    }
+
+    return 0; // nil ends the for loop
+}
+
+// shared by fs.dir and fs.walk, returns the values for a generic for loop
+static int CreateDirIter(lua_State* L, const char* path, int opts, bool recursive) {
+    bool reuse = false;
+    if (opts) {
+        lua_getfield(L, opts, "recursive");
+        if (!lua_isnil(L, -1)) recursive = lua_toboolean(L, -1);
+        lua_getfield(L, opts, "reuse");
+        reuse = lua_toboolean(L, -1);
+        lua_pop(L, 2);
+    }
+
+    DirIter* iter = (DirIter*) lua_newuserdatauv(L, sizeof(DirIter), 0);
+    iter->depth = 0;
+    iter->recursive = recursive;
+    luaL_setmetatable(L, GM9LUA_DIRITER_MT);
+
+    strncpy(iter->path, path, 256);
+    iter->path[255] = '\0';
+    FRESULT res = fvx_opendir(&(iter->dirs[0]), iter->path);
+    if (res != FR_OK) {
+        return luaL_error(L, "could not opendir %s (%d)", path, res);
+    }
+    iter->depth = 1;
+    // strip trailing slash, the separator is added back per entry
+    iter->pathlen[0] = strnlen(iter->path, 255);
+    if (iter->pathlen[0] && (iter->path[iter->pathlen[0] - 1] == '/'))
+        iter->path[--(iter->pathlen[0])] = '\0';
+
+    lua_pushvalue(L, -1); // userdata
+    if (opts) lua_getfield(L, opts, "pattern");
+    else lua_pushnil(L);
+    if (reuse) lua_createtable(L, 0, 5);
+    else lua_pushnil(L);
+    lua_pushcclosure(L, DirIterNext, 3);
+
+    // for loop values: iterator, state, control, closing value
+    lua_insert(L, -2);
+    lua_pushnil(L);
+    lua_insert(L, -2);
+    lua_pushnil(L);
+    lua_insert(L, -2);
+    return 4;
+}
+
+static int fs_dir(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.dir");
+    const char* path = luaL_checkstring(L, 1);
+    if (extra) luaL_checktype(L, 2, LUA_TTABLE);
+    return CreateDirIter(L, path, extra ? 2 : 0, false);
+}
+
+static int fs_walk(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.walk");
+    const char* path = luaL_checkstring(L, 1);
+    if (extra) luaL_checktype(L, 2, LUA_TTABLE);
+    return CreateDirIter(L, path, extra ? 2 : 0, true);
+}
+
 static int fs_stat(lua_State* L) {
     CheckLuaArgCount(L, 1, "fs.stat");
     const char* path = luaL_checkstring(L, 1);
@@ -241,6 +411,189 @@ static int fs_dir_info(lua_State* L) {
     return 1;
 }
 
+// one file seen by fs.tree_manifest, path is an offset into LuaManifest.paths
+typedef struct {
+    u32 path;
+    u64 size;
+    u8 hash[0x20];
+    bool has_hash;
+    u32 cmac; // TREE_CMAC_*
+} LuaManifestEntry;
+
+// last visitor of fs.tree_manifest, entries are collected in C and the table is built after the walk
+// (a Lua allocation error inside TreeWalk() would longjmp past its open directories)
+// lives in a userdata, so __gc frees the lists if building the table fails
+typedef struct {
+    TreeShaInfo* sha;
+    TreeCmacInfo* cmac;
+    LuaManifestEntry* entries;
+    u32 n_entries;
+    u32 max_entries;
+    char* paths;
+    u32 paths_size;
+    u32 paths_max;
+    bool oom;
+} LuaManifest;
+
+static void FreeLuaManifest(LuaManifest* manifest) {
+    if (manifest->entries) free(manifest->entries);
+    if (manifest->paths) free(manifest->paths);
+    manifest->entries = NULL;
+    manifest->paths = NULL;
+    manifest->n_entries = manifest->max_entries = 0;
+    manifest->paths_size = manifest->paths_max = 0;
+}
+
+static int LuaManifestGc(lua_State* L) {
+    FreeLuaManifest((LuaManifest*) luaL_checkudata(L, 1, GM9LUA_MANIFEST_MT));
+    return 0;
+}
+
+static u32 LuaManifestFile(const char* path, u64 size, void* ctx) {
+    (void) path;
+    (void) size;
+    return ((LuaManifest*) ctx)->oom ? TV_ABORT : TV_NEXT;
+}
+
+static void LuaManifestDone(const char* path, u64 size, bool read_ok, void* ctx) {
+    (void) read_ok;
+    LuaManifest* manifest = (LuaManifest*) ctx;
+    u32 plen = strnlen(path, 256) + 1;
+
+    // grow both lists by doubling, the walk is aborted on the next file if that fails
+    if (manifest->n_entries >= manifest->max_entries) {
+        u32 max_entries = manifest->max_entries ? manifest->max_entries * 2 : 64;
+        LuaManifestEntry* entries = realloc(manifest->entries, max_entries * sizeof(LuaManifestEntry));
+        if (!entries) {
+            manifest->oom = true;
+            return;
+        }
+        manifest->entries = entries;
+        manifest->max_entries = max_entries;
+    }
+    if (manifest->paths_size + plen > manifest->paths_max) {
+        u32 paths_max = max(manifest->paths_max ? manifest->paths_max * 2 : 4096, manifest->paths_size + plen);
+        char* paths = realloc(manifest->paths, paths_max);
+        if (!paths) {
+            manifest->oom = true;
+            return;
+        }
+        manifest->paths = paths;
+        manifest->paths_max = paths_max;
+    }
+
+    LuaManifestEntry* entry = &(manifest->entries[manifest->n_entries++]);
+    memcpy(manifest->paths + manifest->paths_size, path, plen - 1);
+    manifest->paths[manifest->paths_size + plen - 1] = '\0';
+    entry->path = manifest->paths_size;
+    manifest->paths_size += plen;
+    entry->size = size;
+    entry->has_hash = manifest->sha && (manifest->sha->valid || !size);
+    if (entry->has_hash) {
+        bool sha1 = manifest->sha->sha1;
+        if (size) memcpy(entry->hash, manifest->sha->hash, sha1 ? 20 : 32);
+        else memcpy(entry->hash, sha1 ? no_data_hash_1 : no_data_hash_256, sha1 ? 20 : 32);
+    }
+    entry->cmac = manifest->cmac ? manifest->cmac->last : TREE_CMAC_NONE;
+}
+
+static int fs_tree_manifest(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.tree_manifest");
+    const char* path = luaL_checkstring(L, 1);
+
+    const char* pattern = NULL;
+    const char* cmac_mode = NULL;
+    bool hash = true;
+    u32 flags = 0;
+    if (extra) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        flags = GetFlagsFromTable(L, 2, flags, USE_SHA1 | SILENT);
+        lua_getfield(L, 2, "pattern");
+        pattern = lua_tostring(L, -1);
+        lua_getfield(L, 2, "cmac");
+        cmac_mode = lua_tostring(L, -1);
+        lua_getfield(L, 2, "hash");
+        if (!lua_isnil(L, -1)) hash = lua_toboolean(L, -1);
+        lua_pop(L, 1); // pattern & cmac strings stay on the stack until we return
+    }
+
+    bool fix_cmac = false;
+    if (cmac_mode) {
+        if (strncmp(cmac_mode, "fix", 4) == 0) fix_cmac = true;
+        else if (strncmp(cmac_mode, "check", 6) != 0)
+            return luaL_error(L, "cmac must be \"check\" or \"fix\", not \"%s\"", cmac_mode);
+    }
+
+    // allocated before the walk, nothing touches the Lua state while directories are open
+    LuaManifest* manifest = (LuaManifest*) lua_newuserdatauv(L, sizeof(LuaManifest), 0);
+    memset(manifest, 0, sizeof(LuaManifest));
+    luaL_setmetatable(L, GM9LUA_MANIFEST_MT);
+
+    // visitor order matters: filter first, CMAC fixes before hashing
+    TreeVisitor visitors[5];
+    TreeSizeInfo size_info;
+    TreeShaInfo sha_info = { .sha1 = (flags & USE_SHA1) };
+    TreeCmacInfo cmac_info = { .fix = fix_cmac };
+    u32 n_visitors = 0;
+
+    if (pattern) TreeVisitorPattern(&(visitors[n_visitors++]), pattern);
+    TreeVisitorSize(&(visitors[n_visitors++]), &size_info);
+    if (cmac_mode) {
+        TreeVisitorCmac(&(visitors[n_visitors++]), &cmac_info);
+        manifest->cmac = &cmac_info;
+    }
+    if (hash) {
+        TreeVisitorSha(&(visitors[n_visitors++]), &sha_info);
+        manifest->sha = &sha_info;
+    }
+    memset(&(visitors[n_visitors]), 0, sizeof(TreeVisitor));
+    visitors[n_visitors].file = LuaManifestFile;
+    visitors[n_visitors].done = LuaManifestDone;
+    visitors[n_visitors++].ctx = manifest;
+
+    bool ret = TreeWalk(path, visitors, n_visitors, !(flags & SILENT));
+    if (!ret || manifest->oom) {
+        FreeLuaManifest(manifest);
+        if (manifest->oom) return luaL_error(L, "out of memory building the manifest of %s", path);
+        return luaL_error(L, "TreeWalk failed or was cancelled on %s", path);
+    }
+
+    lua_createtable(L, 0, 5);
+    lua_createtable(L, manifest->n_entries, 0);
+    for (u32 i = 0; i < manifest->n_entries; i++) {
+        LuaManifestEntry* entry = &(manifest->entries[i]);
+        lua_createtable(L, 0, 4);
+        lua_pushstring(L, manifest->paths + entry->path);
+        lua_setfield(L, -2, "path");
+        lua_pushinteger(L, entry->size);
+        lua_setfield(L, -2, "size");
+        if (entry->has_hash) {
+            lua_pushlstring(L, (char*) entry->hash, sha_info.sha1 ? 20 : 32);
+            lua_setfield(L, -2, "hash");
+        }
+        if (entry->cmac != TREE_CMAC_NONE) {
+            lua_pushboolean(L, entry->cmac == TREE_CMAC_OK);
+            lua_setfield(L, -2, "cmac_ok");
+        }
+        lua_seti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "entries");
+    FreeLuaManifest(manifest);
+
+    lua_pushinteger(L, size_info.size);
+    lua_setfield(L, -2, "size");
+    lua_pushinteger(L, size_info.dirs);
+    lua_setfield(L, -2, "dirs");
+    lua_pushinteger(L, size_info.files);
+    lua_setfield(L, -2, "files");
+    if (cmac_mode) {
+        lua_pushinteger(L, cmac_info.n_bad);
+        lua_setfield(L, -2, "cmac_bad");
+    }
+
+    return 1;
+}
+
 static int fs_exists(lua_State* L) {
     CheckLuaArgCount(L, 1, "fs.exists");
     const char* path = luaL_checkstring(L, 1);
@@ -413,14 +766,99 @@ static int fs_hash_file(lua_State* L) {
     if (size == 0) {
         // shortcut by just returning the hash of empty data
         memcpy(hash_fil, (flags & USE_SHA1) ? no_data_hash_1 : no_data_hash_256, hashlen);
-    } else if (!(FileGetSha(path, hash_fil, offset, size, (flags & USE_SHA1)))) {
-        return luaL_error(L, "FileGetSha failed on %s", path);
+    } else {
+        LuaProgress prog;
+        StartLuaProgress(L, extra ? 4 : 0, &prog);
+        bool res = FileGetSha(path, hash_fil, offset, size, (flags & USE_SHA1), NULL, 0);
+        if (EndLuaProgress(L, &prog)) {
+            return PushLuaProgressCancel(L, &prog, true);
+        } else if (!res) {
+            return luaL_error(L, "FileGetSha failed on %s", path);
+        }
     }
 
     lua_pushlstring(L, (char*)hash_fil, hashlen);
     return 1;
 }
 
+#define LUA_FIND_MAX_DEFAULT    1024 // default match limit for {all=true}
+#define LUA_FIND_MAX_LIMIT      (STD_BUFFER_SIZE / sizeof(u32)) // upper bound for {max=...}
+
+static int fs_find_data(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 2, "fs.find_data");
+    const char* path = luaL_checkstring(L, 1);
+    size_t data_length = 0;
+    const u8* data = (const u8*) luaL_checklstring(L, 2, &data_length);
+    const u8* mask = NULL;
+    lua_Integer offset = 0;
+    lua_Integer max_found = 1;
+
+    if (data_length == 0) {
+        return luaL_error(L, "search data must not be empty");
+    }
+
+    if (extra) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        lua_getfield(L, 3, "offset");
+        if (!lua_isnil(L, -1)) offset = luaL_checkinteger(L, -1);
+        lua_getfield(L, 3, "mask");
+        if (!lua_isnil(L, -1)) {
+            size_t mask_length = 0;
+            mask = (const u8*) luaL_checklstring(L, -1, &mask_length);
+            if (mask_length != data_length) {
+                return luaL_error(L, "mask length (%d) does not match data length (%d)", (int) mask_length, (int) data_length);
+            }
+        }
+        lua_getfield(L, 3, "all");
+        if (lua_toboolean(L, -1)) {
+            lua_getfield(L, 3, "max");
+            max_found = lua_isnil(L, -1) ? LUA_FIND_MAX_DEFAULT : luaL_checkinteger(L, -1);
+            lua_pop(L, 1);
+            if (max_found < 1) {
+                return luaL_error(L, "max has to be at least 1");
+            } else if (max_found > (lua_Integer) LUA_FIND_MAX_LIMIT) {
+                return luaL_error(L, "max can not be larger than %d", (int) LUA_FIND_MAX_LIMIT);
+            }
+        } else max_found = 0;
+        lua_pop(L, 3); // strings stay referenced by the options table
+    } else max_found = 0;
+
+    if (offset < 0) {
+        return luaL_error(L, "offset must not be negative");
+    } else if (offset > 0) {
+        FILINFO fno;
+        if ((fvx_stat(path, &fno) == FR_OK) && ((u64) offset > fno.fsize)) {
+            return luaL_error(L, "offset %I is past the end of %s", offset, path);
+        }
+    }
+
+    // owned by the GC, so errors raised from here on can't leak it
+    u32* found = NULL;
+    if (max_found) found = (u32*) lua_newuserdatauv(L, (size_t) max_found * sizeof(u32), 0);
+
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 3 : 0, &prog);
+    u32 n_found = 0;
+    u32 found_offset = (u32) -1;
+    if (max_found) n_found = FileFindAllData(path, data, mask, data_length, found, max_found);
+    else found_offset = FileFindDataMasked(path, data, mask, data_length, offset);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, true);
+    }
+
+    if (max_found) { // all matches, as a list of offsets
+        lua_createtable(L, n_found, 0);
+        for (u32 i = 0; i < n_found; i++) {
+            lua_pushinteger(L, found[i]);
+            lua_seti(L, -2, i + 1);
+        }
+    } else if (found_offset != (u32) -1) {
+        lua_pushinteger(L, found_offset);
+    } else lua_pushnil(L);
+
+    return 1;
+}
+
 static int fs_hash_data(lua_State* L) {
     bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.hash_data");
     size_t data_length = 0;
@@ -464,18 +902,220 @@ static int fs_allow(lua_State* L) {
 };
 
 static int fs_verify(lua_State* L) {
-    CheckLuaArgCount(L, 1, "fs.verify");
+    bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.verify");
     const char* path = luaL_checkstring(L, 1);
     bool res;
 
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 2 : 0, &prog);
     u64 filetype = IdentifyFileType(path);
     if (filetype & IMG_NAND) res = (ValidateNandDump(path) == 0);
     else res = (VerifyGameFile(path) == 0);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, false);
+    }
 
     lua_pushboolean(L, res);
     return 1;
 }
 
+// one fs.build_cia result, kept in C until the batch is ended
+typedef struct {
+    const char* path; // stays referenced by the private copy of the paths
+    u64 msec;
+    bool built;
+} LuaCiaResult;
+
+static int fs_build_cia(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.build_cia");
+    bool single = !lua_istable(L, 1);
+    if (single) luaL_checkstring(L, 1);
+    lua_Integer n_paths = single ? 1 : luaL_len(L, 1);
+    bool force_legit = false;
+
+    // everything Lua is done before or after the batch, an error in between would leave it running
+    // the paths go to a private table on the stack, the progress callback may change the argument
+    LuaCiaResult* results = (LuaCiaResult*) lua_newuserdatauv(L, max(n_paths, 1) * sizeof(LuaCiaResult), 0);
+    lua_createtable(L, single ? 0 : n_paths, 0);
+    if (single) results[0].path = lua_tostring(L, 1);
+    for (lua_Integer i = 1; !single && (i <= n_paths); i++) {
+        lua_geti(L, 1, i);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            return luaL_argerror(L, 1, lua_pushfstring(L, "paths[%I] is not a string", i));
+        }
+        results[i - 1].path = lua_tostring(L, -1);
+        lua_seti(L, -2, i);
+    }
+
+    if (extra) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_getfield(L, 2, "legit");
+        force_legit = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+    }
+
+    bool all_built = true;
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 2 : 0, &prog);
+    bool batch = !single && (BeginCiaBatch() == 0);
+    for (lua_Integer i = 0; (i < n_paths) && !prog.cancelled; i++) {
+        u64 timer = timer_start();
+        results[i].built = (BuildCiaFromGameFile(results[i].path, force_legit) == 0);
+        results[i].msec = timer_msec(timer);
+        all_built = all_built && results[i].built;
+    }
+    if (batch) EndCiaBatch();
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, false);
+    }
+
+    lua_pushboolean(L, all_built);
+    lua_createtable(L, n_paths, 0);
+    for (lua_Integer i = 0; i < n_paths; i++) {
+        lua_createtable(L, 0, 3);
+        lua_pushstring(L, results[i].path);
+        lua_setfield(L, -2, "path");
+        lua_pushboolean(L, results[i].built);
+        lua_setfield(L, -2, "success");
+        lua_pushinteger(L, results[i].msec);
+        lua_setfield(L, -2, "msec");
+        lua_seti(L, -2, i + 1);
+    }
+    return 2;
+}
+
+// source NAND image for fs.nand_backup_*, "S:/nand.bin" unless {nand=...} is given
+static const char* GetLuaNandBackupSource(lua_State* L, int opts) {
+    const char* path_nand = "S:/nand.bin";
+    if (opts) {
+        lua_getfield(L, opts, "nand");
+        if (!lua_isnil(L, -1)) path_nand = luaL_checkstring(L, -1);
+        lua_pop(L, 1); // string stays referenced by the options table
+    }
+    return path_nand;
+}
+
+static int fs_nand_backup_base(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 1, "fs.nand_backup_base");
+    const char* path_base = luaL_checkstring(L, 1);
+    if (extra) luaL_checktype(L, 2, LUA_TTABLE);
+    const char* path_nand = GetLuaNandBackupSource(L, extra ? 2 : 0);
+
+    if (!CheckWritePermissions(path_base)) {
+        return luaL_error(L, "writing not allowed: %s", path_base);
+    }
+
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 2 : 0, &prog);
+    u32 res = BuildNandBackupBase(path_nand, path_base);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, false);
+    } else if (res != 0) {
+        return luaL_error(L, "BuildNandBackupBase failed on %s -> %s", path_nand, path_base);
+    }
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+static int fs_nand_backup_delta(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 2, "fs.nand_backup_delta");
+    const char* path_base = luaL_checkstring(L, 1);
+    const char* path_delta = luaL_checkstring(L, 2);
+    if (extra) luaL_checktype(L, 3, LUA_TTABLE);
+    const char* path_nand = GetLuaNandBackupSource(L, extra ? 3 : 0);
+    u32 changed = 0;
+    u32 total = 0;
+
+    if (!CheckWritePermissions(path_delta)) {
+        return luaL_error(L, "writing not allowed: %s", path_delta);
+    }
+
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 3 : 0, &prog);
+    u32 res = BuildNandBackupDelta(path_nand, path_base, path_delta, &changed, &total);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, true);
+    } else if (res != 0) {
+        return luaL_error(L, "BuildNandBackupDelta failed on %s -> %s (base %s)", path_nand, path_delta, path_base);
+    }
+
+    lua_pushinteger(L, changed);
+    lua_pushinteger(L, total);
+    return 2;
+}
+
+static int fs_nand_backup_restore(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 3, "fs.nand_backup_restore");
+    const char* path_base = luaL_checkstring(L, 1);
+    const char* path_delta = luaL_checkstring(L, 2);
+    const char* path_out = luaL_checkstring(L, 3);
+    if (extra) luaL_checktype(L, 4, LUA_TTABLE);
+
+    if (!CheckWritePermissions(path_out)) {
+        return luaL_error(L, "writing not allowed: %s", path_out);
+    }
+
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 4 : 0, &prog);
+    u32 res = RestoreNandBackupDelta(path_base, path_delta, path_out);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, false);
+    } else if (res != 0) {
+        return luaL_error(L, "RestoreNandBackupDelta failed on %s + %s -> %s", path_base, path_delta, path_out);
+    }
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+static int fs_sparse_dump(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 2, "fs.sparse_dump");
+    const char* path_src = luaL_checkstring(L, 1);
+    const char* path_dst = luaL_checkstring(L, 2);
+    if (extra) luaL_checktype(L, 3, LUA_TTABLE);
+    u64 stored = 0;
+
+    if (!CheckWritePermissions(path_dst)) {
+        return luaL_error(L, "writing not allowed: %s", path_dst);
+    }
+
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 3 : 0, &prog);
+    u32 res = DumpSparseImage(path_src, path_dst, &stored);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, true);
+    } else if (res != 0) {
+        return luaL_error(L, "DumpSparseImage failed on %s -> %s", path_src, path_dst);
+    }
+
+    lua_pushinteger(L, stored);
+    return 1;
+}
+
+static int fs_sparse_expand(lua_State* L) {
+    bool extra = CheckLuaArgCountPlusExtra(L, 2, "fs.sparse_expand");
+    const char* path_src = luaL_checkstring(L, 1);
+    const char* path_dst = luaL_checkstring(L, 2);
+    if (extra) luaL_checktype(L, 3, LUA_TTABLE);
+
+    if (!CheckWritePermissions(path_dst)) {
+        return luaL_error(L, "writing not allowed: %s", path_dst);
+    }
+
+    LuaProgress prog;
+    StartLuaProgress(L, extra ? 3 : 0, &prog);
+    u32 res = ExpandSparseImage(path_src, path_dst);
+    if (EndLuaProgress(L, &prog)) {
+        return PushLuaProgressCancel(L, &prog, false);
+    } else if (res != 0) {
+        return luaL_error(L, "ExpandSparseImage failed on %s -> %s", path_src, path_dst);
+    }
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
 static int fs_sd_is_mounted(lua_State* L) {
     CheckLuaArgCount(L, 0, "fs.sd_is_mounted");
 
@@ -525,9 +1165,12 @@ static const luaL_Reg fs_lib[] = {
     {"copy", fs_copy},
     {"mkdir", fs_mkdir},
     {"list_dir", fs_list_dir},
+    {"dir", fs_dir},
+    {"walk", fs_walk},
     {"stat", fs_stat},
     {"stat_fs", fs_stat_fs},
     {"dir_info", fs_dir_info},
+    {"tree_manifest", fs_tree_manifest},
     {"exists", fs_exists},
     {"is_dir", fs_is_dir},
     {"is_file", fs_is_file},
@@ -539,7 +1182,14 @@ static const luaL_Reg fs_lib[] = {
     {"get_img_mount", fs_get_img_mount},
     {"hash_file", fs_hash_file},
     {"hash_data", fs_hash_data},
+    {"find_data", fs_find_data},
     {"verify", fs_verify},
+    {"build_cia", fs_build_cia},
+    {"nand_backup_base", fs_nand_backup_base},
+    {"nand_backup_delta", fs_nand_backup_delta},
+    {"nand_backup_restore", fs_nand_backup_restore},
+    {"sparse_dump", fs_sparse_dump},
+    {"sparse_expand", fs_sparse_expand},
     {"allow", fs_allow},
     {"sd_is_mounted", fs_sd_is_mounted},
     {"sd_switch", fs_sd_switch},
@@ -547,7 +1197,24 @@ static const luaL_Reg fs_lib[] = {
     {NULL, NULL}
 };
 
+static const luaL_Reg fs_diriter_meta[] = {
+    {"__close", DirIterClose},
+    {"__gc", DirIterClose},
+    {NULL, NULL}
+};
+
+static const luaL_Reg fs_manifest_meta[] = {
+    {"__gc", LuaManifestGc},
+    {NULL, NULL}
+};
+
 int gm9lua_open_fs(lua_State* L) {
+    luaL_newmetatable(L, GM9LUA_DIRITER_MT);
+    luaL_setfuncs(L, fs_diriter_meta, 0);
+    lua_pop(L, 1);
+    luaL_newmetatable(L, GM9LUA_MANIFEST_MT);
+    luaL_setfuncs(L, fs_manifest_meta, 0);
+    lua_pop(L, 1);
     luaL_newlib(L, fs_lib);
     return 1;
 }
@@ -0,0 +1,93 @@
+#ifndef NO_LUA
+#include "gm9progress.h"
+#include "ui.h"
+
+// runs protected: stack is the LuaProgress and the callback, nothing in here may escape to the hook
+static int LuaProgressCall(lua_State* L) {
+    LuaProgress* prog = (LuaProgress*) lua_touserdata(L, 1);
+    lua_pushinteger(L, prog->current);
+    lua_pushinteger(L, prog->total);
+    lua_pushstring(L, prog->opstr);
+    if (lua_pcall(L, 3, 1, 0) != LUA_OK) {
+        // can't raise the error from in here, it is rethrown in EndLuaProgress()
+        prog->err_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        prog->cancelled = true;
+        return 0;
+    }
+    // only an explicit false cancels, so callbacks don't need to return anything
+    if (lua_isboolean(L, -1) && !lua_toboolean(L, -1)) prog->cancelled = true;
+    return 0;
+}
+
+static bool LuaProgressHook(u64 current, u64 total, const char* opstr, void* ctx) {
+    LuaProgress* prog = (LuaProgress*) ctx;
+    lua_State* L = prog->L;
+    prog->current = current;
+    prog->total = total;
+    if (prog->cancelled) return false;
+
+    // an error escaping here would longjmp over the C code running the operation (open files, buffers),
+    // so everything that can raise one (allocations included) happens inside the trampoline
+    if (!lua_checkstack(L, 3)) {
+        prog->cancelled = true;
+        return false;
+    }
+    prog->opstr = opstr;
+    lua_pushcfunction(L, LuaProgressCall);
+    lua_pushlightuserdata(L, prog);
+    lua_pushvalue(L, prog->func);
+    if (lua_pcall(L, 2, 0, 0) != LUA_OK) {
+        // out of memory before or while storing the callback error
+        lua_pop(L, 1);
+        prog->cancelled = true;
+    }
+    prog->opstr = NULL;
+    return !prog->cancelled;
+}
+
+// installs the progress hook if the options table at opts has a progress function
+void StartLuaProgress(lua_State* L, int opts, LuaProgress* prog) {
+    memset(prog, 0, sizeof(LuaProgress));
+    prog->L = L;
+    prog->err_ref = LUA_NOREF;
+    if (!opts) return;
+
+    lua_getfield(L, opts, "progress_interval");
+    u64 interval = luaL_optinteger(L, -1, LUA_PROGRESS_INTERVAL);
+    lua_pop(L, 1);
+    lua_getfield(L, opts, "progress");
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return;
+    }
+    luaL_checktype(L, -1, LUA_TFUNCTION);
+    prog->func = lua_gettop(L); // stays on the stack until the operation is done
+    SetProgressHook(LuaProgressHook, prog, interval);
+}
+
+// removes the progress hook and rethrows errors from the callback, true if cancelled
+bool EndLuaProgress(lua_State* L, LuaProgress* prog) {
+    if (!prog->func) return false;
+    SetProgressHook(NULL, NULL, 0);
+    if (prog->err_ref != LUA_NOREF) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, prog->err_ref);
+        luaL_unref(L, LUA_REGISTRYINDEX, prog->err_ref);
+        lua_error(L);
+    }
+    return prog->cancelled;
+}
+
+// return values for a cancelled operation: false (or nil) plus the last progress state
+int PushLuaProgressCancel(lua_State* L, LuaProgress* prog, bool nil_first) {
+    if (nil_first) lua_pushnil(L);
+    else lua_pushboolean(L, false);
+    lua_createtable(L, 0, 3);
+    lua_pushboolean(L, true);
+    lua_setfield(L, -2, "cancelled");
+    lua_pushinteger(L, prog->current);
+    lua_setfield(L, -2, "current");
+    lua_pushinteger(L, prog->total);
+    lua_setfield(L, -2, "total");
+    return 2;
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+#include "gm9lua.h"
+
+#define LUA_PROGRESS_INTERVAL   (1024 * 1024) // default bytes between progress callbacks
+
+// state for the optional progress callback of long running operations
+typedef struct {
+    lua_State* L;
+    int func;           // stack index of the callback
+    int err_ref;        // registry reference to an error raised by the callback
+    bool cancelled;
+    u64 current;
+    u64 total;
+    const char* opstr;  // only valid during the callback
+} LuaProgress;
+
+void StartLuaProgress(lua_State* L, int opts, LuaProgress* prog);
+bool EndLuaProgress(lua_State* L, LuaProgress* prog);
+int PushLuaProgressCancel(lua_State* L, LuaProgress* prog, bool nil_first);
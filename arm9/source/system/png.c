@@ -3,6 +3,10 @@
 
 #include "lodepng.h"
 #include "png.h"
+#include "crc32.h"
+#include "vff.h"
+
+#define PNG_IDAT_SIZE	(16 << 10)
 
 // dest and src can be the same
 static inline void _rgb24_to_rgb565(u16 *dest, const u8 *src, size_t dim)
@@ -33,7 +37,7 @@ u16 *PNG_Decompress(const u8 *png, size_t png_len, u32 *w, u32 *h)
 {
 	u16 *img;
 	unsigned res;
-	size_t width, height;
+	unsigned width, height;
 
 	img = NULL;
 	res = lodepng_decode24((u8**)&img, &width, &height, png, png_len);
@@ -76,3 +80,215 @@ u8 *PNG_Compress(const u16 *fb, u32 w, u32 h, size_t *png_sz)
 
 	return img;
 }
+
+// streaming encoder below: rows are converted one at a time and deflated with
+// fixed Huffman codes, matching only against the previous pixel and the pixel
+// one row up (good enough for screen contents), IDAT chunks go straight to file
+typedef struct {
+	FIL *file;
+	u8 *idat;
+	u32 fill;
+	u32 bitbuf;
+	u32 bitcnt;
+	bool error;
+} PngStream;
+
+static const u16 png_len_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 png_len_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 png_dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 png_dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static inline void _png_put_be32(u8 *dest, u32 val)
+{
+	dest[0] = val >> 24;
+	dest[1] = val >> 16;
+	dest[2] = val >> 8;
+	dest[3] = val;
+}
+
+static void _png_write_chunk(PngStream *s, const char *type, const u8 *data, u32 len)
+{
+	u8 len_be[4], crc_be[4];
+	u32 crc = crc32_calculate(0xFFFFFFFF, (const u8*) type, 4);
+	UINT bw;
+
+	crc = crc32_calculate(crc, data, len) ^ 0xFFFFFFFF;
+	_png_put_be32(len_be, len);
+	_png_put_be32(crc_be, crc);
+	if ((fvx_write(s->file, len_be, 4, &bw) != FR_OK) || (bw != 4) ||
+		(fvx_write(s->file, type, 4, &bw) != FR_OK) || (bw != 4) ||
+		(len && ((fvx_write(s->file, data, len, &bw) != FR_OK) || (bw != len))) ||
+		(fvx_write(s->file, crc_be, 4, &bw) != FR_OK) || (bw != 4))
+		s->error = true;
+}
+
+static inline void _png_put_byte(PngStream *s, u8 byte)
+{
+	s->idat[s->fill++] = byte;
+	if (s->fill == PNG_IDAT_SIZE) {
+		_png_write_chunk(s, "IDAT", s->idat, s->fill);
+		s->fill = 0;
+	}
+}
+
+// bits go out LSB first, n <= 16
+static inline void _png_put_bits(PngStream *s, u32 val, u32 n)
+{
+	s->bitbuf |= val << s->bitcnt;
+	s->bitcnt += n;
+	while (s->bitcnt >= 8) {
+		_png_put_byte(s, s->bitbuf & 0xFF);
+		s->bitbuf >>= 8;
+		s->bitcnt -= 8;
+	}
+}
+
+// Huffman codes go out MSB first
+static inline void _png_put_code(PngStream *s, u32 code, u32 n)
+{
+	u32 rev = 0;
+	for (u32 i = 0; i < n; i++, code >>= 1)
+		rev = (rev << 1) | (code & 1);
+	_png_put_bits(s, rev, n);
+}
+
+static void _png_put_symbol(PngStream *s, u32 sym)
+{
+	if (sym < 144) _png_put_code(s, 0x30 + sym, 8);
+	else if (sym < 256) _png_put_code(s, 0x190 + sym - 144, 9);
+	else if (sym < 280) _png_put_code(s, sym - 256, 7);
+	else _png_put_code(s, 0xC0 + sym - 280, 8);
+}
+
+static void _png_put_match(PngStream *s, u32 len, u32 dist)
+{
+	u32 lc = 28, dc = 29;
+	while (png_len_base[lc] > len) lc--;
+	while (png_dist_base[dc] > dist) dc--;
+	_png_put_symbol(s, 257 + lc);
+	_png_put_bits(s, len - png_len_base[lc], png_len_extra[lc]);
+	_png_put_code(s, dc, 5);
+	_png_put_bits(s, dist - png_dist_base[dc], png_dist_extra[dc]);
+}
+
+// deflate one filtered row, prev is the row before it (NULL for the first row)
+static void _png_deflate_row(PngStream *s, const u8 *cur, const u8 *prev, u32 len)
+{
+	for (u32 i = 0; i < len;) {
+		u32 max_len = (len - i > 258) ? 258 : len - i;
+		u32 best_len = 0, best_dist = 0;
+		u32 l;
+
+		if (i >= 3) { // previous pixel
+			for (l = 0; (l < max_len) && (cur[i + l] == cur[i + l - 3]); l++);
+			best_len = l;
+			best_dist = 3;
+		}
+
+		if (prev && (len <= 32768)) { // same pixel, one row up (within the deflate window)
+			for (l = 0; (l < max_len) && (cur[i + l] == prev[i + l]); l++);
+			if (l > best_len) {
+				best_len = l;
+				best_dist = len;
+			}
+		}
+
+		if (best_len >= 3) {
+			_png_put_match(s, best_len, best_dist);
+			i += best_len;
+		} else {
+			_png_put_symbol(s, cur[i++]);
+		}
+	}
+}
+
+bool PNG_CompressToFile(const char *path, u32 w, u32 h, png_row_cb get_row, void *data)
+{
+	static const u8 png_magic[8] = { PNG_MAGIC };
+	u32 rowlen = 1 + (w * 3);
+	u32 adler_a = 1, adler_b = 0;
+	PngStream s = { 0 };
+	u8 ihdr[13];
+	FIL file;
+	UINT bw;
+
+	// one 565 row, two RGB24 rows with filter byte, one IDAT chunk
+	u8 *mem = malloc((w * 2) + (rowlen * 2) + PNG_IDAT_SIZE);
+	if (!mem) return false;
+	u16 *row565 = (u16*)(void*) mem;
+	u8 *cur = mem + (w * 2);
+	u8 *prev = cur + rowlen;
+	s.idat = prev + rowlen;
+
+	if (fvx_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+		free(mem);
+		return false;
+	}
+	s.file = &file;
+
+	// signature and header
+	_png_put_be32(ihdr, w);
+	_png_put_be32(ihdr + 4, h);
+	ihdr[8] = 8; // bit depth
+	ihdr[9] = 2; // truecolor
+	ihdr[10] = ihdr[11] = ihdr[12] = 0; // deflate, no filter, no interlace
+	if ((fvx_write(&file, png_magic, 8, &bw) != FR_OK) || (bw != 8))
+		s.error = true;
+	_png_write_chunk(&s, "IHDR", ihdr, sizeof(ihdr));
+
+	// zlib header, a single final block with fixed codes
+	_png_put_byte(&s, 0x78);
+	_png_put_byte(&s, 0x01);
+	_png_put_bits(&s, 1, 1);
+	_png_put_bits(&s, 1, 2);
+
+	for (u32 y = 0; (y < h) && !s.error; y++) {
+		get_row(row565, y, data);
+		cur[0] = 0; // filter: none
+		_rgb565_to_rgb24(cur + 1, row565, w);
+		_png_deflate_row(&s, cur, y ? prev : NULL, rowlen);
+
+		// reduce at least every 5552 byte, before adler_b can overflow
+		for (u32 i = 0; i < rowlen;) {
+			u32 n = (rowlen - i > 5552) ? 5552 : rowlen - i;
+			for (; n; n--, i++) {
+				adler_a += cur[i];
+				adler_b += adler_a;
+			}
+			adler_a %= 65521;
+			adler_b %= 65521;
+		}
+
+		u8 *tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+
+	// end of block, pad to byte, adler32
+	_png_put_symbol(&s, 256);
+	if (s.bitcnt) _png_put_bits(&s, 0, 8 - s.bitcnt);
+	u8 adler_be[4];
+	_png_put_be32(adler_be, (adler_b << 16) | adler_a);
+	for (u32 i = 0; i < 4; i++)
+		_png_put_byte(&s, adler_be[i]);
+	if (s.fill) _png_write_chunk(&s, "IDAT", s.idat, s.fill);
+	_png_write_chunk(&s, "IEND", NULL, 0);
+
+	fvx_close(&file);
+	free(mem);
+
+	if (s.error) fvx_unlink(path);
+	return !s.error;
+}
@@ -8,3 +8,8 @@
 
 u16 *PNG_Decompress(const u8 *png, size_t png_len, u32 *w, u32 *h);
 u8 *PNG_Compress(const u16 *fb, u32 w, u32 h, size_t *png_sz);
+
+// fetches row y of the image as w RGB565 pixels
+typedef void (*png_row_cb)(u16 *row, u32 y, void *data);
+// encodes straight to file, only needs a few rows worth of memory
+bool PNG_CompressToFile(const char *path, u32 w, u32 h, png_row_cb get_row, void *data);
@@ -11,6 +11,8 @@
 #include "unittype.h"
 #include "aes.h"
 #include "sha.h"
+#include "crc32.h"
+#include "gamecart.h"
 
 // use NCCH crypto defines for everything
 #define CRYPTO_DECRYPT  NCCH_NOCRYPTO
@@ -19,6 +21,26 @@
 // partitionA path
 #define PART_PATH       "D:/partitionA.bin"
 
+// shared buffers while a batch CIA build is running (see BeginCiaBatch())
+static CiaStub* batch_cia = NULL;
+static u8* batch_buffer = NULL;
+
+static CiaStub* AllocCiaStub(void) {
+    return (batch_cia) ? batch_cia : (CiaStub*) malloc(sizeof(CiaStub));
+}
+
+static void FreeCiaStub(CiaStub* cia) {
+    if (cia != batch_cia) free(cia);
+}
+
+static u8* AllocContentBuffer(void) {
+    return (batch_buffer) ? batch_buffer : (u8*) malloc(STD_BUFFER_SIZE);
+}
+
+static void FreeContentBuffer(u8* buffer) {
+    if (buffer != batch_buffer) free(buffer);
+}
+
 
 u32 GetCbcBlocks(FIL* file, void* buffer, u64 offset, u32 count, u8* titlekey, u8* forced_iv) {
     u8 iv[16] __attribute__((aligned(4)));
@@ -475,14 +497,39 @@ u32 WriteCiaStub(CiaStub* stub, const char* path) {
     return 0;
 }
 
-u32 VerifyTmdContent(const char* path, u64 offset, TmdContentChunk* chunk, const u8* titlekey) {
+// hashes (and decrypts) one content from the current file position
+// buffer has to be at least STD_BUFFER_SIZE byte
+u32 CheckTmdContentHash(FIL* file, TmdContentChunk* chunk, const u8* titlekey, u8* buffer, const char* path) {
     u8 hash[32] = { 0 };
     u8 ctr[16];
-    FIL file;
 
     u8* expected = chunk->hash;
     u64 size = getbe64(chunk->size);
     bool encrypted = getbe16(chunk->type) & 0x1;
+    u32 ret = 0;
+
+    u32 mode = SHA1_MODE;
+    for (u32 i = 20; i < 32; i++)
+        if (expected[i]) mode = SHA256_MODE;
+    GetTmdCtr(ctr, chunk);
+    sha_init(mode);
+    for (u64 i = 0; (i < size) && (ret == 0); i += STD_BUFFER_SIZE) {
+        u32 read_bytes = min(STD_BUFFER_SIZE, (size - i));
+        UINT bytes_read;
+        if ((fvx_read(file, buffer, read_bytes, &bytes_read) != FR_OK) || (bytes_read != read_bytes))
+            ret = 1;
+        if (encrypted) DecryptCiaContentSequential(buffer, read_bytes, ctr, titlekey);
+        sha_update(buffer, read_bytes);
+        if (!ShowProgress(i + read_bytes, size, path)) ret = 1;
+    }
+    sha_get(hash);
+
+    return ret | (memcmp(hash, expected, 32) ? 1 : 0);
+}
+
+u32 VerifyTmdContent(const char* path, u64 offset, TmdContentChunk* chunk, const u8* titlekey) {
+    u64 size = getbe64(chunk->size);
+    FIL file;
 
     if (!ShowProgress(0, 0, path)) return 1;
     if (fvx_open(&file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK)
@@ -499,24 +546,98 @@ u32 VerifyTmdContent(const char* path, u64 offset, TmdContentChunk* chunk, const
         return 1;
     }
 
-    u32 mode = SHA1_MODE;
-    for (u32 i = 20; i < 32; i++)
-        if (expected[i]) mode = SHA256_MODE;
-    GetTmdCtr(ctr, chunk);
-    sha_init(mode);
-    for (u32 i = 0; i < size; i += STD_BUFFER_SIZE) {
-        u32 read_bytes = min(STD_BUFFER_SIZE, (size - i));
-        UINT bytes_read;
-        fvx_read(&file, buffer, read_bytes, &bytes_read);
-        if (encrypted) DecryptCiaContentSequential(buffer, read_bytes, ctr, titlekey);
-        sha_update(buffer, read_bytes);
-        if (!ShowProgress(i + read_bytes, size, path)) break;
-    }
-    sha_get(hash);
+    u32 ret = CheckTmdContentHash(&file, chunk, titlekey, buffer, path);
     free(buffer);
     fvx_close(&file);
 
-    return memcmp(hash, expected, 32);
+    return ret;
+}
+
+#define NCCH_HASH_REGIONS_MAX   (1 + 1 + 10 + 1 + 1) // ExtHeader, ExeFS header, ExeFS files, RomFS header, RomFS lvl3
+// one or more back to back blocks of an NCCH, each with its own SHA-256
+typedef struct {
+    u64 offset;         // relative to the NCCH
+    u32 size;           // size of a single block
+    u32 count;
+    const u8* hashes;   // one per block
+    u32* result;        // set on a mismatch, the remaining blocks are skipped
+} NcchHashRegion;
+
+static void AddNcchHashRegion(NcchHashRegion* regions, u32* n_regions, u64 offset, u32 size, u32 count, const u8* hashes, u32* result) {
+    if (*n_regions >= NCCH_HASH_REGIONS_MAX) return;
+    regions[(*n_regions)++] = (NcchHashRegion) { .offset = offset, .size = size, .count = count, .hashes = hashes, .result = result };
+}
+
+// reads and decrypts data at offset_data (relative to the NCCH)
+static u32 ReadNcchData(FIL* file, void* data, u32 offset_ncch, u64 offset_data, u32 size, NcchHeader* ncch) {
+    UINT btr;
+    fvx_lseek(file, offset_ncch + offset_data);
+    if ((fvx_read(file, data, size, &btr) != FR_OK) || (btr != size) ||
+        (DecryptNcch(data, offset_data, size, ncch, NULL) != 0))
+        return 1;
+    return 0;
+}
+
+// checks all regions in a single pass in file order, through one decrypted window
+// regions may leave gaps (skipped) or overlap (read again), failed regions get their result set
+static u32 CheckNcchHashRegions(FIL* file, u32 offset_ncch, NcchHeader* ncch, ExeFsHeader* exefs,
+    NcchHashRegion* regions, u32 n_regions, u8* buffer, const char* path) {
+    u64 win_offset = 0;
+    u32 win_size = 0;
+    u64 total = 0;
+    u64 done = 0;
+    u32 ret = 0;
+
+    // sort by offset (insertion sort, there are only a few)
+    for (u32 i = 1; i < n_regions; i++) {
+        for (u32 j = i; j && (regions[j-1].offset > regions[j].offset); j--) {
+            NcchHashRegion tmp = regions[j];
+            regions[j] = regions[j-1];
+            regions[j-1] = tmp;
+        }
+    }
+    for (u32 r = 0; r < n_regions; r++)
+        total += (u64) regions[r].size * regions[r].count;
+
+    if (!ShowProgress(0, 0, path)) ret = 1;
+    for (u32 r = 0; (r < n_regions) && !ret; r++) {
+        NcchHashRegion* region = regions + r;
+        for (u32 b = 0; (b < region->count) && !*(region->result) && !ret; b++) {
+            u64 pos = region->offset + ((u64) b * region->size);
+            u32 left = region->size;
+            u8 hash[0x20];
+
+            sha_init(SHA256_MODE);
+            while (left) {
+                if ((pos < win_offset) || (pos >= win_offset + win_size)) { // refill window at pos
+                    UINT btr;
+                    win_offset = pos;
+                    win_size = STD_BUFFER_SIZE;
+                    if (((fvx_tell(file) != offset_ncch + pos) && (fvx_lseek(file, offset_ncch + pos) != FR_OK)) ||
+                        (fvx_read(file, buffer, win_size, &btr) != FR_OK))
+                        btr = 0;
+                    win_size = btr;
+                    if ((win_size < min(left, STD_BUFFER_SIZE)) || (DecryptNcch(buffer, win_offset, win_size, ncch, exefs) != 0)) {
+                        win_size = 0;
+                        break; // short read, region can't be complete
+                    }
+                    if (!ShowProgress(done, total, path)) ret = 1;
+                }
+                u32 count = min(left, win_offset + win_size - pos);
+                sha_update(buffer + (pos - win_offset), count);
+                pos += count;
+                left -= count;
+            }
+            sha_get(hash);
+
+            if (left || (memcmp(hash, region->hashes + (b * 0x20), 0x20) != 0)) *(region->result) = 1;
+            done += region->size;
+        }
+    }
+
+    // cancelled: anything that wasn't checked can't count as verified
+    if (ret) for (u32 r = 0; r < n_regions; r++) *(regions[r].result) = 1;
+    return ret;
 }
 
 u32 VerifyNcchFile(const char* path, u32 offset, u32 size) {
@@ -594,124 +715,91 @@ u32 VerifyNcchFile(const char* path, u32 offset, u32 size) {
     u32 ver_exefs = 0;
     u32 ver_romfs = 0;
 
-    // base hash check for extheader
-    if (ncch.size_exthdr > 0) {
-        fvx_lseek(&file, offset + NCCH_EXTHDR_OFFSET);
-        ver_exthdr = CheckNcchHash(ncch.hash_exthdr, &file, 0x400, offset, &ncch, NULL);
-    }
+    NcchHashRegion regions[NCCH_HASH_REGIONS_MAX];
+    u32 n_regions = 0;
+    bool cancelled = false;
 
-    // base hash check for exefs
+    // ExtHeader and ExeFS, including the ExeFS files (workaround for Process9)
+    if (ncch.size_exthdr > 0)
+        AddNcchHashRegion(regions, &n_regions, NCCH_EXTHDR_OFFSET, 0x400, 1, ncch.hash_exthdr, &ver_exthdr);
     if (ncch.size_exefs > 0) {
-        fvx_lseek(&file, offset + (ncch.offset_exefs * NCCH_MEDIA_UNIT));
-        ver_exefs = CheckNcchHash(ncch.hash_exefs, &file, ncch.size_exefs_hash * NCCH_MEDIA_UNIT, offset, &ncch, &exefs);
-    }
-
-    // base hash check for romfs
-    if (ncch.size_romfs > 0) {
-        fvx_lseek(&file, offset + (ncch.offset_romfs * NCCH_MEDIA_UNIT));
-        ver_romfs = CheckNcchHash(ncch.hash_romfs, &file, ncch.size_romfs_hash * NCCH_MEDIA_UNIT, offset, &ncch, NULL);
-    }
-
-    // thorough exefs verification (workaround for Process9)
-    if (!ShowProgress(0, 0, path)) return 1;
-    if ((ncch.size_exefs > 0) && (memcmp(exthdr.name, "Process9", 8) != 0)) {
-        for (u32 i = 0; !ver_exefs && (i < 10); i++) {
-            ExeFsFileHeader* exefile = exefs.files + i;
-            u8* hash = exefs.hashes[9 - i];
-            if (!exefile->size) continue;
-            fvx_lseek(&file, offset + (ncch.offset_exefs * NCCH_MEDIA_UNIT) + 0x200 + exefile->offset);
-            ver_exefs = CheckNcchHash(hash, &file, exefile->size, offset, &ncch, &exefs);
+        u64 offset_exefs = ncch.offset_exefs * NCCH_MEDIA_UNIT;
+        AddNcchHashRegion(regions, &n_regions, offset_exefs, ncch.size_exefs_hash * NCCH_MEDIA_UNIT, 1, ncch.hash_exefs, &ver_exefs);
+        if (!ncch.size_exthdr || (memcmp(exthdr.name, "Process9", 8) != 0)) {
+            for (u32 i = 0; i < 10; i++) {
+                ExeFsFileHeader* exefile = exefs.files + i;
+                if (!exefile->size) continue;
+                AddNcchHashRegion(regions, &n_regions, offset_exefs + 0x200 + exefile->offset, exefile->size, 1, exefs.hashes[9 - i], &ver_exefs);
+            }
         }
     }
 
-    // thorough romfs verification
-    if (!ver_romfs && (ncch.size_romfs > 0)) {
+    // RomFS: the IVFC header and the hash levels are loaded and checked up front,
+    // the lvl3 data (by far the biggest part) is then checked along with the rest
+    u8* masterhash = NULL;
+    u8* lvl1_data = NULL;
+    u8* lvl2_data = NULL;
+    if (ncch.size_romfs > 0) {
         UINT btr;
+        u64 offset_romfs = ncch.offset_romfs * NCCH_MEDIA_UNIT;
+        AddNcchHashRegion(regions, &n_regions, offset_romfs, ncch.size_romfs_hash * NCCH_MEDIA_UNIT, 1, ncch.hash_romfs, &ver_romfs);
 
         // load ivfc header
         RomFsIvfcHeader ivfc;
-        fvx_lseek(&file, offset + (ncch.offset_romfs * NCCH_MEDIA_UNIT));
+        fvx_lseek(&file, offset + offset_romfs);
         if ((fvx_read(&file, &ivfc, sizeof(RomFsIvfcHeader), &btr) != FR_OK) ||
-            (DecryptNcch((u8*) &ivfc, ncch.offset_romfs * NCCH_MEDIA_UNIT, sizeof(RomFsIvfcHeader), &ncch, NULL) != 0) )
+            (DecryptNcch((u8*) &ivfc, offset_romfs, sizeof(RomFsIvfcHeader), &ncch, NULL) != 0) ||
+            (ValidateRomFsHeader(&ivfc, ncch.size_romfs * NCCH_MEDIA_UNIT) != 0))
             ver_romfs = 1;
 
-        // load data
+        // load masterhash(es), lvl1, lvl2
         u64 lvl1_size = 0;
         u64 lvl2_size = 0;
-        u8* masterhash = NULL;
-        u8* lvl1_data = NULL;
-        u8* lvl2_data = NULL;
-        if (!ver_romfs && (ValidateRomFsHeader(&ivfc, ncch.size_romfs * NCCH_MEDIA_UNIT) == 0)) {
-            // load masterhash(es)
-            masterhash = malloc(ivfc.size_masterhash);
-            if (masterhash) {
-                u64 offset_add = (ncch.offset_romfs * NCCH_MEDIA_UNIT) + sizeof(RomFsIvfcHeader);
-                fvx_lseek(&file, offset + offset_add);
-                if ((fvx_read(&file, masterhash, ivfc.size_masterhash, &btr) != FR_OK) ||
-                    (DecryptNcch(masterhash, offset_add, ivfc.size_masterhash, &ncch, NULL) != 0))
-                    ver_romfs = 1;
-            }
-
-            // load lvl1
+        if (!ver_romfs) {
             lvl1_size = align(ivfc.size_lvl1, 1 << ivfc.log_lvl1);
-            lvl1_data = malloc(lvl1_size);
-            if (lvl1_data) {
-                u64 offset_add = (ncch.offset_romfs * NCCH_MEDIA_UNIT) + GetRomFsLvOffset(&ivfc, 1);
-                fvx_lseek(&file, offset + offset_add);
-                if ((fvx_read(&file, lvl1_data, lvl1_size, &btr) != FR_OK) ||
-                    (DecryptNcch(lvl1_data, offset_add, lvl1_size, &ncch, NULL) != 0))
-                    ver_romfs = 1;
-            }
-
-            // load lvl2
             lvl2_size = align(ivfc.size_lvl2, 1 << ivfc.log_lvl2);
+            masterhash = malloc(ivfc.size_masterhash);
+            lvl1_data = malloc(lvl1_size);
             lvl2_data = malloc(lvl2_size);
-            if (lvl2_data) {
-                u64 offset_add = (ncch.offset_romfs * NCCH_MEDIA_UNIT) + GetRomFsLvOffset(&ivfc, 2);
-                fvx_lseek(&file, offset + offset_add);
-                if ((fvx_read(&file, lvl2_data, lvl2_size, &btr) != FR_OK) ||
-                    (DecryptNcch(lvl2_data, offset_add, lvl2_size, &ncch, NULL) != 0))
-                    ver_romfs = 1;
-            }
-
-            // check mallocs
-            if (!masterhash || !lvl1_data || !lvl2_data)
-                ver_romfs = 1; // should never happen
+            if (!masterhash || !lvl1_data || !lvl2_data ||
+                (ReadNcchData(&file, masterhash, offset, offset_romfs + sizeof(RomFsIvfcHeader), ivfc.size_masterhash, &ncch) != 0) ||
+                (ReadNcchData(&file, lvl1_data, offset, offset_romfs + GetRomFsLvOffset(&ivfc, 1), lvl1_size, &ncch) != 0) ||
+                (ReadNcchData(&file, lvl2_data, offset, offset_romfs + GetRomFsLvOffset(&ivfc, 2), lvl2_size, &ncch) != 0))
+                ver_romfs = 1;
         }
 
-        // actual verification
+        // verify lvl1 and lvl2
         if (!ver_romfs) {
-            // verify lvl1
             u32 n_blocks = lvl1_size >> ivfc.log_lvl1;
             u32 block_log = ivfc.log_lvl1;
             for (u32 i = 0; !ver_romfs && (i < n_blocks); i++)
                 ver_romfs = (u32) sha_cmp(masterhash + (i*0x20), lvl1_data + (i<<block_log), 1<<block_log, SHA256_MODE);
 
-            // verify lvl2
             n_blocks = lvl2_size >> ivfc.log_lvl2;
             block_log = ivfc.log_lvl2;
-            for (u32 i = 0; !ver_romfs && (i < n_blocks); i++) {
+            for (u32 i = 0; !ver_romfs && (i < n_blocks); i++)
                 ver_romfs = sha_cmp(lvl1_data + (i*0x20), lvl2_data + (i<<block_log), 1<<block_log, SHA256_MODE);
-            }
-
-            // lvl3 verification (this will take long)
-            u64 offset_add = (ncch.offset_romfs * NCCH_MEDIA_UNIT) + GetRomFsLvOffset(&ivfc, 3);
-            n_blocks = align(ivfc.size_lvl3, 1 << ivfc.log_lvl3) >> ivfc.log_lvl3;
-            block_log = ivfc.log_lvl3;
-            fvx_lseek(&file, offset + offset_add);
-            for (u32 i = 0; !ver_romfs && (i < n_blocks); i++) {
-                ver_romfs = CheckNcchHash(lvl2_data + (i*0x20), &file, 1 << block_log, offset, &ncch, NULL);
-                offset_add += 1 << block_log;
-                if (!(i % 16) && !ShowProgress(i+1, n_blocks, path)) ver_romfs = 1;
-            }
         }
 
-        if (masterhash) free(masterhash);
-        if (lvl1_data) free(lvl1_data);
-        if (lvl2_data) free(lvl2_data);
+        // lvl3 blocks, hashes are in lvl2
+        if (!ver_romfs) {
+            u32 n_blocks = align(ivfc.size_lvl3, 1 << ivfc.log_lvl3) >> ivfc.log_lvl3;
+            AddNcchHashRegion(regions, &n_regions, offset_romfs + GetRomFsLvOffset(&ivfc, 3), 1 << ivfc.log_lvl3, n_blocks, lvl2_data, &ver_romfs);
+        }
     }
 
-    if (!offset && (ver_exthdr|ver_exefs|ver_romfs)) { // verification summary
+    // everything in one sequential sweep
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer) ver_exthdr = ver_exefs = ver_romfs = 1;
+    else if (CheckNcchHashRegions(&file, offset, &ncch, ncch.size_exefs ? &exefs : NULL, regions, n_regions, buffer, path) != 0)
+        cancelled = true;
+
+    free(buffer);
+    free(masterhash);
+    free(lvl1_data);
+    free(lvl2_data);
+
+    if (!offset && !cancelled && (ver_exthdr|ver_exefs|ver_romfs)) { // verification summary
         ShowPrompt(false, STR_PATH_NCCH_VERIFICATION_FAILED_INFO, pathstr,
             (!ncch.size_exthdr) ? "-" : (ver_exthdr == 0) ? STR_OK : STR_FAIL,
             (!ncch.size_exefs) ? "-" : (ver_exefs == 0) ? STR_OK : STR_FAIL,
@@ -779,25 +867,53 @@ u32 VerifyCiaFile(const char* path) {
         return 1;
     }
 
-    // verify contents
+    // plan content verification: contents are stored back to back in TMD order,
+    // so the whole content area can be checked in one sequential sweep
     u32 content_count = getbe16(cia->tmd.content_count);
-    u64 next_offset = info.offset_content;
     u8* cnt_index = cia->header.content_index;
+    u64 content_end = info.offset_content;
     for (u32 i = 0; (i < content_count) && (i < TMD_MAX_CONTENTS); i++) {
+        TmdContentChunk* chunk = &(cia->content_list[i]);
+        u16 index = getbe16(chunk->index);
+        if (!(cnt_index[index/8] & (1 << (7-(index%8))))) continue; // missing contents are not stored
+        content_end += getbe64(chunk->size);
+    }
+
+    FIL file;
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer || (fvx_open(&file, path, FA_READ | FA_OPEN_EXISTING) != FR_OK)) {
+        free(buffer);
+        free(cia);
+        return 1;
+    }
+
+    // a truncated file fails without hashing anything
+    u64 next_offset = info.offset_content;
+    u32 ret = 0;
+    if (content_end > fvx_size(&file)) {
+        ShowPrompt(false, "%s\n%s", pathstr, STR_ERROR_FILE_IS_TOO_SMALL);
+        ret = 1;
+    }
+
+    // verify contents, stop at the first mismatch
+    fvx_lseek(&file, next_offset);
+    for (u32 i = 0; !ret && (i < content_count) && (i < TMD_MAX_CONTENTS); i++) {
         TmdContentChunk* chunk = &(cia->content_list[i]);
         u16 index = getbe16(chunk->index);
         if (!(cnt_index[index/8] & (1 << (7-(index%8))))) continue; // don't check missing contents
-        if (VerifyTmdContent(path, next_offset, chunk, titlekey) != 0) {
+        if (!ShowProgress(0, 0, path) ||
+            (CheckTmdContentHash(&file, chunk, titlekey, buffer, path) != 0)) {
             ShowPrompt(false, STR_PATH_ID_N_SIZE_AT_OFFSET_VERIFICATION_FAILED,
                 pathstr, getbe32(chunk->id), getbe64(chunk->size), next_offset);
-            free(cia);
-            return 1;
+            ret = 1;
         }
         next_offset += getbe64(chunk->size);
     }
 
+    fvx_close(&file);
+    free(buffer);
     free(cia);
-    return 0;
+    return ret;
 }
 
 u32 VerifyTmdFile(const char* path, bool cdn) {
@@ -889,19 +1005,23 @@ u32 VerifyTadFile(const char* path) {
         (VerifyTadStub(&tad) != 0))
         return 1;
 
-    // verify contents
+    // verify contents, one buffer for all of them
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer) return 1;
     u32 content_start = sizeof(TadStub); 
-    for (u32 i = 0; i < TAD_NUM_CONTENT; i++) {
+    u32 ret = 0;
+    for (u32 i = 0; (i < TAD_NUM_CONTENT) && !ret; i++) {
         u8 hash[32];
         u32 len = align(hdr->content_size[i], 0x10);
         if (!len) continue; // non-existant section
-        if (!FileGetSha(path, hash, content_start, len, false) ||
+        if (!FileGetSha(path, hash, content_start, len, false, buffer, STD_BUFFER_SIZE) ||
             (memcmp(hash, ftr->content_sha256[i], 32) != 0))
-            return 1;
+            ret = 1;
         content_start += len + sizeof(TadBlockMetaData);
     }
 
-    return 0;
+    free(buffer);
+    return ret;
 }
 
 u32 VerifyFirmFile(const char* path) {
@@ -2067,7 +2187,7 @@ u32 InsertCiaContent(const char* path_cia, const char* path_content, u32 offset,
     }
 
     // allocate buffer
-    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    u8* buffer = AllocContentBuffer();
     if (!buffer) {
         fvx_close(&ofile);
         fvx_close(&dfile);
@@ -2097,7 +2217,7 @@ u32 InsertCiaContent(const char* path_cia, const char* path_content, u32 offset,
     u8 hash[0x20] __attribute__((aligned(4)));
     sha_get(hash);
 
-    free(buffer);
+    FreeContentBuffer(buffer);
     fvx_close(&ofile);
     fvx_close(&dfile);
 
@@ -2253,7 +2373,7 @@ u32 BuildCiaFromTadFile(const char* path_tad, const char* path_dest, bool force_
         return 1;
     
     // build the CIA stub
-    CiaStub* cia = (CiaStub*) malloc(sizeof(CiaStub));
+    CiaStub* cia = AllocCiaStub();
     if (!cia) return 1;
     TitleMetaData* tmd = &(cia->tmd);
     TicketCommon* ticket = &(cia->ticket);
@@ -2265,7 +2385,7 @@ u32 BuildCiaFromTadFile(const char* path_tad, const char* path_dest, bool force_
         (BuildFakeTicket((Ticket*) ticket, tmd->title_id) != 0) ||
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (WriteCiaStub(cia, path_dest) != 0)) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
     
@@ -2273,14 +2393,14 @@ u32 BuildCiaFromTadFile(const char* path_tad, const char* path_dest, bool force_
     u32 content_count = getbe16(tmd->content_count);
     u8* title_id = tmd->title_id;
     if (!content_count || (content_count > 8)) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
     
     // check for legit TMD
     if (force_legit && ((ValidateTmdSignature(tmd) != 0) || VerifyTmd(tmd) != 0)) {
         ShowPrompt(false, STR_ID_N_TMD_IN_TAD_NOT_LEGIT, getbe64(title_id));
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
@@ -2300,7 +2420,7 @@ u32 BuildCiaFromTadFile(const char* path_tad, const char* path_dest, bool force_
         }
     }
     if (tad_content_count != content_count) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
     
@@ -2316,7 +2436,7 @@ u32 BuildCiaFromTadFile(const char* path_tad, const char* path_dest, bool force_
         u64 size = getbe64(chunk->size);
         if (InsertCiaContent(path_dest, path_tad, next_offset, size,
              chunk, titlekey, force_legit, false, false) != 0) {
-            free(cia);
+            FreeCiaStub(cia);
             return 1;
         }
         next_offset += align(size, 0x10) + sizeof(TadBlockMetaData);
@@ -2326,11 +2446,11 @@ u32 BuildCiaFromTadFile(const char* path_tad, const char* path_dest, bool force_
     if ((force_legit && (VerifyTmd(tmd) != 0)) ||
         (!force_legit && (FixTmdHashes(tmd) != 0)) ||
         (WriteCiaStub(cia, path_dest) != 0)) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
-    free(cia);
+    FreeCiaStub(cia);
     return 0;
 }
 
@@ -2468,12 +2588,12 @@ u32 InstallFromTmdFile(const char* path_tmd, const char* path_dest) {
 }
 
 u32 BuildCiaFromTmdFile(const char* path_tmd, const char* path_dest, bool force_legit, bool cdn) {
-    void* buffer = (void*) malloc(sizeof(CiaStub));
+    CiaStub* buffer = AllocCiaStub();
     if (!buffer) return 1;
 
     u32 ret = BuildInstallFromTmdFileBuffered(path_tmd, path_dest, force_legit, cdn, buffer, false);
 
-    free(buffer);
+    FreeCiaStub(buffer);
     return ret;
 }
 
@@ -2509,7 +2629,7 @@ u32 BuildInstallFromNcchFile(const char* path_ncch, const char* path_dest, bool
         title_id[i] = (ncch.programId >> ((7-i)*8)) & 0xFF;
 
     // build the CIA stub
-    CiaStub* cia = (CiaStub*) malloc(sizeof(CiaStub));
+    CiaStub* cia = AllocCiaStub();
     if (!cia) return 1;
     memset(cia, 0, sizeof(CiaStub));
     if ((BuildCiaHeader(&(cia->header), TICKET_COMMON_SIZE) != 0) ||
@@ -2518,7 +2638,7 @@ u32 BuildInstallFromNcchFile(const char* path_ncch, const char* path_dest, bool
         (BuildFakeTmd(&(cia->tmd), title_id, 1, save_size, 0, 0)) ||
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (!install && (WriteCiaStub(cia, path_dest) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
@@ -2527,7 +2647,7 @@ u32 BuildInstallFromNcchFile(const char* path_ncch, const char* path_dest, bool
     memset(chunk, 0, sizeof(TmdContentChunk)); // nothing else to do
     if ((!install && (InsertCiaContent(path_dest, path_ncch, 0, 0, chunk, NULL, false, true, false) != 0)) ||
         (install && (InstallCiaContent(path_dest, path_ncch, 0, 0, chunk, title_id, NULL, true, false) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
@@ -2547,11 +2667,11 @@ u32 BuildInstallFromNcchFile(const char* path_ncch, const char* path_dest, bool
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (!install && (WriteCiaStub(cia, path_dest) != 0)) ||
         (install && (InstallCiaSystemData(cia, path_dest) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
-    free(cia);
+    FreeCiaStub(cia);
     return 0;
 }
 
@@ -2579,7 +2699,7 @@ u32 BuildInstallFromNcsdFile(const char* path_ncsd, const char* path_dest, bool
     save_size = (u32) exthdr.savedata_size;
 
     // build the CIA stub
-    CiaStub* cia = (CiaStub*) malloc(sizeof(CiaStub));
+    CiaStub* cia = AllocCiaStub();
     if (!cia) return 1;
     memset(cia, 0, sizeof(CiaStub));
     if ((BuildCiaHeader(&(cia->header), TICKET_COMMON_SIZE) != 0) ||
@@ -2588,7 +2708,7 @@ u32 BuildInstallFromNcsdFile(const char* path_ncsd, const char* path_dest, bool
         (BuildFakeTmd(&(cia->tmd), title_id, content_count, save_size, 0, 0)) ||
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (!install && (WriteCiaStub(cia, path_dest) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
@@ -2606,7 +2726,7 @@ u32 BuildInstallFromNcsdFile(const char* path_ncsd, const char* path_dest, bool
                 offset, size, chunk++, NULL, false, (i == 0), false) != 0)) ||
             (install && (InstallCiaContent(path_dest, path_ncsd,
                 offset, size, chunk++, title_id, NULL, (i == 0), false) != 0))) {
-            free(cia);
+            FreeCiaStub(cia);
             return 1;
         }
     }
@@ -2637,11 +2757,11 @@ u32 BuildInstallFromNcsdFile(const char* path_ncsd, const char* path_dest, bool
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (!install && (WriteCiaStub(cia, path_dest) != 0)) ||
         (install && (InstallCiaSystemData(cia, path_dest) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
-    free(cia);
+    FreeCiaStub(cia);
     return 0;
 }
 
@@ -2676,7 +2796,7 @@ u32 BuildInstallFromNdsFile(const char* path_nds, const char* path_dest, bool in
     memcpy(title_id, tidhigh_3ds, 3);
 
     // build the CIA stub
-    CiaStub* cia = (CiaStub*) malloc(sizeof(CiaStub));
+    CiaStub* cia = AllocCiaStub();
     if (!cia) return 1;
     memset(cia, 0, sizeof(CiaStub));
     if ((BuildCiaHeader(&(cia->header), TICKET_COMMON_SIZE) != 0) ||
@@ -2685,7 +2805,7 @@ u32 BuildInstallFromNdsFile(const char* path_nds, const char* path_dest, bool in
         (BuildFakeTmd(&(cia->tmd), title_id, 1, save_size, privsave_size, twl_flag)) ||
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (!install && (WriteCiaStub(cia, path_dest) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
@@ -2694,7 +2814,7 @@ u32 BuildInstallFromNdsFile(const char* path_nds, const char* path_dest, bool in
     memset(chunk, 0, sizeof(TmdContentChunk)); // nothing else to do
     if ((!install && (InsertCiaContent(path_dest, path_nds, 0, 0, chunk, NULL, false, false, false) != 0)) ||
         (install && (InstallCiaContent(path_dest, path_nds, 0, 0, chunk, title_id, NULL, false, false) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
@@ -2704,11 +2824,11 @@ u32 BuildInstallFromNdsFile(const char* path_nds, const char* path_dest, bool in
         (FixCiaHeaderForTmd(&(cia->header), &(cia->tmd)) != 0) ||
         (!install && (WriteCiaStub(cia, path_dest) != 0)) ||
         (install && (InstallCiaSystemData(cia, path_dest) != 0))) {
-        free(cia);
+        FreeCiaStub(cia);
         return 1;
     }
 
-    free(cia);
+    FreeCiaStub(cia);
     return 0;
 }
 
@@ -2830,10 +2950,10 @@ u32 BuildCiaFromGameFile(const char* path, bool force_legit) {
     } else { // find a proper extension for CIA
         char dest_old[256];
         strncpy(dest_old, dest, 256);
-        CiaStub* cia = (CiaStub*) malloc(sizeof(CiaStub));
+        CiaStub* cia = AllocCiaStub();
         if (!cia) return 1;
         if (LoadCiaStub(cia, dest) != 0) {
-            free(cia);
+            FreeCiaStub(cia);
             return 1;
         }
 
@@ -2843,7 +2963,7 @@ u32 BuildCiaFromGameFile(const char* path, bool force_legit) {
                 snprintf(dot, 32, ".%08lX.%s", getbe32(ticket->console_id), "legit.cia");
             else snprintf(dot, 32, ".%s", "piratelegit.cia");
         } else snprintf(dot, 16, ".%s", "standard.cia");
-        free(cia);
+        FreeCiaStub(cia);
 
         fvx_unlink(dest);
         fvx_rename(dest_old, dest);
@@ -2852,6 +2972,59 @@ u32 BuildCiaFromGameFile(const char* path, bool force_legit) {
     return ret;
 }
 
+u32 BeginCiaBatch(void) {
+    if (batch_cia) return 0; // already running
+
+    // one set of buffers for all titles
+    batch_cia = (CiaStub*) malloc(sizeof(CiaStub));
+    batch_buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!batch_cia || !batch_buffer) {
+        EndCiaBatch();
+        return 1;
+    }
+
+    // cert bundle and key databases stay loaded until EndCiaBatch()
+    HoldCiaCert(true);
+    HoldTitleKeyDbs(true);
+    HoldSeedDbs(true);
+
+    return 0;
+}
+
+void EndCiaBatch(void) {
+    HoldCiaCert(false);
+    HoldTitleKeyDbs(false);
+    HoldSeedDbs(false);
+
+    free(batch_cia);
+    free(batch_buffer);
+    batch_cia = NULL;
+    batch_buffer = NULL;
+}
+
+u32 BuildCiaFromGameDir(const char* path, bool force_legit, u32* n_built, u32* n_failed) {
+    DIR pdir;
+    FILINFO fno;
+    char fpath[256];
+
+    *n_built = *n_failed = 0;
+    if (fvx_opendir(&pdir, path) != FR_OK)
+        return 1;
+
+    bool batch = (BeginCiaBatch() == 0);
+    while ((fvx_readdir(&pdir, &fno) == FR_OK) && *(fno.fname)) {
+        if (fno.fattrib & AM_DIR) continue;
+        snprintf(fpath, sizeof(fpath), "%s/%s", path, fno.fname);
+        if (!FTYPE_CIABUILD(IdentifyFileType(fpath))) continue;
+        if (BuildCiaFromGameFile(fpath, force_legit) == 0) (*n_built)++;
+        else (*n_failed)++;
+    }
+    if (batch) EndCiaBatch();
+    fvx_closedir(&pdir);
+
+    return (*n_failed) ? 1 : 0;
+}
+
 u32 InstallGameFile(const char* path, bool to_emunand) {
     char drv[3];
     u64 filetype = IdentifyFileType(path);
@@ -3208,7 +3381,7 @@ u32 ExtractCodeFromCxiFile(const char* path, const char* path_out, char* extstr)
     return 0;
 }
 
-u32 CompressCode(const char* path, const char* path_out) {
+u32 CompressCode(const char* path, const char* path_out, u32 level) {
     char dest[256];
 
     strncpy(dest, path_out ? path_out : OUTPUT_PATH, 255);
@@ -3229,7 +3402,7 @@ u32 CompressCode(const char* path, const char* path_out) {
 
     // load code.bin and compress code
     if ((fvx_qread(path, code_dec, 0, code_dec_size, NULL) != FR_OK) ||
-        (!CompressCodeLzss(code_dec, code_dec_size, code_cmp, &code_cmp_size))) {
+        (!CompressCodeLzssLevel(code_dec, code_dec_size, code_cmp, &code_cmp_size, level))) {
         free(code_dec);
         free(code_cmp);
         return 1;
@@ -3350,6 +3523,65 @@ u32 TrimGameFile(const char* path) {
     return 0;
 }
 
+u32 DumpGameCart(const char* path, CartData* cdata, u64 size, bool write_hashes, u8* sha256, u32* crc32) {
+    u8 hash[0x20];
+    u32 crc = ~0;
+    u32 ret = 0;
+    FIL file;
+
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer) return 1;
+
+    // preallocate, so running out of space shows up before reading the cart
+    if (fvx_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        free(buffer);
+        return 1;
+    }
+    if ((fvx_lseek(&file, size) != FR_OK) || (fvx_tell(&file) != size) ||
+        (fvx_lseek(&file, 0) != FR_OK))
+        ret = 1;
+
+    // single pass: read, hash & write, the file is kept open in between
+    sha_init(SHA256_MODE);
+    ShowProgress(0, 0, path);
+    for (u64 pos = 0; (pos < size) && !ret; pos += STD_BUFFER_SIZE) {
+        UINT len = min(size - pos, STD_BUFFER_SIZE);
+        UINT bw;
+        if ((ReadCartBytes(buffer, pos, len, cdata, false) != 0) ||
+            (fvx_write(&file, buffer, len, &bw) != FR_OK) || (bw != len)) {
+            ret = 1;
+            break;
+        }
+        sha_update(buffer, len);
+        crc = crc32_calculate(crc, buffer, len);
+        if (!ShowProgress(pos + len, size, path)) ret = 1;
+    }
+    sha_get(hash);
+
+    fvx_close(&file);
+    free(buffer);
+    if (ret) {
+        fvx_unlink(path);
+        return 1;
+    }
+
+    // sidecar .sha file, same format as written by the SHA calculator, and .sfv file with the CRC32
+    if (write_hashes) {
+        char side_path[256];
+        char sfv[256 + 16];
+        const char* name = strrchr(path, '/');
+        snprintf(side_path, sizeof(side_path), "%s.sha", path);
+        if (!FileSetData(side_path, hash, 0x20, 0, true)) return 1;
+        snprintf(side_path, sizeof(side_path), "%s.sfv", path);
+        snprintf(sfv, sizeof(sfv), "%s %08lX\r\n", name ? name + 1 : path, ~crc);
+        if (!FileSetData(side_path, sfv, strnlen(sfv, sizeof(sfv)), 0, true)) return 1;
+    }
+
+    if (sha256) memcpy(sha256, hash, 0x20);
+    if (crc32) *crc32 = ~crc;
+    return 0;
+}
+
 u32 LoadSmdhFromGameFile(const char* path, Smdh* smdh) {
     u64 filetype = IdentifyFileType(path);
 
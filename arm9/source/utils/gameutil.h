@@ -1,20 +1,25 @@
 #pragma once
 
 #include "common.h"
+#include "gamecart.h"
 
 u32 VerifyGameFile(const char* path);
 u32 CheckEncryptedGameFile(const char* path);
 u32 CryptGameFile(const char* path, bool inplace, bool encrypt);
 u32 BuildCiaFromGameFile(const char* path, bool force_legit);
+u32 BeginCiaBatch(void);
+void EndCiaBatch(void);
+u32 BuildCiaFromGameDir(const char* path, bool force_legit, u32* n_built, u32* n_failed);
 u32 InstallGameFile(const char* path, bool to_emunand);
 u32 InstallCifinishFile(const char* path, bool to_emunand);
 u32 InstallTicketFile(const char* path, bool to_emunand);
 u32 DumpTicketForGameFile(const char* path, bool force_legit);
 u32 DumpCxiSrlFromGameFile(const char* path);
 u32 ExtractCodeFromCxiFile(const char* path, const char* path_out, char* extstr);
-u32 CompressCode(const char* path, const char* path_out);
+u32 CompressCode(const char* path, const char* path_out, u32 level);
 u64 GetGameFileTrimmedSize(const char* path);
 u32 TrimGameFile(const char* path);
+u32 DumpGameCart(const char* path, CartData* cdata, u64 size, bool write_hashes, u8* sha256, u32* crc32);
 u32 ShowGameFileIcon(const char* path, u16* screen);
 u32 ShowGameCheckerInfo(const char* path);
 u64 GetGameFileTitleId(const char* path);
@@ -450,40 +450,43 @@ u32 CheckFixCmdCmac(const char* path, bool fix, bool check_perms) {
     return 0;
 }
 
-u32 RecursiveFixFileCmacWorker(char* path) {
-    FILINFO fno;
-    DIR pdir;
-    u32 err = 0;
+static u32 TreeCmacFile(const char* path, u64 size, void* ctx) {
+    (void) size;
+    TreeCmacInfo* info = (TreeCmacInfo*) ctx;
+    info->last = TREE_CMAC_NONE;
+    if (CheckCmacPath(path) != 0) return TV_NEXT;
+    if (((info->fix) ? FixFileCmac(path, true) : CheckFileCmac(path)) == 0) {
+        info->last = TREE_CMAC_OK;
+        info->n_ok++;
+    } else {
+        info->last = TREE_CMAC_BAD;
+        info->n_bad++;
+    }
+    return TV_NEXT;
+}
 
-    if (fvx_opendir(&pdir, path) == FR_OK) { // process folder contents
+static u32 TreeCmacDir(const char* path, void* ctx) {
+    if (((TreeCmacInfo*) ctx)->fix) {
         char pathstr[UTF_BUFFER_BYTESIZE(32)];
         TruncateString(pathstr, path, 32, 8);
-        char* fname = path + strnlen(path, 255);
-        *(fname++) = '/';
-
         ShowString("%s\n%s", pathstr, STR_FIXING_CMACS_PLEASE_WAIT);
-        while (f_readdir(&pdir, &fno) == FR_OK) {
-            if ((strncmp(fno.fname, ".", 2) == 0) || (strncmp(fno.fname, "..", 3) == 0))
-                continue; // filter out virtual entries
-            strncpy(fname, fno.fname, path + 255 - fname);
-            if (fno.fname[0] == 0) {
-                break;
-            } else if (fno.fattrib & AM_DIR) { // directory, recurse through it
-                if (RecursiveFixFileCmacWorker(path) != 0) err = 1;
-            } else if (CheckCmacPath(path) == 0) { // file, try to fix the CMAC
-                if (FixFileCmac(path, true) != 0) err = 1;
-                ShowString("%s\n%s", pathstr, STR_FIXING_CMACS_PLEASE_WAIT);
-            }
-        }
-        f_closedir(&pdir);
-        *(--fname) = '\0';
-    } else if (CheckCmacPath(path) == 0) // fix single file CMAC
-        return FixFileCmac(path, true);
+    }
+    return TV_NEXT;
+}
 
-    return err;
+void TreeVisitorCmac(TreeVisitor* visitor, TreeCmacInfo* info) {
+    bool fix = info->fix;
+    memset(visitor, 0, sizeof(TreeVisitor));
+    memset(info, 0, sizeof(TreeCmacInfo));
+    info->fix = fix;
+    visitor->file = TreeCmacFile;
+    visitor->dir = TreeCmacDir;
+    visitor->ctx = info;
 }
 
 u32 RecursiveFixFileCmac(const char* path) {
+    DIR pdir;
+
     // create a fixed up local path
     // (this is highly path sensitive)
     char lpath[256];
@@ -499,5 +502,14 @@ u32 RecursiveFixFileCmac(const char* path) {
         }
     }
 
-    return RecursiveFixFileCmacWorker(lpath);
+    if (fvx_opendir(&pdir, lpath) != FR_OK) // fix single file CMAC
+        return (CheckCmacPath(lpath) == 0) ? FixFileCmac(lpath, true) : 0;
+    fvx_closedir(&pdir);
+
+    TreeVisitor visitor;
+    TreeCmacInfo info = { .fix = true };
+    TreeVisitorCmac(&visitor, &info);
+    TreeCmacDir(lpath, &info);
+    if (!TreeWalk(lpath, &visitor, 1, false)) return 1;
+    return info.n_bad ? 1 : 0;
 }
@@ -1,12 +1,25 @@
 #pragma once
 
 #include "common.h"
+#include "fsutil.h"
 
 #define ReadFileCmac(path, cmac)               ReadWriteFileCmac(path, cmac, false, true)
 #define WriteFileCmac(path, cmac, check_perms) ReadWriteFileCmac(path, cmac, true, check_perms)
 #define CheckCmdCmac(path)                     CheckFixCmdCmac(path, false, true)
 #define FixCmdCmac(path, check_perms)          CheckFixCmdCmac(path, true, check_perms)
 
+// CMAC state of the last file seen by the tree walk visitor
+#define TREE_CMAC_NONE  0 // not a CMAC protected file
+#define TREE_CMAC_OK    1 // CMAC valid / fixed
+#define TREE_CMAC_BAD   2 // CMAC invalid / fixing failed
+
+typedef struct {
+    bool fix;
+    u32 last;
+    u32 n_ok;
+    u32 n_bad;
+} TreeCmacInfo;
+
 u32 CheckCmacPath(const char* path);
 u32 ReadWriteFileCmac(const char* path, u8* cmac, bool do_write, bool check_perms);
 u32 CalculateFileCmac(const char* path, u8* cmac);
@@ -15,3 +28,4 @@ u32 FixFileCmac(const char* path, bool check_perms);
 u32 FixAgbSaveCmac(void* data, u8* cmac, const char* sddrv);
 u32 CheckFixCmdCmac(const char* path, bool fix, bool check_perms);
 u32 RecursiveFixFileCmac(const char* path);
+void TreeVisitorCmac(TreeVisitor* visitor, TreeCmacInfo* info);
@@ -392,7 +392,34 @@ u32 ValidateNandDump(const char* path) {
     return 0;
 }
 
-u32 SafeRestoreNandDump(const char* path) {
+// writes only the sector runs that differ from what is already on NAND
+// buffer_loc may be NULL to write everything
+static u32 WriteNandSectorsChanged(const u8* buffer, u8* buffer_loc, u32 sector, u32 count, u64* written) {
+    if (!buffer_loc || (ReadNandSectors(buffer_loc, sector, count, 0xFF, NAND_SYSNAND) != 0)) {
+        if (WriteNandSectors(buffer, sector, count, 0xFF, NAND_SYSNAND) != 0) return 1;
+        if (written) *written += count * 0x200;
+        return 0;
+    }
+
+    for (u32 i = 0; i < count;) {
+        // skip identical sectors
+        while ((i < count) && (memcmp(buffer + (i * 0x200), buffer_loc + (i * 0x200), 0x200) == 0)) i++;
+        if (i >= count) break;
+
+        // find the end of the differing run
+        u32 n = 1;
+        while ((i + n < count) && (memcmp(buffer + ((i + n) * 0x200), buffer_loc + ((i + n) * 0x200), 0x200) != 0)) n++;
+
+        if (WriteNandSectors(buffer + (i * 0x200), sector + i, n, 0xFF, NAND_SYSNAND) != 0) return 1;
+        if (written) *written += n * 0x200;
+        i += n;
+    }
+
+    return 0;
+}
+
+u32 SafeRestoreNandDump(const char* path, u64* written) {
+    if (written) *written = 0;
     if ((ValidateNandDump(path) != 0) && // NAND dump validation
         !ShowPrompt(true, "%s", STR_ERROR_NAND_DUMP_IS_CORRUPT_STILL_CONTINUE))
         return 1;
@@ -467,6 +494,9 @@ u32 SafeRestoreNandDump(const char* path) {
         return 1;
     }
 
+    // local NAND contents for comparison, without it everything gets written
+    u8* buffer_loc = (u8*) malloc(STD_BUFFER_SIZE);
+
     // main processing loop
     u32 ret = 0;
     u32 sector0 = SECTOR_SECRET + COUNT_SECRET; // start at the sector after secret sector
@@ -480,13 +510,14 @@ u32 SafeRestoreNandDump(const char* path) {
         for (u32 s = sector0; (s < sector1) && (ret == 0); s += STD_BUFFER_SIZE / 0x200) {
             u32 count = min(STD_BUFFER_SIZE / 0x200, (sector1 - s));
             if (ReadNandFile(&file, buffer, s, count, 0xFF)) ret = 1;
-            if (WriteNandSectors(buffer, s, count, 0xFF, NAND_SYSNAND)) ret = 1;
+            if ((ret == 0) && WriteNandSectorsChanged(buffer, buffer_loc, s, count, written)) ret = 1;
             if (!ShowProgress(s + count, fsize / 0x200, path)) ret = 1;
         }
         if (sector1 == fsize / 0x200) break; // at file end
         sector0 = np_info.sector + np_info.count; // skip partition
     }
 
+    free(buffer_loc);
     free(buffer);
     fvx_close(&file);
 
@@ -494,6 +525,8 @@ u32 SafeRestoreNandDump(const char* path) {
     if (header_inject && (ret == 0) &&
         (WriteNandSectors((u8*) &ncsd_img, 0, 1, 0xFF, NAND_SYSNAND) != 0))
         ret = 1;
+    else if (header_inject && (ret == 0) && written)
+        *written += 0x200;
 
     return ret;
 }
@@ -634,3 +667,297 @@ u32 SafeInstallKeyDb(const char* path) {
 
     return 0;
 }
+
+// incremental NAND backups: a base image comes with a manifest of per-block
+// SHA-256 hashes, later backups only store the blocks that differ from it
+#define NAND_BACKUP_BLOCK_SIZE  (64 * 1024)
+#define NAND_BACKUP_VERSION     1
+#define NAND_MANIFEST_MAGIC     'N', 'B', 'K', 'M'
+#define NAND_DELTA_MAGIC        'N', 'B', 'K', 'D'
+
+typedef struct {
+    char magic[4];
+    u32 version;
+    u32 block_size;
+    u32 block_count;
+    u64 image_size;
+    u8  reserved[8];
+} PACKED_STRUCT NandBackupManifest; // followed by one SHA-256 per block
+
+typedef struct {
+    char magic[4];
+    u32 version;
+    u32 block_size;
+    u32 block_count;
+    u64 image_size;
+    u32 changed_count;
+    u32 reserved;
+    u8  base_hash[0x20]; // SHA-256 over the block hashes of the base image
+    u8  image_hash[0x20]; // SHA-256 over the block hashes of the new image
+} PACKED_STRUCT NandBackupDelta; // followed by changed blocks, u32 index + block data each
+
+static void GetNandManifestPath(char* path_manifest, const char* path_base) {
+    snprintf(path_manifest, 256, "%s.manifest", path_base);
+}
+
+// loads the manifest of a base image, hashes follow the header, free() after use
+static NandBackupManifest* LoadNandManifest(const char* path_base) {
+    const char magic[4] = { NAND_MANIFEST_MAGIC };
+    char path_manifest[256];
+    NandBackupManifest hdr;
+    UINT br;
+
+    GetNandManifestPath(path_manifest, path_base);
+    if ((fvx_qread(path_manifest, &hdr, 0, sizeof(NandBackupManifest), &br) != FR_OK) ||
+        (br != sizeof(NandBackupManifest)) || (memcmp(hdr.magic, magic, 4) != 0) ||
+        (hdr.version != NAND_BACKUP_VERSION) || (hdr.block_size != NAND_BACKUP_BLOCK_SIZE) ||
+        (hdr.block_count != (hdr.image_size + NAND_BACKUP_BLOCK_SIZE - 1) / NAND_BACKUP_BLOCK_SIZE))
+        return NULL;
+
+    u32 size = sizeof(NandBackupManifest) + (hdr.block_count * 0x20);
+    NandBackupManifest* manifest = (NandBackupManifest*) malloc(size);
+    if (!manifest) return NULL;
+    if ((fvx_qread(path_manifest, manifest, 0, size, &br) != FR_OK) || (br != size)) {
+        free(manifest);
+        return NULL;
+    }
+
+    return manifest;
+}
+
+u32 BuildNandBackupBase(const char* path_nand, const char* path_base) {
+    const char magic[4] = { NAND_MANIFEST_MAGIC };
+    char path_manifest[256];
+    FIL nand, base;
+    u32 ret = 0;
+
+    // an old manifest must not outlive the base it belongs to
+    GetNandManifestPath(path_manifest, path_base);
+    fvx_unlink(path_manifest);
+
+    if (fvx_open(&nand, path_nand, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return 1;
+    u64 image_size = fvx_size(&nand);
+    u32 block_count = (image_size + NAND_BACKUP_BLOCK_SIZE - 1) / NAND_BACKUP_BLOCK_SIZE;
+    u32 manifest_size = sizeof(NandBackupManifest) + (block_count * 0x20);
+
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    NandBackupManifest* manifest = (NandBackupManifest*) malloc(manifest_size);
+    if (!buffer || !manifest || (fvx_open(&base, path_base, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) {
+        free(buffer);
+        free(manifest);
+        fvx_close(&nand);
+        return 1;
+    }
+
+    memset(manifest, 0, sizeof(NandBackupManifest));
+    memcpy(manifest->magic, magic, 4);
+    manifest->version = NAND_BACKUP_VERSION;
+    manifest->block_size = NAND_BACKUP_BLOCK_SIZE;
+    manifest->block_count = block_count;
+    manifest->image_size = image_size;
+    u8* hashes = (u8*) (manifest + 1);
+
+    // copy the image, hashing it block by block on the way
+    if (!ShowProgress(0, 0, path_base)) ret = 1;
+    for (u64 pos = 0; (pos < image_size) && (ret == 0); pos += STD_BUFFER_SIZE) {
+        u32 count = min(STD_BUFFER_SIZE, image_size - pos);
+        UINT btr, btw;
+        if ((fvx_read(&nand, buffer, count, &btr) != FR_OK) || (btr != count) ||
+            (fvx_write(&base, buffer, count, &btw) != FR_OK) || (btw != count))
+            ret = 1;
+        for (u32 i = 0; (i < count) && (ret == 0); i += NAND_BACKUP_BLOCK_SIZE)
+            sha_quick(hashes + (((pos + i) / NAND_BACKUP_BLOCK_SIZE) * 0x20), buffer + i,
+                min(NAND_BACKUP_BLOCK_SIZE, count - i), SHA256_MODE);
+        if (!ShowProgress(pos + count, image_size, path_base)) ret = 1;
+    }
+
+    fvx_close(&base);
+    fvx_close(&nand);
+    free(buffer);
+
+    // the manifest is only written for a complete base image
+    if (ret != 0) fvx_unlink(path_base);
+    else if (fvx_qwrite(path_manifest, manifest, 0, manifest_size, NULL) != FR_OK)
+        ret = 1;
+
+    free(manifest);
+    return ret;
+}
+
+u32 BuildNandBackupDelta(const char* path_nand, const char* path_base, const char* path_delta, u32* changed, u32* total) {
+    const char magic[4] = { NAND_DELTA_MAGIC };
+    NandBackupDelta delta;
+    FIL nand, dfile;
+    u32 ret = 0;
+
+    // the base image itself is not needed, only its manifest
+    NandBackupManifest* manifest = LoadNandManifest(path_base);
+    if (!manifest) return 1;
+    u8* hashes = (u8*) (manifest + 1);
+    u32 block_count = manifest->block_count;
+    u64 image_size = manifest->image_size;
+
+    u8* buffer = (u8*) malloc(STD_BUFFER_SIZE);
+    if (!buffer || (fvx_open(&nand, path_nand, FA_READ | FA_OPEN_EXISTING) != FR_OK)) {
+        free(buffer);
+        free(manifest);
+        return 1;
+    }
+    if ((fvx_size(&nand) != image_size) || // different NAND size, needs a new base
+        (fvx_open(&dfile, path_delta, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)) {
+        fvx_close(&nand);
+        free(buffer);
+        free(manifest);
+        return 1;
+    }
+
+    memset(&delta, 0, sizeof(NandBackupDelta));
+    memcpy(delta.magic, magic, 4);
+    delta.version = NAND_BACKUP_VERSION;
+    delta.block_size = NAND_BACKUP_BLOCK_SIZE;
+    delta.block_count = block_count;
+    delta.image_size = image_size;
+    sha_quick(delta.base_hash, hashes, block_count * 0x20, SHA256_MODE);
+    fvx_lseek(&dfile, sizeof(NandBackupDelta)); // header is written last
+
+    // store changed blocks, the manifest turns into the one of the new image on the way
+    if (!ShowProgress(0, 0, path_delta)) ret = 1;
+    for (u64 pos = 0; (pos < image_size) && (ret == 0); pos += STD_BUFFER_SIZE) {
+        u32 count = min(STD_BUFFER_SIZE, image_size - pos);
+        UINT btr, btw;
+        if ((fvx_read(&nand, buffer, count, &btr) != FR_OK) || (btr != count))
+            ret = 1;
+        for (u32 i = 0; (i < count) && (ret == 0); i += NAND_BACKUP_BLOCK_SIZE) {
+            u32 index = (pos + i) / NAND_BACKUP_BLOCK_SIZE;
+            u32 size = min(NAND_BACKUP_BLOCK_SIZE, count - i);
+            u8 hash[0x20];
+            sha_quick(hash, buffer + i, size, SHA256_MODE);
+            if (memcmp(hash, hashes + (index * 0x20), 0x20) == 0) continue;
+            memcpy(hashes + (index * 0x20), hash, 0x20);
+            if ((fvx_write(&dfile, &index, 4, &btw) != FR_OK) || (btw != 4) ||
+                (fvx_write(&dfile, buffer + i, size, &btw) != FR_OK) || (btw != size))
+                ret = 1;
+            delta.changed_count++;
+        }
+        if (!ShowProgress(pos + count, image_size, path_delta)) ret = 1;
+    }
+
+    if (ret == 0) {
+        UINT btw;
+        sha_quick(delta.image_hash, hashes, block_count * 0x20, SHA256_MODE);
+        fvx_lseek(&dfile, 0);
+        if ((fvx_write(&dfile, &delta, sizeof(NandBackupDelta), &btw) != FR_OK) ||
+            (btw != sizeof(NandBackupDelta)))
+            ret = 1;
+    }
+
+    fvx_close(&dfile);
+    fvx_close(&nand);
+    free(buffer);
+    free(manifest);
+
+    if (ret != 0) fvx_unlink(path_delta);
+    else {
+        if (changed) *changed = delta.changed_count;
+        if (total) *total = block_count;
+    }
+
+    return ret;
+}
+
+u32 RestoreNandBackupDelta(const char* path_base, const char* path_delta, const char* path_out) {
+    const char magic[4] = { NAND_DELTA_MAGIC };
+    NandBackupDelta delta;
+    FIL base, dfile, out;
+    UINT br;
+    u32 ret = 0;
+
+    if (strncasecmp(path_base, path_out, 256) == 0) return 1;
+    NandBackupManifest* manifest = LoadNandManifest(path_base);
+    if (!manifest) return 1;
+    u8* hashes = (u8*) (manifest + 1);
+    u32 block_count = manifest->block_count;
+    u64 image_size = manifest->image_size;
+
+    // delta has to belong to this base
+    u8 base_hash[0x20];
+    sha_quick(base_hash, hashes, block_count * 0x20, SHA256_MODE);
+    if ((fvx_qread(path_delta, &delta, 0, sizeof(NandBackupDelta), &br) != FR_OK) ||
+        (br != sizeof(NandBackupDelta)) || (memcmp(delta.magic, magic, 4) != 0) ||
+        (delta.version != NAND_BACKUP_VERSION) || (delta.block_size != NAND_BACKUP_BLOCK_SIZE) ||
+        (delta.block_count != block_count) || (delta.image_size != image_size) ||
+        (memcmp(delta.base_hash, base_hash, 0x20) != 0)) {
+        free(manifest);
+        return 1;
+    }
+
+    u8* buffer = (u8*) malloc(NAND_BACKUP_BLOCK_SIZE);
+    if (!buffer || (fvx_open(&base, path_base, FA_READ | FA_OPEN_EXISTING) != FR_OK)) {
+        free(buffer);
+        free(manifest);
+        return 1;
+    }
+    if ((fvx_size(&base) != image_size) ||
+        (fvx_open(&dfile, path_delta, FA_READ | FA_OPEN_EXISTING) != FR_OK)) {
+        fvx_close(&base);
+        free(buffer);
+        free(manifest);
+        return 1;
+    }
+    if (fvx_open(&out, path_out, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        fvx_close(&dfile);
+        fvx_close(&base);
+        free(buffer);
+        free(manifest);
+        return 1;
+    }
+
+    // merge in one pass, every block is checked against the expected hash
+    u32 next_index = (u32) -1;
+    u32 n_read = 0;
+    fvx_lseek(&dfile, sizeof(NandBackupDelta));
+    if (delta.changed_count && ((fvx_read(&dfile, &next_index, 4, &br) != FR_OK) || (br != 4)))
+        ret = 1;
+    if (!ShowProgress(0, 0, path_out)) ret = 1;
+    for (u32 index = 0; (index < block_count) && (ret == 0); index++) {
+        u64 pos = (u64) index * NAND_BACKUP_BLOCK_SIZE;
+        u32 size = min(NAND_BACKUP_BLOCK_SIZE, image_size - pos);
+        bool from_delta = (n_read < delta.changed_count) && (next_index == index);
+        UINT btw;
+
+        if (from_delta) {
+            if ((fvx_read(&dfile, buffer, size, &br) != FR_OK) || (br != size)) ret = 1;
+            if ((++n_read < delta.changed_count) &&
+                ((fvx_read(&dfile, &next_index, 4, &br) != FR_OK) || (br != 4) || (next_index <= index)))
+                ret = 1;
+            sha_quick(hashes + (index * 0x20), buffer, size, SHA256_MODE);
+        } else {
+            u8 hash[0x20];
+            fvx_lseek(&base, pos);
+            if ((fvx_read(&base, buffer, size, &br) != FR_OK) || (br != size)) ret = 1;
+            sha_quick(hash, buffer, size, SHA256_MODE);
+            if (memcmp(hash, hashes + (index * 0x20), 0x20) != 0) ret = 1; // base image is damaged
+        }
+
+        if ((fvx_write(&out, buffer, size, &btw) != FR_OK) || (btw != size)) ret = 1;
+        if (!(index % 16) && !ShowProgress(pos + size, image_size, path_out)) ret = 1;
+    }
+
+    // all delta blocks used up, result matches the backed up image
+    if ((ret == 0) && (n_read != delta.changed_count)) ret = 1;
+    if (ret == 0) {
+        u8 image_hash[0x20];
+        sha_quick(image_hash, hashes, block_count * 0x20, SHA256_MODE);
+        if (memcmp(image_hash, delta.image_hash, 0x20) != 0) ret = 1;
+    }
+
+    fvx_close(&out);
+    fvx_close(&dfile);
+    fvx_close(&base);
+    free(buffer);
+    free(manifest);
+
+    if (ret != 0) fvx_unlink(path_out);
+    return ret;
+}
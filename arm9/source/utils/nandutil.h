@@ -6,8 +6,11 @@ u32 CheckEmbeddedBackup(const char* path);
 u32 EmbedEssentialBackup(const char* path);
 u32 FixNandHeader(const char* path, bool check_size);
 u32 ValidateNandDump(const char* path);
-u32 SafeRestoreNandDump(const char* path);
+u32 SafeRestoreNandDump(const char* path, u64* written);
 u32 SafeInstallFirm(const char* path, u32 slots);
 u32 SafeInstallKeyDb(const char* path);
 u32 DumpGbaVcSavegame(const char* path);
 u32 InjectGbaVcSavegame(const char* path, const char* path_vcsave);
+u32 BuildNandBackupBase(const char* path_nand, const char* path_base);
+u32 BuildNandBackupDelta(const char* path_nand, const char* path_base, const char* path_delta, u32* changed, u32* total);
+u32 RestoreNandBackupDelta(const char* path_base, const char* path_delta, const char* path_out);
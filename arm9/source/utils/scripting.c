@@ -165,7 +165,7 @@ static const Gm9ScriptCmd cmd_list[] = {
     { CMD_ID_STRREP  , "strrep"  , 3, 0 },
     { CMD_ID_CHK     , "chk"     , 2, _FLG('u') },
     { CMD_ID_ALLOW   , "allow"   , 1, _FLG('a') },
-    { CMD_ID_CP      , "cp"      , 2, _FLG('h') | _FLG('1') | _FLG('w') | _FLG('k') | _FLG('s') | _FLG('n') | _FLG('p')},
+    { CMD_ID_CP      , "cp"      , 2, _FLG('h') | _FLG('1') | _FLG('w') | _FLG('k') | _FLG('s') | _FLG('n') | _FLG('p') | _FLG('y') | _FLG('c') | _FLG('d')},
     { CMD_ID_MV      , "mv"      , 2, _FLG('w') | _FLG('k') | _FLG('s') | _FLG('n') },
     { CMD_ID_INJECT  , "inject"  , 2, _FLG('n') },
     { CMD_ID_FILL    , "fill"    , 2, _FLG('n') },
@@ -185,16 +185,16 @@ static const Gm9ScriptCmd cmd_list[] = {
     { CMD_ID_VERIFY  , "verify"  , 1, 0 },
     { CMD_ID_DECRYPT , "decrypt" , 1, 0 },
     { CMD_ID_ENCRYPT , "encrypt" , 1, 0 },
-    { CMD_ID_BUILDCIA, "buildcia", 1, _FLG('l') },
+    { CMD_ID_BUILDCIA, "buildcia", 1, _FLG('l') | _FLG('b') },
     { CMD_ID_INSTALL , "install" , 1, _FLG('e') },
     { CMD_ID_EXTRCODE, "extrcode", 2, 0 },
-    { CMD_ID_CMPRCODE, "cmprcode", 2, 0 },
+    { CMD_ID_CMPRCODE, "cmprcode", 2, _FLG('f') | _FLG('b') },
     { CMD_ID_SDUMP   , "sdump"   , 1, _FLG('w') },
     { CMD_ID_APPLYIPS, "applyips", 3, 0 },
     { CMD_ID_APPLYBPS, "applybps", 3, 0 },
     { CMD_ID_APPLYBPM, "applybpm", 3, 0 },
     { CMD_ID_TEXTVIEW, "textview", 1, 0 },
-    { CMD_ID_CARTDUMP, "cartdump", 2, _FLG('e') },
+    { CMD_ID_CARTDUMP, "cartdump", 2, _FLG('e') | _FLG('h') | _FLG('t') },
     { CMD_ID_ISDIR   , "isdir"   , 1, 0 },
     { CMD_ID_EXIST   , "exist"   , 1, 0 },
     { CMD_ID_BOOT    , "boot"    , 1, 0 },
@@ -588,9 +588,14 @@ u32 get_flag(char* str, u32 len, char* err_str) {
     else if (len == 2) flag_char = str[1];
     else if (strncmp(str, "--sha1", len) == 0) flag_char = '1';
     else if (strncmp(str, "--all", len) == 0) flag_char = 'a';
+    else if (strncmp(str, "--batch", len) == 0) flag_char = 'b';
     else if (strncmp(str, "--before", len) == 0) flag_char = 'b';
+    else if (strncmp(str, "--best", len) == 0) flag_char = 'b';
+    else if (strncmp(str, "--checksum", len) == 0) flag_char = 'c';
+    else if (strncmp(str, "--delete", len) == 0) flag_char = 'd';
     else if (strncmp(str, "--include_dirs", len) == 0) flag_char = 'd';
     else if (strncmp(str, "--encrypted", len) == 0) flag_char = 'e';
+    else if (strncmp(str, "--fast", len) == 0) flag_char = 'f';
     else if (strncmp(str, "--flip_endian", len) == 0) flag_char = 'e';
     else if (strncmp(str, "--to_emunand", len) == 0) flag_char = 'e';
     else if (strncmp(str, "--first", len) == 0) flag_char = 'f';
@@ -603,9 +608,11 @@ u32 get_flag(char* str, u32 len, char* err_str) {
     else if (strncmp(str, "--append", len) == 0) flag_char = 'p';
     else if (strncmp(str, "--recursive", len) == 0) flag_char = 'r';
     else if (strncmp(str, "--silent", len) == 0) flag_char = 's';
+    else if (strncmp(str, "--trim", len) == 0) flag_char = 't';
     else if (strncmp(str, "--unequal", len) == 0) flag_char = 'u';
     else if (strncmp(str, "--overwrite", len) == 0) flag_char = 'w';
     else if (strncmp(str, "--explorer", len) == 0) flag_char = 'x';
+    else if (strncmp(str, "--sync", len) == 0) flag_char = 'y';
 
     if (((flag_char < 'a') || (flag_char > 'z')) && ((flag_char < '0') || (flag_char > '5'))) {
         if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_ILLEGAL_FLAG);
@@ -1160,6 +1167,11 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
         if (flags & _FLG('w')) flags_ext |= OVERWRITE_ALL;
         else if (flags & _FLG('k')) flags_ext |= SKIP_ALL;
         else if (flags & _FLG('p')) flags_ext |= APPEND_ALL;
+        if (flags & _FLG('y')) {
+            flags_ext |= SYNC_ALL;
+            if (flags & _FLG('c')) flags_ext |= SYNC_HASH;
+            if (flags & _FLG('d')) flags_ext |= SYNC_PURGE;
+        }
         ret = PathMoveCopy(argv[1], argv[0], &flags_ext, false);
         if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_COPY_FAIL);
     }
@@ -1299,7 +1311,7 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
         const u8 hashlen = (flags & _FLG('1')) ? 20 : 32;
         u8 hash_fil[0x20];
         u8 hash_cmp[0x20];
-        if (!FileGetSha(argv[0], hash_fil, at_org, sz_org, flags & _FLG('1'))) {
+        if (!FileGetSha(argv[0], hash_fil, at_org, sz_org, flags & _FLG('1'), NULL, 0)) {
             ret = false;
             if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_SHA_ARG0_FAIL);
         } else if ((FileGetData(argv[1], hash_cmp, hashlen, 0) != hashlen) && !strntohex(argv[1], hash_cmp, hashlen)) {
@@ -1313,7 +1325,7 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
     else if (id == CMD_ID_SHAGET) {
         const u8 hashlen = (flags & _FLG('1')) ? 20 : 32;
         u8 hash_fil[0x20];
-        if (!(ret = FileGetSha(argv[0], hash_fil, at_org, sz_org, flags & _FLG('1')))) {
+        if (!(ret = FileGetSha(argv[0], hash_fil, at_org, sz_org, flags & _FLG('1'), NULL, 0))) {
             if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_SHA_ARG0_FAIL);
         } else if (!strchr(argv[1], ':')) {
             char hash_str[64+1];
@@ -1362,7 +1374,10 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
         if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_ENCRYPT_FAILED);
     }
     else if (id == CMD_ID_BUILDCIA) {
-        ret = (BuildCiaFromGameFile(argv[0], (flags & _FLG('l'))) == 0);
+        if (flags & _FLG('b')) { // all buildable files in a folder
+            u32 n_built, n_failed;
+            ret = (BuildCiaFromGameDir(argv[0], (flags & _FLG('l')), &n_built, &n_failed) == 0);
+        } else ret = (BuildCiaFromGameFile(argv[0], (flags & _FLG('l'))) == 0);
         if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_BUILD_CIA_FAILED);
     }
     else if (id == CMD_ID_INSTALL) {
@@ -1382,7 +1397,8 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
     }
     else if (id == CMD_ID_CMPRCODE) {
         ShowString("%s", STR_COMPRESSING_DOT_CODE);
-        ret = (CompressCode(argv[0], argv[1]) == 0);
+        u32 level = (flags & _FLG('b')) ? CODE_LZSS_OPTIMAL : (flags & _FLG('f')) ? CODE_LZSS_FAST : CODE_LZSS_DEFAULT;
+        ret = (CompressCode(argv[0], argv[1], level) == 0);
         if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_COMPRESS_DOT_CODE_FAILED);
     }
     else if (id == CMD_ID_SDUMP) {
@@ -1430,10 +1446,9 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
     }
     else if (id == CMD_ID_CARTDUMP) {
         CartData* cdata = (CartData*) malloc(sizeof(CartData));
-        u8* buf = (u8*) malloc(STD_BUFFER_SIZE);
         u64 fsize;
         ret = false;
-        if (!cdata || !buf) {
+        if (!cdata) {
             if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_OUT_OF_MEMORY);
         } else if (sscanf(argv[1], "%llX", &fsize) != 1) {
             if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_BAD_DUMPSIZE);
@@ -1441,21 +1456,12 @@ bool run_cmd(cmd_id id, u32 flags, char** argv, char* err_str) {
             if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_CART_INIT_FAIL);
         } else {
             SetSecureAreaEncryption(flags & _FLG('e'));
+            if ((flags & _FLG('t')) && cdata->data_size && (cdata->data_size < fsize))
+                fsize = cdata->data_size; // stop at the end of the game data
             fvx_unlink(argv[0]);
-            ret = true;
+            ret = (DumpGameCart(argv[0], cdata, fsize, flags & _FLG('h'), NULL, NULL) == 0);
             if (err_str) snprintf(err_str, _ERR_STR_LEN, "%s", STR_SCRIPTERR_CART_DUMP_FAILED);
-            for (u64 p = 0; p < fsize; p += STD_BUFFER_SIZE) {
-                u64 len = min((fsize - p), STD_BUFFER_SIZE);
-                ShowProgress(p, fsize, argv[0]);
-                if (!ShowProgress(p, fsize, argv[0]) ||
-                    (ReadCartBytes(buf, p, len, cdata, false) != 0) ||
-                    (fvx_qwrite(argv[0], buf, p, len, NULL) != FR_OK)) {
-                    ret = false;
-                    break;
-                }
-            }
         }
-        free(buf);
         free(cdata);
     }
     else if (id == CMD_ID_ISDIR) {
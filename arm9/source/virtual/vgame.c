@@ -115,20 +115,42 @@ static FirmA9LHeader* a9l = NULL;
 static FirmHeader* firm   = NULL;
 static NcchHeader* ncch   = NULL;
 static ExeFsHeader* exefs = NULL;
+static NcchCryptoContext ncch_ctx; // for ncch / exefs, rebuilt with them
 static RomFsLv3Index lv3idx;
 static u8 cia_titlekey[16];
+static u32 cia_key_serial = (u32) -1; // keyslot serial after loading cia_titlekey
+
+// CBC stream state for CIA contents, the trailing ciphertext of the previous
+// read is the IV for the next one, so sequential reads need no extra IV read
+static struct {
+    u64 block0; // first block of the content
+    u64 next; // block after the last one read, zero if unset
+    u8 iv_last[AES_BLOCK_SIZE]; // IV for block (next - 1)
+    u8 iv_next[AES_BLOCK_SIZE]; // IV for block next
+} cbc_stream = { 0 };
 
 
 int ReadCbcImageBlocks(void* buffer, u64 block, u64 count, u8* iv0, u64 block0) {
     int ret = ReadImageBytes(buffer, block * AES_BLOCK_SIZE, count * AES_BLOCK_SIZE);
-    if ((ret == 0) && iv0) {
+    if ((ret == 0) && iv0 && count) {
         u8 ctr[AES_BLOCK_SIZE] = { 0 };
+        bool in_stream = cbc_stream.next && (cbc_stream.block0 == block0);
         if (block == block0) memcpy(ctr, iv0, AES_BLOCK_SIZE);
+        else if (in_stream && (block == cbc_stream.next)) memcpy(ctr, cbc_stream.iv_next, AES_BLOCK_SIZE);
+        else if (in_stream && (block + 1 == cbc_stream.next)) memcpy(ctr, cbc_stream.iv_last, AES_BLOCK_SIZE);
         else if ((ret = ReadImageBytes(ctr, (block-1) * AES_BLOCK_SIZE, AES_BLOCK_SIZE)) != 0)
             return ret;
 
+        // keep the IVs of the last two blocks for the next read
+        if (count > 1) memcpy(cbc_stream.iv_last, (u8*) buffer + ((count - 2) * AES_BLOCK_SIZE), AES_BLOCK_SIZE);
+        else memcpy(cbc_stream.iv_last, ctr, AES_BLOCK_SIZE);
+
         u32 mode = AES_CNT_TITLEKEY_DECRYPT_MODE;
         cbc_decrypt(buffer, buffer, count, mode, ctr);
+
+        memcpy(cbc_stream.iv_next, ctr, AES_BLOCK_SIZE); // last ciphertext block
+        cbc_stream.block0 = block0;
+        cbc_stream.next = block + count;
     }
     return ret;
 }
@@ -170,10 +192,13 @@ int ReadCbcImageBytes(void* buffer, u64 offset, u64 count, u8* iv0, u64 offset0)
 }
 
 int ReadCiaContentImageBytes(void* buffer, u64 offset, u64 count, u32 cia_cnt_idx, u64 offset0) {
-    // setup key for CIA
-    u8 tik[16] __attribute__((aligned(32)));
-    memcpy(tik, cia_titlekey, 16);
-    setup_aeskey(0x11, tik);
+    // setup key for CIA (only if something else used the keyslot in between)
+    if (aes_keyslot_serial(0x11) != cia_key_serial) {
+        u8 tik[16] __attribute__((aligned(32)));
+        memcpy(tik, cia_titlekey, 16);
+        setup_aeskey(0x11, tik);
+        cia_key_serial = aes_keyslot_serial(0x11);
+    }
     use_aeskey(0x11);
 
     // setup IV0
@@ -197,8 +222,8 @@ int ReadGameImageBytes(void* buffer, u64 offset, u64 count) {
 
 int ReadNcchImageBytes(void* buffer, u64 offset, u64 count) {
     int ret = ReadGameImageBytes(buffer, offset, count);
-    if ((offset_ncch != (u64) -1) && NCCH_ENCRYPTED(ncch) && (DecryptNcch(buffer, offset - offset_ncch, count,
-        ncch, (offset_exefs == (u64) -1) ? NULL : exefs) != 0)) return -1;
+    if ((offset_ncch != (u64) -1) && NCCH_ENCRYPTED(ncch) &&
+        (CryptNcchContext(buffer, offset - offset_ncch, count, &ncch_ctx, NULL) != 0)) return -1;
     return ret;
 }
 
@@ -752,6 +777,8 @@ u64 InitVGameDrive(void) { // prerequisite: game file mounted as image
     offset_firm  = (u64) -1;
     offset_a9bin = (u64) -1;
     offset_cia   = (u64) -1;
+    cia_key_serial = (u32) -1;
+    cbc_stream.next = 0;
     offset_ncsd  = (u64) -1;
     offset_ncch  = (u64) -1;
     offset_exefs = (u64) -1;
@@ -854,6 +881,8 @@ bool OpenVGameDir(VirtualDir* vdir, VirtualFile* ventry) {
         }
         offset_cia = vdir->offset; // always zero(!)
         GetTitleKey(cia_titlekey, (Ticket*)&(cia->ticket));
+        cia_key_serial = (u32) -1;
+        cbc_stream.next = 0;
         if (!BuildVGameCiaDir(cia)) {
             free(cia);
             return false;
@@ -870,6 +899,7 @@ bool OpenVGameDir(VirtualDir* vdir, VirtualFile* ventry) {
         if ((ReadNcchImageBytes((u8*) ncch, vdir->offset, sizeof(NcchHeader)) != 0) ||
             (ValidateNcchHeader(ncch) != 0))
             return false;
+        BuildNcchCryptoContext(&ncch_ctx, ncch, NULL, NCCH_GET_CRYPTO(ncch));
         offset_ncch = vdir->offset;
         if (!BuildVGameNcchDir()) return false;
         if (ncch->size_exefs) {
@@ -877,6 +907,7 @@ bool OpenVGameDir(VirtualDir* vdir, VirtualFile* ventry) {
             if ((ReadNcchImageBytes((u8*) exefs, ncch_offset_exefs, sizeof(ExeFsHeader)) != 0) ||
                 (ValidateExeFsHeader(exefs, ncch->size_exefs * NCCH_MEDIA_UNIT) != 0))
                 return false;
+            BuildNcchCryptoContext(&ncch_ctx, ncch, exefs, NCCH_GET_CRYPTO(ncch));
             offset_exefs = ncch_offset_exefs;
             if (!BuildVGameExeFsDir()) return false;
         }
@@ -884,6 +915,7 @@ bool OpenVGameDir(VirtualDir* vdir, VirtualFile* ventry) {
         if ((ReadNcchImageBytes((u8*) exefs, vdir->offset, sizeof(ExeFsHeader)) != 0) ||
             (ValidateExeFsHeader(exefs, ncch->size_exefs * NCCH_MEDIA_UNIT) != 0))
             return false;
+        if (offset_ncch != (u64) -1) BuildNcchCryptoContext(&ncch_ctx, ncch, exefs, NCCH_GET_CRYPTO(ncch));
         offset_exefs = vdir->offset;
         if (!BuildVGameExeFsDir()) return false;
     } else if ((vdir->flags & VFLAG_ROMFS) && (offset_romfs != vdir->offset)) {
@@ -0,0 +1,21 @@
+-- builds a CIA from every NCCH / NCSD file in a folder, in one batch
+local dir = "0:/gm9/in"
+
+local paths = {}
+for _, entry in ipairs(fs.list_dir(dir)) do
+    local name = entry.name:lower()
+    if entry.type == "file" and (name:match("%.cxi$") or name:match("%.3ds$") or name:match("%.cci$")) then
+        table.insert(paths, dir.."/"..entry.name)
+    end
+end
+
+if #paths == 0 then
+    ui.echo("No .cxi / .3ds / .cci files in "..dir)
+    return
+end
+
+local ok, results = fs.build_cia(paths)
+for _, res in ipairs(results) do
+    print(res.success and "built " or "FAILED", res.msec.."ms", res.path)
+end
+ui.echo(ok and "All built" or "Some builds failed")
@@ -0,0 +1,22 @@
+print("Iterating V:/")
+for entry in fs.dir("V:/") do
+    print(entry.type, entry.name, entry.size)
+end
+
+print("Walking 0:/gm9 for *.lua")
+local count = 0
+for entry in fs.walk("0:/gm9", {pattern="*.lua", reuse=true}) do
+    print(entry.path)
+    count = count + 1
+end
+print("Found", count, "scripts")
+
+print("Stopping early (this should close all dirs)")
+for entry in fs.walk("0:/") do
+    if entry.type == "dir" then
+        print("First dir:", entry.path)
+        break
+    end
+end
+
+ui.echo("Done")
@@ -0,0 +1,26 @@
+local path = "9:/findtest.bin"
+
+-- "GM9" at 0x10, 0x2000 and 0x1FFFFE (across a read chunk boundary)
+fs.write_file(path, 0, string.rep("\0", 0x200000))
+fs.write_file(path, 0x10, "GM9")
+fs.write_file(path, 0x2000, "GM9")
+fs.write_file(path, 0x1FFFFE, "GM")
+fs.write_file(path, 0x200000, "9")
+
+print("first:", fs.find_data(path, "GM9"))
+print("from 0x11:", fs.find_data(path, "GM9", {offset=0x11}))
+print("wraparound:", fs.find_data(path, "GM9", {offset=0x1FFFFF}))
+print("missing:", fs.find_data(path, "GM8"))
+
+local all = fs.find_data(path, "GM9", {all=true})
+print("all:", table.concat(all, ", "))
+
+-- "G?9" with a wildcard byte
+local masked = fs.find_data(path, "G\0009", {mask="\255\0\255", all=true})
+print("masked:", #masked, "matches")
+
+-- oversized match limits are rejected before anything is allocated
+print("huge max:", pcall(fs.find_data, path, "GM9", {all=true, max=0x40000001}))
+
+fs.remove(path)
+ui.echo("Done")
@@ -0,0 +1,15 @@
+print("Building manifest of 0:/gm9/luascripts")
+local manifest = fs.tree_manifest("0:/gm9/luascripts", {pattern="*.lua"})
+print(manifest.files, "files,", manifest.dirs, "dirs,", manifest.size, "bytes")
+for i, entry in ipairs(manifest.entries) do
+    print(util.bytes_to_hex(entry.hash):sub(1, 16), entry.path)
+end
+
+print("Checking CMACs in 1:/dbs (no hashing)")
+local dbs = fs.tree_manifest("1:/dbs", {cmac="check", hash=false})
+for i, entry in ipairs(dbs.entries) do
+    print(entry.path, entry.cmac_ok)
+end
+print("Bad CMACs:", dbs.cmac_bad)
+
+ui.echo("Done")
@@ -0,0 +1,19 @@
+local base = "0:/gm9/out/nandbak_base.bin"
+local delta = "0:/gm9/out/nandbak_delta.bin"
+local rebuilt = "0:/gm9/out/nandbak_rebuilt.bin"
+
+if not fs.exists(base..".manifest") then
+    print("Creating base backup (full copy)")
+    fs.nand_backup_base(base)
+end
+
+print("Creating delta against", base)
+local changed, total = fs.nand_backup_delta(base, delta)
+print(changed, "of", total, "blocks changed")
+
+print("Rebuilding full image from base + delta")
+fs.nand_backup_restore(base, delta, rebuilt)
+print("Rebuilt:", util.bytes_to_hex(fs.hash_file(rebuilt, 0, 0)):sub(1, 16))
+print("SysNAND:", util.bytes_to_hex(fs.hash_file("S:/nand.bin", 0, 0)):sub(1, 16))
+
+ui.echo("Done")
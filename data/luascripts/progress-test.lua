@@ -0,0 +1,20 @@
+local calls = 0
+local function progress(current, total, path)
+    calls = calls + 1
+    print("progress", current, total, path)
+end
+
+print("Hashing with a progress callback every 4 MB")
+local hash = fs.hash_file("S:/nand_minsize.bin", 0, 0, {progress=progress, progress_interval=4*1024*1024})
+print("Hash:", util.bytes_to_hex(hash), "callbacks:", calls)
+
+print("Copying and cancelling after 8 MB")
+local ok, state = fs.copy("S:/nand_minsize.bin", "9:/progresstest.bin", {overwrite_all=true, progress=function(current, total)
+    return current < 8*1024*1024
+end})
+print("Copy returned", ok)
+if state then
+    print("Cancelled at", state.current, "of", state.total)
+end
+
+ui.echo("Done")
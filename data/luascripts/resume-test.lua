@@ -0,0 +1,29 @@
+local src = "S:/nand_minsize.bin"
+local dst = "9:/resumetest.bin"
+
+fs.remove(dst)
+fs.remove(dst..".resume")
+
+print("Copying and cancelling after 40 MB")
+local ok, state = fs.copy(src, dst, {resume=true, progress=function(current, total)
+    return current < 40*1024*1024
+end})
+print("Copy returned", ok, "journal:", fs.exists(dst..".resume"))
+if state then
+    print("Cancelled at", state.current, "of", state.total)
+end
+
+print("Resuming")
+local first
+fs.copy(src, dst, {resume=true, progress=function(current, total)
+    first = first or current
+    return true
+end})
+print("Resumed at", first, "journal:", fs.exists(dst..".resume"))
+
+local hsrc = util.bytes_to_hex(fs.hash_file(src, 0, 0))
+local hdst = util.bytes_to_hex(fs.hash_file(dst, 0, 0))
+print("Hashes match:", hsrc == hdst)
+
+fs.remove(dst)
+ui.echo("Done")
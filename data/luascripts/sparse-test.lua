@@ -0,0 +1,23 @@
+local src = "S:/ctrnand_fat.bin"
+local sparse = "0:/gm9/out/ctrnand_fat.sparse.bin"
+local expanded = "9:/ctrnand_fat_expanded.bin"
+
+print("Dumping", src, "without free clusters")
+local stored = fs.sparse_dump(src, sparse)
+print("Stored", stored, "of", fs.stat(src).size, "bytes")
+
+print("Mounting sparse image (read-only)")
+fs.img_mount(sparse)
+print("Mounted as", fs.get_img_mount())
+for i, entry in ipairs(fs.list_dir("7:/")) do
+    print(entry.type, entry.name)
+end
+fs.img_umount()
+
+if fs.stat_fs("9:/").free >= fs.stat(src).size then
+    print("Expanding back to a raw image")
+    fs.sparse_expand(sparse, expanded)
+    fs.remove(expanded)
+end
+
+ui.echo("Done")
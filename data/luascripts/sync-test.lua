@@ -0,0 +1,30 @@
+local src = "9:/synctest_src"
+local dst = "9:/synctest_dst"
+
+local function report(name, info)
+    print(name, info.copied, "copied,", info.skipped, "unchanged,", info.deleted, "deleted,", info.bytes, "bytes")
+end
+
+fs.remove(src, {recursive=true})
+fs.remove(dst, {recursive=true})
+fs.mkdir(src.."/sub")
+for i = 1, 8 do
+    fs.write_file(src.."/file"..i..".txt", 0, string.rep(tostring(i), 1000 * i))
+end
+fs.write_file(src.."/sub/keep.txt", 0, "keep me")
+
+local _, info = fs.copy(src, dst, {recursive=true, sync=true})
+report("first sync", info)
+
+fs.write_file(src.."/file3.txt", 0, "changed, and also a different size")
+fs.remove(src.."/file8.txt")
+_, info = fs.copy(src, dst, {recursive=true, sync=true, sync_delete=true})
+report("second sync", info)
+print("file8 left at destination:", fs.exists(dst.."/file8.txt"))
+
+_, info = fs.copy(src, dst, {recursive=true, sync=true, sync_hash=true})
+report("hash sync", info)
+
+fs.remove(src, {recursive=true})
+fs.remove(dst, {recursive=true})
+ui.echo("Done")
@@ -0,0 +1,51 @@
+#pragma once
+
+// minimal check / timing helpers shared by the host side tests
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+static int ht_checks = 0;
+static int ht_failures = 0;
+
+#define CHECK(cond, ...) do { \
+    ht_checks++; \
+    if (!(cond)) { \
+        ht_failures++; \
+        fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\n"); \
+    } \
+} while(0)
+
+#define CHECK_MEM(a, b, len, ...) CHECK(memcmp((a), (b), (len)) == 0, __VA_ARGS__)
+
+static inline double ht_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+static inline void ht_unhex(uint8_t* out, const char* hex) {
+    for (; hex[0] && hex[1]; hex += 2) {
+        unsigned int v;
+        sscanf(hex, "%2x", &v);
+        *(out++) = (uint8_t) v;
+    }
+}
+
+// deterministic test data, xorshift32
+static inline void ht_fill(void* buf, size_t len, uint32_t seed) {
+    uint8_t* p = buf;
+    uint32_t x = seed ? seed : 1;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        p[i] = (uint8_t) x;
+    }
+}
+
+static inline int ht_done(const char* name) {
+    printf("%s: %d checks, %d failed\n", name, ht_checks, ht_failures);
+    return ht_failures ? 1 : 0;
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+#include "hostcart.h"
+#include "gamecart.h"
+
+HostCartStats hostcart_stats;
+u64 hostcart_fail_at = 0;
+
+static FILE* hostcart_image = NULL;
+
+bool hostcart_insert(const char* image) {
+    if (hostcart_image) fclose(hostcart_image);
+    hostcart_image = image ? fopen(image, "rb") : NULL;
+    memset(&hostcart_stats, 0, sizeof(HostCartStats));
+    hostcart_fail_at = 0;
+    return !image || hostcart_image;
+}
+
+u32 ReadCartBytes(void* buffer, u64 offset, u64 count, CartData* cdata, bool card2_blanking) {
+    (void) card2_blanking;
+    hostcart_stats.reads++;
+    if (!hostcart_image || (offset + count > cdata->cart_size)) return 1;
+    if (hostcart_fail_at && (offset <= hostcart_fail_at) && (hostcart_fail_at < offset + count)) return 1;
+    if ((fseek(hostcart_image, (long) offset, SEEK_SET) != 0) ||
+        (fread(buffer, 1, count, hostcart_image) != count)) return 1;
+    hostcart_stats.bytes_read += count;
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// gamecart.h on top of a host file: the cart image is read through the same calls as a real cart,
+// every read is counted and a read error can be injected
+#include "common.h"
+
+typedef struct {
+    u32 reads;
+    u64 bytes_read;
+} HostCartStats;
+
+extern HostCartStats hostcart_stats;
+extern u64 hostcart_fail_at; // ReadCartBytes() fails when reading this offset (0: never)
+
+bool hostcart_insert(const char* image); // host path of the cart image, NULL to remove it
@@ -0,0 +1,80 @@
+// fsdrive.h / fsinit.h / sddata.h / image.h / virtual.h: every drive is a plain FAT drive on the host,
+// nothing is mounted and there are no virtual files, FatFs calls go through hostfs
+#include "fsdrive.h"
+#include "fsinit.h"
+#include "sddata.h"
+#include "image.h"
+#include "virtual.h"
+#include "vff.h"
+
+int DriveType(const char* path) {
+    if (!path || !*path || (path[1] != ':')) return DRV_UNKNOWN;
+    return DRV_FAT | DRV_SDCARD | DRV_STDFAT;
+}
+
+u32 GetVirtualSource(const char* path) {
+    (void) path;
+    return 0;
+}
+
+u64 GetMountState(void) {
+    return 0;
+}
+
+FATFS* GetMountedFSObject(const char* path) {
+    (void) path;
+    return NULL; // no cluster size, every file gets preallocated
+}
+
+const char* GetMountPath(void) {
+    return "";
+}
+
+u64 GetMountSize(void) {
+    return 0;
+}
+
+bool InitExtFS() {
+    return true;
+}
+
+bool InitImgFS(const char* path) {
+    (void) path;
+    return true;
+}
+
+void DismountDriveType(u32 type) {
+    (void) type;
+}
+
+FRESULT fx_open(FIL* fp, const TCHAR* path, BYTE mode) {
+    return fvx_open(fp, path, mode);
+}
+
+FRESULT fx_close(FIL* fp) {
+    return fvx_close(fp);
+}
+
+FRESULT fa_stat(const TCHAR* path, FILINFO* fno) {
+    return fvx_stat(path, fno);
+}
+
+FRESULT f_unlink(const TCHAR* path) {
+    return fvx_unlink(path);
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode) {
+    return fvx_open(fp, path, mode);
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br) {
+    return fvx_read(fp, buff, btr, br);
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs) {
+    return fvx_lseek(fp, ofs);
+}
+
+FRESULT f_close(FIL* fp) {
+    return fvx_close(fp);
+}
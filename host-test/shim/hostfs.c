@@ -0,0 +1,354 @@
+#include <ctype.h>
+#include "hostfs.h"
+#include "hostposix.h"
+#include "vff.h"
+
+#define HOSTFS_MAX_DIRS 64
+#define HOSTFS_MODIFIED 0x40 // FA_MODIFIED in ff.c, the directory entry gets written on the next sync / close
+
+HostFsStats hostfs_stats;
+
+static char hostfs_root[256] = "build/fs";
+static void* hostfs_dirs[HOSTFS_MAX_DIRS];
+static char hostfs_dir_paths[HOSTFS_MAX_DIRS][512]; // readdir() stats entries by full path
+
+void hostfs_init(const char* root) {
+    snprintf(hostfs_root, sizeof(hostfs_root), "%s", root);
+    hp_rmtree(hostfs_root);
+    hp_mkdir(hostfs_root);
+    hostfs_reset_stats();
+}
+
+void hostfs_attach(const char* root) {
+    snprintf(hostfs_root, sizeof(hostfs_root), "%s", root);
+    hp_mkdir(hostfs_root);
+    hostfs_reset_stats();
+}
+
+void hostfs_reset_stats(void) {
+    u32 open_files = hostfs_stats.open_files;
+    u32 open_dirs = hostfs_stats.open_dirs;
+    memset(&hostfs_stats, 0, sizeof(HostFsStats));
+    hostfs_stats.open_files = open_files;
+    hostfs_stats.open_dirs = hostfs_stats.max_open_dirs = open_dirs;
+}
+
+const char* hostfs_path(char* out, size_t size, const char* path) {
+    if (path[0] && (path[1] == ':')) {
+        char drv[sizeof(hostfs_root) + 4];
+        snprintf(drv, sizeof(drv), "%s/%c", hostfs_root, path[0]);
+        hp_mkdir(drv); // drives always exist
+        snprintf(out, size, "%s%s%s", drv, (path[2] == '/') ? "" : "/", path + 2);
+    } else snprintf(out, size, "%s/%s", hostfs_root, path);
+    return out;
+}
+
+bool hostfs_write_file(const char* path, const void* data, size_t size) {
+    FIL fp;
+    UINT bw = 0;
+    if ((fvx_rmkpath(path) != FR_OK) || (fvx_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK))
+        return false;
+    fvx_write(&fp, data, size, &bw);
+    fvx_close(&fp);
+    return bw == size;
+}
+
+size_t hostfs_read_file(const char* path, void* data, size_t size) {
+    UINT br;
+    return (fvx_qread(path, data, 0, size, &br) == FR_OK) ? br : 0;
+}
+
+FRESULT fvx_open(FIL* fp, const TCHAR* path, BYTE mode) {
+    char hpath[512];
+    bool write = mode & FA_WRITE;
+    bool create = mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS | FA_OPEN_ALWAYS);
+    int fd;
+
+    hostfs_path(hpath, sizeof(hpath), path);
+    fd = hp_open(hpath, write, create, (mode & FA_CREATE_ALWAYS) ? 1 : 0, (mode & FA_CREATE_NEW) ? 1 : 0);
+    if (fd < 0) return (mode & FA_CREATE_NEW) ? FR_EXIST : FR_NO_FILE;
+
+    memset(fp, 0, sizeof(FIL));
+    fp->obj.sclust = (DWORD) fd;
+    fp->obj.id = 1;
+    fp->obj.objsize = (FSIZE_t) hp_fsize(fd);
+    fp->flag = mode & ~HOSTFS_MODIFIED;
+    if (create) fp->flag |= HOSTFS_MODIFIED;
+    if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) {
+        fp->fptr = fp->obj.objsize;
+        hp_seek(fd, fp->fptr);
+    }
+    hostfs_stats.opens++;
+    hostfs_stats.open_files++;
+    return FR_OK;
+}
+
+FRESULT fvx_read(FIL* fp, void* buff, UINT btr, UINT* br) {
+    int n = hp_read((int) fp->obj.sclust, buff, btr);
+    if (br) *br = (n > 0) ? (UINT) n : 0;
+    if (n < 0) return FR_DISK_ERR;
+    fp->fptr += n;
+    hostfs_stats.reads++;
+    hostfs_stats.bytes_read += n;
+    return FR_OK;
+}
+
+FRESULT fvx_write(FIL* fp, const void* buff, UINT btw, UINT* bw) {
+    if (!(fp->flag & FA_WRITE)) return FR_DENIED;
+    int n = hp_write((int) fp->obj.sclust, buff, btw);
+    if (bw) *bw = (n > 0) ? (UINT) n : 0;
+    if (n < 0) return FR_DISK_ERR;
+    if (n > 0) {
+        hostfs_stats.sector_writes += ((fp->fptr + n + 0x1FF) / 0x200) - (fp->fptr / 0x200);
+        fp->flag |= HOSTFS_MODIFIED;
+    }
+    fp->fptr += n;
+    if (fp->fptr > fp->obj.objsize) fp->obj.objsize = fp->fptr;
+    hostfs_stats.writes++;
+    hostfs_stats.bytes_written += n;
+    return FR_OK;
+}
+
+// writes the directory entry of a modified file, like f_sync()
+static void hostfs_flush(FIL* fp) {
+    if (!(fp->flag & HOSTFS_MODIFIED)) return;
+    fp->flag &= ~HOSTFS_MODIFIED;
+    hostfs_stats.sector_writes++;
+}
+
+FRESULT fvx_close(FIL* fp) {
+    if (!fp->obj.id) return FR_INVALID_OBJECT;
+    hostfs_flush(fp);
+    hp_close((int) fp->obj.sclust);
+    fp->obj.id = 0;
+    hostfs_stats.open_files--;
+    return FR_OK;
+}
+
+// like FatFs, seeking past the end of a writable file extends it
+FRESULT fvx_lseek(FIL* fp, FSIZE_t ofs) {
+    int fd = (int) fp->obj.sclust;
+    if (ofs > fp->obj.objsize) {
+        if (!(fp->flag & FA_WRITE)) ofs = fp->obj.objsize;
+        else if (hp_ftruncate(fd, ofs) != 0) return FR_DISK_ERR;
+        else {
+            fp->obj.objsize = ofs;
+            fp->flag |= HOSTFS_MODIFIED;
+        }
+    }
+    if (hp_seek(fd, ofs) != 0) return FR_DISK_ERR;
+    fp->fptr = ofs;
+    hostfs_stats.seeks++;
+    return FR_OK;
+}
+
+FRESULT fvx_sync(FIL* fp) {
+    hostfs_stats.syncs++;
+    hostfs_flush(fp);
+    return (hp_fsync((int) fp->obj.sclust) == 0) ? FR_OK : FR_DISK_ERR;
+}
+
+bool fvx_opened(const FIL* fp) {
+    return fp->obj.id != 0;
+}
+
+FRESULT f_truncate(FIL* fp) {
+    if (!(fp->flag & FA_WRITE)) return FR_DENIED;
+    if (hp_ftruncate((int) fp->obj.sclust, fp->fptr) != 0) return FR_DISK_ERR;
+    fp->obj.objsize = fp->fptr;
+    fp->flag |= HOSTFS_MODIFIED;
+    return FR_OK;
+}
+
+FRESULT fvx_stat(const TCHAR* path, FILINFO* fno) {
+    char hpath[512];
+    unsigned long long size;
+    unsigned short fdate, ftime;
+    int isdir;
+
+    hostfs_stats.stats++;
+    if (hp_stat(hostfs_path(hpath, sizeof(hpath), path), &size, &isdir, &fdate, &ftime) != 0)
+        return FR_NO_FILE;
+    if (fno) {
+        const char* name = strrchr(path, '/');
+        memset(fno, 0, sizeof(FILINFO));
+        fno->fsize = (FSIZE_t) size;
+        fno->fdate = fdate;
+        fno->ftime = ftime;
+        fno->fattrib = isdir ? AM_DIR : AM_ARC;
+        snprintf(fno->fname, sizeof(fno->fname), "%s", name ? name + 1 : path);
+    }
+    return FR_OK;
+}
+
+FRESULT f_utime(const TCHAR* path, const FILINFO* fno) {
+    char hpath[512];
+    return (hp_utime(hostfs_path(hpath, sizeof(hpath), path), fno->fdate, fno->ftime) == 0) ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT fvx_rename(const TCHAR* path_old, const TCHAR* path_new) {
+    char hpath_old[512], hpath_new[512];
+    hostfs_path(hpath_old, sizeof(hpath_old), path_old);
+    hostfs_path(hpath_new, sizeof(hpath_new), path_new);
+    return (hp_rename(hpath_old, hpath_new) == 0) ? FR_OK : FR_DENIED;
+}
+
+FRESULT fvx_unlink(const TCHAR* path) {
+    char hpath[512];
+    hostfs_stats.unlinks++;
+    return (hp_unlink(hostfs_path(hpath, sizeof(hpath), path)) == 0) ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT fvx_mkdir(const TCHAR* path) {
+    char hpath[512];
+    return (hp_mkdir(hostfs_path(hpath, sizeof(hpath), path)) == 0) ? FR_OK : FR_EXIST;
+}
+
+FRESULT fvx_opendir(DIR* dp, const TCHAR* path) {
+    char hpath[512];
+    u32 i;
+
+    for (i = 0; (i < HOSTFS_MAX_DIRS) && hostfs_dirs[i]; i++);
+    if (i >= HOSTFS_MAX_DIRS) return FR_TOO_MANY_OPEN_FILES;
+    if (!(hostfs_dirs[i] = hp_opendir(hostfs_path(hpath, sizeof(hpath), path))))
+        return FR_NO_PATH;
+    snprintf(hostfs_dir_paths[i], sizeof(hostfs_dir_paths[i]), "%s", hpath);
+
+    memset(dp, 0, sizeof(DIR));
+    dp->obj.sclust = i;
+    dp->obj.id = 1;
+    hostfs_stats.opendirs++;
+    if (++hostfs_stats.open_dirs > hostfs_stats.max_open_dirs)
+        hostfs_stats.max_open_dirs = hostfs_stats.open_dirs;
+    return FR_OK;
+}
+
+FRESULT fvx_closedir(DIR* dp) {
+    if (!dp->obj.id) return FR_INVALID_OBJECT;
+    hp_closedir(hostfs_dirs[dp->obj.sclust]);
+    hostfs_dirs[dp->obj.sclust] = NULL;
+    dp->obj.id = 0;
+    hostfs_stats.open_dirs--;
+    return FR_OK;
+}
+
+FRESULT fvx_readdir(DIR* dp, FILINFO* fno) {
+    void* dir = hostfs_dirs[dp->obj.sclust];
+    char name[FF_LFN_BUF + 1];
+
+    hostfs_stats.readdirs++;
+    memset(fno, 0, sizeof(FILINFO));
+    if (!dir || !hp_readdir(dir, name, sizeof(name))) return FR_OK; // end of directory
+
+    char hpath[1024];
+    unsigned long long size;
+    unsigned short fdate, ftime;
+    int isdir;
+    snprintf(hpath, sizeof(hpath), "%s/%s", hostfs_dir_paths[dp->obj.sclust], name);
+    if (hp_stat(hpath, &size, &isdir, &fdate, &ftime) != 0) return FR_DISK_ERR;
+    fno->fsize = (FSIZE_t) size;
+    fno->fdate = fdate;
+    fno->ftime = ftime;
+    fno->fattrib = isdir ? AM_DIR : AM_ARC;
+    snprintf(fno->fname, sizeof(fno->fname), "%s", name);
+    return FR_OK;
+}
+
+// same wildcard rules as vff.c: '?' is one char, '*' one or more, case insensitive
+FRESULT fvx_match_name(const TCHAR* path, const TCHAR* pattern) {
+    for (; *pattern != '*'; pattern++, path++) {
+        if ((*pattern == '\0') && (*path == '\0')) return FR_OK;
+        else if ((*pattern == '\0') || (*path == '\0')) return FR_NO_FILE;
+        else if ((*pattern != '?') && (tolower(*pattern) != tolower(*path))) return FR_NO_FILE;
+    }
+    if ((*(pattern+1) == '?') || (*(pattern+1) == '*') || (*path == '\0')) return FR_NO_FILE;
+    if (*(pattern+1) == '\0') return FR_OK;
+    for (path++; *path != '\0'; path++)
+        if (fvx_match_name(path, pattern + 1) == FR_OK) return FR_OK;
+    return FR_NO_FILE;
+}
+
+FRESULT fvx_findpath(TCHAR* path, const TCHAR* pattern, BYTE mode) {
+    DIR pdir;
+    FILINFO fno;
+    FRESULT res;
+    const char* npattern = strrchr(pattern, '/');
+    if (!npattern || (strlen(pattern) > FF_MAX_LFN)) return FR_INVALID_NAME;
+    strcpy(path, pattern);
+    char* fname = path + (++npattern - pattern);
+    fname[-1] = '\0';
+    if ((res = fvx_opendir(&pdir, path)) != FR_OK) return res;
+    fname[-1] = '/';
+    *fname = '\0';
+    while ((fvx_readdir(&pdir, &fno) == FR_OK) && *(fno.fname)) {
+        if (fvx_match_name(fno.fname, npattern) != FR_OK) continue;
+        int cmp = strncmp(fno.fname, fname, FF_MAX_LFN);
+        if (((mode & FN_HIGHEST) && (cmp > 0)) || ((mode & FN_LOWEST) && (cmp < 0)) || !(*fname))
+            strcpy(fname, fno.fname);
+        if (!(mode & (FN_HIGHEST|FN_LOWEST))) break;
+    }
+    fvx_closedir(&pdir);
+    return (*fname) ? FR_OK : FR_NO_PATH;
+}
+
+FRESULT fvx_qread(const TCHAR* path, void* buff, FSIZE_t ofs, UINT btr, UINT* br) {
+    FIL fp;
+    FRESULT res = fvx_open(&fp, path, FA_READ | FA_OPEN_EXISTING);
+    if (res != FR_OK) return res;
+    res = fvx_lseek(&fp, ofs);
+    if (res == FR_OK) res = fvx_read(&fp, buff, btr, br);
+    fvx_close(&fp);
+    return res;
+}
+
+FRESULT fvx_qwrite(const TCHAR* path, const void* buff, FSIZE_t ofs, UINT btw, UINT* bw) {
+    FIL fp;
+    FRESULT res = fvx_open(&fp, path, FA_WRITE | FA_OPEN_ALWAYS);
+    if (res != FR_OK) return res;
+    res = fvx_lseek(&fp, ofs);
+    if (res == FR_OK) res = fvx_write(&fp, buff, btw, bw);
+    fvx_close(&fp);
+    return res;
+}
+
+FRESULT fvx_qcreate(const TCHAR* path, UINT btc) {
+    FIL fp;
+    FRESULT res = fvx_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if (res != FR_OK) return res;
+    res = fvx_lseek(&fp, btc);
+    fvx_close(&fp);
+    return res;
+}
+
+FSIZE_t fvx_qsize(const TCHAR* path) {
+    FILINFO fno;
+    return (fvx_stat(path, &fno) == FR_OK) ? fno.fsize : 0;
+}
+
+FRESULT fvx_rmkdir(const TCHAR* path) {
+    char buf[512];
+    char* slash = buf + 3;
+    snprintf(buf, sizeof(buf), "%s", path);
+    while ((slash = strchr(slash, '/'))) {
+        *slash = '\0';
+        fvx_mkdir(buf);
+        *(slash++) = '/';
+    }
+    fvx_mkdir(buf);
+    FILINFO fno;
+    return ((fvx_stat(path, &fno) == FR_OK) && (fno.fattrib & AM_DIR)) ? FR_OK : FR_NO_PATH;
+}
+
+FRESULT fvx_rmkpath(const TCHAR* path) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", path);
+    char* slash = strrchr(buf, '/');
+    if (!slash || (slash <= buf + 2)) return FR_OK;
+    *slash = '\0';
+    return fvx_rmkdir(buf);
+}
+
+FRESULT fvx_runlink(const TCHAR* path) {
+    char hpath[512];
+    return (hp_rmtree(hostfs_path(hpath, sizeof(hpath), path)) == 0) ? FR_OK : FR_DENIED;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// FatFs / vff.h on top of a host directory: "X:/path" maps to "<root>/X/path"
+// every call is counted, so tests can check I/O patterns as well as results
+#include "common.h"
+
+typedef struct {
+    u32 opens;
+    u32 reads;
+    u32 writes;
+    u32 seeks;
+    u32 stats;
+    u32 opendirs;
+    u32 readdirs;
+    u32 unlinks;
+    u32 syncs;
+    u32 sector_writes; // as on a FAT volume: data sectors written plus a directory entry update per flush
+    u64 bytes_read;
+    u64 bytes_written;
+    u32 open_files;
+    u32 open_dirs;
+    u32 max_open_dirs;
+} HostFsStats;
+
+extern HostFsStats hostfs_stats;
+
+void hostfs_init(const char* root); // starts from an empty root
+void hostfs_attach(const char* root); // keeps what is already there (big read only test trees)
+void hostfs_reset_stats(void);
+const char* hostfs_path(char* out, size_t size, const char* path);
+bool hostfs_write_file(const char* path, const void* data, size_t size);
+size_t hostfs_read_file(const char* path, void* data, size_t size);
@@ -0,0 +1,18 @@
+// fsperm.h: everything is writable on the host
+#include "fsperm.h"
+
+bool CheckWritePermissions(const char* path) {
+    (void) path;
+    return true;
+}
+
+bool CheckDirWritePermissions(const char* path) {
+    (void) path;
+    return true;
+}
+
+bool SetWritePermissions(u32 perm, bool add_perm) {
+    (void) perm;
+    (void) add_perm;
+    return true;
+}
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "hostposix.h"
+
+int hp_open(const char* path, int write, int create, int truncate, int exclusive) {
+    int flags = write ? O_RDWR : O_RDONLY;
+    if (create) flags |= O_CREAT;
+    if (truncate) flags |= O_TRUNC;
+    if (exclusive) flags |= O_EXCL;
+    return open(path, flags, 0644);
+}
+
+int hp_read(int fd, void* buf, unsigned int size) {
+    unsigned int done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, (char*) buf + done, size - done);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        done += n;
+    }
+    return (int) done;
+}
+
+int hp_write(int fd, const void* buf, unsigned int size) {
+    unsigned int done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, (const char*) buf + done, size - done);
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return (int) done;
+}
+
+int hp_seek(int fd, unsigned long long offset) {
+    return (lseek(fd, (off_t) offset, SEEK_SET) == (off_t) offset) ? 0 : -1;
+}
+
+long long hp_fsize(int fd) {
+    struct stat st;
+    return (fstat(fd, &st) == 0) ? (long long) st.st_size : -1;
+}
+
+int hp_ftruncate(int fd, unsigned long long size) {
+    return ftruncate(fd, (off_t) size);
+}
+
+int hp_fsync(int fd) {
+    (void) fd; // nothing is cached on our side
+    return 0;
+}
+
+void hp_close(int fd) {
+    close(fd);
+}
+
+// FAT timestamps are local time, 2 second resolution
+static void to_fat_time(time_t t, unsigned short* fdate, unsigned short* ftime) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    if (fdate) *fdate = (unsigned short) (((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+    if (ftime) *ftime = (unsigned short) ((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+}
+
+int hp_stat(const char* path, unsigned long long* size, int* isdir, unsigned short* fdate, unsigned short* ftime) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    if (size) *size = S_ISDIR(st.st_mode) ? 0 : (unsigned long long) st.st_size;
+    if (isdir) *isdir = S_ISDIR(st.st_mode);
+    to_fat_time(st.st_mtime, fdate, ftime);
+    return 0;
+}
+
+int hp_utime(const char* path, unsigned short fdate, unsigned short ftime) {
+    struct tm tm = { 0 };
+    struct timespec ts[2];
+    tm.tm_year = (fdate >> 9) + 80;
+    tm.tm_mon = ((fdate >> 5) & 0xF) - 1;
+    tm.tm_mday = fdate & 0x1F;
+    tm.tm_hour = ftime >> 11;
+    tm.tm_min = (ftime >> 5) & 0x3F;
+    tm.tm_sec = (ftime & 0x1F) * 2;
+    tm.tm_isdst = -1;
+    ts[0].tv_sec = ts[1].tv_sec = mktime(&tm);
+    ts[0].tv_nsec = ts[1].tv_nsec = 0;
+    return utimensat(AT_FDCWD, path, ts, 0);
+}
+
+int hp_rename(const char* path_old, const char* path_new) {
+    struct stat st;
+    if (stat(path_new, &st) == 0) return -1; // FatFs won't overwrite
+    return rename(path_old, path_new);
+}
+
+int hp_unlink(const char* path) {
+    return remove(path);
+}
+
+int hp_mkdir(const char* path) {
+    return mkdir(path, 0755);
+}
+
+int hp_rmtree(const char* path) {
+    struct stat st;
+    if (lstat(path, &st) != 0) return 0;
+    if (S_ISDIR(st.st_mode)) {
+        DIR* dir = opendir(path);
+        struct dirent* e;
+        if (!dir) return -1;
+        while ((e = readdir(dir))) {
+            char sub[1024];
+            if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+            snprintf(sub, sizeof(sub), "%s/%s", path, e->d_name);
+            hp_rmtree(sub);
+        }
+        closedir(dir);
+    }
+    return remove(path);
+}
+
+void* hp_opendir(const char* path) {
+    return opendir(path);
+}
+
+int hp_readdir(void* dir, char* name, unsigned int size) {
+    struct dirent* e;
+    do e = readdir((DIR*) dir);
+    while (e && (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")));
+    if (!e) return 0;
+    snprintf(name, size, "%s", e->d_name);
+    return 1;
+}
+
+void hp_closedir(void* dir) {
+    closedir((DIR*) dir);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// POSIX side of the hostfs shim, kept apart because ff.h and dirent.h both define DIR
+int hp_open(const char* path, int write, int create, int truncate, int exclusive);
+int hp_read(int fd, void* buf, unsigned int size);
+int hp_write(int fd, const void* buf, unsigned int size);
+int hp_seek(int fd, unsigned long long offset);
+long long hp_fsize(int fd);
+int hp_ftruncate(int fd, unsigned long long size);
+int hp_fsync(int fd);
+void hp_close(int fd);
+
+int hp_stat(const char* path, unsigned long long* size, int* isdir, unsigned short* fdate, unsigned short* ftime);
+int hp_utime(const char* path, unsigned short fdate, unsigned short ftime);
+int hp_rename(const char* path_old, const char* path_new);
+int hp_unlink(const char* path);
+int hp_mkdir(const char* path);
+int hp_rmtree(const char* path);
+
+void* hp_opendir(const char* path);
+int hp_readdir(void* dir, char* name, unsigned int size);
+void hp_closedir(void* dir);
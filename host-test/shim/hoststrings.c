@@ -0,0 +1,6 @@
+// language strings with their English defaults (language.c loads them at runtime)
+#include "language.h"
+
+#define STRING(what, def) const char* STR_##what = def;
+#include "language.inl"
+#undef STRING
@@ -0,0 +1,26 @@
+// timer.h on the host monotonic clock, in TICKS_PER_SEC units
+#include <time.h>
+#include "timer.h"
+
+u64 timer_start( void ) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((u64) ts.tv_sec * TICKS_PER_SEC) + (((u64) ts.tv_nsec * TICKS_PER_SEC) / 1000000000ULL);
+}
+
+u64 timer_ticks( u64 start_time ) {
+    return timer_start() - start_time;
+}
+
+u64 timer_msec( u64 start_time ) {
+    return timer_ticks(start_time) / (TICKS_PER_SEC / 1000);
+}
+
+u64 timer_sec( u64 start_time ) {
+    return timer_ticks(start_time) / TICKS_PER_SEC;
+}
+
+void wait_msec( u64 msec ) {
+    struct timespec ts = { (time_t) (msec / 1000), (long) ((msec % 1000) * 1000000) };
+    nanosleep(&ts, NULL);
+}
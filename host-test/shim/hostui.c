@@ -0,0 +1,112 @@
+#include <stdarg.h>
+#include "hostui.h"
+#include "ui.h"
+#include "hid.h"
+
+HostUiStats hostui_stats;
+bool hostui_prompt_answer = true;
+u32 hostui_cancel_after = 0;
+u32 hostui_buttons = 0;
+
+static ProgressHook progress_hook = NULL;
+static void* progress_hook_ctx = NULL;
+static u64 progress_hook_interval = 0;
+static u64 progress_hook_last = 0;
+
+void hostui_reset(void) {
+    memset(&hostui_stats, 0, sizeof(HostUiStats));
+    hostui_prompt_answer = true;
+    hostui_cancel_after = 0;
+    hostui_buttons = 0;
+}
+
+bool ShowProgress(u64 current, u64 total, const char* opstr) {
+    hostui_stats.progress_calls++;
+    // same rate limit as ui.c, the first and the last call always go through
+    if (progress_hook && (!current || (current >= total) || (current < progress_hook_last) ||
+        (current - progress_hook_last >= progress_hook_interval))) {
+        progress_hook_last = current;
+        if (!progress_hook(current, total, opstr, progress_hook_ctx)) return false;
+    }
+    return !hostui_cancel_after || (hostui_stats.progress_calls < hostui_cancel_after);
+}
+
+// no refresh rate here, only the hook interval, so every counter update is seen without a hook
+bool ProgressUpdate(ProgressCounter* prog) {
+    bool ret = ShowProgress(prog->current, prog->total, prog->opstr);
+    prog->next = min(prog->current + (progress_hook ? progress_hook_interval : 1), prog->total);
+    return ret;
+}
+
+void SetProgressHook(ProgressHook hook, void* ctx, u64 interval) {
+    progress_hook = hook;
+    progress_hook_ctx = ctx;
+    progress_hook_interval = interval;
+    progress_hook_last = 0;
+}
+
+bool ProgressHookActive(void) {
+    return progress_hook != NULL;
+}
+
+bool CheckButton(u32 button) {
+    return (hostui_buttons & button) == button;
+}
+
+bool ShowPrompt(bool ask, const char *format, ...) {
+    if (getenv("HOSTTEST_VERBOSE")) { // HOSTTEST_VERBOSE=1 make host-test shows what the code would prompt
+        va_list va;
+        va_start(va, format);
+        vfprintf(stderr, format, va);
+        fputc('\n', stderr);
+        va_end(va);
+    }
+    hostui_stats.prompts++;
+    return ask ? hostui_prompt_answer : true;
+}
+
+u32 ShowSelectPrompt(int n, const char** options, const char *format, ...) {
+    (void) n;
+    (void) options;
+    (void) format;
+    hostui_stats.prompts++;
+    return 0; // cancel
+}
+
+void ShowString(const char *format, ...) {
+    (void) format;
+    hostui_stats.strings++;
+}
+
+void TruncateString(char* dest, const char* orig, int nlength, int tpos) {
+    (void) tpos;
+    snprintf(dest, nlength + 1, "%s", orig);
+}
+
+void FormatNumber(char* str, u64 number) {
+    sprintf(str, "%llu", (unsigned long long) number);
+}
+
+void FormatBytes(char* str, u64 bytes) {
+    sprintf(str, "%llu Byte", (unsigned long long) bytes);
+}
+
+bool ShowStringPrompt(char* inputstr, u32 max_size, const char *format, ...) {
+    (void) inputstr;
+    (void) max_size;
+    (void) format;
+    hostui_stats.prompts++;
+    return false; // cancel
+}
+
+bool ShowKeyboard(char* inputstr, u32 max_size, const char *format, ...) {
+    (void) inputstr;
+    (void) max_size;
+    (void) format;
+    hostui_stats.prompts++;
+    return false; // cancel
+}
+
+bool TouchIsCalibrated(void) {
+    return false;
+}
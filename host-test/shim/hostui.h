@@ -0,0 +1,17 @@
+#pragma once
+
+// headless ui.h: nothing is drawn, calls are counted and prompts answer on their own
+#include "common.h"
+
+typedef struct {
+    u32 progress_calls;
+    u32 prompts;
+    u32 strings;
+} HostUiStats;
+
+extern HostUiStats hostui_stats;
+extern bool hostui_prompt_answer;   // answer to yes / no prompts
+extern u32 hostui_cancel_after;     // ShowProgress() cancels after this many calls (0: never)
+extern u32 hostui_buttons;          // buttons held, for CheckButton()
+
+void hostui_reset(void);
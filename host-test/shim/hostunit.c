@@ -0,0 +1,23 @@
+// unittype.h: IS_DEVKIT reads the unit info byte at 0x01FFB819 (ARM9 ITCM) and IS_UNLOCKED the CFG9 sysprot
+// bits at 0x10000000, the host maps zeroed pages there before main(), so the code under test sees a retail,
+// unlocked unit
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define UNITINFO_PAGE   0x01FFB000UL
+#define CFG9_PAGE       0x10000000UL
+
+static void hostunit_map(unsigned long addr) {
+    void* page = mmap((void*) addr, 0x1000, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (page != (void*) addr) {
+        fprintf(stderr, "hostunit: can't map the page at %08lX\n", addr);
+        exit(1);
+    }
+}
+
+__attribute__((constructor)) static void hostunit_init(void) {
+    hostunit_map(UNITINFO_PAGE);
+    hostunit_map(CFG9_PAGE);
+}
@@ -0,0 +1,17 @@
+// ui.h: the screens are fixed VRAM addresses, the host maps zeroed memory there before main(),
+// so the real drawing code renders into an in-memory framebuffer
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "vram.h"
+
+#define VRAM_MAP_SIZE   (((VRAM_END - VRAM_START) + 0xFFF) & ~0xFFF)
+
+__attribute__((constructor)) static void hostvram_init(void) {
+    void* vram = mmap((void*) VRAM_START, VRAM_MAP_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (vram != (void*) VRAM_START) {
+        fprintf(stderr, "hostvram: can't map the framebuffers\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,176 @@
+// BPS patches built on the fly (all four actions, near and far copies), applied through hostfs
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "crc32.h"
+#include "hid.h"
+#include "vff.h"
+#include "bps.h"
+
+#define SRC_PATH "0:/bps/source.bin"
+#define DST_PATH "0:/bps/target.bin"
+#define BPS_PATH "0:/bps/patch.bps"
+
+typedef struct {
+    u8* data;
+    u32 size;
+} Buffer;
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static void put8(Buffer* b, u8 v) {
+    b->data[b->size++] = v;
+}
+
+static void put_vli(Buffer* b, u64 v) {
+    for (;;) {
+        u8 x = v & 0x7F;
+        v >>= 7;
+        if (!v) {
+            put8(b, 0x80 | x);
+            break;
+        }
+        put8(b, x);
+        v--;
+    }
+}
+
+static void put_signed(Buffer* b, s64 v) {
+    put_vli(b, ((u64) ((v < 0) ? -v : v) << 1) | (v < 0));
+}
+
+static void put32(Buffer* b, u32 v) {
+    for (u32 i = 0; i < 4; i++) put8(b, (u8) (v >> (8 * i)));
+}
+
+// builds target and patch side by side, counting the actions used
+static void make_patch(const Buffer* src, Buffer* dst, Buffer* bps, u32 dst_size, u32* counts) {
+    s64 src_rel = 0, dst_rel = 0;
+
+    bps->size = 0;
+    memcpy(bps->data, "BPS1", 4);
+    bps->size = 4;
+    put_vli(bps, src->size);
+    put_vli(bps, dst_size);
+    put_vli(bps, 0); // no metadata
+
+    dst->size = 0;
+    while (dst->size < dst_size) {
+        u32 len = 1 + rnd() % ((rnd() % 8) ? 64 : 4096);
+        u32 act = rnd() % 4;
+        if (len > dst_size - dst->size) len = dst_size - dst->size;
+        if ((act == 0) && (dst->size + len > src->size)) act = 1; // SourceRead needs a source byte at the same offset
+        if ((act == 2) && (len >= src->size)) act = 1;
+        if ((act == 3) && !dst->size) act = 1;
+
+        u32 off = 0;
+        if (act == 0) { // SourceRead
+            memcpy(dst->data + dst->size, src->data + dst->size, len);
+        } else if (act == 1) { // TargetRead
+            for (u32 i = 0; i < len; i++) dst->data[dst->size + i] = (u8) rnd();
+        } else if (act == 2) { // SourceCopy, near or far
+            off = (rnd() % 2) ? (u32) ((src_rel + (rnd() % 512)) % (src->size - len)) : rnd() % (src->size - len);
+            memcpy(dst->data + dst->size, src->data + off, len);
+        } else { // TargetCopy, runs (distance 1) to far back references
+            off = dst->size - ((rnd() % 3 == 0) ? 1 : 1 + rnd() % dst->size);
+            for (u32 i = 0; i < len; i++) dst->data[dst->size + i] = dst->data[off + i];
+        }
+
+        put_vli(bps, ((u64) (len - 1) << 2) | act);
+        if (act == 1) {
+            memcpy(bps->data + bps->size, dst->data + dst->size, len);
+            bps->size += len;
+        } else if (act == 2) {
+            put_signed(bps, (s64) off - src_rel);
+            src_rel = off + len;
+        } else if (act == 3) {
+            put_signed(bps, (s64) off - dst_rel);
+            dst_rel = off + len;
+        }
+        dst->size += len;
+        counts[act]++;
+    }
+
+    put32(bps, crc32_calculate(~0, src->data, src->size) ^ ~0);
+    put32(bps, crc32_calculate(~0, dst->data, dst->size) ^ ~0);
+    put32(bps, crc32_calculate(~0, bps->data, bps->size) ^ ~0);
+}
+
+static bool apply_and_compare(const Buffer* dst) {
+    u8* out = malloc(dst->size + 1);
+    bool ok = (ApplyBPSPatch(BPS_PATH, SRC_PATH, DST_PATH) == 0) &&
+        (fvx_qsize(DST_PATH) == dst->size) &&
+        (hostfs_read_file(DST_PATH, out, dst->size) == dst->size) &&
+        (memcmp(out, dst->data, dst->size) == 0);
+    free(out);
+    return ok;
+}
+
+int main(void) {
+    static const u32 sizes[][2] = { // source, target
+        { 1000, 1200 }, { 100000, 90000 }, { 300000, 700000 }, { 2 << 20, 2 << 20 }
+    };
+    Buffer src, dst, bps;
+
+    hostfs_init("build/fs_bps");
+    for (u32 t = 0; t < countof(sizes); t++) {
+        u32 counts[4] = { 0 };
+        rnd_state = 0x1234 + t;
+        src.size = sizes[t][0];
+        src.data = malloc(src.size);
+        dst.data = malloc(sizes[t][1]);
+        bps.data = malloc(2 * sizes[t][1] + 64);
+        ht_fill(src.data, src.size, t + 1);
+        make_patch(&src, &dst, &bps, sizes[t][1], counts);
+        hostfs_write_file(SRC_PATH, src.data, src.size);
+        hostfs_write_file(BPS_PATH, bps.data, bps.size);
+
+        hostfs_reset_stats();
+        hostui_reset();
+        double t0 = ht_now();
+        CHECK(apply_and_compare(&dst), "apply %lu -> %lu", (unsigned long) src.size, (unsigned long) dst.size);
+        double t1 = ht_now();
+        printf("  %7lu -> %7lu: %5lu actions, %4lu reads, %4lu writes, %6.1f ms\n",
+            (unsigned long) src.size, (unsigned long) dst.size,
+            (unsigned long) (counts[0] + counts[1] + counts[2] + counts[3]),
+            (unsigned long) hostfs_stats.reads, (unsigned long) hostfs_stats.writes, (t1 - t0) * 1000);
+        // the patch stream (VLIs, TargetRead data) goes through the window, only source / old target data is read per action
+        CHECK(hostfs_stats.reads < counts[0] + counts[2] + counts[3] + bps.size / (64 * 1024) + 16, "buffered patch reads");
+        CHECK(hostfs_stats.writes <= dst.size / (256 * 1024) + 1, "buffered writes");
+
+        // corrupted patch payload, wrong source size, wrong source data (caught by the output crc)
+        if (t == 1) {
+            u32 pos = bps.size / 2;
+            bps.data[pos] ^= 0x01;
+            hostfs_write_file(BPS_PATH, bps.data, bps.size);
+            CHECK(ApplyBPSPatch(BPS_PATH, SRC_PATH, DST_PATH) != 0, "corrupt patch rejected");
+            bps.data[pos] ^= 0x01;
+            hostfs_write_file(BPS_PATH, bps.data, bps.size);
+            hostfs_write_file(SRC_PATH, src.data, src.size - 1);
+            CHECK(ApplyBPSPatch(BPS_PATH, SRC_PATH, DST_PATH) != 0, "short source rejected");
+            for (u32 i = 0; i < src.size; i++) src.data[i] ^= 0x01;
+            hostfs_write_file(SRC_PATH, src.data, src.size);
+            CHECK(ApplyBPSPatch(BPS_PATH, SRC_PATH, DST_PATH) != 0, "wrong source rejected");
+        }
+
+        // abort via B button
+        if (t == 3) {
+            hostui_buttons = BUTTON_B;
+            CHECK(ApplyBPSPatch(BPS_PATH, SRC_PATH, DST_PATH) != 0, "abort");
+            hostui_reset();
+        }
+
+        free(src.data);
+        free(dst.data);
+        free(bps.data);
+    }
+
+    return ht_done("bps");
+}
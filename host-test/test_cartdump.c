@@ -0,0 +1,116 @@
+// DumpGameCart() from a file backed fake cart: one read per chunk, no read back of the dump,
+// SHA-256 / CRC32 against zlib and the .sha / .sfv sidecars, failed or cancelled dumps leave nothing behind
+#define crc32_combine zlib_crc32_combine // clashes with crc32.h
+#include <zlib.h>
+#undef crc32_combine
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "hostcart.h"
+#include "common.h"
+#include "vff.h"
+#include "sha.h"
+#include "gamecart.h"
+#include "gameutil.h"
+
+#define CART_IMAGE  "build/cart_image.bin" // host path, not on the fake SD
+#define CART_SIZE   (5 * STD_BUFFER_SIZE + 0x1200)
+#define DATA_SIZE   (3 * STD_BUFFER_SIZE + 0x200) // trimmed size
+#define DUMP_DIR    "0:/gm9/out"
+
+static bool exists(const char* path) {
+    return fvx_stat(path, NULL) == FR_OK;
+}
+
+// dump matches the image, the sidecars match the image hashes
+static u32 check_dump(const char* path, const u8* image, u64 size, bool hashes) {
+    static u8 data[CART_SIZE + 1];
+    char side_path[256];
+    char sfv[256];
+    u8 hash[0x20], ref[0x20];
+    u32 n_bad = 0;
+
+    if ((hostfs_read_file(path, data, sizeof(data)) != size) || (memcmp(data, image, size) != 0)) n_bad++;
+    sha_quick(ref, image, size, SHA256_MODE);
+    snprintf(side_path, sizeof(side_path), "%s.sha", path);
+    if (!hashes) return n_bad + exists(side_path);
+    if ((hostfs_read_file(side_path, hash, sizeof(hash) + 1) != 0x20) || (memcmp(hash, ref, 0x20) != 0)) n_bad++;
+
+    snprintf(side_path, sizeof(side_path), "%s.sfv", path);
+    size_t len = hostfs_read_file(side_path, sfv, sizeof(sfv) - 1);
+    sfv[len] = '\0';
+    char ref_sfv[256];
+    snprintf(ref_sfv, sizeof(ref_sfv), "%s %08lX\r\n", strrchr(path, '/') + 1, (unsigned long) crc32(0, image, size));
+    if (strcmp(sfv, ref_sfv) != 0) n_bad++;
+    return n_bad;
+}
+
+int main(void) {
+    static CartData cdata;
+    u8* image = malloc(CART_SIZE);
+    u8 sha256[0x20], ref[0x20];
+    u32 crc;
+    if (!image) return 1;
+
+    hostfs_init("build/fs_cartdump");
+    fvx_rmkdir(DUMP_DIR);
+    ht_fill(image, CART_SIZE, 0x3D5);
+    FILE* fp = fopen(CART_IMAGE, "wb");
+    if (!fp || (fwrite(image, 1, CART_SIZE, fp) != CART_SIZE)) return 1;
+    fclose(fp);
+    CHECK(hostcart_insert(CART_IMAGE), "cart image");
+    memset(&cdata, 0, sizeof(CartData));
+    cdata.cart_type = CART_CTR;
+    cdata.cart_size = CART_SIZE;
+    cdata.data_size = DATA_SIZE;
+
+    // full dump: every cart byte read once, written once and never read back
+    const char* path = DUMP_DIR "/full.3ds";
+    hostfs_reset_stats();
+    double t0 = ht_now();
+    CHECK(DumpGameCart(path, &cdata, CART_SIZE, true, sha256, &crc) == 0, "full dump");
+    double t1 = ht_now();
+    sha_quick(ref, image, CART_SIZE, SHA256_MODE);
+    CHECK((memcmp(sha256, ref, 0x20) == 0) && (crc == (u32) crc32(0, image, CART_SIZE)), "full dump hashes");
+    CHECK((hostcart_stats.reads == 6) && (hostcart_stats.bytes_read == CART_SIZE), "full dump: %lu cart reads",
+        (unsigned long) hostcart_stats.reads);
+    HostFsStats dump_stats = hostfs_stats;
+    CHECK(!dump_stats.bytes_read && (dump_stats.opens == 3) && !hostfs_stats.open_files,
+        "full dump: %lu opens, %llu bytes read back", (unsigned long) dump_stats.opens,
+        (unsigned long long) dump_stats.bytes_read);
+    CHECK(!check_dump(path, image, CART_SIZE, true), "full dump contents");
+    printf("  %.1f MB dump: %lu cart reads, %lu opens, %.1f ms\n", CART_SIZE / 1048576.0,
+        (unsigned long) hostcart_stats.reads, (unsigned long) dump_stats.opens, (t1 - t0) * 1000);
+
+    // trimmed dump, without sidecars
+    path = DUMP_DIR "/trim.3ds";
+    memset(&hostcart_stats, 0, sizeof(HostCartStats));
+    CHECK(DumpGameCart(path, &cdata, DATA_SIZE, false, sha256, &crc) == 0, "trimmed dump");
+    sha_quick(ref, image, DATA_SIZE, SHA256_MODE);
+    CHECK((memcmp(sha256, ref, 0x20) == 0) && (crc == (u32) crc32(0, image, DATA_SIZE)), "trimmed dump hashes");
+    CHECK((hostcart_stats.bytes_read == DATA_SIZE) && !check_dump(path, image, DATA_SIZE, false), "trimmed dump contents");
+    CHECK(!exists(DUMP_DIR "/trim.3ds.sfv"), "trimmed dump: no sidecars");
+
+    // cart read error in the middle: no dump, no sidecars
+    path = DUMP_DIR "/fail.3ds";
+    hostcart_fail_at = 2 * STD_BUFFER_SIZE + 0x100;
+    hostfs_reset_stats();
+    CHECK(DumpGameCart(path, &cdata, CART_SIZE, true, NULL, NULL) != 0, "read error");
+    CHECK(!exists(path) && !exists(DUMP_DIR "/fail.3ds.sha") && !exists(DUMP_DIR "/fail.3ds.sfv") &&
+        !hostfs_stats.open_files, "read error: nothing left");
+    hostcart_fail_at = 0;
+
+    // cancel: same
+    hostui_reset();
+    hostui_cancel_after = 3;
+    CHECK(DumpGameCart(path, &cdata, CART_SIZE, true, NULL, NULL) != 0, "cancel");
+    CHECK(!exists(path) && !exists(DUMP_DIR "/fail.3ds.sha") && !hostfs_stats.open_files, "cancel: nothing left");
+    hostui_reset();
+
+    // past the end of the cart
+    CHECK(DumpGameCart(path, &cdata, CART_SIZE + 0x200, true, NULL, NULL) != 0 && !exists(path), "oversized dump");
+
+    hostcart_insert(NULL);
+    free(image);
+    return ht_done("cartdump");
+}
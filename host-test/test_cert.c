@@ -0,0 +1,211 @@
+// ticket signatures against a synthetic certs.db: issuer cache and verified signature memo,
+// counted through stand-ins for the DISA/DIFF reader and the RSA engine
+#include "hosttest.h"
+#include "common.h"
+#include "sha.h"
+#include "rsa.h"
+#include "disadiff.h"
+#include "cert.h"
+#include "ticket.h"
+
+#define N_TICKETS   1000
+#define N_OTHER     12 // issuers not in the fixed storage, more than the cache holds
+#define DB_SIZE     0x8000
+
+typedef struct {
+    u32 db_opens;
+    u32 db_reads;
+    u32 rsa_ops;
+} CertStats;
+
+static CertStats stats;
+static u8 certs_db[DB_SIZE];
+static u32 key_mod[0x100 / 4];
+
+// certs.db partition behind the DISA/DIFF layer, only the SysNAND one exists
+u32 GetDisaDiffRWInfo(const char* path, DisaDiffRWInfo* info, bool partitionB) {
+    (void) partitionB;
+    stats.db_opens++;
+    memset(info, 0, sizeof(DisaDiffRWInfo));
+    info->size_dpfs_lvl2 = 0x10;
+    return (path[0] == '1') ? 0 : 1;
+}
+
+u32 BuildDisaDiffDpfsLvl2Cache(const char* path, const DisaDiffRWInfo* info, u8* cache, u32 cache_size) {
+    (void) path;
+    (void) info;
+    memset(cache, 0, cache_size);
+    return 0;
+}
+
+u32 ReadDisaDiffIvfcLvl4(const char* path, const DisaDiffRWInfo* info, u32 offset, u32 size, void* buffer) {
+    (void) path;
+    (void) info;
+    stats.db_reads++;
+    if (offset + size > DB_SIZE) return 0;
+    memcpy(buffer, certs_db + offset, size);
+    return size;
+}
+
+// RSA stand-in: the "signature" is SHA-256 over modulus and data, padded with zeroes
+bool RSA_setKey2048(u8 keyslot, const u32* const mod, u32 exp) {
+    (void) keyslot;
+    (void) exp;
+    memcpy(key_mod, mod, 0x100);
+    return true;
+}
+
+static void sign(u8* sig, const u8* mod, const void* data, u32 size) {
+    memset(sig, 0, 0x100);
+    sha_init(SHA256_MODE);
+    sha_update(mod, 0x100);
+    sha_update(data, size);
+    sha_get(sig);
+}
+
+bool RSA_verify2048(const u32* const encSig, const u32* const data, u32 size) {
+    u8 sig[0x100];
+    stats.rsa_ops++;
+    sign(sig, (u8*) key_mod, data, size);
+    return memcmp(sig, encSig, 0x100) == 0;
+}
+
+static u8* put_cert(u8* p, u32 sig_type, const char* issuer, const char* name, u32 seed) {
+    u32 sig_size = (sig_type == 0x10003) ? CERT_RSA4096_SIG_SIZE : CERT_RSA2048_SIG_SIZE;
+    memset(p, 0, sig_size + CERT_RSA2048_BODY_SIZE);
+    p[1] = 0x01;
+    p[3] = (u8) sig_type;
+    ht_fill(p + 4, sig_size - 4, seed);
+    CertificateBody* body = (CertificateBody*) (void*) (p + sig_size);
+    strcpy(body->issuer, issuer);
+    body->keytype[3] = 1; // RSA 2048
+    strcpy(body->name, name);
+    ht_fill(body->pub_key_data, 0x100, seed + 1); // modulus
+    body->pub_key_data[0x102] = 0x01; // exponent 0x10001
+    body->pub_key_data[0x103] = 0x01;
+    return p + sig_size + CERT_RSA2048_BODY_SIZE;
+}
+
+static void other_issuer(char* issuer, u32 i) {
+    snprintf(issuer, 0x40, "Root-CA00000003-XS%08lX", (unsigned long) (0x20 + i));
+}
+
+static void make_certs_db(void) {
+    char name[0x40];
+    u8* p = certs_db + 0x10;
+    memset(certs_db, 0, sizeof(certs_db));
+    p = put_cert(p, 0x10003, "Root", "CA00000003", 1);
+    p = put_cert(p, 0x10004, "Root-CA00000003", "XS0000000c", 3);
+    p = put_cert(p, 0x10004, "Root-CA00000003", "CP0000000b", 5);
+    for (u32 i = 0; i < N_OTHER; i++) {
+        snprintf(name, sizeof(name), "XS%08lX", (unsigned long) (0x20 + i));
+        p = put_cert(p, 0x10004, "Root-CA00000003", name, 0x100 + i);
+    }
+    u32 used = align(p - (certs_db + 0x10), 0x100); // the header wants a multiple of 0x100
+    memcpy(certs_db, "CERT", 4);
+    memcpy(certs_db + 8, &used, 4);
+}
+
+// modulus of the cert for issuer, as put there by make_certs_db()
+static const u8* issuer_mod(const char* issuer) {
+    for (u8* p = certs_db + 0x10; p < certs_db + DB_SIZE - CERT_RSA2048_BODY_SIZE; p++) {
+        CertificateBody* body = (CertificateBody*) (void*) p;
+        char full[0x80];
+        if (strncmp(body->issuer, "Root", 4) != 0) continue;
+        snprintf(full, sizeof(full), "%.40s-%.40s", body->issuer, body->name);
+        if (strcmp(full, issuer) == 0) return body->pub_key_data;
+    }
+    return NULL;
+}
+
+static void make_ticket(TicketCommon* ticket, const char* issuer, u32 n) {
+    static const u8 sig_type[4] = { TICKET_SIG_TYPE };
+    memset(ticket, 0, sizeof(TicketCommon));
+    memcpy(ticket->sig_type, sig_type, 4);
+    strcpy((char*) ticket->issuer, issuer);
+    ticket->version = 0x01;
+    ht_fill(ticket->titlekey, 16, n + 7);
+    ticket->title_id[0] = 0x00; ticket->title_id[1] = 0x04;
+    ticket->title_id[6] = (u8) (n >> 8); ticket->title_id[7] = (u8) n;
+    ticket->content_index[7] = 0x28 + 0x84; // content index size: headers and one rights field
+    const u8* mod = issuer_mod(issuer);
+    if (mod) sign(ticket->signature, mod, ticket->issuer, GetTicketSize((Ticket*) ticket) - 0x140);
+}
+
+static u32 validate(TicketCommon* ticket) {
+    return ValidateTicketSignature((Ticket*) ticket);
+}
+
+int main(void) {
+    static TicketCommon tickets[N_TICKETS];
+    char issuer[0x40];
+    make_certs_db();
+
+    // one in ten tickets comes from one of six other issuers, all fit in the cache
+    for (u32 i = 0; i < N_TICKETS; i++) {
+        if (i % 10) make_ticket(&tickets[i], TICKET_ISSUER, i);
+        else {
+            other_issuer(issuer, (i / 10) % 6);
+            make_ticket(&tickets[i], issuer, i);
+        }
+    }
+
+    // every ticket checked twice in a row, as while building and then installing a CIA
+    u32 bad = 0;
+    memset(&stats, 0, sizeof(stats));
+    double t0 = ht_now();
+    for (u32 i = 0; i < N_TICKETS; i++) {
+        if (validate(&tickets[i]) != 0) bad++;
+        if (validate(&tickets[i]) != 0) bad++;
+    }
+    double t1 = ht_now();
+    CHECK(!bad, "%lu tickets failed", (unsigned long) bad);
+    CHECK(stats.rsa_ops == N_TICKETS, "%lu RSA operations", (unsigned long) stats.rsa_ops);
+    CHECK(stats.db_opens == 1 + 6, "%lu certs.db opens", (unsigned long) stats.db_opens);
+    printf("  %u tickets x2: %4lu RSA ops, %3lu certs.db opens, %5lu reads, %6.1f ms\n", N_TICKETS,
+        (unsigned long) stats.rsa_ops, (unsigned long) stats.db_opens, (unsigned long) stats.db_reads, (t1 - t0) * 1000);
+    printf("  without cache and memo:  %4u RSA ops, %3u certs.db opens\n", 2 * N_TICKETS, 1 + 2 * (N_TICKETS / 10));
+
+    // damaged tickets fail every time, failures are not remembered
+    TicketCommon ticket = tickets[5];
+    ticket.titlekey[3] ^= 1;
+    memset(&stats, 0, sizeof(stats));
+    CHECK((validate(&ticket) != 0) && (validate(&ticket) != 0) && (stats.rsa_ops == 2), "damaged ticket");
+    ticket = tickets[5];
+    ticket.signature[0x10] ^= 1;
+    CHECK(validate(&ticket) != 0, "damaged signature");
+
+    // issuer in neither certs.db: both are searched
+    make_ticket(&ticket, "Root-CA00000003-XS00000099", 1);
+    memset(&stats, 0, sizeof(stats));
+    CHECK((validate(&ticket) != 0) && (stats.db_opens == 2) && !stats.rsa_ops, "unknown issuer");
+
+    // all twelve other issuers: the six new ones push out the least recently used,
+    // then the last eight used are all cached
+    memset(&stats, 0, sizeof(stats));
+    bad = 0;
+    for (u32 i = 0; i < N_OTHER; i++) {
+        other_issuer(issuer, i);
+        make_ticket(&ticket, issuer, 2000 + i);
+        bad += validate(&ticket);
+    }
+    CHECK(!bad && (stats.db_opens == 6), "new issuers: %lu opens", (unsigned long) stats.db_opens);
+    memset(&stats, 0, sizeof(stats));
+    for (u32 i = N_OTHER - 8; i < N_OTHER; i++) {
+        other_issuer(issuer, i);
+        make_ticket(&ticket, issuer, 3000 + i);
+        bad += validate(&ticket);
+    }
+    CHECK(!bad && !stats.db_opens && (stats.rsa_ops == 8), "cached issuers: %lu opens", (unsigned long) stats.db_opens);
+    other_issuer(issuer, 0);
+    make_ticket(&ticket, issuer, 4000);
+    CHECK(!validate(&ticket) && (stats.db_opens == 1), "evicted issuer loaded again");
+
+    // the memo holds the last 32 verified blocks, older ones cost an RSA operation again
+    memset(&stats, 0, sizeof(stats));
+    for (u32 i = 0; i < 32; i++) validate(&tickets[i]);
+    for (u32 i = 0; i < 32; i++) validate(&tickets[i]);
+    CHECK(stats.rsa_ops == 32, "memo size: %lu RSA ops", (unsigned long) stats.rsa_ops);
+
+    return ht_done("cert");
+}
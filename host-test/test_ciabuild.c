@@ -0,0 +1,294 @@
+// BuildCiaFromGameFile() on synthetic NCCH / NCSD titles, one by one and as a batch (BeginCiaBatch()):
+// identical CIAs either way, certs.db reads, support file loads and heap traffic per title
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "testncch.h"
+#include "common.h"
+#include "vff.h"
+#include "rsa.h"
+#include "disadiff.h"
+#include "filetype.h"
+#include "support.h"
+#include "cert.h"
+#include "cia.h"
+#include "ncsd.h"
+#include "ticketdb.h"
+#include "nandcmac.h"
+#include "keydb.h"
+#include "gameutil.h"
+
+#define N_NCCH      12
+#define N_NCSD      4
+#define GAME_DIR    "0:/games"
+#define DB_SIZE     0x2000
+
+typedef struct {
+    u32 db_reads; // certs.db, through the DISA/DIFF layer
+    u32 support_loads;
+    u32 allocs;
+    u64 alloc_bytes;
+} BuildStats;
+
+static BuildStats stats;
+static u8 certs_db[DB_SIZE];
+
+void* __real_malloc(size_t size);
+void* __wrap_malloc(size_t size) {
+    stats.allocs++;
+    stats.alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+// support.c without the VRAM0 TAR, only the SD card path
+size_t LoadSupportFile(const char* fname, void* buffer, size_t max_len) {
+    char path[256];
+    UINT len;
+    stats.support_loads++;
+    snprintf(path, sizeof(path), "0:/gm9/support/%s", fname);
+    return (fvx_qread(path, buffer, 0, max_len, &len) == FR_OK) ? len : 0;
+}
+
+// the retail cert bundle is checked against its known hash, the synthetic one can't pass that:
+// cia.c's BuildCiaCert() / HoldCiaCert() without the hash check, same resident bundle while held
+static u8* ciacert_resident = NULL;
+
+u32 __wrap_BuildCiaCert(u8* ciacert) {
+    static const char* const issuers[] = {"Root-CA00000003", "Root-CA00000003-XS0000000c", "Root-CA00000003-CP0000000b"};
+    if (ciacert_resident) {
+        memcpy(ciacert, ciacert_resident, CIA_CERT_SIZE);
+        return 0;
+    }
+    size_t size = CIA_CERT_SIZE;
+    return (BuildRawCertBundleFromCertDb(ciacert, &size, issuers, 3) || (size != CIA_CERT_SIZE)) ? 1 : 0;
+}
+
+void __wrap_HoldCiaCert(bool hold) {
+    if (!hold) {
+        free(ciacert_resident);
+        ciacert_resident = NULL;
+    } else if (!ciacert_resident) {
+        u8* ciacert = (u8*) malloc(CIA_CERT_SIZE);
+        if (ciacert && (__wrap_BuildCiaCert(ciacert) == 0)) ciacert_resident = ciacert;
+        else free(ciacert);
+    }
+}
+
+// certs.db partition behind the DISA/DIFF layer, only the SysNAND one exists, no SEEDDB
+u32 GetDisaDiffRWInfo(const char* path, DisaDiffRWInfo* info, bool partitionB) {
+    (void) partitionB;
+    memset(info, 0, sizeof(DisaDiffRWInfo));
+    info->size_dpfs_lvl2 = 0x10;
+    return (strcmp(path, "1:/dbs/certs.db") == 0) ? 0 : 1;
+}
+
+u32 WriteDisaDiffIvfcLvl4(const char* path, const DisaDiffRWInfo* info, u32 offset, u32 size, const void* buffer) {
+    (void) path;
+    (void) info;
+    (void) offset;
+    (void) size;
+    (void) buffer;
+    return 0;
+}
+
+u32 BuildDisaDiffDpfsLvl2Cache(const char* path, const DisaDiffRWInfo* info, u8* cache, u32 cache_size) {
+    (void) path;
+    (void) info;
+    memset(cache, 0, cache_size);
+    return 0;
+}
+
+u32 ReadDisaDiffIvfcLvl4(const char* path, const DisaDiffRWInfo* info, u32 offset, u32 size, void* buffer) {
+    (void) info;
+    if (strcmp(path, "1:/dbs/certs.db") != 0) return 0;
+    stats.db_reads++;
+    if (offset + size > DB_SIZE) return 0;
+    memcpy(buffer, certs_db + offset, size);
+    return size;
+}
+
+// hostkeys.c without FindSeed(), seedsave.c is the real one here
+u32 LoadKeyFromFile(void* key, u32 keyslot, char type, char* id) {
+    (void) key;
+    (void) keyslot;
+    (void) type;
+    (void) id;
+    return 1;
+}
+
+// installs only, never reached from a CIA build
+u32 FixFileCmac(const char* path, bool check_perms) {
+    (void) path;
+    (void) check_perms;
+    return 1;
+}
+
+// RSA stand-in, nothing verifies: every CIA comes out as "standard"
+bool RSA_setKey2048(u8 keyslot, const u32* const mod, u32 exp) {
+    (void) keyslot;
+    (void) mod;
+    (void) exp;
+    return true;
+}
+
+bool RSA_verify2048(const u32* const encSig, const u32* const data, u32 size) {
+    (void) encSig;
+    (void) data;
+    (void) size;
+    return false;
+}
+
+// filetype.c pulls in everything, NCCH and NCSD by their magic are enough here
+u64 IdentifyFileType(const char* path) {
+    u8 header[0x200];
+    UINT br;
+    if ((fvx_qread(path, header, 0, sizeof(header), &br) != FR_OK) || (br != sizeof(header))) return 0;
+    if (memcmp(header + 0x100, "NCCH", 4) == 0) return GAME_NCCH;
+    if (memcmp(header + 0x100, "NCSD", 4) == 0) return GAME_NCSD;
+    return 0;
+}
+
+static u8* put_cert(u8* p, u32 sig_type, const char* issuer, const char* name, u32 seed) {
+    u32 sig_size = (sig_type == 0x10003) ? CERT_RSA4096_SIG_SIZE : CERT_RSA2048_SIG_SIZE;
+    memset(p, 0, sig_size + CERT_RSA2048_BODY_SIZE);
+    p[1] = 0x01;
+    p[3] = (u8) sig_type;
+    ht_fill(p + 4, sig_size - 4, seed);
+    CertificateBody* body = (CertificateBody*) (void*) (p + sig_size);
+    strcpy(body->issuer, issuer);
+    body->keytype[3] = 1; // RSA 2048
+    strcpy(body->name, name);
+    ht_fill(body->pub_key_data, 0x100, seed + 1);
+    body->pub_key_data[0x102] = 0x01; // exponent 0x10001
+    body->pub_key_data[0x103] = 0x01;
+    return p + sig_size + CERT_RSA2048_BODY_SIZE;
+}
+
+static void make_certs_db(void) {
+    u8* p = certs_db + 0x10;
+    memset(certs_db, 0, sizeof(certs_db));
+    p = put_cert(p, 0x10003, "Root", "CA00000003", 1);
+    p = put_cert(p, 0x10004, "Root-CA00000003", "XS0000000c", 3);
+    p = put_cert(p, 0x10004, "Root-CA00000003", "CP0000000b", 5);
+    u32 used = align(p - (certs_db + 0x10), 0x100);
+    memcpy(certs_db, "CERT", 4);
+    memcpy(certs_db + 8, &used, 4);
+}
+
+// encTitleKeys.bin with one entry per title, so no title falls through to the NAND ticket.db
+static void make_titlekeys(void) {
+    static TitleKeysInfo tikdb;
+    TitleKeysInfo* info = &tikdb;
+    memset(info, 0, sizeof(TitleKeysInfo));
+    info->n_entries = N_NCCH + N_NCSD;
+    for (u32 i = 0; i < info->n_entries; i++) {
+        u64 title_id = 0x0004000000123400ull + i;
+        for (u32 b = 0; b < 8; b++) info->entries[i].title_id[b] = (title_id >> ((7 - b) * 8)) & 0xFF;
+        ht_fill(info->entries[i].titlekey, 16, i + 1);
+    }
+    hostfs_write_file("0:/gm9/support/" TIKDB_NAME_ENC, info, 16 + (info->n_entries * sizeof(TitleKeyEntry)));
+}
+
+// NCCHs as .app, some of them inside an NCSD with one partition
+static void make_titles(void) {
+    char path[256];
+    fvx_rmkdir(GAME_DIR);
+    for (u32 i = 0; i < N_NCCH + N_NCSD; i++) {
+        TestNcch t;
+        char name[16];
+        snprintf(name, sizeof(name), "Title%02lu", (unsigned long) i);
+        make_ncch(&t, (256 << 10) + (i * 0x3000), name);
+        NcchHeader* ncch = (NcchHeader*) (void*) t.data;
+        ncch->partitionId = ncch->programId = 0x0004000000123400ull + i;
+        if (i < N_NCCH) {
+            snprintf(path, sizeof(path), GAME_DIR "/title%02lu.app", (unsigned long) i);
+            hostfs_write_file(path, t.data, t.size);
+        } else {
+            u32 size = NCSD_CNT0_OFFSET + t.size;
+            u8* data = calloc(size, 1);
+            NcsdHeader* ncsd = (NcsdHeader*) (void*) data;
+            memcpy(ncsd->magic, "NCSD", 4);
+            ncsd->size = size / NCSD_MEDIA_UNIT;
+            ncsd->mediaId = ncch->programId;
+            ncsd->partitions[0].offset = NCSD_CNT0_OFFSET / NCSD_MEDIA_UNIT;
+            ncsd->partitions[0].size = t.size / NCSD_MEDIA_UNIT;
+            memcpy(data + NCSD_CNT0_OFFSET, t.data, t.size);
+            snprintf(path, sizeof(path), GAME_DIR "/title%02lu.3ds", (unsigned long) i);
+            hostfs_write_file(path, data, size);
+            free(data);
+        }
+        free(t.data);
+    }
+}
+
+// hash of every built CIA, in title order
+static u32 hash_outputs(u8 hashes[][0x20]) {
+    static u8 data[4 << 20];
+    char path[256];
+    u32 n_found = 0;
+    for (u32 i = 0; i < N_NCCH + N_NCSD; i++) {
+        snprintf(path, sizeof(path), OUTPUT_PATH "/title%02lu.standard.cia", (unsigned long) i);
+        size_t size = hostfs_read_file(path, data, sizeof(data));
+        memset(hashes[i], 0, 0x20);
+        if (!size || (size == sizeof(data))) continue;
+        sha_quick(hashes[i], data, size, SHA256_MODE);
+        fvx_unlink(path);
+        n_found++;
+    }
+    return n_found;
+}
+
+static void report(const char* what, double secs) {
+    const u32 n = N_NCCH + N_NCSD;
+    printf("  %-8s %2lu titles: %5.2f ms/title, %4lu certs.db reads, %3lu support loads, %5lu allocs (%.1f MB)\n",
+        what, (unsigned long) n, secs * 1000 / n, (unsigned long) stats.db_reads, (unsigned long) stats.support_loads,
+        (unsigned long) stats.allocs, stats.alloc_bytes / 1048576.0);
+}
+
+int main(void) {
+    static u8 single[N_NCCH + N_NCSD][0x20];
+    static u8 batch[N_NCCH + N_NCSD][0x20];
+    char path[256];
+    const u32 n = N_NCCH + N_NCSD;
+
+    hostfs_init("build/fs_ciabuild");
+    make_certs_db();
+    make_titlekeys();
+    make_titles();
+
+    // one by one, as before batches
+    u32 n_fail = 0;
+    memset(&stats, 0, sizeof(stats));
+    double t0 = ht_now();
+    for (u32 i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), GAME_DIR "/title%02lu.%s", (unsigned long) i, (i < N_NCCH) ? "app" : "3ds");
+        if (BuildCiaFromGameFile(path, false) != 0) n_fail++;
+    }
+    double t1 = ht_now();
+    BuildStats single_stats = stats;
+    CHECK(!n_fail, "single: %lu failed", (unsigned long) n_fail);
+    CHECK(hash_outputs(single) == n, "single: all CIAs there");
+    report("single", t1 - t0);
+
+    // the whole folder as one batch
+    u32 n_built, n_failed;
+    memset(&stats, 0, sizeof(stats));
+    t0 = ht_now();
+    CHECK(BuildCiaFromGameDir(GAME_DIR, false, &n_built, &n_failed) == 0, "batch");
+    t1 = ht_now();
+    CHECK((n_built == n) && !n_failed, "batch: %lu built, %lu failed", (unsigned long) n_built,
+        (unsigned long) n_failed);
+    CHECK(hash_outputs(batch) == n, "batch: all CIAs there");
+    CHECK(memcmp(single, batch, sizeof(single)) == 0, "batch: same CIAs as one by one");
+    report("batch", t1 - t0);
+
+    // the cert bundle and the title key database once per batch, not once per title
+    CHECK(stats.support_loads < single_stats.support_loads / 4, "batch: %lu support loads",
+        (unsigned long) stats.support_loads);
+    CHECK(stats.db_reads < single_stats.db_reads, "batch: %lu certs.db reads", (unsigned long) stats.db_reads);
+    CHECK(stats.alloc_bytes < single_stats.alloc_bytes / 2, "batch: %.1f MB allocated",
+        stats.alloc_bytes / 1048576.0);
+    CHECK(!ciacert_resident && !hostfs_stats.open_files, "batch: nothing left held or open");
+
+    return ht_done("ciabuild");
+}
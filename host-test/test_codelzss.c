@@ -0,0 +1,219 @@
+// reverse LZSS (.code) codec: round trips, throttled progress, cancel, corrupt input, ratios
+#include "hosttest.h"
+#include "hostui.h"
+#include "common.h"
+#include "codelzss.h"
+
+// decoder loop as it was before the fast path (progress on every control byte), for reference
+static u32 RefDecompressCodeLzss(u8* code, u32* code_size, u32 max_size) {
+    u8* comp_start = code;
+    if ((*code_size < 8) || (*code_size > max_size)) return 1;
+    u32 off_size_comp = getle32(code + *code_size - 8);
+    u32 addsize_dec = getle32(code + *code_size - 4);
+    u32 comp_size = off_size_comp & 0xFFFFFF;
+    int comp_end = (int) comp_size - (int) ((off_size_comp >> 24) % 0xFF);
+    if (comp_size > *code_size) return 1;
+    comp_start += *code_size - comp_size;
+    if ((comp_end < 0) || (comp_size + addsize_dec > max_size)) return 1;
+
+    u8* data_end = comp_start + comp_size + addsize_dec;
+    u8* ptr_in = comp_start + comp_end;
+    u8* ptr_out = data_end;
+    while ((ptr_in > comp_start) && (ptr_out > comp_start)) {
+        if (ptr_out < ptr_in) return 1;
+        u8 ctrlbyte = *(--ptr_in);
+        for (int i = 7; i >= 0; i--) {
+            if ((ptr_in <= comp_start) || (ptr_out <= comp_start)) break;
+            if ((ctrlbyte >> i) & 0x1) {
+                ptr_in -= 2;
+                u16 seg_code = getle16(ptr_in);
+                if (ptr_in < comp_start) return 1;
+                u32 seg_off = (seg_code & 0x0FFF) + 2;
+                u32 seg_len = ((seg_code >> 12) & 0xF) + 3;
+                if ((ptr_out - seg_len < comp_start) || (ptr_out + seg_off >= data_end)) return 1;
+                for (u32 c = 0; c < seg_len; c++) {
+                    u8 byte = *(ptr_out + seg_off);
+                    *(--ptr_out) = byte;
+                }
+            } else {
+                if ((ptr_out == comp_start) || (ptr_in == comp_start)) return 1;
+                *(--ptr_out) = *(--ptr_in);
+            }
+        }
+    }
+    if ((ptr_in != comp_start) || (ptr_out != comp_start)) return 1;
+    *code_size = data_end - code;
+    return 0;
+}
+
+static u32 rnd(u32* x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// code-like test data: short literal runs and lots of near / far repeats
+static void gen_code(u8* buf, u32 size, u32 seed) {
+    u32 x = seed | 1;
+    for (u32 i = 0; i < size;) {
+        if ((i > 64) && (rnd(&x) % 4)) {
+            u32 far = rnd(&x) % 2;
+            u32 d = 1 + rnd(&x) % (far ? 4000 : 8);
+            u32 l = 3 + rnd(&x) % 20;
+            if (d > i) d = i;
+            for (u32 k = 0; (k < l) && (i < size); k++, i++) buf[i] = buf[i - d];
+        } else buf[i++] = (u8) (rnd(&x) % ((seed & 1) ? 256 : 16));
+    }
+}
+
+// compressed copy of src at the start of a max_size buffer, 0 if it didn't compress
+static u32 compress_to(u8* dst, const u8* src, u32 size, u32 level) {
+    u32 comp_size = size;
+    if (!CompressCodeLzssLevel(src, size, dst, &comp_size, level)) return 0;
+    return comp_size;
+}
+
+static void test_roundtrip(u32 size, u32 seed) {
+    u8* src = malloc(size);
+    u8* buf = malloc(size);
+    u8* ref = malloc(size);
+    if (!src || !buf || !ref) goto done;
+    gen_code(src, size, seed);
+
+    u32 comp_size = compress_to(buf, src, size, CODE_LZSS_DEFAULT);
+    CHECK(comp_size && (comp_size < size), "compress %lu", (unsigned long) size);
+    if (!comp_size) goto done;
+    CHECK(GetCodeLzssUncompressedSize(buf + comp_size - 8, comp_size) == size, "uncompressed size %lu", (unsigned long) size);
+    memcpy(ref, buf, comp_size);
+
+    u32 dec_size = comp_size;
+    hostui_reset();
+    CHECK(DecompressCodeLzss(buf, &dec_size, size) == 0, "decompress %lu", (unsigned long) size);
+    CHECK((dec_size == size) && (memcmp(buf, src, size) == 0), "decompressed data %lu", (unsigned long) size);
+    CHECK(hostui_stats.progress_calls <= (size / (64 * 1024)) + 2, "progress throttled (%lu calls)",
+        (unsigned long) hostui_stats.progress_calls);
+
+    u32 ref_size = comp_size;
+    CHECK((RefDecompressCodeLzss(ref, &ref_size, size) == 0) && (ref_size == size) && (memcmp(ref, src, size) == 0),
+        "reference decoder %lu", (unsigned long) size);
+
+    done:
+    free(src);
+    free(buf);
+    free(ref);
+}
+
+static void test_errors(void) {
+    const u32 size = 256 * 1024;
+    u8* src = malloc(size);
+    u8* buf = malloc(size);
+    gen_code(src, size, 7);
+    u32 comp_size = compress_to(buf, src, size, CODE_LZSS_DEFAULT);
+
+    // cancel, confirmed
+    u32 dec_size = comp_size;
+    hostui_reset();
+    hostui_cancel_after = 1;
+    CHECK(DecompressCodeLzss(buf, &dec_size, size) == 1, "cancel");
+    CHECK(hostui_stats.prompts == 1, "cancel prompt");
+
+    // cancel, declined: goes on
+    compress_to(buf, src, size, CODE_LZSS_DEFAULT);
+    dec_size = comp_size;
+    hostui_reset();
+    hostui_cancel_after = 1;
+    hostui_prompt_answer = false;
+    CHECK((DecompressCodeLzss(buf, &dec_size, size) == 0) && (memcmp(buf, src, size) == 0), "cancel declined");
+    hostui_reset();
+
+    // too small output buffer, broken footer, truncated input
+    compress_to(buf, src, size, CODE_LZSS_DEFAULT);
+    dec_size = comp_size;
+    CHECK(DecompressCodeLzss(buf, &dec_size, size - 1) == 1, "max size");
+    buf[comp_size - 6] ^= 0x40; // compressed size
+    dec_size = comp_size;
+    CHECK(DecompressCodeLzss(buf, &dec_size, size) == 1, "broken footer");
+    dec_size = 4;
+    CHECK(DecompressCodeLzss(buf + comp_size - 4, &dec_size, size) == 1, "truncated");
+
+    free(src);
+    free(buf);
+}
+
+static void bench_decode(void) {
+    const u32 size = 4 << 20;
+    u8* src = malloc(size);
+    u8* buf = malloc(size);
+    gen_code(src, size, 11);
+    u32 comp_size = compress_to(buf, src, size, CODE_LZSS_FAST);
+    u8* comp = malloc(comp_size);
+    memcpy(comp, buf, comp_size);
+
+    u32 dec_size = comp_size;
+    double t0 = ht_now();
+    DecompressCodeLzss(buf, &dec_size, size);
+    double t1 = ht_now();
+    memcpy(buf, comp, comp_size);
+    dec_size = comp_size;
+    double t2 = ht_now();
+    RefDecompressCodeLzss(buf, &dec_size, size);
+    double t3 = ht_now();
+    printf("  decode     %7.1f MB/s (reference loop %.1f MB/s)\n", 4 / (t1 - t0), 4 / (t3 - t2));
+
+    free(comp);
+    free(src);
+    free(buf);
+}
+
+// every level decodes back, higher levels don't compress worse
+static void test_levels(void) {
+    static const char* names[] = { "fast", "default", "optimal" };
+    const u32 size = 2 << 20;
+    u8* src = malloc(size);
+    u8* buf = malloc(size);
+    u32 comp_sizes[3] = { 0 };
+
+    for (u32 seed = 1; seed <= 2; seed++) {
+        gen_code(src, size, seed);
+        for (u32 level = CODE_LZSS_FAST; level <= CODE_LZSS_OPTIMAL; level++) {
+            hostui_reset();
+            double t0 = ht_now();
+            u32 comp_size = compress_to(buf, src, size, level);
+            double t1 = ht_now();
+            u32 dec_size = comp_size;
+            CHECK(comp_size && (DecompressCodeLzss(buf, &dec_size, size) == 0) && (dec_size == size) &&
+                (memcmp(buf, src, size) == 0), "level %lu round trip", (unsigned long) level);
+            comp_sizes[level] = comp_size;
+            printf("  %-8s %s  %5.1f%%  %7.1f ms\n", names[level], (seed & 1) ? "bytes " : "nibble",
+                comp_size * 100.0 / size, (t1 - t0) * 1000);
+        }
+        CHECK(comp_sizes[CODE_LZSS_DEFAULT] <= comp_sizes[CODE_LZSS_FAST], "default <= fast");
+        CHECK(comp_sizes[CODE_LZSS_OPTIMAL] <= comp_sizes[CODE_LZSS_DEFAULT], "optimal <= default");
+    }
+
+    // incompressible input is refused at every level
+    ht_fill(src, size, 3);
+    for (u32 level = CODE_LZSS_FAST; level <= CODE_LZSS_OPTIMAL; level++)
+        CHECK(!compress_to(buf, src, size, level), "incompressible, level %lu", (unsigned long) level);
+
+    // cancel while compressing
+    gen_code(src, size, 1);
+    hostui_reset();
+    hostui_cancel_after = 2;
+    CHECK(!compress_to(buf, src, size, CODE_LZSS_DEFAULT), "compress cancel");
+    hostui_reset();
+
+    free(src);
+    free(buf);
+}
+
+int main(void) {
+    static const u32 sizes[] = { 100, 4097, 65536, 100000, 700001, 2 << 20 };
+    for (u32 i = 0; i < countof(sizes); i++)
+        test_roundtrip(sizes[i], i + 1);
+    test_errors();
+    test_levels();
+    bench_decode();
+    return ht_done("codelzss");
+}
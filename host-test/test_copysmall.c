@@ -0,0 +1,120 @@
+// PathMoveCopy() of a folder with 10k small files (saves, extdata, homebrew): files smaller than a destination
+// cluster skip the preallocation, time, syncs, seeks and sector writes (as counted by hostfs) against copying
+// without a known cluster size (every file preallocated, as before), both give the same tree
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "ui.h"
+#include "fsutil.h"
+
+#define SRC_ROOT    "0:/src"
+#define DST_ROOT    "0:/dst"
+#define N_DIRS      100
+#define N_FILES     100 // per dir
+#define MAX_SIZE    (48 * 1024)
+#define CLUSTER_SEC 64 // 32kB clusters, as on most SD cards
+
+static FATFS dest_fs;
+static FATFS* mounted_fs = NULL;
+
+// hostdrive.c has no FatFs objects, this one only carries the cluster size
+FATFS* __wrap_GetMountedFSObject(const char* path) {
+    (void) path;
+    return mounted_fs;
+}
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+// mostly a few kB, some empty and every 16th above the cluster size
+static u32 make_tree(u64* size) {
+    static u8 data[MAX_SIZE];
+    char path[64];
+    u32 n_big = 0;
+    *size = 0;
+    fvx_mkdir(SRC_ROOT);
+    for (u32 d = 0; d < N_DIRS; d++) {
+        snprintf(path, sizeof(path), SRC_ROOT "/dir%02lu", (unsigned long) d);
+        fvx_mkdir(path);
+        for (u32 f = 0; f < N_FILES; f++) {
+            u32 fsize = (f % 16 == 15) ? MAX_SIZE - (rnd() % 1024) : (f % 10) ? rnd() % 4096 : 0;
+            snprintf(path, sizeof(path), SRC_ROOT "/dir%02lu/file%02lu.sav", (unsigned long) d, (unsigned long) f);
+            ht_fill(data, fsize, rnd());
+            hostfs_write_file(path, data, fsize);
+            if (fsize >= CLUSTER_SEC * 0x200) n_big++;
+            *size += fsize;
+        }
+    }
+    return n_big;
+}
+
+static u32 compare_trees(void) {
+    static u8 odata[MAX_SIZE], ddata[MAX_SIZE];
+    char opath[64], dpath[64];
+    u32 n_bad = 0;
+    for (u32 d = 0; d < N_DIRS; d++) {
+        for (u32 f = 0; f < N_FILES; f++) {
+            snprintf(opath, sizeof(opath), SRC_ROOT "/dir%02lu/file%02lu.sav", (unsigned long) d, (unsigned long) f);
+            snprintf(dpath, sizeof(dpath), DST_ROOT "/dir%02lu/file%02lu.sav", (unsigned long) d, (unsigned long) f);
+            size_t osize = hostfs_read_file(opath, odata, MAX_SIZE);
+            if ((fvx_stat(dpath, NULL) != FR_OK) || (hostfs_read_file(dpath, ddata, MAX_SIZE) != osize) ||
+                (memcmp(odata, ddata, osize) != 0)) n_bad++;
+        }
+    }
+    return n_bad;
+}
+
+static HostFsStats copy_tree(const char* name, FATFS* fs, double* ms) {
+    u32 flags = OVERWRITE_ALL;
+    PathDelete(DST_ROOT);
+    mounted_fs = fs;
+    hostfs_reset_stats();
+    hostui_reset();
+    double t0 = ht_now();
+    CHECK(PathMoveCopy(DST_ROOT, SRC_ROOT, &flags, false), "%s: copy", name);
+    double t1 = ht_now();
+    HostFsStats stats = hostfs_stats;
+    *ms = (t1 - t0) * 1000;
+    CHECK(!compare_trees() && !hostfs_stats.open_files, "%s: contents", name);
+    printf("  %-12s %6lu syncs, %6lu seeks, %6lu sector writes, %5lu progress calls, %.1f ms\n", name,
+        (unsigned long) stats.syncs, (unsigned long) stats.seeks, (unsigned long) stats.sector_writes,
+        (unsigned long) hostui_stats.progress_calls, *ms);
+    return stats;
+}
+
+int main(void) {
+    u64 tree_size;
+    double ms_prealloc, ms_small;
+
+    hostfs_init("build/fs_copysmall");
+    u32 n_big = make_tree(&tree_size);
+    u32 n_files = N_DIRS * N_FILES;
+    printf("  %lu files (%lu over a cluster) in %lu dirs, %.1f MB\n", (unsigned long) n_files,
+        (unsigned long) n_big, (unsigned long) N_DIRS, tree_size / 1048576.0);
+
+    // no cluster size known: every file preallocated with lseek + sync, back and sync again
+    HostFsStats prealloc = copy_tree("preallocate", NULL, &ms_prealloc);
+    memset(&dest_fs, 0, sizeof(dest_fs));
+    dest_fs.csize = CLUSTER_SEC;
+    HostFsStats small = copy_tree("small files", &dest_fs, &ms_small);
+
+    // each preallocation costs two syncs (origin and destination too), and two directory entry updates
+    // for files that get data, the data sectors are the same
+    CHECK(small.bytes_written == prealloc.bytes_written, "same data written");
+    CHECK(prealloc.syncs - small.syncs == 2 * (n_files - n_big), "syncs: %lu vs %lu",
+        (unsigned long) small.syncs, (unsigned long) prealloc.syncs);
+    CHECK(small.sector_writes < prealloc.sector_writes, "sector writes: %lu vs %lu",
+        (unsigned long) small.sector_writes, (unsigned long) prealloc.sector_writes);
+    printf("  per file: %.2f vs %.2f syncs, %.2f vs %.2f sector writes, x%.2f time\n",
+        (double) small.syncs / n_files, (double) prealloc.syncs / n_files,
+        (double) small.sector_writes / n_files, (double) prealloc.sector_writes / n_files, ms_prealloc / ms_small);
+
+    return ht_done("copysmall");
+}
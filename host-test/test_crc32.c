@@ -0,0 +1,75 @@
+// slicing-by-8 crc32_calculate() / crc32_combine() against zlib, every alignment
+#define crc32_combine zlib_crc32_combine // clashes with crc32.h
+#include <zlib.h>
+#undef crc32_combine
+#include "hosttest.h"
+#include "hostfs.h"
+#include "common.h"
+#include "crc32.h"
+
+#define CRC_PATH "0:/crc.bin"
+
+static u32 crc32_bytewise(u32 crc, const u8* data, u32 length) {
+    while (length--) crc = crc32_adjust(crc, *(data++));
+    return crc;
+}
+
+int main(void) {
+    static u8 buf[0x10000 + 16];
+    ht_fill(buf, sizeof(buf), 0x31);
+
+    // all start alignments, short (bytewise only) to long (slicing) lengths
+    static const u32 lengths[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 63, 64, 65, 255, 1000, 4099, 0x10000 };
+    for (u32 a = 0; a < 8; a++) {
+        for (u32 l = 0; l < countof(lengths); l++) {
+            const u8* data = buf + a;
+            u32 len = lengths[l];
+            u32 crc = crc32_calculate(~0, data, len) ^ ~0;
+            u32 ref = (u32) crc32(0, data, len);
+            CHECK(crc == ref, "align %lu length %lu: %08lX != %08lX", (unsigned long) a, (unsigned long) len,
+                (unsigned long) crc, (unsigned long) ref);
+        }
+    }
+
+    // incremental updates with odd splits give the same result
+    u32 crc = ~0;
+    for (u32 pos = 0, step = 1; pos < 0x10000; pos += step, step = (step * 3) % 97 + 1)
+        crc = crc32_calculate(crc, buf + pos, min(step, 0x10000 - pos));
+    CHECK((crc ^ ~0) == (u32) crc32(0, buf, 0x10000), "incremental");
+
+    // combine matches the crc of the concatenation
+    static const u32 splits[] = { 0, 1, 5, 16, 1000, 0x8000, 0xFFFF, 0x10000 };
+    for (u32 s = 0; s < countof(splits); s++) {
+        u32 n1 = splits[s];
+        u32 n2 = 0x10000 - n1;
+        u32 crc1 = crc32_calculate(~0, buf, n1) ^ ~0;
+        u32 crc2 = crc32_calculate(~0, buf + n1, n2) ^ ~0;
+        CHECK(crc32_combine(crc1, crc2, n2) == (u32) crc32(0, buf, 0x10000), "combine at %lu", (unsigned long) n1);
+    }
+
+    // from file, with an offset
+    hostfs_init("build/fs_crc32");
+    hostfs_write_file(CRC_PATH, buf, 0x10000);
+    CHECK(crc32_calculate_from_file(CRC_PATH, 3, 0x8000) == (u32) crc32(0, buf + 3, 0x8000), "from file");
+
+    // throughput: slicing vs. bytewise vs. zlib
+    const u32 size = 64 << 20;
+    u8* big = malloc(size);
+    if (big) {
+        ht_fill(big, size, 5);
+        double t0 = ht_now();
+        volatile u32 r0 = crc32_calculate(~0, big, size);
+        double t1 = ht_now();
+        volatile u32 r1 = crc32_bytewise(~0, big, size);
+        double t2 = ht_now();
+        volatile u32 r2 = (u32) crc32(0, big, size);
+        double t3 = ht_now();
+        CHECK((r0 == r1) && ((r0 ^ ~0) == r2), "64MB");
+        printf("  slicing  %7.1f MB/s\n", 64 / (t1 - t0));
+        printf("  bytewise %7.1f MB/s\n", 64 / (t2 - t1));
+        printf("  zlib     %7.1f MB/s\n", 64 / (t3 - t2));
+        free(big);
+    }
+
+    return ht_done("crc32");
+}
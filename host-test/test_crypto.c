@@ -0,0 +1,185 @@
+// known answer tests + throughput for the SOFT_CRYPTO AES / SHA backend
+// (FIPS-197, SP 800-38A, RFC 4493, FIPS 180-4)
+#include "hosttest.h"
+#include "common.h"
+#include "aes.h"
+#include "sha.h"
+
+#define SLOT 0x11
+
+static const char* nist_key = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char* nist_pt  = "6bc1bee22e409f96e93d7e117393172a" "ae2d8a571e03ac9c9eb76fac45af8e51"
+                              "30c81c46a35ce411e5fbc1191a0a52ef" "f69f2445df4f9b17ad2b417be66c3710";
+
+static void test_aes_kat(void) {
+    u8 key[16], pt[64], buf[64], exp[64], iv[16];
+
+    // FIPS-197 C.1
+    ht_unhex(key, "000102030405060708090a0b0c0d0e0f");
+    ht_unhex(pt, "00112233445566778899aabbccddeeff");
+    ht_unhex(exp, "69c4e0d86a7b0430d8cdb78070b4c55a");
+    setup_aeskey(SLOT, key);
+    use_aeskey(SLOT);
+    ecb_decrypt(pt, buf, 1, AES_CNT_ECB_ENCRYPT_MODE);
+    CHECK_MEM(buf, exp, 16, "FIPS-197 encrypt");
+    ecb_decrypt(buf, buf, 1, AES_CNT_ECB_DECRYPT_MODE);
+    CHECK_MEM(buf, pt, 16, "FIPS-197 decrypt");
+
+    // SP 800-38A F.1.1 / F.1.2 ECB
+    ht_unhex(key, nist_key);
+    ht_unhex(pt, nist_pt);
+    ht_unhex(exp, "3ad77bb40d7a3660a89ecaf32466ef97" "f5d3d58503b9699de785895a96fdbaaf"
+                  "43b1cd7f598ece23881b00e3ed030688" "7b0c785e27e8ad3f8223207104725dd4");
+    setup_aeskey(SLOT, key);
+    use_aeskey(SLOT);
+    ecb_decrypt(pt, buf, 4, AES_CNT_ECB_ENCRYPT_MODE);
+    CHECK_MEM(buf, exp, 64, "SP800-38A ECB encrypt");
+    ecb_decrypt(exp, buf, 4, AES_CNT_ECB_DECRYPT_MODE);
+    CHECK_MEM(buf, pt, 64, "SP800-38A ECB decrypt");
+
+    // F.2.1 / F.2.2 CBC
+    ht_unhex(exp, "7649abac8119b246cee98e9b12e9197d" "5086cb9b507219ee95db113a917678b2"
+                  "73bed6b8e3c1743b7116e69e22229516" "3ff1caa1681fac09120eca307586e1a7");
+    ht_unhex(iv, "000102030405060708090a0b0c0d0e0f");
+    cbc_encrypt(pt, buf, 4, AES_CNT_TITLEKEY_ENCRYPT_MODE, iv);
+    CHECK_MEM(buf, exp, 64, "SP800-38A CBC encrypt");
+    ht_unhex(iv, "000102030405060708090a0b0c0d0e0f");
+    cbc_decrypt(exp, buf, 4, AES_CNT_TITLEKEY_DECRYPT_MODE, iv);
+    CHECK_MEM(buf, pt, 64, "SP800-38A CBC decrypt");
+
+    // F.5.1 CTR, in one go, block by block and at odd byte offsets
+    ht_unhex(exp, "874d6191b620e3261bef6864990db6ce" "9806f66b7970fdff8617187bb9fffdff"
+                  "5ae4df3edbd5d35e5b4f09020db03eab" "1e031dda2fbe03d1792170a0f3009cee");
+    ht_unhex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    memcpy(buf, pt, 64);
+    ctr_decrypt(buf, buf, 4, AES_CNT_CTRNAND_MODE, iv);
+    CHECK_MEM(buf, exp, 64, "SP800-38A CTR");
+    ht_unhex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    for (u32 i = 0; i < 4; i++)
+        ctr_decrypt(pt + 16*i, buf + 16*i, 1, AES_CNT_CTRNAND_MODE, iv);
+    CHECK_MEM(buf, exp, 64, "SP800-38A CTR blockwise");
+    for (u32 off = 0; off < 64; off += 13) {
+        ht_unhex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+        memcpy(buf, pt, 64);
+        ctr_decrypt_byte(buf + off, buf + off, 64 - off, off, AES_CNT_CTRNAND_MODE, iv);
+        CHECK_MEM(buf + off, exp + off, 64 - off, "CTR byte offset %lu", (unsigned long) off);
+    }
+
+    // word order / endianness flags: TWL mode is CTR on fully reversed blocks
+    u8 rpt[16], rbuf[16], riv[16];
+    ht_unhex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    for (u32 i = 0; i < 16; i++) rpt[i] = pt[15-i];
+    set_ctr(iv);
+    aes_decrypt(rpt, rbuf, 1, AES_CNT_TWLNAND_MODE);
+    for (u32 i = 0; i < 16; i++) riv[i] = rbuf[15-i];
+    CHECK_MEM(riv, exp, 16, "TWL mode byte order");
+
+    // RFC 4493 CMAC (full blocks only, as in aes_cmac())
+    u8 mac[16];
+    ht_unhex(exp, "070a16b46b4d4144f79bdd9dd04a287c");
+    aes_cmac(pt, mac, 1);
+    CHECK_MEM(mac, exp, 16, "RFC4493 CMAC 16 byte");
+    ht_unhex(exp, "51f0bebf7e3b9d92fc49741779363cfe");
+    aes_cmac(pt, mac, 4);
+    CHECK_MEM(mac, exp, 16, "RFC4493 CMAC 64 byte");
+}
+
+static void test_keyslots(void) {
+    u8 keyx[16], keyy[16], pt[16], a[16], b[16];
+    ht_fill(keyx, 16, 1);
+    ht_fill(keyy, 16, 2);
+    ht_fill(pt, 16, 3);
+
+    // keyslot serial moves with every key write
+    u32 serial = aes_keyslot_serial(0x25);
+    setup_aeskeyX(0x25, keyx);
+    CHECK(aes_keyslot_serial(0x25) == serial + 1, "keyslot serial after keyX");
+    setup_aeskeyY(0x25, keyy);
+    CHECK(aes_keyslot_serial(0x25) == serial + 2, "keyslot serial after keyY");
+
+    // same keyX / keyY in two slots gives the same normal key, a different keyY doesn't
+    setup_aeskeyX(0x2C, keyx);
+    setup_aeskeyY(0x2C, keyy);
+    use_aeskey(0x25);
+    ecb_decrypt(pt, a, 1, AES_CNT_ECB_ENCRYPT_MODE);
+    use_aeskey(0x2C);
+    ecb_decrypt(pt, b, 1, AES_CNT_ECB_ENCRYPT_MODE);
+    CHECK_MEM(a, b, 16, "scrambler is deterministic");
+    keyy[0] ^= 1;
+    setup_aeskeyY(0x2C, keyy);
+    ecb_decrypt(pt, b, 1, AES_CNT_ECB_ENCRYPT_MODE);
+    CHECK(memcmp(a, b, 16) != 0, "scrambler depends on keyY");
+}
+
+static void test_sha_kat(void) {
+    static const char* abc = "abc";
+    static const char* abc448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    u8 res[32], exp[32];
+
+    ht_unhex(exp, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    sha_quick(res, abc, 3, SHA256_MODE);
+    CHECK_MEM(res, exp, 32, "SHA-256 abc");
+    CHECK(sha_cmp(exp, abc, 3, SHA256_MODE) == 0, "sha_cmp");
+    ht_unhex(exp, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    sha_quick(res, abc, 0, SHA256_MODE);
+    CHECK_MEM(res, exp, 32, "SHA-256 empty");
+    ht_unhex(exp, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    sha_quick(res, abc448, strlen(abc448), SHA256_MODE);
+    CHECK_MEM(res, exp, 32, "SHA-256 448 bit");
+    ht_unhex(exp, "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7");
+    sha_quick(res, abc, 3, SHA224_MODE);
+    CHECK_MEM(res, exp, 28, "SHA-224 abc");
+    ht_unhex(exp, "a9993e364706816aba3e25717850c26c9cd0d89d");
+    sha_quick(res, abc, 3, SHA1_MODE);
+    CHECK_MEM(res, exp, 20, "SHA-1 abc");
+    ht_unhex(exp, "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    sha_quick(res, abc448, strlen(abc448), SHA1_MODE);
+    CHECK_MEM(res, exp, 20, "SHA-1 448 bit");
+
+    // one million 'a', streamed in uneven chunks
+    static u8 a1m[1000000];
+    static const u32 chunks[] = { 1, 7, 63, 64, 65, 1000, 4097 };
+    memset(a1m, 'a', sizeof(a1m));
+    ht_unhex(exp, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    for (u32 c = 0; c < countof(chunks); c++) {
+        sha_init(SHA256_MODE);
+        for (u32 pos = 0; pos < sizeof(a1m); pos += chunks[c])
+            sha_update(a1m + pos, min(chunks[c], sizeof(a1m) - pos));
+        sha_get(res);
+        CHECK_MEM(res, exp, 32, "SHA-256 million a, chunk %lu", (unsigned long) chunks[c]);
+    }
+    ht_unhex(exp, "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+    sha_quick(res, a1m, sizeof(a1m), SHA1_MODE);
+    CHECK_MEM(res, exp, 20, "SHA-1 million a");
+}
+
+static void bench(void) {
+    const u32 size = 16 << 20;
+    u8* buf = malloc(size);
+    u8 key[16] = { 0 }, iv[16] = { 0 }, res[32];
+    if (!buf) return;
+    ht_fill(buf, size, 4);
+
+    setup_aeskey(SLOT, key);
+    use_aeskey(SLOT);
+    double t0 = ht_now();
+    ctr_decrypt(buf, buf, size / AES_BLOCK_SIZE, AES_CNT_CTRNAND_MODE, iv);
+    double t1 = ht_now();
+    sha_quick(res, buf, size, SHA256_MODE);
+    double t2 = ht_now();
+    sha_quick(res, buf, size, SHA1_MODE);
+    double t3 = ht_now();
+
+    printf("  aes-ctr  %7.1f MB/s\n", 16 / (t1 - t0));
+    printf("  sha-256  %7.1f MB/s\n", 16 / (t2 - t1));
+    printf("  sha-1    %7.1f MB/s\n", 16 / (t3 - t2));
+    free(buf);
+}
+
+int main(void) {
+    test_aes_kat();
+    test_keyslots();
+    test_sha_kat();
+    bench();
+    return ht_done("crypto");
+}
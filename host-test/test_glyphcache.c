@@ -0,0 +1,225 @@
+// DrawCharacter() from ui.c with and without the glyph cache (no cache: its allocation fails): hex viewer pages,
+// marked ranges, all characters in many colors (so the cache evicts) and a font change give the same framebuffers,
+// and the full screen hex viewer render time with and without the cache
+#include "hosttest.h"
+#include "common.h"
+#include "ui.h"
+#include "hid.h"
+#include "timer.h"
+#include "vram0.h"
+
+#define PAGE_SIZE   (16 * 32) // more than any hex viewer layout shows
+#define N_PAGES     24
+#define N_FRAMES    400
+
+static bool no_cache = false;
+static u32 cache_allocs = 0;
+
+// the glyph cache is the only calloc() in ui.c
+void* __real_calloc(size_t nmemb, size_t size);
+void* __wrap_calloc(size_t nmemb, size_t size) {
+    if (no_cache) return NULL;
+    cache_allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+u64 timer_start(void) { return 0; }
+u64 timer_ticks(u64 start_time) { (void) start_time; return 0; }
+u64 timer_msec(u64 start_time) { (void) start_time; return 0; }
+u64 timer_sec(u64 start_time) { (void) start_time; return 0; }
+void wait_msec(u64 msec) { (void) msec; }
+
+// no VRAM0 tar on the host, the font is set explicitly
+const char vram_data[1], vram_data_end[1];
+void* FindTarFileInfo(void* tardata, void* tardata_end, const char* fname, u64* fsize) {
+    (void) tardata;
+    (void) tardata_end;
+    (void) fname;
+    (void) fsize;
+    return NULL;
+}
+
+u32 InputWait(u32 timeout_sec) {
+    (void) timeout_sec;
+    return BUTTON_A;
+}
+
+bool CheckButton(u32 button) {
+    (void) button;
+    return false;
+}
+
+static u64 hash_screens(void) {
+    const u16* screens[2] = { TOP_SCREEN, BOT_SCREEN };
+    const u32 n_pixels[2] = { SCREEN_WIDTH_TOP * SCREEN_HEIGHT, SCREEN_WIDTH_BOT * SCREEN_HEIGHT };
+    u64 h = 0xCBF29CE484222325ULL; // FNV-1a
+    for (u32 s = 0; s < 2; s++)
+        for (u32 i = 0; i < n_pixels[s]; i++) h = (h ^ screens[s][i]) * 0x100000001B3ULL;
+    return h;
+}
+
+// random font of 16x16 characters in a PBM
+static bool set_font(u32 width, u32 height, u32 seed) {
+    static u8 pbm[32 + (16 * 8 * 16 * 10)];
+    u32 hdr = snprintf((char*) pbm, 32, "P4\n%lu %lu\n", (unsigned long) (16 * width), (unsigned long) (16 * height));
+    u32 size = ((16 * width + 7) / 8) * 16 * height;
+    ht_fill(pbm + hdr, size, seed);
+    return SetFont(pbm, hdr + size);
+}
+
+// hex viewer layouts as in FileHexViewer(), mode 0 (dual screen, 8 columns) and 2 (top screen, 16 columns)
+typedef struct {
+    u32 vpad, hlpad, hrpad, cols;
+    int x_off, x_hex, x_ascii;
+    bool dual_screen;
+} HexLayout;
+
+static HexLayout hex_layout(u32 mode) {
+    HexLayout l;
+    u32 fw = FONT_WIDTH_EXT;
+    if (mode == 2) {
+        l = (HexLayout) { .vpad = 1, .hlpad = 0, .hrpad = 1 + 8 - fw, .cols = 16, .x_off = -1, .x_hex = 0 };
+        l.x_ascii = SCREEN_WIDTH_TOP - (fw * l.cols);
+    } else {
+        l = (HexLayout) { .vpad = 2, .hlpad = 2, .hrpad = 2, .cols = 8, .dual_screen = true };
+        l.x_off = (SCREEN_WIDTH_TOP - SCREEN_WIDTH_BOT) / 2;
+        l.x_ascii = SCREEN_WIDTH_TOP - l.x_off - (fw * l.cols);
+        l.x_hex = (SCREEN_WIDTH_TOP - ((l.hlpad + (2*fw) + l.hrpad) * l.cols)) / 2;
+    }
+    return l;
+}
+
+// one screen of the hex viewer, drawn the way FileHexViewer() does
+static void draw_hexview(const HexLayout* l, const u8* data, u32 offset, s32 found_offset, u32 found_size) {
+    u32 fw = FONT_WIDTH_EXT;
+    u32 fh = FONT_HEIGHT_EXT;
+    u32 rows = (l->dual_screen ? 2 : 1) * SCREEN_HEIGHT / (fh + (2*l->vpad));
+    for (u32 row = 0; row < rows; row++) {
+        char ascii[16 + 1] = { 0 };
+        u32 y = row * (fh + (2*l->vpad)) + l->vpad;
+        u32 curr_pos = row * l->cols;
+        u16* screen = TOP_SCREEN;
+        u32 x0 = 0;
+
+        s32 marked0 = 0, marked1 = 0;
+        if ((found_size > 0) && (found_offset + (s32) found_size > (s32) curr_pos) &&
+            (found_offset < (s32) (curr_pos + l->cols))) {
+            marked0 = found_offset - curr_pos;
+            marked1 = marked0 + found_size;
+            if (marked0 < 0) marked0 = 0;
+            if (marked1 > (s32) l->cols) marked1 = (s32) l->cols;
+        }
+
+        if (y >= SCREEN_HEIGHT) {
+            y -= SCREEN_HEIGHT;
+            screen = BOT_SCREEN;
+            x0 = 40;
+        }
+
+        memcpy(ascii, data + curr_pos, l->cols);
+        for (u32 col = 0; col < l->cols; col++)
+            if (ascii[col] == 0x00) ascii[col] = ' ';
+
+        if (l->x_off >= 0) DrawStringF(screen, l->x_off - x0, y, COLOR_HVOFFS, COLOR_STD_BG, "%08X",
+            (unsigned int) (offset + curr_pos));
+        if (l->x_ascii >= 0) {
+            for (u32 i = 0; i < l->cols; i++)
+                DrawCharacter(screen, ascii[i], l->x_ascii - x0 + (fw * i), y, COLOR_HVASCII, COLOR_STD_BG);
+            for (u32 i = (u32) marked0; i < (u32) marked1; i++)
+                DrawCharacter(screen, ascii[i % l->cols], l->x_ascii - x0 + (fw * i), y, COLOR_MARKED, COLOR_STD_BG);
+        }
+
+        for (u32 col = 0; (col < l->cols) && (l->x_hex >= 0); col++) {
+            u32 x = (l->x_hex + l->hlpad) + (((2*fw) + l->hrpad + l->hlpad) * col) - x0;
+            u32 hex_color = (((s32) col >= marked0) && ((s32) col < marked1)) ? COLOR_MARKED : COLOR_HVHEX(col);
+            DrawStringF(screen, x, y, hex_color, COLOR_STD_BG, "%02X", (unsigned int) data[curr_pos + col]);
+        }
+    }
+}
+
+// every character (but NUL, never drawn) in more colors than the cache holds, at every y parity,
+// also transparent
+static u64 draw_chars(void) {
+    ClearScreen(TOP_SCREEN, COLOR_STD_BG);
+    for (u32 c = 1; c < 0x100; c++) {
+        u32 x = (c % 48) * FONT_WIDTH_EXT;
+        u32 y = (c / 48) * (FONT_HEIGHT_EXT + 1) + (c % 3);
+        u32 color = RGB(c, 0xFF - c, (c * 7) & 0xFF);
+        DrawCharacter(TOP_SCREEN, c, x, y, color, (c % 5) ? COLOR_STD_BG : COLOR_TRANSPARENT);
+        DrawCharacter(TOP_SCREEN, c, x, y + 120, COLOR_WHITE, color);
+    }
+    return hash_screens();
+}
+
+// everything DrawCharacter() gets used for here, one framebuffer hash per step
+static u32 draw_all(u64* hashes) {
+    static u8 data[N_PAGES * PAGE_SIZE];
+    const u32 fonts[2][2] = { { 8, 8 }, { 6, 9 } }; // odd height: columns start unaligned every other row
+    u32 n = 0;
+
+    for (u32 f = 0; f < 2; f++) {
+        if (!set_font(fonts[f][0], fonts[f][1], 0xF0A7 + f)) return 0;
+        ht_fill(data, sizeof(data), 0xDA7A);
+
+        // the hex viewer of the second font starts on what the first one left in the cache
+        if (f == 0) hashes[n++] = draw_chars();
+
+        // hex viewer pages in both layouts, with a marked range moving through
+        for (u32 mode = 0; mode <= 2; mode += 2) {
+            HexLayout l = hex_layout(mode);
+            ClearScreen(TOP_SCREEN, COLOR_STD_BG);
+            ClearScreen(BOT_SCREEN, COLOR_STD_BG);
+            for (u32 p = 0; p < N_PAGES; p++) {
+                draw_hexview(&l, data + (p * PAGE_SIZE), p * PAGE_SIZE, (p * 37) % PAGE_SIZE - 20, 3 + p);
+                hashes[n++] = hash_screens();
+            }
+        }
+
+        if (f == 1) hashes[n++] = draw_chars();
+    }
+
+    return n;
+}
+
+// full screen hex viewer renders per second
+static double bench(u32 mode) {
+    static u8 data[N_PAGES * PAGE_SIZE];
+    HexLayout l = hex_layout(mode);
+    ht_fill(data, sizeof(data), 0xBE7C);
+    double t0 = ht_now();
+    for (u32 i = 0; i < N_FRAMES; i++)
+        draw_hexview(&l, data + ((i % N_PAGES) * PAGE_SIZE), (i % N_PAGES) * PAGE_SIZE, -1, 0);
+    double t1 = ht_now();
+    return N_FRAMES / (t1 - t0);
+}
+
+int main(void) {
+    static u64 hash_plain[128], hash_cached[128];
+
+    no_cache = true;
+    u32 n_plain = draw_all(hash_plain);
+    no_cache = false;
+    u32 n_cached = draw_all(hash_cached);
+    CHECK(n_plain && (n_plain == n_cached), "%lu / %lu steps", (unsigned long) n_plain, (unsigned long) n_cached);
+    CHECK(cache_allocs == 1, "cache allocated %lu times", (unsigned long) cache_allocs);
+
+    u32 n_bad = 0;
+    for (u32 i = 0; i < n_plain; i++) {
+        if (hash_plain[i] == hash_cached[i]) continue;
+        if (!n_bad++) fprintf(stderr, "  first mismatch at step %lu\n", (unsigned long) i);
+    }
+    CHECK(!n_bad, "cached glyphs: %lu of %lu screens differ", (unsigned long) n_bad, (unsigned long) n_plain);
+
+    // hex viewer with the 8x8 font
+    CHECK(set_font(8, 8, 0xF0A7), "font");
+    for (u32 mode = 0; mode <= 2; mode += 2) {
+        no_cache = true;
+        double fps_plain = bench(mode);
+        no_cache = false;
+        double fps_cached = bench(mode);
+        printf("  hex viewer mode %lu, full screen renders: %.0f/s uncached, %.0f/s cached (x%.2f)\n",
+            (unsigned long) mode, fps_plain, fps_cached, fps_cached / fps_plain);
+    }
+
+    return ht_done("glyphcache");
+}
@@ -0,0 +1,192 @@
+// IPS patches built on the fly (plain and RLE records, growing past the source, truncate record), applied through hostfs
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "ips.h"
+
+#define SRC_PATH "0:/ips/source.bin"
+#define DST_PATH "0:/ips/target.bin"
+#define IPS_PATH "0:/ips/patch.ips"
+
+typedef struct {
+    u32 src_size;
+    u32 records;
+    u32 grow; // records may reach this far past the source end
+    u32 truncate; // 0: no truncate record
+} IpsTest;
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static u8* put24(u8* p, u32 v) {
+    *(p++) = (u8) (v >> 16);
+    *(p++) = (u8) (v >> 8);
+    *(p++) = (u8) v;
+    return p;
+}
+
+static u8* put16(u8* p, u32 v) {
+    *(p++) = (u8) (v >> 8);
+    *(p++) = (u8) v;
+    return p;
+}
+
+// builds the patch and applies it to a copy of src in memory, that is the expected result
+static u32 make_patch(const IpsTest* t, const u8* src, u8* ips, u8* dst, u32* dst_size, u32* rle_count) {
+    u32 span = t->truncate ? min(t->truncate, t->src_size + t->grow) : t->src_size + t->grow;
+    u32 out_size = t->src_size;
+    u32 rec_end = 0;
+    u32 offset = 0;
+    u8* p = ips;
+
+    memcpy(dst, src, t->src_size);
+    memcpy(p, "PATCH", 5);
+    p += 5;
+    for (u32 r = 0; r < t->records; r++) {
+        offset += rnd() % (2 * span / t->records);
+        if (offset == 0x454F46) offset++; // that is "EOF"
+        u32 size = 1 + rnd() % ((rnd() % 8) ? 32 : 2000);
+        if (offset + size > span) break;
+        p = put24(p, offset);
+        if (rnd() % 4 == 0) { // RLE
+            u8 val = (u8) rnd();
+            p = put16(p, 0);
+            p = put16(p, size);
+            *(p++) = val;
+            memset(dst + offset, val, size);
+            (*rle_count)++;
+        } else {
+            p = put16(p, size);
+            for (u32 i = 0; i < size; i++) dst[offset + i] = *(p++) = (u8) rnd();
+        }
+        rec_end = offset + size;
+        if (offset + size > out_size) {
+            if (offset > out_size) memset(dst + out_size, 0, offset - out_size); // gap is zero filled
+            out_size = offset + size;
+        }
+        offset += size;
+    }
+    memcpy(p, "EOF", 3);
+    p += 3;
+    if (t->truncate) {
+        p = put24(p, t->truncate); // records all end below it
+        out_size = max(rec_end, min(t->src_size, t->truncate)); // cuts the source, never grows it
+    }
+    *dst_size = out_size;
+    return p - ips;
+}
+
+static bool check_output(const char* path, const u8* dst, u32 dst_size) {
+    u8* out = malloc(dst_size + 1);
+    bool ok = out && (fvx_qsize(path) == dst_size) &&
+        (hostfs_read_file(path, out, dst_size) == dst_size) &&
+        (memcmp(out, dst, dst_size) == 0);
+    free(out);
+    return ok;
+}
+
+static void test_apply(const IpsTest* t, u32 seed) {
+    u32 buf_size = t->src_size + t->grow + 2048;
+    u8* src = malloc(t->src_size);
+    u8* dst = malloc(buf_size);
+    u8* ips = malloc(t->records * 2048 + 16);
+    u32 dst_size, rle_count = 0;
+
+    rnd_state = seed;
+    ht_fill(src, t->src_size, seed);
+    u32 ips_size = make_patch(t, src, ips, dst, &dst_size, &rle_count);
+    hostfs_write_file(SRC_PATH, src, t->src_size);
+    hostfs_write_file(IPS_PATH, ips, ips_size);
+
+    hostfs_reset_stats();
+    hostui_reset();
+    double t0 = ht_now();
+    CHECK(ApplyIPSPatch(IPS_PATH, SRC_PATH, DST_PATH) == 0, "apply %lu records", (unsigned long) t->records);
+    double t1 = ht_now();
+    CHECK(check_output(DST_PATH, dst, dst_size), "output %lu -> %lu", (unsigned long) t->src_size, (unsigned long) dst_size);
+    printf("  %7lu -> %7lu: %5lu records (%lu RLE), %4lu reads, %5lu writes, %6.1f ms\n",
+        (unsigned long) t->src_size, (unsigned long) dst_size, (unsigned long) t->records, (unsigned long) rle_count,
+        (unsigned long) hostfs_stats.reads, (unsigned long) hostfs_stats.writes, (t1 - t0) * 1000);
+    // the patch goes through the window twice (scan, apply), source is copied in big blocks
+    CHECK(hostfs_stats.reads <= 2 * (ips_size / (64 * 1024) + 1) + t->src_size / STD_BUFFER_SIZE + 2, "windowed reads");
+
+    // in place, the output file is the input
+    hostfs_write_file(DST_PATH, src, t->src_size);
+    CHECK((ApplyIPSPatch(IPS_PATH, DST_PATH, DST_PATH) == 0) && check_output(DST_PATH, dst, dst_size), "in place");
+
+    free(src);
+    free(dst);
+    free(ips);
+}
+
+static void test_errors(void) {
+    static u8 src[4096];
+    u8 ips[64], *p = ips;
+    ht_fill(src, sizeof(src), 9);
+    hostfs_write_file(SRC_PATH, src, sizeof(src));
+
+    // offsets going backwards are applied, but reported
+    memcpy(p, "PATCH", 5);
+    p = put16(put24(p + 5, 100), 1);
+    *(p++) = 0xAA;
+    p = put16(put24(p, 10), 1);
+    *(p++) = 0xBB;
+    memcpy(p, "EOF", 3);
+    hostfs_write_file(IPS_PATH, ips, p + 3 - ips);
+    CHECK(ApplyIPSPatch(IPS_PATH, SRC_PATH, DST_PATH) != 0, "scrambled");
+
+    // missing EOF, bad magic, RLE record of size 0
+    hostfs_write_file(IPS_PATH, ips, p - ips);
+    CHECK(ApplyIPSPatch(IPS_PATH, SRC_PATH, DST_PATH) != 0, "missing EOF");
+    ips[0] = 'X';
+    hostfs_write_file(IPS_PATH, ips, p + 3 - ips);
+    CHECK(ApplyIPSPatch(IPS_PATH, SRC_PATH, DST_PATH) != 0, "bad magic");
+    p = ips;
+    memcpy(p, "PATCH", 5);
+    p = put16(put16(put24(p + 5, 0), 0), 0);
+    *(p++) = 0;
+    memcpy(p, "EOF", 3);
+    hostfs_write_file(IPS_PATH, ips, p + 3 - ips);
+    CHECK(ApplyIPSPatch(IPS_PATH, SRC_PATH, DST_PATH) != 0, "empty RLE");
+
+    // cancel
+    IpsTest t = { 100000, 200, 0, 0 };
+    u8* buf = malloc(4 * t.src_size);
+    u8* dst = malloc(t.src_size + 2048);
+    u32 dst_size, rle_count = 0;
+    ht_fill(buf, t.src_size, 10);
+    hostfs_write_file(SRC_PATH, buf, t.src_size);
+    u32 ips_size = make_patch(&t, buf, buf + t.src_size, dst, &dst_size, &rle_count);
+    hostfs_write_file(IPS_PATH, buf + t.src_size, ips_size);
+    hostui_reset();
+    hostui_cancel_after = 10;
+    CHECK(ApplyIPSPatch(IPS_PATH, SRC_PATH, DST_PATH) != 0, "cancel");
+    hostui_reset();
+    free(buf);
+    free(dst);
+}
+
+int main(void) {
+    static const IpsTest tests[] = {
+        { 1000, 4, 0, 0 },
+        { 100000, 300, 0, 0 },
+        { 100000, 300, 50000, 0 }, // grows, gaps get zero filled
+        { 300000, 1000, 0, 200000 }, // truncate record cuts the source
+        { 300000, 1000, 0, 350000 }, // but doesn't extend it
+        { 4 << 20, 20000, 1 << 20, 0 },
+    };
+
+    hostfs_init("build/fs_ips");
+    for (u32 i = 0; i < countof(tests); i++)
+        test_apply(&tests[i], 0x77 + i);
+    test_errors();
+
+    return ht_done("ips");
+}
@@ -0,0 +1,141 @@
+// Lua progress callbacks (gm9progress.c): arguments, cancel by returning false, errors rethrown after the
+// operation, out of memory inside the hook cancels instead of unwinding through C, and the callback overhead per GB
+#include "hosttest.h"
+#include "hostui.h"
+#include "common.h"
+#include "ui.h"
+#include "gm9progress.h"
+
+#define OP_STEP     (64 * 1024)
+#define GB          (1024ULL * 1024 * 1024)
+
+static bool alloc_fail = false;
+static u32 ops_open = 0; // operations that didn't get to their cleanup
+
+static void* test_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    (void) ud;
+    (void) osize;
+    if (!nsize) {
+        free(ptr);
+        return NULL;
+    }
+    if (alloc_fail) return NULL;
+    return realloc(ptr, nsize);
+}
+
+// op(total, opts [, oom]): walks 0..total in OP_STEP steps like a copy would
+static int test_op(lua_State* L) {
+    static u32 n_op = 0;
+    char opstr[32];
+    u64 total = luaL_checkinteger(L, 1);
+    bool oom = lua_toboolean(L, 3);
+    lua_settop(L, 2);
+
+    LuaProgress prog;
+    StartLuaProgress(L, lua_istable(L, 2) ? 2 : 0, &prog);
+    ops_open++;
+    for (u64 current = 0; current <= total; current += OP_STEP) {
+        // a fresh opstr for every call, so pushing it always allocates
+        snprintf(opstr, sizeof(opstr), "op %lu", (unsigned long) n_op++);
+        alloc_fail = oom;
+        bool cont = ShowProgress(current, total, opstr);
+        alloc_fail = false;
+        if (!cont) break;
+    }
+    ops_open--;
+    if (EndLuaProgress(L, &prog)) return PushLuaProgressCancel(L, &prog, false);
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+static bool run(lua_State* L, const char* code) {
+    if (luaL_dostring(L, code) == LUA_OK) return true;
+    fprintf(stderr, "  %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return false;
+}
+
+static lua_Integer get_int(lua_State* L, const char* name) {
+    lua_getglobal(L, name);
+    lua_Integer res = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return res;
+}
+
+static bool get_bool(lua_State* L, const char* name) {
+    lua_getglobal(L, name);
+    bool res = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    return res;
+}
+
+// ms per simulated GB, ShowProgress every OP_STEP
+static double bench(lua_State* L, const char* opts, u32* callbacks) {
+    char code[256];
+    snprintf(code, sizeof(code), "calls = 0; res = op(%llu, %s)", GB, opts);
+    double t0 = ht_now();
+    bool ok = run(L, code);
+    double t1 = ht_now();
+    *callbacks = get_int(L, "calls");
+    return ok && get_bool(L, "res") ? (t1 - t0) * 1000 : -1;
+}
+
+int main(void) {
+    lua_State* L = lua_newstate(test_alloc, NULL);
+    if (!L) return 1;
+    luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+    luaL_requiref(L, LUA_STRLIBNAME, luaopen_string, 1);
+    lua_pop(L, 2);
+    lua_register(L, "op", test_op);
+
+    // callback gets current, total and the operation, the first and last call always go through
+    CHECK(run(L, "calls = 0; res = op(10 * 65536, { progress_interval = 4 * 65536, progress = function(c, t, s) "
+        "calls = calls + 1; last_c, last_t, last_s = c, t, s end })"), "args");
+    CHECK(get_bool(L, "res") && (get_int(L, "calls") == 4) && (get_int(L, "last_c") == 10 * 65536) &&
+        (get_int(L, "last_t") == 10 * 65536), "args: %ld calls", (long) get_int(L, "calls"));
+    lua_getglobal(L, "last_s");
+    CHECK(lua_isstring(L, -1) && (strncmp(lua_tostring(L, -1), "op ", 3) == 0), "args: opstr");
+    lua_pop(L, 1);
+
+    // no return value continues, an explicit false cancels with the state of the last call
+    CHECK(run(L, "calls = 0; res, info = op(10 * 65536, { progress_interval = 0, progress = function(c) "
+        "calls = calls + 1; if calls == 3 then return false end end })"), "cancel");
+    CHECK(!get_bool(L, "res") && (get_int(L, "calls") == 3), "cancel: %ld calls", (long) get_int(L, "calls"));
+    CHECK(run(L, "ok = info.cancelled and info.current == 2 * 65536 and info.total == 10 * 65536") &&
+        get_bool(L, "ok"), "cancel: info");
+
+    // errors stop the operation, which still cleans up, and are raised after it
+    CHECK(run(L, "calls = 0; ok, err = pcall(op, 10 * 65536, { progress_interval = 0, progress = function(c) "
+        "calls = calls + 1; if calls == 2 then error('boom', 0) end end })"), "error");
+    lua_getglobal(L, "err");
+    CHECK(!get_bool(L, "ok") && lua_isstring(L, -1) && (strcmp(lua_tostring(L, -1), "boom") == 0) &&
+        (get_int(L, "calls") == 2), "error: rethrown");
+    lua_pop(L, 1);
+    CHECK(!ops_open, "error: operation cleaned up");
+
+    // out of memory in the hook itself: a plain cancel, no error unwinding through the operation
+    ops_open = 0;
+    CHECK(run(L, "calls = 0; ok, res, info = pcall(op, 10 * 65536, { progress_interval = 0, progress = function(c) "
+        "calls = calls + 1 end }, true)"), "oom");
+    CHECK(get_bool(L, "ok") && !get_bool(L, "res") && !get_int(L, "calls"), "oom: cancelled, %ld calls",
+        (long) get_int(L, "calls"));
+    CHECK(!ops_open, "oom: operation cleaned up");
+
+    // still usable afterwards
+    CHECK(run(L, "res = op(65536, { progress = function() end })") && get_bool(L, "res"), "after oom");
+
+    // callback overhead, 1 GB in OP_STEP steps
+    u32 calls_none, calls_1m, calls_64k;
+    run(L, "function count() calls = calls + 1 end");
+    double t_none = bench(L, "nil", &calls_none);
+    double t_1m = bench(L, "{ progress = count }", &calls_1m);
+    double t_64k = bench(L, "{ progress_interval = 65536, progress = count }", &calls_64k);
+    CHECK((t_none >= 0) && (t_1m >= 0) && (t_64k >= 0), "benchmark");
+    CHECK(!calls_none && (calls_1m == GB / LUA_PROGRESS_INTERVAL + 1) && (calls_64k == GB / OP_STEP + 1),
+        "benchmark: %lu / %lu callbacks", (unsigned long) calls_1m, (unsigned long) calls_64k);
+    printf("  callback overhead per GB: %.3f ms at 1MB (%lu calls), %.3f ms at 64kB (%lu calls), %.3f ms base\n",
+        t_1m - t_none, (unsigned long) calls_1m, t_64k - t_none, (unsigned long) calls_64k, t_none);
+
+    lua_close(L);
+    return ht_done("luaprogress");
+}
@@ -0,0 +1,167 @@
+// fs.walk / fs.dir (gm9fs.c) on a synthetic 100k file tree: every entry once, only the current branch open,
+// early exit closes everything, and time and peak Lua memory against a recursive fs.list_dir walk
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "fsutil.h"
+#include "nandcmac.h"
+#include "gm9fs.h"
+
+#define TREE_ROOT   "0:/tree"
+#define TREE_STAMP  "0:/tree.done" // outside the tree
+#define N_TOP       10
+#define N_SUB       10
+#define N_FILES     1000 // per subdir
+#define N_DIRS      (N_TOP + (N_TOP * N_SUB))
+#define N_ENTRIES   (N_DIRS + (N_TOP * N_SUB * N_FILES))
+
+static size_t mem_now = 0;
+static size_t mem_peak = 0;
+
+static void* count_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    (void) ud;
+    if (!ptr) osize = 0;
+    if (!nsize) {
+        free(ptr);
+        mem_now -= osize;
+        return NULL;
+    }
+    void* res = realloc(ptr, nsize);
+    if (!res) return NULL;
+    mem_now += nsize - osize;
+    if (mem_now > mem_peak) mem_peak = mem_now;
+    return res;
+}
+
+// everything below is only reachable through other fs functions
+u32 AutoEmuNandBase(bool reset) { (void) reset; return 1; }
+u32 BeginCiaBatch(void) { return 1; }
+void EndCiaBatch(void) { }
+u32 BuildCiaFromGameFile(const char* path, bool force_legit) { (void) path; (void) force_legit; return 1; }
+u32 BuildNandBackupBase(const char* path_nand, const char* path_base) { (void) path_nand; (void) path_base; return 1; }
+u32 BuildNandBackupDelta(const char* path_nand, const char* path_base, const char* path_delta, u32* changed, u32* total) {
+    (void) path_nand; (void) path_base; (void) path_delta; (void) changed; (void) total;
+    return 1;
+}
+u32 RestoreNandBackupDelta(const char* path_base, const char* path_delta, const char* path_out) {
+    (void) path_base; (void) path_delta; (void) path_out;
+    return 1;
+}
+u32 ValidateNandDump(const char* path) { (void) path; return 1; }
+u32 DumpSparseImage(const char* path_src, const char* path_dst, u64* stored) {
+    (void) path_src; (void) path_dst; (void) stored;
+    return 1;
+}
+u32 ExpandSparseImage(const char* path_src, const char* path_dst) { (void) path_src; (void) path_dst; return 1; }
+u32 VerifyGameFile(const char* path) { (void) path; return 1; }
+u64 IdentifyFileType(const char* path) { (void) path; return 0; }
+u32 RecursiveFixFileCmac(const char* path) { (void) path; return 1; }
+void TreeVisitorCmac(TreeVisitor* visitor, TreeCmacInfo* info) { (void) visitor; (void) info; }
+bool CheckSDMountState(void) { return true; }
+bool InitSDCardFS() { return true; }
+void DeinitSDCardFS() { }
+void DeinitExtFS() { }
+uint64_t GetFreeSpace(const char* path) { (void) path; return 0; }
+uint64_t GetTotalSpace(const char* path) { (void) path; return 0; }
+u32 InputWait(u32 timeout_sec) { (void) timeout_sec; return 0; }
+
+static void make_tree(void) {
+    char path[64];
+    fvx_mkdir(TREE_ROOT);
+    for (u32 t = 0; t < N_TOP; t++) {
+        snprintf(path, sizeof(path), TREE_ROOT "/top%lu", (unsigned long) t);
+        fvx_mkdir(path);
+        for (u32 s = 0; s < N_SUB; s++) {
+            snprintf(path, sizeof(path), TREE_ROOT "/top%lu/sub%lu", (unsigned long) t, (unsigned long) s);
+            fvx_mkdir(path);
+            for (u32 f = 0; f < N_FILES; f++) {
+                snprintf(path, sizeof(path), TREE_ROOT "/top%lu/sub%lu/file%04lu.%s", (unsigned long) t,
+                    (unsigned long) s, (unsigned long) f, (f % 4) ? "bin" : "txt");
+                hostfs_write_file(path, "x", f % 2);
+            }
+        }
+    }
+    hostfs_write_file(TREE_STAMP, "", 0);
+}
+
+static bool run(lua_State* L, const char* code) {
+    if (luaL_dostring(L, code) == LUA_OK) return true;
+    fprintf(stderr, "  %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return false;
+}
+
+static lua_Integer get_int(lua_State* L, const char* name) {
+    lua_getglobal(L, name);
+    lua_Integer res = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return res;
+}
+
+// runs a walk that counts into n / files / size, returns peak memory over the start in kB, -1 on error
+static double bench(lua_State* L, const char* name, const char* code, lua_Integer n_expected) {
+    lua_gc(L, LUA_GCCOLLECT);
+    size_t mem_start = mem_now;
+    mem_peak = mem_now;
+    hostfs_reset_stats();
+    double t0 = ht_now();
+    bool ok = run(L, code);
+    double t1 = ht_now();
+    double peak = (mem_peak - mem_start) / 1024.0;
+    lua_Integer n = get_int(L, "n");
+    CHECK(ok && (n == n_expected), "%s: %ld entries, expected %ld", name, (long) n, (long) n_expected);
+    printf("  %-22s %6ld entries, %7.1f ms, peak %8.1f kB, max %lu dirs open\n", name, (long) n, (t1 - t0) * 1000,
+        peak, (unsigned long) hostfs_stats.max_open_dirs);
+    run(L, "n = nil; all = nil");
+    return ok ? peak : -1;
+}
+
+int main(void) {
+    lua_State* L = lua_newstate(count_alloc, NULL);
+    if (!L) return 1;
+    luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+    luaL_requiref(L, GM9LUA_FSLIBNAME, gm9lua_open_fs, 1);
+    lua_pop(L, 2);
+
+    // the tree is only built once, it takes a while on most host filesystems
+    hostfs_attach("build/fs_luawalk");
+    if (fvx_stat(TREE_STAMP, NULL) != FR_OK) {
+        hostfs_init("build/fs_luawalk");
+        double t0 = ht_now();
+        make_tree();
+        double t1 = ht_now();
+        printf("  tree of %lu files in %lu dirs built in %.0f ms\n", (unsigned long) (N_ENTRIES - N_DIRS),
+            (unsigned long) N_DIRS, (t1 - t0) * 1000);
+    }
+
+    // the way scripts had to do it: everything in tables
+    double peak_list = bench(L, "recursive fs.list_dir",
+        "local function rec(path, out) for _, e in ipairs(fs.list_dir(path)) do e.path = path .. '/' .. e.name; "
+        "out[#out + 1] = e; if e.type == 'dir' then rec(e.path, out) end end end "
+        "all = {}; rec('" TREE_ROOT "', all); n = #all", N_ENTRIES);
+
+    double peak_walk = bench(L, "fs.walk",
+        "n, size = 0, 0; for e in fs.walk('" TREE_ROOT "') do n = n + 1; size = size + e.size end", N_ENTRIES);
+    CHECK(get_int(L, "size") == N_TOP * N_SUB * N_FILES / 2, "fs.walk: sizes");
+    CHECK(hostfs_stats.max_open_dirs <= 3, "fs.walk: %lu dirs open", (unsigned long) hostfs_stats.max_open_dirs);
+    double peak_reuse = bench(L, "fs.walk, reuse",
+        "n = 0; for e in fs.walk('" TREE_ROOT "', { reuse = true }) do n = n + 1 end", N_ENTRIES);
+    bench(L, "fs.walk, pattern *.txt",
+        "n = 0; for e in fs.walk('" TREE_ROOT "', { pattern = '*.txt' }) do n = n + 1 end", N_TOP * N_SUB * N_FILES / 4);
+    bench(L, "fs.dir",
+        "n = 0; for e in fs.dir('" TREE_ROOT "/top3/sub7') do n = n + 1 end", N_FILES);
+    CHECK((peak_walk >= 0) && (peak_reuse >= 0) && (peak_walk * 10 < peak_list) && (peak_reuse <= peak_walk),
+        "peak memory: %.1f / %.1f kB vs %.1f kB", peak_walk, peak_reuse, peak_list);
+
+    // leaving the loop early closes the branch right away, errors too
+    CHECK(run(L, "for e in fs.walk('" TREE_ROOT "') do if e.name == 'file0500.bin' then break end end") &&
+        !hostfs_stats.open_dirs, "break: %lu dirs left open", (unsigned long) hostfs_stats.open_dirs);
+    CHECK(run(L, "ok = pcall(function() for e in fs.walk('" TREE_ROOT "') do "
+        "if e.name == 'file0500.bin' then error('stop') end end end)") && !get_int(L, "ok") &&
+        !hostfs_stats.open_dirs, "error: %lu dirs left open", (unsigned long) hostfs_stats.open_dirs);
+
+    lua_close(L);
+    return ht_done("luawalk");
+}
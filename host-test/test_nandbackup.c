@@ -0,0 +1,127 @@
+// incremental NAND backups: base + manifest, deltas for synthetic change patterns, restore round trips
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "nandutil.h"
+
+#define NAND_PATH   "0:/nand/nand.bin"
+#define BASE_PATH   "0:/nand/base.bin"
+#define DELTA_PATH  "0:/nand/delta.bin"
+#define OUT_PATH    "0:/nand/restored.bin"
+
+#define BLOCK_SIZE  (64 * 1024)
+#define IMAGE_SIZE  ((32 << 20) + 0x2345) // partial last block
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static bool restore_matches(const u8* image) {
+    u8* out = malloc(IMAGE_SIZE);
+    bool ok = out && (RestoreNandBackupDelta(BASE_PATH, DELTA_PATH, OUT_PATH) == 0) &&
+        (hostfs_read_file(OUT_PATH, out, IMAGE_SIZE) == IMAGE_SIZE) &&
+        (fvx_qsize(OUT_PATH) == IMAGE_SIZE) &&
+        (memcmp(out, image, IMAGE_SIZE) == 0);
+    free(out);
+    return ok;
+}
+
+// one change pattern on top of the base image: delta, restore, compare
+static void test_delta(const char* name, u8* image, const u8* base, u32 expected) {
+    u32 changed = 0, total = 0;
+    hostfs_write_file(NAND_PATH, image, IMAGE_SIZE);
+
+    double t0 = ht_now();
+    CHECK(BuildNandBackupDelta(NAND_PATH, BASE_PATH, DELTA_PATH, &changed, &total) == 0, "%s: delta", name);
+    double t1 = ht_now();
+    CHECK(changed == expected, "%s: %lu changed blocks, expected %lu", name, (unsigned long) changed, (unsigned long) expected);
+    CHECK(restore_matches(image), "%s: restore", name);
+    double t2 = ht_now();
+    printf("  %-10s %4lu / %lu blocks, delta %8lu byte (%5.1f%%), %6.1f ms delta, %6.1f ms restore\n",
+        name, (unsigned long) changed, (unsigned long) total, (unsigned long) fvx_qsize(DELTA_PATH),
+        fvx_qsize(DELTA_PATH) * 100.0 / IMAGE_SIZE, (t1 - t0) * 1000, (t2 - t1) * 1000);
+
+    memcpy(image, base, IMAGE_SIZE);
+}
+
+int main(void) {
+    const u32 n_blocks = (IMAGE_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    u8* base = malloc(IMAGE_SIZE);
+    u8* image = malloc(IMAGE_SIZE);
+    if (!base || !image) return 1;
+
+    hostfs_init("build/fs_nandbackup");
+    ht_fill(base, IMAGE_SIZE, 42);
+    memset(base + (4 << 20), 0xFF, 4 << 20); // unused space, identical blocks share a hash
+    hostfs_write_file(NAND_PATH, base, IMAGE_SIZE);
+    CHECK(BuildNandBackupBase(NAND_PATH, BASE_PATH) == 0, "base");
+    CHECK(fvx_qsize(BASE_PATH ".manifest") == 32 + (n_blocks * 0x20), "manifest size");
+    memcpy(image, base, IMAGE_SIZE);
+
+    // no change, single bytes scattered, one contiguous range, last (partial) block, everything
+    test_delta("unchanged", image, base, 0);
+    rnd_state = 7;
+    u32 hit[(IMAGE_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE] = { 0 }, n_hit = 0;
+    for (u32 i = 0; i < 100; i++) {
+        u32 pos = rnd() % IMAGE_SIZE;
+        image[pos] ^= 0x5A;
+        if (!hit[pos / BLOCK_SIZE]++) n_hit++;
+    }
+    test_delta("scattered", image, base, n_hit);
+    memset(image + 0x123456, 0, 3 << 20); // 3MB, not block aligned
+    test_delta("range", image, base, ((0x123456 + (3 << 20) - 1) / BLOCK_SIZE) - (0x123456 / BLOCK_SIZE) + 1);
+    image[IMAGE_SIZE - 1] ^= 1;
+    test_delta("tail", image, base, 1);
+    for (u32 i = 0; i < IMAGE_SIZE; i++) image[i] = ~image[i];
+    test_delta("all", image, base, n_blocks);
+
+    // restoring onto the base itself is refused
+    CHECK(RestoreNandBackupDelta(BASE_PATH, DELTA_PATH, BASE_PATH) != 0, "restore onto base");
+
+    // damaged base image, damaged delta
+    image[BLOCK_SIZE * 3] ^= 1;
+    hostfs_write_file(NAND_PATH, image, IMAGE_SIZE);
+    CHECK(BuildNandBackupDelta(NAND_PATH, BASE_PATH, DELTA_PATH, NULL, NULL) == 0, "delta for damage tests");
+    base[BLOCK_SIZE * 10] ^= 1;
+    hostfs_write_file(BASE_PATH, base, IMAGE_SIZE);
+    CHECK(RestoreNandBackupDelta(BASE_PATH, DELTA_PATH, OUT_PATH) != 0, "damaged base");
+    CHECK(fvx_qsize(OUT_PATH) == 0, "no output left behind");
+    base[BLOCK_SIZE * 10] ^= 1;
+    hostfs_write_file(BASE_PATH, base, IMAGE_SIZE);
+    CHECK(restore_matches(image), "base repaired");
+    u32 delta_size = fvx_qsize(DELTA_PATH);
+    u8* delta = malloc(delta_size);
+    hostfs_read_file(DELTA_PATH, delta, delta_size);
+    delta[delta_size - 100] ^= 1;
+    hostfs_write_file(DELTA_PATH, delta, delta_size);
+    CHECK(RestoreNandBackupDelta(BASE_PATH, DELTA_PATH, OUT_PATH) != 0, "damaged delta");
+    free(delta);
+
+    // a delta of another base doesn't apply
+    CHECK(BuildNandBackupDelta(NAND_PATH, BASE_PATH, DELTA_PATH, NULL, NULL) == 0, "delta for other base");
+    hostfs_write_file(NAND_PATH, image, IMAGE_SIZE);
+    CHECK(BuildNandBackupBase(NAND_PATH, BASE_PATH) == 0, "other base");
+    CHECK(RestoreNandBackupDelta(BASE_PATH, DELTA_PATH, OUT_PATH) != 0, "delta of another base");
+
+    // different NAND size needs a new base
+    hostfs_write_file(NAND_PATH, image, IMAGE_SIZE - BLOCK_SIZE);
+    CHECK(BuildNandBackupDelta(NAND_PATH, BASE_PATH, DELTA_PATH, NULL, NULL) != 0, "size mismatch");
+
+    // cancel leaves neither a base nor a manifest
+    hostfs_write_file(NAND_PATH, image, IMAGE_SIZE);
+    hostui_reset();
+    hostui_cancel_after = 3;
+    CHECK(BuildNandBackupBase(NAND_PATH, BASE_PATH) != 0, "cancel");
+    CHECK(!fvx_qsize(BASE_PATH) && !fvx_qsize(BASE_PATH ".manifest"), "cancel cleanup");
+    hostui_reset();
+
+    free(base);
+    free(image);
+    return ht_done("nandbackup");
+}
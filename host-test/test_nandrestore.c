@@ -0,0 +1,168 @@
+// SafeRestoreNandDump() onto a fake SysNAND in memory: only the changed sectors outside the FIRM partitions
+// get written, the written byte count matches, the result is the dump there and the old NAND everywhere else
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "nand.h"
+#include "nandutil.h"
+#include "ui.h"
+
+#define DUMP_PATH       "0:/gm9/out/nand.bin"
+#define NAND_SECTORS    0x8000
+#define NAND_SIZE       (NAND_SECTORS * 0x200)
+#define FIRM0_SECTOR    0x2000
+#define FIRM1_SECTOR    0x2800
+#define FIRM_SECTORS    0x800
+#define CTR_SECTOR      0x3000
+
+static u8* sysnand = NULL;
+
+static struct {
+    u32 write_calls;
+    u32 sectors_written;
+    u32 sectors_read;
+    u32 fail_reads_from; // local reads of sectors from here on fail, 0: never
+} nand_stats;
+
+// nand.h, the SysNAND is a plain buffer without crypto
+int __wrap_ReadNandSectors(void* buffer, u32 sector, u32 count, u32 keyslot, u32 nand_src) {
+    (void) keyslot;
+    if ((nand_src != NAND_SYSNAND) || (sector + count > NAND_SECTORS)) return -1;
+    if (nand_stats.fail_reads_from && (sector + count > nand_stats.fail_reads_from)) return -1;
+    memcpy(buffer, sysnand + (sector * 0x200), count * 0x200);
+    nand_stats.sectors_read += count;
+    return 0;
+}
+
+int __wrap_WriteNandSectors(const void* buffer, u32 sector, u32 count, u32 keyslot, u32 nand_dst) {
+    (void) keyslot;
+    if ((nand_dst != NAND_SYSNAND) || (sector + count > NAND_SECTORS)) return -1;
+    memcpy(sysnand + (sector * 0x200), buffer, count * 0x200);
+    nand_stats.write_calls++;
+    nand_stats.sectors_written += count;
+    return 0;
+}
+
+// never reached or irrelevant here, the dump doesn't pass ValidateNandDump() and the prompt says continue
+int sdmmc_get_cid(bool isNand, u32* info) {
+    (void) isNand;
+    (void) info;
+    return 1;
+}
+
+u32 ValidateFirm(void* firm, u32 firm_size, bool installable) {
+    (void) firm;
+    (void) firm_size;
+    (void) installable;
+    return 1;
+}
+
+bool ShowUnlockSequence(u32 seqlvl, const char *format, ...) {
+    (void) seqlvl;
+    (void) format;
+    return true;
+}
+
+// NCSD with TWL, two FIRMs and CTR, the rest of the NAND is random
+static void make_nand(u8* nand) {
+    NandNcsdHeader* ncsd = (NandNcsdHeader*) (void*) nand;
+    ht_fill(nand, NAND_SIZE, 0x4A4D);
+    memset(ncsd, 0, sizeof(NandNcsdHeader));
+    memcpy(ncsd->magic, "NCSD", 4);
+    ncsd->size = NAND_SECTORS;
+    const u8 types[4] = { NP_TYPE_STD, NP_TYPE_FIRM, NP_TYPE_FIRM, NP_TYPE_STD };
+    const u8 subtypes[4] = { NP_SUBTYPE_TWL, NP_SUBTYPE_CTR, NP_SUBTYPE_CTR, NP_SUBTYPE_CTR };
+    const u32 offsets[5] = { 0, FIRM0_SECTOR, FIRM1_SECTOR, CTR_SECTOR, NAND_SECTORS };
+    for (u32 i = 0; i < 4; i++) {
+        ncsd->partitions_fs_type[i] = types[i];
+        ncsd->partitions_crypto_type[i] = subtypes[i];
+        ncsd->partitions[i].offset = offsets[i];
+        ncsd->partitions[i].size = offsets[i + 1] - offsets[i];
+    }
+}
+
+static bool restored_sector(u32 sector) {
+    return ((sector > SECTOR_SECRET) && (sector < FIRM0_SECTOR)) || (sector >= CTR_SECTOR);
+}
+
+// what the SysNAND should look like after restoring the dump
+static u32 expected_nand(u8* expected, const u8* nand, const u8* dump) {
+    u32 changed = 0;
+    memcpy(expected, nand, NAND_SIZE);
+    for (u32 s = 0; s < NAND_SECTORS; s++) {
+        if (!restored_sector(s) || !memcmp(nand + (s * 0x200), dump + (s * 0x200), 0x200)) continue;
+        memcpy(expected + (s * 0x200), dump + (s * 0x200), 0x200);
+        changed++;
+    }
+    return changed;
+}
+
+static void test_restore(const char* name, const u8* nand, const u8* dump, bool local_reads) {
+    static u8 expected[NAND_SIZE];
+    u32 changed = expected_nand(expected, nand, dump);
+    u32 restored = (FIRM0_SECTOR - SECTOR_SECRET - 1) + (NAND_SECTORS - CTR_SECTOR);
+    u64 written = 0;
+
+    memcpy(sysnand, nand, NAND_SIZE);
+    hostfs_write_file(DUMP_PATH, dump, NAND_SIZE);
+    memset(&nand_stats, 0, sizeof(nand_stats));
+    nand_stats.fail_reads_from = local_reads ? 0 : 1;
+    hostui_reset();
+    double t0 = ht_now();
+    CHECK(SafeRestoreNandDump(DUMP_PATH, &written) == 0, "%s: restore", name);
+    double t1 = ht_now();
+    CHECK(memcmp(sysnand, expected, NAND_SIZE) == 0, "%s: SysNAND contents", name);
+
+    u32 expect_sectors = local_reads ? changed : restored;
+    CHECK((nand_stats.sectors_written == expect_sectors) && (written == (u64) expect_sectors * 0x200),
+        "%s: %lu sectors / %llu byte written, expected %lu sectors", name, (unsigned long) nand_stats.sectors_written,
+        (unsigned long long) written, (unsigned long) expect_sectors);
+    CHECK(!hostfs_stats.open_files, "%s: files closed", name);
+    printf("  %-10s %5lu changed sectors: %5lu written in %4lu runs, %5lu compared, %.1f ms\n", name,
+        (unsigned long) changed, (unsigned long) nand_stats.sectors_written, (unsigned long) nand_stats.write_calls,
+        (unsigned long) nand_stats.sectors_read, (t1 - t0) * 1000);
+}
+
+int main(void) {
+    static u8 nand[NAND_SIZE], dump[NAND_SIZE];
+    sysnand = malloc(NAND_SIZE);
+    if (!sysnand) return 1;
+
+    hostfs_init("build/fs_nandrestore");
+    fvx_rmkdir("0:/gm9/out");
+    hostfs_write_file("S:/essential.exefs", "x", 1);
+    make_nand(nand);
+
+    // identical dump: nothing written
+    memcpy(dump, nand, NAND_SIZE);
+    test_restore("identical", nand, dump, true);
+
+    // scattered sectors, also in the FIRMs and below the secret sector (never restored)
+    for (u32 i = 0; i < 200; i++) {
+        u32 s = 1 + ((i * 0x9E3779B1u) % (NAND_SECTORS - 1));
+        dump[(s * 0x200) + (i % 0x200)] ^= 0xA5;
+    }
+    test_restore("scattered", nand, dump, true);
+
+    // one contiguous range across a buffer boundary
+    memset(dump + (0x3F00 * 0x200), 0, 0x400 * 0x200);
+    test_restore("range", nand, dump, true);
+
+    // local NAND can't be read for the compare: everything restorable gets written
+    test_restore("no compare", nand, dump, false);
+
+    // declined at the corrupt dump prompt: nothing written
+    memcpy(sysnand, nand, NAND_SIZE);
+    memset(&nand_stats, 0, sizeof(nand_stats));
+    hostui_reset();
+    hostui_prompt_answer = false;
+    u64 written = 1;
+    CHECK((SafeRestoreNandDump(DUMP_PATH, &written) != 0) && !written && !nand_stats.write_calls &&
+        !memcmp(sysnand, nand, NAND_SIZE), "declined");
+    hostui_reset();
+
+    free(sysnand);
+    return ht_done("nandrestore");
+}
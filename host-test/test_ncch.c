@@ -0,0 +1,244 @@
+// VerifyNcchFile() on synthetic NCCHs (ExtHeader, ExeFS, RomFS with IVFC levels), plain and with
+// standard crypto through the software AES backend: damage detection, read pattern, throughput;
+// crypto contexts built once per NCCH against per call key setup, same output either way
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "testncch.h"
+#include "common.h"
+#include "vff.h"
+#include "aes.h"
+#include "sha.h"
+#include "ncch.h"
+#include "exefs.h"
+#include "romfs.h"
+#include "gameutil.h"
+
+// gameutil.c, not exported
+u32 VerifyNcchFile(const char* path, u32 offset, u32 size);
+u32 CheckNcchHash(u8* expected, FIL* file, u32 size_data, u32 offset_ncch, NcchHeader* ncch, ExeFsHeader* exefs);
+
+#define NCCH_PATH   "0:/ncch/test.app"
+
+// standard crypto (slot 0x2C, keyY from the signature), the host has a made up keyX for it
+static void encrypt_ncch(TestNcch* t) {
+    NcchHeader ncch;
+    ExeFsHeader exefs;
+    memcpy(&ncch, t->data, sizeof(NcchHeader));
+    memcpy(&exefs, t->data + t->offset_exefs, sizeof(ExeFsHeader));
+    CryptNcch(t->data, 0, t->size, &ncch, &exefs, NCCH_STDCRYPTO);
+}
+
+static u32 verify(const TestNcch* t, u32 offset) {
+    hostfs_write_file(NCCH_PATH, t->data - offset, t->size + offset);
+    return VerifyNcchFile(NCCH_PATH, offset, 0);
+}
+
+// flips one byte, checks that verification fails, flips it back
+static void check_damage(TestNcch* t, u32 pos, const char* what) {
+    t->data[pos] ^= 0x10;
+    hostui_reset();
+    CHECK(verify(t, 0) != 0, "damaged %s detected", what);
+    CHECK(hostui_stats.prompts == 1, "damaged %s: summary shown", what);
+    t->data[pos] ^= 0x10;
+}
+
+static void test_ncch(bool encrypted) {
+    const char* mode = encrypted ? "encrypted" : "plain";
+    TestNcch t;
+    make_ncch(&t, (3 << 20) + 0x777, "TestApp");
+    if (encrypted) encrypt_ncch(&t);
+
+    hostfs_reset_stats();
+    hostui_reset();
+    CHECK(verify(&t, 0) == 0, "%s: verify", mode);
+    CHECK(hostui_stats.prompts == 0, "%s: no prompt", mode);
+    // one pass: every byte read about once, a handful of seeks for headers, hash levels and gaps
+    CHECK(hostfs_stats.bytes_read <= t.size + STD_BUFFER_SIZE + 0x10000, "%s: %llu bytes read for %lu", mode,
+        (unsigned long long) hostfs_stats.bytes_read, (unsigned long) t.size);
+    CHECK(hostfs_stats.reads < 32, "%s: %lu reads", mode, (unsigned long) hostfs_stats.reads);
+
+    check_damage(&t, NCCH_EXTHDR_OFFSET + 0x10, "ExtHeader");
+    check_damage(&t, t.offset_exefs + 0x08, "ExeFS header");
+    check_damage(&t, t.offset_exefs + 0x200 + 1000, "ExeFS .code");
+    check_damage(&t, t.offset_exefs + 0x200 + align(300000, 0x200) + 5, "ExeFS banner");
+    check_damage(&t, t.offset_romfs + sizeof(RomFsIvfcHeader) + 3, "RomFS master hash");
+    check_damage(&t, t.offset_romfs + t.offset_lvl2 + 0x40, "RomFS lvl2");
+    check_damage(&t, t.offset_romfs + t.offset_lvl3, "RomFS lvl3 first block");
+    check_damage(&t, t.offset_romfs + t.offset_lvl3 + t.size_lvl3 - 1, "RomFS lvl3 last block");
+    CHECK(verify(&t, 0) == 0, "%s: undamaged again", mode);
+
+    // gaps between the regions are not hashed
+    t.data[t.offset_romfs - 0x10] ^= 0x10;
+    CHECK(verify(&t, 0) == 0, "%s: gap not hashed", mode);
+    t.data[t.offset_romfs - 0x10] ^= 0x10;
+
+    // inside a bigger file, as in an NCSD / CIA
+    u8* outer = malloc(t.size + 0x4000);
+    memset(outer, 0xEE, 0x4000);
+    memcpy(outer + 0x4000, t.data, t.size);
+    free(t.data);
+    t.data = outer + 0x4000;
+    CHECK(verify(&t, 0x4000) == 0, "%s: at offset", mode);
+
+    // truncated file
+    hostfs_write_file(NCCH_PATH, t.data, t.size - 0x200);
+    hostui_reset();
+    CHECK(VerifyNcchFile(NCCH_PATH, 0, 0) != 0, "%s: truncated", mode);
+
+    // cancel: fails, but no summary
+    hostui_reset();
+    hostui_cancel_after = 2;
+    CHECK((verify(&t, 0) != 0) && (hostui_stats.prompts == 0), "%s: cancel", mode);
+    hostui_reset();
+
+    free(outer);
+}
+
+// Process9 has its ExeFS files unhashed, they are skipped
+static void test_process9(void) {
+    TestNcch t;
+    make_ncch(&t, 64 * 1024, "Process9");
+    t.data[t.offset_exefs + 0x200 + 10] ^= 1;
+    CHECK(verify(&t, 0) == 0, "Process9 ExeFS files skipped");
+    t.data[t.offset_exefs + 0x08] ^= 1;
+    CHECK(verify(&t, 0) != 0, "Process9 ExeFS header still checked");
+    free(t.data);
+}
+
+// chunk by chunk, as the game drive reads, through a context built once or per call (CryptNcch())
+static void crypt_chunks(u8* data, u32 size, NcchHeader* ncch, ExeFsHeader* exefs, u16 crypt_to, bool cached,
+    NcchCryptoStats* stats) {
+    NcchCryptoContext from, to;
+    u8 other[16];
+    ht_fill(other, 16, 0x77); // something else used the keyslots before
+    setup_aeskeyY(0x2C, other);
+    setup_aeskey(0x11, other);
+    ResetNcchCryptoStats();
+    BuildNcchCryptoContext(&from, ncch, exefs, NCCH_GET_CRYPTO(ncch));
+    BuildNcchCryptoContext(&to, ncch, exefs, crypt_to);
+    for (u32 pos = 0, i = 0; pos < size; i++) {
+        u32 len = min(size - pos, 0x3000 + ((i * 0x1F3) % 0x5000)); // unaligned chunks
+        if (cached) CHECK(CryptNcchContext(data + pos, pos, len, &from, &to) == 0, "cached crypt");
+        else CHECK(CryptNcch(data + pos, pos, len, ncch, exefs, crypt_to) == 0, "uncached crypt");
+        pos += len;
+    }
+    GetNcchCryptoStats(stats);
+}
+
+static void test_crypto_context(u8 flags7, const char* mode) {
+    NcchCryptoStats stats[2];
+    TestNcch t;
+    make_ncch(&t, (1 << 20) + 0x555, "Context");
+    u8* plain = malloc(t.size);
+    u8* data = malloc(t.size);
+    memcpy(plain, t.data, t.size);
+    NcchHeader ncch;
+    ExeFsHeader exefs;
+    memcpy(&exefs, t.data + t.offset_exefs, sizeof(ExeFsHeader));
+
+    // reference: the whole NCCH in one call
+    NcchHeader* hdr = (NcchHeader*) (void*) t.data;
+    memcpy(&ncch, hdr, sizeof(NcchHeader));
+    CHECK(CryptNcch(t.data, 0, t.size, &ncch, &exefs, flags7) == 0, "%s: encrypt", mode);
+    memcpy(&ncch, t.data, sizeof(NcchHeader));
+
+    // decrypt, with and without the context
+    for (u32 cached = 0; cached < 2; cached++) {
+        memcpy(data, t.data, t.size);
+        crypt_chunks(data, t.size, &ncch, &exefs, NCCH_NOCRYPTO, cached, &stats[cached]);
+        CHECK(memcmp(data, plain, t.size) == 0, "%s: %s decrypt", mode, cached ? "cached" : "uncached");
+        printf("  %-9s %s: %4lu key derivations, %2lu key setups, %.2f setups / MB\n", mode,
+            cached ? "cached  " : "uncached", (unsigned long) stats[cached].key_derivations,
+            (unsigned long) stats[cached].key_setups, stats[cached].key_setups / (stats[cached].bytes / 1048576.0));
+    }
+    CHECK((stats[1].key_derivations == 2) && (stats[1].key_setups == 1), "%s: %lu key derivations with the context", mode,
+        (unsigned long) stats[1].key_derivations);
+    CHECK(stats[0].key_derivations > 20 * stats[1].key_derivations, "%s: %lu key derivations per call", mode,
+        (unsigned long) stats[0].key_derivations);
+    CHECK(stats[0].bytes == stats[1].bytes, "%s: same bytes", mode);
+
+    // encrypt from plain, with and without the context
+    NcchHeader ncch_plain;
+    memcpy(&ncch_plain, plain, sizeof(NcchHeader));
+    for (u32 cached = 0; cached < 2; cached++) {
+        memcpy(data, plain, t.size);
+        crypt_chunks(data, t.size, &ncch_plain, &exefs, flags7, cached, &stats[cached]);
+        CHECK(memcmp(data, t.data, t.size) == 0, "%s: %s encrypt", mode, cached ? "cached" : "uncached");
+    }
+
+    // sequential, as in CryptNcchNcsdBossFirmFile()
+    memcpy(data, t.data, t.size);
+    ResetNcchCryptoStats();
+    for (u32 pos = 0; pos < t.size; pos += 0x8000)
+        CHECK(CryptNcchSequential(data + pos, pos, min(t.size - pos, 0x8000), NCCH_NOCRYPTO) == 0, "sequential");
+    GetNcchCryptoStats(&stats[0]);
+    CHECK(memcmp(data, plain, t.size) == 0, "%s: sequential decrypt", mode);
+    CHECK(stats[0].key_derivations <= 4, "%s: sequential, %lu key derivations", mode,
+        (unsigned long) stats[0].key_derivations);
+
+    free(t.data);
+    free(plain);
+    free(data);
+}
+
+// the RomFS data level one hash block at a time, as VerifyNcchFile() did before the sweep
+static double bench_per_block(const TestNcch* t, const u8* lvl2, u32* reads) {
+    NcchHeader ncch;
+    FIL file;
+    u32 bad = 0;
+    memcpy(&ncch, t->data, sizeof(NcchHeader));
+    if (fvx_open(&file, NCCH_PATH, FA_READ | FA_OPEN_EXISTING) != FR_OK) return 0;
+    hostfs_reset_stats();
+    double t0 = ht_now();
+    fvx_lseek(&file, t->offset_romfs + t->offset_lvl3);
+    for (u32 i = 0; i < (align(t->size_lvl3, 1 << IVFC_LOG) >> IVFC_LOG); i++)
+        bad |= CheckNcchHash((u8*) lvl2 + (i * 0x20), &file, 1 << IVFC_LOG, 0, &ncch, NULL);
+    double t1 = ht_now();
+    fvx_close(&file);
+    *reads = hostfs_stats.reads;
+    CHECK(!bad, "per block reference");
+    return t1 - t0;
+}
+
+static void bench(void) {
+    for (u32 encrypted = 0; encrypted < 2; encrypted++) {
+        TestNcch t;
+        make_ncch(&t, 64 << 20, "Bench");
+        u32 size_lvl2 = (align(t.size_lvl3, 1 << IVFC_LOG) >> IVFC_LOG) * 0x20;
+        u8* lvl2 = malloc(size_lvl2); // decrypted
+        memcpy(lvl2, t.data + t.offset_romfs + t.offset_lvl2, size_lvl2);
+        if (encrypted) encrypt_ncch(&t);
+        hostfs_write_file(NCCH_PATH, t.data, t.size);
+        hostfs_reset_stats();
+        double t0 = ht_now();
+        u32 res = VerifyNcchFile(NCCH_PATH, 0, 0);
+        double t1 = ht_now();
+        CHECK(res == 0, "bench verify");
+        printf("  %-9s %3lu MB: %7.1f MB/s, %3lu reads, %3lu seeks\n", encrypted ? "encrypted" : "plain",
+            (unsigned long) (t.size >> 20), (t.size / 1048576.0) / (t1 - t0),
+            (unsigned long) hostfs_stats.reads, (unsigned long) hostfs_stats.seeks);
+        u32 reads = 0;
+        double t_ref = bench_per_block(&t, lvl2, &reads);
+        printf("  %-9s RomFS per block: %7.1f MB/s, %5lu reads\n", "", (t.size_lvl3 / 1048576.0) / t_ref,
+            (unsigned long) reads);
+        free(lvl2);
+        free(t.data);
+    }
+}
+
+int main(void) {
+    u8 keyx[16];
+    ht_fill(keyx, 16, 0x2C);
+    setup_aeskeyX(0x2C, keyx);
+
+    hostfs_init("build/fs_ncch");
+    test_ncch(false);
+    test_ncch(true);
+    test_process9();
+    test_crypto_context(NCCH_STDCRYPTO, "standard");
+    test_crypto_context(0x01, "fixed key");
+    bench();
+
+    return ht_done("ncch");
+}
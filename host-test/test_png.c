@@ -0,0 +1,171 @@
+// PNG_CompressToFile() output, decoded by lodepng and by zlib (adler32 included), and peak heap and time
+// against the old screenshot path (PNG_Compress() through lodepng, then one write)
+#include <malloc.h>
+#define crc32_combine zlib_crc32_combine // clashes with crc32.h
+#include <zlib.h>
+#undef crc32_combine
+#include "hosttest.h"
+#include "hostfs.h"
+#include "common.h"
+#include "vff.h"
+#include "png.h"
+
+#define PNG_PATH "0:/test.png"
+#define N_BENCH  10
+
+// heap in use by png.c, lodepng.c and this file (not hostfs, not zlib)
+static size_t mem_now = 0;
+static size_t mem_peak = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static void* count_alloc(void* ptr) {
+    if (ptr) mem_now += malloc_usable_size(ptr);
+    if (mem_now > mem_peak) mem_peak = mem_now;
+    return ptr;
+}
+
+void* __wrap_malloc(size_t size) {
+    return count_alloc(__real_malloc(size));
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size) {
+    return count_alloc(__real_calloc(nmemb, size));
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    size_t osize = ptr ? malloc_usable_size(ptr) : 0;
+    void* res = __real_realloc(ptr, size);
+    if (!res && size) return NULL; // old block untouched
+    mem_now -= osize;
+    return count_alloc(res);
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) mem_now -= malloc_usable_size(ptr);
+    __real_free(ptr);
+}
+
+typedef struct {
+    u32 w;
+    u32 seed;
+} TestImage;
+
+// flat areas, vertical repeats and noise, so every deflate path gets used
+static u16 test_pixel(const TestImage* img, u32 x, u32 y) {
+    u32 v = (x * 2654435761u) ^ (y * 40503u) ^ img->seed;
+    switch ((y / 3) % 3) {
+        case 0: return (u16) (x / 16);
+        case 1: return (u16) ((x % 7) * 0x0841);
+        default: return (u16) (v >> 7);
+    }
+}
+
+static void test_get_row(u16 *row, u32 y, void *data) {
+    const TestImage* img = data;
+    for (u32 x = 0; x < img->w; x++)
+        row[x] = test_pixel(img, x, y);
+}
+
+// zlib stream from all IDAT chunks
+static u8* png_idat(const u8* png, size_t size, size_t* zsize) {
+    u8* z = malloc(size);
+    size_t pos = 8;
+    *zsize = 0;
+    while (z && (pos + 12 <= size)) {
+        u32 len = getbe32(png + pos);
+        if (memcmp(png + pos + 4, "IDAT", 4) == 0) {
+            memcpy(z + *zsize, png + pos + 8, len);
+            *zsize += len;
+        }
+        pos += 12 + len;
+    }
+    return z;
+}
+
+static void test_roundtrip(u32 w, u32 h) {
+    TestImage img = { w, w * 31 + h };
+    u8* png = NULL;
+
+    CHECK(PNG_CompressToFile(PNG_PATH, w, h, test_get_row, &img), "encode %lux%lu", (unsigned long) w, (unsigned long) h);
+    size_t png_size = fvx_qsize(PNG_PATH);
+    if (!png_size || !(png = malloc(png_size)) || (hostfs_read_file(PNG_PATH, png, png_size) != png_size)) {
+        CHECK(false, "read back %lux%lu", (unsigned long) w, (unsigned long) h);
+        free(png);
+        return;
+    }
+
+    // lodepng (checks CRCs and adler32)
+    u32 dw = 0, dh = 0;
+    u16* dec = PNG_Decompress(png, png_size, &dw, &dh);
+    CHECK(dec && (dw == w) && (dh == h), "lodepng decode %lux%lu", (unsigned long) w, (unsigned long) h);
+    if (dec && (dw == w) && (dh == h)) {
+        u32 bad = 0;
+        for (u32 y = 0; y < h; y++)
+            for (u32 x = 0; x < w; x++)
+                if (dec[y * w + x] != test_pixel(&img, x, y)) bad++;
+        CHECK(!bad, "%lux%lu: %lu pixels differ", (unsigned long) w, (unsigned long) h, (unsigned long) bad);
+    }
+    free(dec);
+
+    // zlib, independent of the in-tree decoder
+    size_t zsize;
+    u8* z = png_idat(png, png_size, &zsize);
+    uLongf raw_size = (1 + w * 3) * h;
+    u8* raw = malloc(raw_size);
+    CHECK(z && raw && (uncompress(raw, &raw_size, z, zsize) == Z_OK) && (raw_size == (1 + w * 3) * h),
+        "zlib inflate %lux%lu", (unsigned long) w, (unsigned long) h);
+    free(raw);
+    free(z);
+    free(png);
+}
+
+int main(void) {
+    static const u32 widths[] = { 1, 2, 7, 400, 1850, 1851, 2000, 5552, 11000 };
+
+    hostfs_init("build/fs_png");
+    for (u32 i = 0; i < countof(widths); i++)
+        test_roundtrip(widths[i], (widths[i] > 2000) ? 4 : 13);
+
+    // screenshot sized benchmark (two 400x240 screens), the source image is there for both
+    // old: RGB24 copy and the complete PNG in memory (plus lodepng state), written in one go
+    TestImage img = { 400, 0 };
+    u16* fb = malloc(400 * 480 * sizeof(u16));
+    if (!fb) return 1;
+    for (u32 y = 0; y < 480; y++)
+        test_get_row(fb + (y * 400), y, &img);
+
+    size_t mem_start = mem_now;
+    mem_peak = mem_now;
+    double t0 = ht_now();
+    for (u32 i = 0; i < N_BENCH; i++) {
+        size_t png_size = 0;
+        u8* png = PNG_Compress(fb, 400, 480, &png_size);
+        if (!png || (fvx_qwrite(PNG_PATH, png, 0, png_size, NULL) != FR_OK)) CHECK(false, "lodepng encode");
+        free(png);
+    }
+    double t1 = ht_now();
+    size_t peak_lodepng = mem_peak - mem_start;
+    size_t size_lodepng = fvx_qsize(PNG_PATH);
+
+    mem_peak = mem_now;
+    double t2 = ht_now();
+    for (u32 i = 0; i < N_BENCH; i++)
+        PNG_CompressToFile(PNG_PATH, 400, 480, test_get_row, &img);
+    double t3 = ht_now();
+    size_t peak_stream = mem_peak - mem_start;
+    size_t size_stream = fvx_qsize(PNG_PATH);
+    free(fb);
+
+    CHECK(peak_stream * 20 < peak_lodepng, "peak heap: %lu vs %lu byte", (unsigned long) peak_stream,
+        (unsigned long) peak_lodepng);
+    printf("  400x480  lodepng:   %7.2f ms/image, %7lu byte, peak heap %8.1f kB\n", (t1 - t0) * 1000 / N_BENCH,
+        (unsigned long) size_lodepng, peak_lodepng / 1024.0);
+    printf("  400x480  streaming: %7.2f ms/image, %7lu byte, peak heap %8.1f kB\n", (t3 - t2) * 1000 / N_BENCH,
+        (unsigned long) size_stream, peak_stream / 1024.0);
+
+    return ht_done("png");
+}
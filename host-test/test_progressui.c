@@ -0,0 +1,188 @@
+// ShowProgress() from ui.c into an in-memory framebuffer on a virtual clock: the delta redraw gives the same
+// screen as a full redraw (also after prompts or other drawing on top), pixels written per second of progress,
+// and the ProgressCounter only reaching ShowProgress() at about the refresh rate
+#include "hosttest.h"
+#include "common.h"
+#include "ui.h"
+#include "hid.h"
+#include "timer.h"
+#include "vram0.h"
+
+#define POISON      0x0842 // never drawn by the progress screen
+#define N_PIXELS    (SCREEN_WIDTH_MAIN * SCREEN_HEIGHT)
+#define OP_SIZE     (64 * 1024 * 1024)
+#define OP_STEPS    256 // one refresh each
+#define STEP_MSEC   40
+#define BUF_SIZE    (4 * 1024)
+#define BUF_USEC    600 // per small buffer, ~6.5MB/s
+
+static u64 vclock = 0; // virtual time in ticks
+static u32 timer_reads = 0;
+static u16 shadow[N_PIXELS]; // what the screen shows
+
+u64 timer_start(void) { timer_reads++; return vclock; }
+u64 timer_ticks(u64 start_time) { timer_reads++; return vclock - start_time; }
+u64 timer_msec(u64 start_time) { return timer_ticks(start_time) / (TICKS_PER_SEC / 1000); }
+u64 timer_sec(u64 start_time) { return timer_ticks(start_time) / TICKS_PER_SEC; }
+void wait_msec(u64 msec) { vclock += msec * (TICKS_PER_SEC / 1000); }
+
+static void advance_usec(u64 usec) {
+    vclock += (usec * TICKS_PER_SEC) / 1000000;
+}
+
+// no VRAM0 tar on the host, the font is set explicitly
+const char vram_data[1], vram_data_end[1];
+void* FindTarFileInfo(void* tardata, void* tardata_end, const char* fname, u64* fsize) {
+    (void) tardata;
+    (void) tardata_end;
+    (void) fname;
+    (void) fsize;
+    return NULL;
+}
+
+u32 InputWait(u32 timeout_sec) {
+    (void) timeout_sec;
+    return BUTTON_A;
+}
+
+bool CheckButton(u32 button) {
+    (void) button;
+    return false;
+}
+
+static u64 hash_screen(const u16* screen) {
+    u64 h = 0xCBF29CE484222325ULL; // FNV-1a
+    for (u32 i = 0; i < N_PIXELS; i++) h = (h ^ screen[i]) * 0x100000001B3ULL;
+    return h;
+}
+
+// fill the screen with a color the progress screen never uses, so anything drawn can be counted
+static void poison(void) {
+    u16* screen = MAIN_SCREEN;
+    for (u32 i = 0; i < N_PIXELS; i++) screen[i] = POISON;
+}
+
+// pixels written since poison(), keeps the shadow up to date
+static u32 collect(void) {
+    const u16* screen = MAIN_SCREEN;
+    u32 written = 0;
+    for (u32 i = 0; i < N_PIXELS; i++) {
+        if (screen[i] == POISON) continue;
+        shadow[i] = screen[i];
+        written++;
+    }
+    return written;
+}
+
+static u32 render(u64 current, u64 total, const char* opstr) {
+    poison();
+    ShowProgress(current, total, opstr);
+    return collect();
+}
+
+// 8x8 font, 16x16 PBM
+static bool set_font(void) {
+    static u8 pbm[16 + (256 * 8)];
+    u32 hdr = snprintf((char*) pbm, 16, "P4\n128 128\n");
+    ht_fill(pbm + hdr, 256 * 8, 0x7E57);
+    return SetFont(pbm, hdr + (256 * 8));
+}
+
+// one refresh per step, delta redraws (with a prompt and some text drawn on top in between)
+// against a full redraw for every step
+static void test_delta_redraw(void) {
+    static u64 hash_delta[OP_STEPS + 1], hash_full[OP_STEPS + 1];
+    const char* opstr = "0:/some/file.bin";
+    u64 px_delta = 0, px_full = 0;
+
+    for (u32 full = 0; full < 2; full++) {
+        vclock = 0;
+        for (u32 i = 0; i <= OP_STEPS; i++) {
+            u64 current = ((u64) OP_SIZE * i) / OP_STEPS;
+            if (full) ClearScreen(MAIN_SCREEN, COLOR_STD_BG);
+            else if ((i == OP_STEPS / 3) || (i == OP_STEPS / 2)) {
+                poison();
+                if (i == OP_STEPS / 3) ShowPrompt(false, "some question");
+                else DrawString(MAIN_SCREEN, "overdrawn", 40, 110, COLOR_STD_FONT, COLOR_STD_BG);
+                collect();
+            }
+            u32 written = render(current, OP_SIZE, opstr);
+            if (full) {
+                hash_full[i] = hash_screen(MAIN_SCREEN);
+                px_full += written;
+            } else {
+                hash_delta[i] = hash_screen(shadow);
+                px_delta += written;
+            }
+            advance_usec(STEP_MSEC * 1000);
+        }
+    }
+
+    u32 n_bad = 0;
+    for (u32 i = 0; i <= OP_STEPS; i++) {
+        if (hash_delta[i] == hash_full[i]) continue;
+        if (!n_bad++) fprintf(stderr, "  first mismatch at step %lu\n", (unsigned long) i);
+    }
+    CHECK(!n_bad, "delta redraw: %lu of %lu steps differ from a full redraw", (unsigned long) n_bad,
+        (unsigned long) OP_STEPS + 1);
+    double sec = (OP_STEPS * STEP_MSEC) / 1000.0;
+    CHECK(px_delta * 10 < px_full, "delta redraw: %llu vs %llu pixels", (unsigned long long) px_delta,
+        (unsigned long long) px_full);
+    printf("  pixels written per second of progress: %.0f delta, %.0f full redraw\n", px_delta / sec, px_full / sec);
+}
+
+// small buffers: per buffer ShowProgress() calls vs ProgressAdd()
+static void test_counter(void) {
+    const char* opstr = "0:/some/other/file.bin";
+    u32 n_buf = OP_SIZE / BUF_SIZE;
+    u64 px_calls = 0, px_counter = 0;
+    u32 reads_calls, reads_counter;
+
+    vclock = 0;
+    timer_reads = 0;
+    px_calls += render(0, OP_SIZE, opstr);
+    for (u32 i = 1; i <= n_buf; i++) {
+        advance_usec(BUF_USEC);
+        px_calls += render((u64) i * BUF_SIZE, OP_SIZE, opstr);
+    }
+    reads_calls = timer_reads;
+
+    // the same through the counter, only poisoned when an update is due
+    vclock = 0;
+    timer_reads = 0;
+    ProgressCounter prog = { .total = OP_SIZE, .opstr = opstr };
+    px_counter += render(0, OP_SIZE, opstr);
+    u32 updates = 0;
+    bool ret = true;
+    for (u32 i = 1; i <= n_buf; i++) {
+        advance_usec(BUF_USEC);
+        bool due = prog.current + BUF_SIZE >= prog.next;
+        if (due) poison();
+        ret = ProgressAdd(&prog, BUF_SIZE) && ret;
+        if (due) {
+            px_counter += collect();
+            updates++;
+        }
+    }
+    reads_counter = timer_reads;
+
+    double sec = (n_buf * (double) BUF_USEC) / 1000000.0;
+    u32 refreshes = (sec * 1000) / 30;
+    CHECK(ret && (prog.current == OP_SIZE) && (prog.next == OP_SIZE), "counter: ends at the total");
+    CHECK((updates > refreshes / 2) && (updates < refreshes * 3), "counter: %lu updates for %lu refreshes",
+        (unsigned long) updates, (unsigned long) refreshes);
+    CHECK(reads_counter * 4 < reads_calls, "counter: %lu vs %lu timer reads", (unsigned long) reads_counter,
+        (unsigned long) reads_calls);
+    printf("  %lu x %ukB buffers, per buffer calls: %lu ShowProgress, %lu timer reads, %.0f px/s\n",
+        (unsigned long) n_buf, BUF_SIZE / 1024, (unsigned long) n_buf, (unsigned long) reads_calls, px_calls / sec);
+    printf("  %lu x %ukB buffers, counter: %lu ShowProgress, %lu timer reads, %.0f px/s\n",
+        (unsigned long) n_buf, BUF_SIZE / 1024, (unsigned long) updates, (unsigned long) reads_counter,
+        px_counter / sec);
+}
+
+int main(void) {
+    CHECK(set_font(), "font");
+    test_delta_redraw();
+    test_counter();
+    return ht_done("progressui");
+}
@@ -0,0 +1,235 @@
+// resumable copies (ALLOW_RESUME): a tree copy interrupted at random offsets again and again, every file is
+// either complete, missing or cut at its journal checkpoint, and the resumed copy only writes what is left.
+// single files with a crash left behind (garbage past the checkpoint), a bad tail or a changed origin
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "ui.h"
+#include "fsutil.h"
+
+#define SRC_ROOT        "0:/src"
+#define DST_ROOT        "0:/dst"
+#define MAX_FILES       64
+#define MAX_FILE_SIZE   (48 * 1024 * 1024)
+#define JOURNAL_EXT     ".resume"
+#define N_INTERRUPTS    6
+
+// same layout as CopyJournal in fsutil.c
+typedef struct {
+    char magic[8];
+    u64  size;
+    u16  fdate;
+    u16  ftime;
+    u32  tail_crc;
+    u32  tail_size;
+    u32  reserved;
+    u64  offset;
+} PACKED_STRUCT TestJournal;
+
+typedef struct {
+    char path[256]; // relative to the roots
+    u64 size;
+} TreeFile;
+
+static TreeFile tree[MAX_FILES];
+static u32 n_tree = 0;
+static u64 tree_size = 0;
+static u8* odata = NULL;
+static u8* ddata = NULL;
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static void add_file(const char* path, u32 size) {
+    char fpath[256];
+    TreeFile* file = &(tree[n_tree++]);
+    snprintf(file->path, sizeof(file->path), "%s", path);
+    snprintf(fpath, sizeof(fpath), SRC_ROOT "%s", path);
+    ht_fill(odata, size, rnd());
+    hostfs_write_file(fpath, odata, size);
+    file->size = size;
+    tree_size += size;
+}
+
+// a few files over the checkpoint size between small ones, in two levels
+static void make_tree(void) {
+    const u32 big_sizes[3] = { (17 * 1024 * 1024) + 5, (40 * 1024 * 1024) + 1000, 33 * 1024 * 1024 };
+    char path[64];
+    fvx_mkdir(SRC_ROOT);
+    fvx_mkdir(SRC_ROOT "/dir0");
+    fvx_mkdir(SRC_ROOT "/dir1");
+    fvx_mkdir(SRC_ROOT "/dir1/sub");
+    for (u32 i = 0; i < 24; i++) {
+        const char* dirs[4] = { "", "/dir0", "/dir1", "/dir1/sub" };
+        snprintf(path, sizeof(path), "%s/file%02lu.bin", dirs[i % 4], (unsigned long) i);
+        add_file(path, (i % 7 == 3) ? big_sizes[(i / 7) % 3] : rnd() % (256 * 1024));
+    }
+}
+
+static bool read_journal(const char* dpath, TestJournal* journal) {
+    char jpath[256];
+    snprintf(jpath, sizeof(jpath), "%s" JOURNAL_EXT, dpath);
+    return hostfs_read_file(jpath, journal, sizeof(TestJournal)) == sizeof(TestJournal);
+}
+
+// every destination file is complete, missing, or exactly the origin up to its checkpoint
+// returns bad files, bytes kept at checkpoints and the number of journals
+static u32 check_interrupted(u64* kept, u32* n_journals) {
+    char opath[256], dpath[256];
+    u32 n_bad = 0;
+    *kept = 0;
+    *n_journals = 0;
+    for (u32 i = 0; i < n_tree; i++) {
+        TestJournal journal;
+        snprintf(opath, sizeof(opath), SRC_ROOT "%s", tree[i].path);
+        snprintf(dpath, sizeof(dpath), DST_ROOT "%s", tree[i].path);
+        size_t osize = hostfs_read_file(opath, odata, MAX_FILE_SIZE);
+        if (fvx_stat(dpath, NULL) != FR_OK) {
+            if (read_journal(dpath, &journal)) n_bad++;
+            continue;
+        }
+        size_t dsize = hostfs_read_file(dpath, ddata, MAX_FILE_SIZE);
+        if (read_journal(dpath, &journal)) {
+            if (!journal.offset || (journal.offset >= osize) || (dsize != journal.offset) ||
+                (memcmp(odata, ddata, dsize) != 0)) n_bad++;
+            *kept += journal.offset;
+            (*n_journals)++;
+        } else if ((dsize != osize) || (memcmp(odata, ddata, osize) != 0)) n_bad++;
+    }
+    return n_bad;
+}
+
+// everything there and no journal left
+static u32 compare_trees(void) {
+    char opath[256], dpath[256];
+    u32 n_bad = 0;
+    for (u32 i = 0; i < n_tree; i++) {
+        TestJournal journal;
+        snprintf(opath, sizeof(opath), SRC_ROOT "%s", tree[i].path);
+        snprintf(dpath, sizeof(dpath), DST_ROOT "%s", tree[i].path);
+        size_t osize = hostfs_read_file(opath, odata, MAX_FILE_SIZE);
+        size_t dsize = hostfs_read_file(dpath, ddata, MAX_FILE_SIZE);
+        if ((fvx_stat(dpath, NULL) != FR_OK) || (osize != dsize) || (memcmp(odata, ddata, osize) != 0) ||
+            read_journal(dpath, &journal)) n_bad++;
+    }
+    return n_bad;
+}
+
+// cancels the copy once the progress gets to the target, like pulling the card would
+typedef struct {
+    u64 target;
+    u64 current;
+} Interrupt;
+
+static bool InterruptHook(u64 current, u64 total, const char* opstr, void* ctx) {
+    (void) total;
+    (void) opstr;
+    Interrupt* interrupt = (Interrupt*) ctx;
+    interrupt->current = current;
+    return current < interrupt->target;
+}
+
+static bool copy(const char* dest, const char* orig, u64 target) {
+    u32 flags = OVERWRITE_ALL | ALLOW_RESUME;
+    Interrupt interrupt = { .target = target };
+    hostfs_reset_stats();
+    if (target) SetProgressHook(InterruptHook, &interrupt, 0);
+    bool res = PathMoveCopy(dest, orig, &flags, false);
+    SetProgressHook(NULL, NULL, 0);
+    return res;
+}
+
+static void test_tree(void) {
+    u64 kept = 0;
+    u32 n_journals = 0;
+    u32 n_resumed = 0;
+
+    for (u32 i = 0; i < N_INTERRUPTS; i++) {
+        u64 target = 1 + (rnd() % tree_size);
+        CHECK(!copy(DST_ROOT, SRC_ROOT, target), "interrupt %lu", (unsigned long) i);
+        u32 n_bad = check_interrupted(&kept, &n_journals);
+        CHECK(!n_bad && !hostfs_stats.open_files, "interrupt %lu at %.1f MB: %lu bad files", (unsigned long) i,
+            target / 1048576.0, (unsigned long) n_bad);
+        n_resumed += n_journals ? 1 : 0;
+    }
+    CHECK(n_resumed, "%lu of %lu interrupts left a checkpoint", (unsigned long) n_resumed, (unsigned long) N_INTERRUPTS);
+
+    // the final run only writes past the checkpoints (plus journals)
+    double t0 = ht_now();
+    CHECK(copy(DST_ROOT, SRC_ROOT, 0), "resume");
+    double t1 = ht_now();
+    CHECK(!compare_trees() && !hostfs_stats.open_files, "resumed contents");
+    CHECK((hostfs_stats.bytes_written >= tree_size - kept) &&
+        (hostfs_stats.bytes_written < tree_size - kept + 64 * sizeof(TestJournal)),
+        "resume: %llu byte written, %llu expected", (unsigned long long) hostfs_stats.bytes_written,
+        (unsigned long long) (tree_size - kept));
+    printf("  %lu files, %.1f MB, %lu journals left: %.1f MB kept, resume wrote %.1f MB in %.1f ms\n",
+        (unsigned long) n_tree, tree_size / 1048576.0, (unsigned long) n_journals, kept / 1048576.0,
+        hostfs_stats.bytes_written / 1048576.0, (t1 - t0) * 1000);
+}
+
+// one big file, interrupted past the first checkpoint, then messed with before resuming
+static void test_file(void) {
+    const char* opath = SRC_ROOT "/dir1/file10.bin";
+    const char* dpath = DST_ROOT "/single.bin";
+    TestJournal journal;
+    FILINFO fno;
+
+    fvx_stat(opath, &fno);
+    u64 osize = fno.fsize;
+
+    // clean interrupt and resume
+    PathDelete(dpath);
+    CHECK(!copy(dpath, opath, (20 * 1024 * 1024)) && read_journal(dpath, &journal) &&
+        (journal.offset == 16 * 1024 * 1024), "file: interrupted at the checkpoint");
+    CHECK(copy(dpath, opath, 0) && !read_journal(dpath, &journal) &&
+        (hostfs_stats.bytes_written <= osize - (16 * 1024 * 1024) + 4 * sizeof(TestJournal)), "file: resumed");
+
+    // crash after preallocation: garbage up to the full size behind the checkpoint
+    CHECK(!copy(dpath, opath, (20 * 1024 * 1024)) && read_journal(dpath, &journal), "crash: interrupted");
+    size_t dsize = hostfs_read_file(dpath, ddata, MAX_FILE_SIZE);
+    ht_fill(ddata + dsize, osize - dsize, 0xDEAD);
+    hostfs_write_file(dpath, ddata, osize);
+    CHECK(copy(dpath, opath, 0) && (hostfs_stats.bytes_written <= osize - journal.offset + 4 * sizeof(TestJournal)),
+        "crash: resumed, %llu byte written", (unsigned long long) hostfs_stats.bytes_written);
+    hostfs_read_file(opath, odata, MAX_FILE_SIZE);
+    CHECK((hostfs_read_file(dpath, ddata, MAX_FILE_SIZE) == osize) && !memcmp(odata, ddata, osize), "crash: contents");
+
+    // the destination doesn't hold the checkpointed data: start over
+    CHECK(!copy(dpath, opath, (20 * 1024 * 1024)) && read_journal(dpath, &journal), "bad tail: interrupted");
+    dsize = hostfs_read_file(dpath, ddata, MAX_FILE_SIZE);
+    ddata[dsize - 100] ^= 0xFF;
+    hostfs_write_file(dpath, ddata, dsize);
+    CHECK(copy(dpath, opath, 0) && (hostfs_stats.bytes_written >= osize), "bad tail: copied from the start");
+    CHECK((hostfs_read_file(dpath, ddata, MAX_FILE_SIZE) == osize) && !memcmp(odata, ddata, osize),
+        "bad tail: contents");
+
+    // the origin changed in between (other timestamp): start over
+    CHECK(!copy(dpath, opath, (20 * 1024 * 1024)) && read_journal(dpath, &journal), "changed: interrupted");
+    fno.ftime ^= 1 << 11;
+    f_utime(opath, &fno);
+    CHECK(copy(dpath, opath, 0) && (hostfs_stats.bytes_written >= osize) && !read_journal(dpath, &journal),
+        "changed: copied from the start");
+}
+
+int main(void) {
+    odata = malloc(MAX_FILE_SIZE);
+    ddata = malloc(MAX_FILE_SIZE);
+    if (!odata || !ddata) return 1;
+
+    hostfs_init("build/fs_resume");
+    make_tree();
+    test_tree();
+    test_file();
+
+    free(odata);
+    free(ddata);
+    return ht_done("resume");
+}
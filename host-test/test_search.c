@@ -0,0 +1,143 @@
+// FileFindData() / FileFindDataMasked() / FileFindAllData() against a naive scan, across chunk borders
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "fsutil.h"
+
+#define FIND_PATH   "0:/search/data.bin"
+#define NOT_FOUND   ((u32) -1)
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static bool naive_match(const u8* ptr, const u8* pat, const u8* mask, u32 len) {
+    for (u32 j = 0; j < len; j++)
+        if ((ptr[j] ^ pat[j]) & (mask ? mask[j] : 0xFF)) return false;
+    return true;
+}
+
+// first match at or after offset, wrapping around (a match may start before offset and reach past it)
+static u32 naive_find(const u8* data, u32 size, const u8* pat, const u8* mask, u32 len, u32 offset) {
+    for (u32 i = offset; i + len <= size; i++)
+        if (naive_match(data + i, pat, mask, len)) return i;
+    for (u32 i = 0; (i < offset) && (i + len <= size); i++)
+        if (naive_match(data + i, pat, mask, len)) return i;
+    return NOT_FOUND;
+}
+
+static u32 naive_find_all(const u8* data, u32 size, const u8* pat, const u8* mask, u32 len, u32* found, u32 max_found) {
+    u32 n = 0;
+    for (u32 i = 0; (i + len <= size) && (n < max_found); i++)
+        if (naive_match(data + i, pat, mask, len)) found[n++] = i;
+    return n;
+}
+
+// patterns cut from the file itself, so there are matches, some right at the 1MB read chunk borders
+static void test_patterns(const u8* data, u32 size) {
+    static const u32 lengths[] = { 1, 2, 3, 4, 5, 8, 16, 31, 64, 300, 4096 };
+    static u32 found[64], ref[64];
+    u8 pat[4096], mask[4096];
+    u32 bad = 0, bad_all = 0, n = 0;
+
+    for (u32 l = 0; l < countof(lengths); l++) {
+        u32 len = lengths[l];
+        for (u32 k = 0; k < 12; k++) {
+            u32 src = (k < 4) ? STD_BUFFER_SIZE * (1 + k % 2) - len / 2 - (k / 2) : rnd() % (size - len);
+            bool masked = (k % 3) == 2;
+            memcpy(pat, data + src, len);
+            if (k == 11) pat[len - 1] ^= 0x80; // probably nowhere
+            for (u32 j = 0; j < len; j++) mask[j] = (rnd() % 4) ? 0xFF : (u8) rnd();
+            const u8* m = masked ? mask : NULL;
+
+            u32 offset = (k % 2) ? src + 1 : rnd() % size; // +1: the wrap around has to find it again
+            u32 res = FileFindDataMasked(FIND_PATH, pat, m, len, offset);
+            u32 exp = naive_find(data, size, pat, m, len, offset);
+            if (res != exp) {
+                if (bad++ < 5) printf("  len %lu%s offset %lu: %08lX != %08lX\n", (unsigned long) len,
+                    masked ? " masked" : "", (unsigned long) offset, (unsigned long) res, (unsigned long) exp);
+            }
+            if (!masked && (FileFindData(FIND_PATH, pat, len, offset) != exp)) bad++;
+
+            u32 n_res = FileFindAllData(FIND_PATH, pat, m, len, found, countof(found));
+            u32 n_exp = naive_find_all(data, size, pat, m, len, ref, countof(ref));
+            if ((n_res != n_exp) || (memcmp(found, ref, n_res * sizeof(u32)) != 0)) bad_all++;
+            n++;
+        }
+    }
+    CHECK(!bad, "find first: %lu of %lu differ", (unsigned long) bad, (unsigned long) n);
+    CHECK(!bad_all, "find all: %lu of %lu differ", (unsigned long) bad_all, (unsigned long) n);
+}
+
+// overlapping and adjacent matches, match limit
+static void test_repeats(void) {
+    static u8 data[3 * STD_BUFFER_SIZE / 2];
+    static u32 found[16];
+    memset(data, 'a', sizeof(data));
+    hostfs_write_file(FIND_PATH, data, sizeof(data));
+
+    CHECK(FileFindAllData(FIND_PATH, (const u8*) "aaaa", NULL, 4, found, 16) == 16, "overlapping, limited");
+    for (u32 i = 0; i < 16; i++)
+        if (found[i] != i) CHECK(false, "overlapping match %lu at %lu", (unsigned long) i, (unsigned long) found[i]);
+    CHECK(FileFindData(FIND_PATH, (u8*) "aab", 3, 0) == NOT_FOUND, "no match");
+    CHECK(FileFindData(FIND_PATH, (u8*) "aaaa", 4, sizeof(data) - 2) == 0, "wraps around");
+    CHECK(FileFindData(FIND_PATH, (u8*) "a", 0, 0) == NOT_FOUND, "empty pattern");
+    CHECK(FileFindData(FIND_PATH, data, STD_BUFFER_SIZE / 2 + 1, 0) == NOT_FOUND, "pattern too long");
+    CHECK(FileFindData("0:/search/missing.bin", (u8*) "a", 1, 0) == NOT_FOUND, "missing file");
+
+    // mask 0 matches anything
+    static const u8 zero[8] = { 0 };
+    static const u8 pat[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    CHECK(FileFindDataMasked(FIND_PATH, pat, zero, 8, 100) == 100, "zero mask");
+}
+
+static void bench(const u8* data, u32 size) {
+    static const u32 lengths[] = { 4, 16, 64, 256 };
+    u8 pat[256];
+    for (u32 l = 0; l < countof(lengths); l++) {
+        u32 len = lengths[l];
+        memcpy(pat, data + size - len, len); // last bytes, so the whole file gets scanned
+        double t0 = ht_now();
+        u32 res = FileFindData(FIND_PATH, pat, len, 0);
+        double t1 = ht_now();
+        volatile u32 ref = naive_find(data, size, pat, NULL, len, 0);
+        double t2 = ht_now();
+        CHECK(res == ref, "bench length %lu", (unsigned long) len);
+        printf("  %3lu byte  %8.1f MB/s, naive (in memory) %7.1f MB/s\n", (unsigned long) len,
+            (size >> 20) / (t1 - t0), (size >> 20) / (t2 - t1));
+    }
+}
+
+int main(void) {
+    const u32 size = 4 * STD_BUFFER_SIZE + 12345;
+    u8* data = malloc(64 << 20);
+    if (!data) return 1;
+
+    // low entropy data, so short patterns show up often
+    hostfs_init("build/fs_search");
+    for (u32 i = 0; i < size; i++) data[i] = "GM9\0\xFFgodmode"[rnd() % 12];
+    hostfs_write_file(FIND_PATH, data, size);
+    test_patterns(data, size);
+
+    // progress is shown on big files only and can cancel the search
+    hostui_reset();
+    CHECK(FileFindData(FIND_PATH, (u8*) "not in there", 12, 0) == NOT_FOUND, "progress");
+    CHECK(hostui_stats.progress_calls > 0, "progress shown");
+    hostui_cancel_after = 2;
+    CHECK(FileFindData(FIND_PATH, (u8*) "not in there", 12, 0) == NOT_FOUND, "cancel");
+    hostui_reset();
+
+    test_repeats();
+
+    ht_fill(data, 64 << 20, 3);
+    hostfs_write_file(FIND_PATH, data, 64 << 20);
+    bench(data, 64 << 20);
+
+    free(data);
+    return ht_done("search");
+}
@@ -0,0 +1,233 @@
+// sparse FAT image dumps: synthetic FAT12/16/32 and MBR images with stale data in free clusters
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "sparse.h"
+
+#define IMG_PATH    "0:/sparse/fat.img"
+#define SPARSE_PATH "0:/sparse/fat.sparse"
+#define OUT_PATH    "0:/sparse/fat.expanded"
+
+#define SECTOR      0x200
+
+typedef struct {
+    const char* name;
+    u32 offset; // partition offset in sectors, 0 for a plain FAT image
+    u32 sct_total;
+    u32 clr_size;
+    u32 fat_bits;
+    u32 fill; // percent of clusters in use
+} FatLayout;
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static void mark(u8* keep, u64 start, u64 end) {
+    for (u64 b = start / SPARSE_BLOCK_SIZE; b < (end + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE; b++)
+        keep[b] = 1;
+}
+
+// writes BPB and FAT of one partition into img (stale random data everywhere else),
+// marks what has to survive in keep[] (one byte per sparse block)
+static void make_fat(u8* img, const FatLayout* l, u8* keep) {
+    u8* part = img + ((u64) l->offset * SECTOR);
+    u32 sct_reserved = (l->fat_bits == 32) ? 32 : 1;
+    u32 root_n = (l->fat_bits == 32) ? 0 : 512;
+    u32 fat_size = (((l->sct_total / l->clr_size) + 2) * l->fat_bits / 8 + SECTOR) / SECTOR;
+    u32 sct_data = sct_reserved + (2 * fat_size) + (root_n * 32 / SECTOR);
+    u32 n_clusters = (l->sct_total - sct_data) / l->clr_size;
+
+    memset(part, 0, SECTOR);
+    part[0] = 0xEB;
+    part[2] = 0x90;
+    memcpy(part + 3, "HOSTTEST", 8);
+    part[0x0B] = SECTOR & 0xFF;
+    part[0x0C] = SECTOR >> 8;
+    part[0x0D] = l->clr_size;
+    part[0x0E] = sct_reserved & 0xFF;
+    part[0x10] = 2;
+    part[0x11] = root_n & 0xFF;
+    part[0x12] = root_n >> 8;
+    part[0x15] = 0xF8;
+    memcpy(part + 0x20, &l->sct_total, 4);
+    if (l->fat_bits == 32) {
+        memcpy(part + 0x24, &fat_size, 4);
+        memcpy(part + 0x52, "FAT32   ", 8);
+    } else {
+        part[0x16] = fat_size & 0xFF;
+        part[0x17] = fat_size >> 8;
+        memcpy(part + 0x36, (l->fat_bits == 16) ? "FAT16   " : "FAT12   ", 8);
+    }
+    part[0x1FE] = 0x55;
+    part[0x1FF] = 0xAA;
+
+    // first FAT: entries 0 / 1 reserved, the rest randomly in use or free
+    u8* fat = part + (sct_reserved * SECTOR);
+    u64 clr_bytes = (u64) l->clr_size * SECTOR;
+    u64 data_start = ((u64) l->offset + sct_data) * SECTOR;
+    memset(fat, 0, fat_size * SECTOR);
+    for (u32 c = 0; c < n_clusters + 2; c++) {
+        bool used = (c < 2) || ((rnd() % 100) < l->fill);
+        u32 entry = used ? (c < 2) ? 0x0FFFFFF8 : 1 + (rnd() % 0x0FFFFFFE) : 0;
+        if (l->fat_bits == 32) memcpy(fat + (c * 4), &entry, 4);
+        else if (l->fat_bits == 16) {
+            entry = entry ? (entry % 0xFFFF) + 1 : 0;
+            fat[c * 2] = entry & 0xFF;
+            fat[c * 2 + 1] = entry >> 8;
+        } else {
+            entry = entry ? (entry % 0xFFF) + 1 : 0;
+            u8* p = fat + ((c * 3) / 2);
+            if (c & 1) {
+                p[0] = (p[0] & 0x0F) | ((entry << 4) & 0xF0);
+                p[1] = entry >> 4;
+            } else {
+                p[0] = entry & 0xFF;
+                p[1] = (p[1] & 0xF0) | (entry >> 8);
+            }
+        }
+        if (used && (c >= 2)) {
+            u64 clr_start = data_start + ((u64) (c - 2) * clr_bytes);
+            mark(keep, clr_start, clr_start + clr_bytes);
+        }
+    }
+
+    // system area and the space behind the last cluster are always kept
+    mark(keep, (u64) l->offset * SECTOR, data_start);
+    mark(keep, data_start + (n_clusters * clr_bytes), ((u64) l->offset + l->sct_total) * SECTOR);
+}
+
+static void make_mbr(u8* img, const FatLayout* parts, u32 n_parts) {
+    memset(img, 0, SECTOR);
+    for (u32 p = 0; p < n_parts; p++) {
+        u8* entry = img + 446 + (p * 16);
+        entry[4] = (parts[p].fat_bits == 32) ? 0x0C : (parts[p].fat_bits == 16) ? 0x06 : 0x01;
+        memcpy(entry + 8, &parts[p].offset, 4);
+        memcpy(entry + 12, &parts[p].sct_total, 4);
+    }
+    img[0x1FE] = 0x55;
+    img[0x1FF] = 0xAA;
+}
+
+// dump, expand, compare, random reads through the block mapping
+static void test_image(const char* name, const u8* img, u32 size, const u8* keep) {
+    u32 n_blocks = (size + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE;
+    u64 expected = 0, stored = 0;
+    for (u32 b = 0; b < n_blocks; b++)
+        if (keep[b]) expected += min(SPARSE_BLOCK_SIZE, size - (b * SPARSE_BLOCK_SIZE));
+    hostfs_write_file(IMG_PATH, img, size);
+
+    double t0 = ht_now();
+    CHECK(DumpSparseImage(IMG_PATH, SPARSE_PATH, &stored) == 0, "%s: dump", name);
+    double t1 = ht_now();
+    CHECK(stored == expected, "%s: stored %llu, expected %llu", name,
+        (unsigned long long) stored, (unsigned long long) expected);
+    CHECK(ExpandSparseImage(SPARSE_PATH, OUT_PATH) == 0, "%s: expand", name);
+    printf("  %-7s %4lu MB -> %6.2f MB (%5.1f%%), dump %6.1f ms, %4lu reads\n", name, (unsigned long) (size >> 20),
+        fvx_qsize(SPARSE_PATH) / 1048576.0, fvx_qsize(SPARSE_PATH) * 100.0 / size, (t1 - t0) * 1000,
+        (unsigned long) hostfs_stats.reads);
+
+    // kept blocks come back as they were, dropped ones as zeroes
+    u8* out = malloc(size);
+    u32 bad = 0;
+    CHECK(out && (fvx_qsize(OUT_PATH) == size) && (hostfs_read_file(OUT_PATH, out, size) == size), "%s: read back", name);
+    for (u32 b = 0; out && (b < n_blocks); b++) {
+        u32 pos = b * SPARSE_BLOCK_SIZE;
+        u32 len = min(SPARSE_BLOCK_SIZE, size - pos);
+        for (u32 i = 0; i < len; i++)
+            if (out[pos + i] != (keep[b] ? img[pos + i] : 0)) {
+                bad++;
+                break;
+            }
+    }
+    CHECK(!bad, "%s: %lu blocks differ", name, (unsigned long) bad);
+
+    // unaligned random reads through the mapping, as ReadImageBytes() does them
+    FIL fp;
+    SparseImage* sparse = NULL;
+    u8* buf = malloc(256 * 1024);
+    CHECK((fvx_open(&fp, SPARSE_PATH, FA_READ | FA_OPEN_EXISTING) == FR_OK) && (sparse = OpenSparseImage(&fp)),
+        "%s: open sparse", name);
+    if (sparse && out && buf) {
+        bad = 0;
+        for (u32 i = 0; i < 2000; i++) {
+            u32 len = 1 + rnd() % ((rnd() % 4) ? 0x600 : (256 * 1024));
+            u32 pos = rnd() % (size - len);
+            if ((ReadSparseImageBytes(&fp, sparse, buf, pos, len) != 0) || (memcmp(buf, out + pos, len) != 0)) bad++;
+        }
+        CHECK(!bad, "%s: %lu mapped reads differ", name, (unsigned long) bad);
+        CHECK(ReadSparseImageBytes(&fp, sparse, buf, size - 1, 2) != 0, "%s: read past the end", name);
+        CloseSparseImage(sparse);
+        fvx_close(&fp);
+    }
+
+    free(buf);
+    free(out);
+}
+
+int main(void) {
+    static const FatLayout plain[] = {
+        { "fat12", 0, 4 << 11, 4, 12, 30 },
+        { "fat16", 0, 64 << 11, 4, 16, 30 },
+        { "fat32", 0, 48 << 11, 1, 32, 30 },
+        { "full", 0, 16 << 11, 4, 16, 100 },
+    };
+    static const FatLayout mbr[] = { // gap in between, unpartitioned space at the end
+        { "mbr", 0x97, 32 << 11, 4, 16, 30 },
+        { "mbr", (40 << 11), 4 << 11, 4, 12, 10 },
+    };
+
+    hostfs_init("build/fs_sparse");
+    for (u32 i = 0; i < countof(plain); i++) {
+        u32 size = plain[i].sct_total * SECTOR;
+        u8* img = malloc(size);
+        u8* keep = calloc(size / SPARSE_BLOCK_SIZE + 1, 1);
+        rnd_state = 0x100 + i;
+        ht_fill(img, size, i + 1);
+        make_fat(img, &plain[i], keep);
+        hostfs_reset_stats();
+        test_image(plain[i].name, img, size, keep);
+        free(img);
+        free(keep);
+    }
+
+    u32 size = 48 << 20;
+    u8* img = malloc(size);
+    u8* keep = calloc(size / SPARSE_BLOCK_SIZE + 1, 1);
+    ht_fill(img, size, 99);
+    make_mbr(img, mbr, countof(mbr));
+    make_fat(img, &mbr[0], keep);
+    make_fat(img, &mbr[1], keep);
+    mark(keep, 0, (u64) mbr[0].offset * SECTOR);
+    mark(keep, (u64) (mbr[0].offset + mbr[0].sct_total) * SECTOR, (u64) mbr[1].offset * SECTOR);
+    mark(keep, (u64) (mbr[1].offset + mbr[1].sct_total) * SECTOR, size);
+    hostfs_reset_stats();
+    test_image("mbr", img, size, keep);
+
+    // a partition that doesn't parse is kept whole
+    memset(img + (mbr[1].offset * SECTOR) + 0x0B, 0, 2); // sector size 0
+    mark(keep, (u64) mbr[1].offset * SECTOR, (u64) (mbr[1].offset + mbr[1].sct_total) * SECTOR);
+    test_image("badpart", img, size, keep);
+
+    // not a FAT image, cancel
+    ht_fill(img, 1 << 20, 5);
+    hostfs_write_file(IMG_PATH, img, 1 << 20);
+    CHECK(DumpSparseImage(IMG_PATH, SPARSE_PATH, NULL) != 0, "not FAT");
+    make_fat(img, &plain[0], keep);
+    hostfs_write_file(IMG_PATH, img, plain[0].sct_total * SECTOR);
+    fvx_unlink(SPARSE_PATH);
+    hostui_reset();
+    hostui_cancel_after = 2;
+    CHECK((DumpSparseImage(IMG_PATH, SPARSE_PATH, NULL) != 0) && !fvx_qsize(SPARSE_PATH), "cancel");
+    hostui_reset();
+    free(img);
+    free(keep);
+
+    return ht_done("sparse");
+}
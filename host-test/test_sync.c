@@ -0,0 +1,235 @@
+// PathMoveCopy() in sync mode on a synthetic tree: skipped / copied / purged files, hash compare through
+// FileGetSha() with the copy buffer, progress against the whole tree and cancel while hashing
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "sha.h"
+#include "ui.h"
+#include "fsutil.h"
+
+#define SRC_ROOT    "0:/src"
+#define DST_ROOT    "0:/dst"
+#define MAX_FILES   256
+
+typedef struct {
+    char path[256]; // relative to the roots
+    u64 size;
+} TreeFile;
+
+static TreeFile tree[MAX_FILES];
+static u32 n_tree = 0;
+static u64 tree_size = 0;
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+// fanout subdirs per level, files of up to 256kB (a few empty) in each dir,
+// the first one in the root spans several copy buffers
+static void make_tree(char* path, u32 depth, u32 fanout, u32 files) {
+    static u8 data[3 * STD_BUFFER_SIZE];
+    char fpath[256];
+    u32 plen = strlen(path);
+    for (u32 i = 0; i < files; i++) {
+        TreeFile* file = &(tree[n_tree++]);
+        u32 size = (!plen && !i) ? sizeof(data) - 123 : (rnd() % 8) ? rnd() % (256 * 1024) : 0;
+        ht_fill(data, size, rnd());
+        snprintf(file->path, sizeof(file->path), "%s/file%02lu.bin", path, (unsigned long) i);
+        snprintf(fpath, sizeof(fpath), SRC_ROOT "%s", file->path);
+        file->size = size;
+        tree_size += size;
+        hostfs_write_file(fpath, data, size);
+    }
+    for (u32 d = 0; (depth > 0) && (d < fanout); d++) {
+        snprintf(path + plen, 256 - plen, "/dir%lu", (unsigned long) d);
+        snprintf(fpath, sizeof(fpath), SRC_ROOT "%s", path);
+        fvx_mkdir(fpath);
+        make_tree(path, depth - 1, fanout, files);
+        path[plen] = '\0';
+    }
+}
+
+// origin and destination have the same contents
+static u32 compare_trees(void) {
+    static u8 odata[3 * STD_BUFFER_SIZE], ddata[3 * STD_BUFFER_SIZE];
+    char opath[256], dpath[256];
+    u32 n_bad = 0;
+    for (u32 i = 0; i < n_tree; i++) {
+        snprintf(opath, sizeof(opath), SRC_ROOT "%s", tree[i].path);
+        snprintf(dpath, sizeof(dpath), DST_ROOT "%s", tree[i].path);
+        size_t osize = hostfs_read_file(opath, odata, sizeof(odata));
+        size_t dsize = hostfs_read_file(dpath, ddata, sizeof(ddata));
+        if ((osize != dsize) || (fvx_stat(dpath, NULL) != FR_OK) || (memcmp(odata, ddata, osize) != 0)) n_bad++;
+    }
+    return n_bad;
+}
+
+// overwrite a file with different data of the same size, keeping its timestamp
+static void change_file(const char* path) {
+    static u8 data[3 * STD_BUFFER_SIZE];
+    FILINFO fno;
+    fvx_stat(path, &fno);
+    size_t size = hostfs_read_file(path, data, sizeof(data));
+    data[size / 2] ^= 0xFF;
+    hostfs_write_file(path, data, size);
+    f_utime(path, &fno);
+}
+
+// progress calls, all of them should go against the tree total
+typedef struct {
+    u32 calls;
+    u32 bad_total;
+    u64 max_current;
+    u32 cancel_after; // 0: never
+} ProgressCheck;
+
+static bool ProgressCheckHook(u64 current, u64 total, const char* opstr, void* ctx) {
+    (void) opstr;
+    ProgressCheck* check = (ProgressCheck*) ctx;
+    check->calls++;
+    if (total != tree_size) check->bad_total++;
+    if (current > check->max_current) check->max_current = current;
+    return !check->cancel_after || (check->calls < check->cancel_after);
+}
+
+static bool sync(u32 extra_flags, SyncInfo* info) {
+    u32 flags = SYNC_ALL | extra_flags;
+    ResetSyncInfo();
+    hostfs_reset_stats();
+    bool res = PathMoveCopy(DST_ROOT, SRC_ROOT, &flags, false);
+    GetSyncInfo(info);
+    return res;
+}
+
+static void test_file_sha(void) {
+    static u8 data[3 * STD_BUFFER_SIZE];
+    char path[256];
+    u8 ref[0x20], hash[0x20];
+    u8 small[0x1000];
+
+    // the multi buffer file of the tree
+    u32 i = 0;
+    while (tree[i].size <= STD_BUFFER_SIZE) i++;
+    snprintf(path, sizeof(path), SRC_ROOT "%s", tree[i].path);
+    size_t size = hostfs_read_file(path, data, sizeof(data));
+    sha_quick(ref, data, size, SHA256_MODE);
+
+    CHECK(FileGetSha(path, hash, 0, 0, false, NULL, 0) && (memcmp(hash, ref, 0x20) == 0), "sha, own buffer");
+    CHECK(FileGetSha(path, hash, 0, 0, false, small, sizeof(small)) && (memcmp(hash, ref, 0x20) == 0),
+        "sha, caller buffer");
+    sha_quick(ref, data + 1000, 5000, SHA1_MODE);
+    CHECK(FileGetSha(path, hash, 1000, 5000, true, small, sizeof(small)) && (memcmp(hash, ref, 20) == 0),
+        "sha1, range");
+
+    // out of range fails and leaves nothing open
+    hostfs_reset_stats();
+    CHECK(!FileGetSha(path, hash, size, 1, false, small, sizeof(small)) && !hostfs_stats.open_files, "range");
+
+    // cancel in between fails the hash
+    hostui_reset();
+    hostui_cancel_after = 3;
+    CHECK(!FileGetSha(path, hash, 0, 0, false, small, sizeof(small)) && !hostfs_stats.open_files, "sha cancel");
+    hostui_reset();
+}
+
+int main(void) {
+    char path[256] = "";
+    SyncInfo info;
+    hostfs_init("build/fs_sync");
+    fvx_mkdir(SRC_ROOT);
+    make_tree(path, 2, 3, 6); // 1 + 3 + 9 dirs
+
+    u32 n_empty = 0;
+    for (u32 i = 0; i < n_tree; i++) n_empty += !tree[i].size;
+
+    // first sync copies everything
+    CHECK(sync(0, &info) && (info.copied == n_tree) && !info.skipped && (info.bytes == tree_size),
+        "initial: %lu copied", (unsigned long) info.copied);
+    CHECK(!compare_trees(), "initial contents");
+
+    // nothing changed: no file is opened
+    CHECK(sync(0, &info) && !info.copied && (info.skipped == n_tree), "unchanged: %lu skipped",
+        (unsigned long) info.skipped);
+    CHECK(!hostfs_stats.opens && !hostfs_stats.bytes_written, "unchanged: %lu opens", (unsigned long) hostfs_stats.opens);
+
+    // hash compare reads both sides once, through the copy buffer, with progress against the tree total
+    ProgressCheck progress = { 0 };
+    SetProgressHook(ProgressCheckHook, &progress, 0);
+    double t0 = ht_now();
+    CHECK(sync(SYNC_HASH, &info) && !info.copied && (info.skipped == n_tree), "hash: %lu skipped",
+        (unsigned long) info.skipped);
+    double t1 = ht_now();
+    SetProgressHook(NULL, NULL, 0);
+    CHECK((hostfs_stats.opens == 2 * (n_tree - n_empty)) && (hostfs_stats.bytes_read == 2 * tree_size) &&
+        !hostfs_stats.bytes_written, "hash: %lu opens", (unsigned long) hostfs_stats.opens);
+    CHECK(!progress.bad_total && (progress.max_current == tree_size),
+        "hash progress: %lu of %lu calls not against the tree", (unsigned long) progress.bad_total,
+        (unsigned long) progress.calls);
+    printf("  %lu files, %.1f MB, hash sync: %lu opens, %lu progress calls, %.1f ms\n", (unsigned long) n_tree,
+        tree_size / 1048576.0, (unsigned long) hostfs_stats.opens, (unsigned long) progress.calls, (t1 - t0) * 1000);
+
+    // same size and timestamp, only the hash compare finds the change
+    u32 changed = 0;
+    while (!tree[changed].size) changed++;
+    snprintf(path, sizeof(path), SRC_ROOT "%s", tree[changed].path);
+    change_file(path);
+    CHECK(sync(0, &info) && !info.copied && compare_trees(), "changed, timestamp only");
+    CHECK(sync(SYNC_HASH, &info) && (info.copied == 1) && (info.bytes == tree[changed].size) && !compare_trees(),
+        "changed, hash: %lu copied", (unsigned long) info.copied);
+
+    // edited in the destination (newer than the origin): the mirror gets reverted
+    FILINFO fno;
+    char dpath[256];
+    snprintf(dpath, sizeof(dpath), DST_ROOT "%s", tree[changed].path);
+    change_file(dpath);
+    fvx_stat(dpath, &fno);
+    fno.ftime ^= 1 << 11; // one hour off
+    f_utime(dpath, &fno);
+    CHECK(sync(0, &info) && (info.copied == 1) && !compare_trees(), "edited destination: %lu copied",
+        (unsigned long) info.copied);
+
+    // orphans in the destination are only deleted with purge
+    fvx_mkdir(DST_ROOT "/dir1/orphan");
+    hostfs_write_file(DST_ROOT "/dir1/orphan/file.bin", "x", 1);
+    hostfs_write_file(DST_ROOT "/orphan.bin", "x", 1);
+    CHECK(sync(0, &info) && !info.deleted && (fvx_stat(DST_ROOT "/orphan.bin", NULL) == FR_OK), "no purge");
+    CHECK(sync(SYNC_PURGE, &info) && (info.deleted == 2) && (info.skipped == n_tree), "purge: %lu deleted",
+        (unsigned long) info.deleted);
+    CHECK((fvx_stat(DST_ROOT "/orphan.bin", NULL) != FR_OK) && (fvx_stat(DST_ROOT "/dir1/orphan", NULL) != FR_OK),
+        "purged");
+
+    // cancel while hashing, confirmed: stops without copying anything
+    change_file(path);
+    hostui_reset();
+    hostui_cancel_after = 3;
+    CHECK(!sync(SYNC_HASH, &info) && !info.copied && !hostfs_stats.bytes_written && !hostfs_stats.open_files,
+        "cancel while hashing");
+    CHECK(hostui_stats.prompts == 1, "cancel: %lu prompts", (unsigned long) hostui_stats.prompts);
+
+    // cancel declined: the file counts as changed and gets copied
+    hostui_reset();
+    hostui_cancel_after = 3;
+    hostui_prompt_answer = false;
+    CHECK(sync(SYNC_HASH, &info) && (info.copied >= 1) && !compare_trees() && hostui_stats.prompts,
+        "cancel declined: %lu copied", (unsigned long) info.copied);
+    hostui_reset();
+
+    // cancel by the progress hook owner: no prompt
+    change_file(path);
+    memset(&progress, 0, sizeof(progress));
+    progress.cancel_after = 5;
+    SetProgressHook(ProgressCheckHook, &progress, 0);
+    CHECK(!sync(SYNC_HASH, &info) && !info.copied && !hostfs_stats.bytes_written, "hook cancel");
+    SetProgressHook(NULL, NULL, 0);
+    CHECK(!hostui_stats.prompts && !hostfs_stats.open_files && !hostfs_stats.open_dirs, "hook cancel: no prompt");
+
+    test_file_sha();
+
+    return ht_done("sync");
+}
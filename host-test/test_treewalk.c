@@ -0,0 +1,207 @@
+// TreeWalk() with the fs.tree_manifest visitor set on a synthetic tree, against a per file script style walk
+#include "hosttest.h"
+#include "hostfs.h"
+#include "hostui.h"
+#include "common.h"
+#include "vff.h"
+#include "sha.h"
+#include "fsutil.h"
+
+#define TREE_ROOT   "0:/tree"
+#define MAX_FILES   4096
+
+typedef struct {
+    char path[256];
+    u64 size;
+    u8 hash[0x20];
+    bool found;
+} TreeFile;
+
+static TreeFile tree[MAX_FILES];
+static u32 n_tree = 0;
+static u32 n_tree_dirs = 0;
+
+static u32 rnd_state = 1;
+static u32 rnd(void) {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+// fanout subdirs per level, some .bin and .txt files of varying size (a few empty) in each dir
+static void make_tree(char* path, u32 depth, u32 fanout, u32 files) {
+    static u8 data[256 * 1024];
+    u32 plen = strlen(path);
+    for (u32 i = 0; i < files; i++) {
+        TreeFile* file = &(tree[n_tree++]);
+        u32 size = (rnd() % 8) ? rnd() % sizeof(data) : (rnd() % 2) ? 0 : rnd() % 64;
+        ht_fill(data, size, rnd());
+        snprintf(file->path, sizeof(file->path), "%s/file%02lu.%s", path, (unsigned long) i, (i % 3) ? "bin" : "txt");
+        file->size = size;
+        sha_quick(file->hash, data, size, SHA256_MODE);
+        hostfs_write_file(file->path, data, size);
+    }
+    for (u32 d = 0; (depth > 0) && (d < fanout); d++) {
+        snprintf(path + plen, 256 - plen, "/dir%lu", (unsigned long) d);
+        fvx_mkdir(path);
+        n_tree_dirs++;
+        make_tree(path, depth - 1, fanout, files);
+        path[plen] = '\0';
+    }
+}
+
+static TreeFile* find_file(const char* path) {
+    for (u32 i = 0; i < n_tree; i++)
+        if (strncmp(tree[i].path, path, 256) == 0) return &(tree[i]);
+    return NULL;
+}
+
+// collects what fs.tree_manifest puts in its table, checked against the tree afterwards
+typedef struct {
+    TreeShaInfo* sha;
+    u32 n_entries;
+    u32 n_bad;
+} ManifestCheck;
+
+static void ManifestCheckDone(const char* path, u64 size, bool read_ok, void* ctx) {
+    ManifestCheck* check = (ManifestCheck*) ctx;
+    TreeFile* file = find_file(path);
+    check->n_entries++;
+    if (!file || file->found || (file->size != size) || !read_ok) check->n_bad++;
+    else if (size && (!check->sha->valid || (memcmp(check->sha->hash, file->hash, 0x20) != 0))) check->n_bad++;
+    if (file) file->found = true;
+}
+
+static bool manifest(const char* pattern, TreeSizeInfo* size_info, ManifestCheck* check, bool show_progress) {
+    TreeVisitor visitors[4];
+    TreeShaInfo sha_info = { .sha1 = false };
+    u32 n_visitors = 0;
+
+    for (u32 i = 0; i < n_tree; i++) tree[i].found = false;
+    memset(check, 0, sizeof(ManifestCheck));
+    check->sha = &sha_info;
+    if (pattern) TreeVisitorPattern(&(visitors[n_visitors++]), pattern);
+    TreeVisitorSize(&(visitors[n_visitors++]), size_info);
+    TreeVisitorSha(&(visitors[n_visitors++]), &sha_info);
+    memset(&(visitors[n_visitors]), 0, sizeof(TreeVisitor));
+    visitors[n_visitors].done = ManifestCheckDone;
+    visitors[n_visitors++].ctx = check;
+    return TreeWalk(TREE_ROOT, visitors, n_visitors, show_progress);
+}
+
+// what a script did before: fs.list_dir() recursively, then fs.stat() and fs.hash_file() per file
+static u32 script_walk(char* path) {
+    DIR dir;
+    FILINFO fno;
+    u32 n_bad = 0;
+    u32 plen = strlen(path);
+    if (fvx_opendir(&dir, path) != FR_OK) return 1;
+    char names[64][FF_LFN_BUF + 1]; // listed first, as fs.list_dir() does
+    bool is_dir[64];
+    u32 n = 0;
+    while ((fvx_readdir(&dir, &fno) == FR_OK) && fno.fname[0] && (n < 64)) {
+        snprintf(names[n], sizeof(names[n]), "%s", fno.fname);
+        is_dir[n++] = fno.fattrib & AM_DIR;
+    }
+    fvx_closedir(&dir);
+
+    for (u32 i = 0; i < n; i++) {
+        snprintf(path + plen, 256 - plen, "/%s", names[i]);
+        if (is_dir[i]) n_bad += script_walk(path);
+        else {
+            u8 hash[0x20];
+            TreeFile* file = find_file(path);
+            if ((fvx_stat(path, &fno) != FR_OK) || !file || (fno.fsize != file->size) ||
+                !FileGetSha(path, hash, 0, 0, false, NULL, 0) || (memcmp(hash, file->hash, 0x20) != 0))
+                n_bad++;
+        }
+        path[plen] = '\0';
+    }
+    return n_bad;
+}
+
+int main(void) {
+    char path[256] = TREE_ROOT;
+    hostfs_init("build/fs_treewalk");
+    fvx_mkdir(TREE_ROOT);
+    make_tree(path, 4, 3, 8); // 1 + 3 + 9 + 27 + 81 dirs
+    fvx_mkdir(TREE_ROOT "/empty");
+    n_tree_dirs++;
+
+    u64 total = 0;
+    for (u32 i = 0; i < n_tree; i++) total += tree[i].size;
+
+    // everything, one open per non empty file, each directory read once
+    TreeSizeInfo size_info;
+    ManifestCheck check;
+    hostfs_reset_stats();
+    double t0 = ht_now();
+    CHECK(manifest(NULL, &size_info, &check, false), "walk");
+    double t1 = ht_now();
+    HostFsStats walk_stats = hostfs_stats;
+    u32 n_empty = 0;
+    for (u32 i = 0; i < n_tree; i++) n_empty += !tree[i].size;
+    CHECK((size_info.files == n_tree) && (size_info.dirs == n_tree_dirs) && (size_info.size == total),
+        "totals: %lu files, %lu dirs", (unsigned long) size_info.files, (unsigned long) size_info.dirs);
+    CHECK((check.n_entries == n_tree) && !check.n_bad, "entries: %lu, %lu bad",
+        (unsigned long) check.n_entries, (unsigned long) check.n_bad);
+    CHECK(walk_stats.opendirs == n_tree_dirs + 1, "%lu opendirs", (unsigned long) walk_stats.opendirs);
+    CHECK(walk_stats.opens == n_tree - n_empty, "%lu opens", (unsigned long) walk_stats.opens);
+    CHECK(walk_stats.stats == 0, "no stats");
+    CHECK(walk_stats.bytes_read == total, "every byte read once");
+    CHECK(walk_stats.max_open_dirs == 5 && !walk_stats.open_dirs && !walk_stats.open_files, "open handles");
+
+    // pattern filter: only the matching files are read
+    u32 n_txt = 0;
+    u64 size_txt = 0;
+    for (u32 i = 0; i < n_tree; i++) {
+        if (!strstr(tree[i].path, ".txt") || !tree[i].size) continue;
+        n_txt++;
+        size_txt += tree[i].size;
+    }
+    hostfs_reset_stats();
+    CHECK(manifest("*.txt", &size_info, &check, false) && !check.n_bad, "pattern");
+    CHECK((hostfs_stats.opens == n_txt) && (hostfs_stats.bytes_read == size_txt), "pattern: %lu opens",
+        (unsigned long) hostfs_stats.opens);
+
+    // DirInfo() never opens files
+    u64 tsize;
+    u32 tdirs, tfiles;
+    hostfs_reset_stats();
+    CHECK(DirInfo(TREE_ROOT, &tsize, &tdirs, &tfiles) && (tsize == total) && (tfiles == n_tree), "DirInfo");
+    CHECK(!hostfs_stats.opens, "DirInfo opens");
+
+    // no visitors, too many and two SHA visitors on the one SHA engine are all refused
+    TreeVisitor visitors[TV_MAX_VISITORS + 1];
+    TreeShaInfo sha_a = { .sha1 = false }, sha_b = { .sha1 = true };
+    for (u32 i = 0; i <= TV_MAX_VISITORS; i++) TreeVisitorSize(&(visitors[i]), &size_info);
+    hostfs_reset_stats();
+    CHECK(!TreeWalk(TREE_ROOT, visitors, 0, false) && !TreeWalk(TREE_ROOT, visitors, TV_MAX_VISITORS + 1, false),
+        "visitor count");
+    TreeVisitorSha(&(visitors[0]), &sha_a);
+    TreeVisitorSha(&(visitors[1]), &sha_b);
+    CHECK(!TreeWalk(TREE_ROOT, visitors, 2, false) && !hostfs_stats.opendirs, "two SHA visitors");
+
+    // cancel with progress shown, nothing left open
+    hostui_reset();
+    hostui_cancel_after = 20;
+    CHECK(!manifest(NULL, &size_info, &check, true), "cancel");
+    CHECK(!hostfs_stats.open_dirs && !hostfs_stats.open_files, "cancel: nothing left open");
+    hostui_reset();
+
+    // script style reference
+    hostfs_reset_stats();
+    double t2 = ht_now();
+    CHECK(script_walk(path) == 0, "script walk");
+    double t3 = ht_now();
+    printf("  %lu files, %lu dirs, %.1f MB\n", (unsigned long) n_tree, (unsigned long) n_tree_dirs, total / 1048576.0);
+    printf("  tree walk: %4lu opendirs, %5lu readdirs, %4lu opens, %4lu stats, %6.1f ms\n",
+        (unsigned long) walk_stats.opendirs, (unsigned long) walk_stats.readdirs, (unsigned long) walk_stats.opens,
+        (unsigned long) walk_stats.stats, (t1 - t0) * 1000);
+    printf("  script:    %4lu opendirs, %5lu readdirs, %4lu opens, %4lu stats, %6.1f ms\n",
+        (unsigned long) hostfs_stats.opendirs, (unsigned long) hostfs_stats.readdirs, (unsigned long) hostfs_stats.opens,
+        (unsigned long) hostfs_stats.stats, (t3 - t2) * 1000);
+
+    return ht_done("treewalk");
+}
@@ -0,0 +1,200 @@
+// CIA contents through the virtual game drive (vgame.c) on a fake mounted image: sequential scans read every
+// byte once with no extra IV reads and one titlekey setup, unaligned and random reads still decrypt right
+#include "hosttest.h"
+#include "common.h"
+#include "image.h"
+#include "vgame.h"
+#include "game.h"
+#include "aes.h"
+
+#define N_CONTENTS  3
+#define CHUNK_SIZE  (64 * 1024)
+
+static const u32 content_size[N_CONTENTS] = { 0x123450, 0x40010, 0x8000 };
+static const bool content_crypto[N_CONTENTS] = { true, true, false };
+static const u8 titlekey[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+
+static u8* image = NULL;
+static u64 image_size = 0;
+static u8* plain[N_CONTENTS];
+
+static struct {
+    u32 reads;
+    u64 bytes;
+    u32 key_setups;
+} stats;
+
+// image.h, the mounted CIA
+int ReadImageBytes(void* buffer, u64 offset, u64 count) {
+    if (offset + count > image_size) return -1;
+    memcpy(buffer, image + offset, count);
+    stats.reads++;
+    stats.bytes += count;
+    return 0;
+}
+
+u64 GetMountState(void) {
+    return GAME_CIA;
+}
+
+u64 GetMountSize(void) {
+    return image_size;
+}
+
+// firm.c, never reached for a CIA
+int ReadNandSectors(void* buffer, u32 sector, u32 count, u32 keyslot, u32 nand_src) {
+    (void) buffer; (void) sector; (void) count; (void) keyslot; (void) nand_src;
+    return 1;
+}
+
+u32 ValidateSecretSector(u8* sector) {
+    (void) sector;
+    return 1;
+}
+
+// no common keys on the host, the ticket is a dummy
+u32 __wrap_GetTitleKey(u8* key, Ticket* ticket) {
+    (void) ticket;
+    memcpy(key, titlekey, 16);
+    return 0;
+}
+
+void __real_setup_aeskey(uint8_t keyslot, const void* keyy);
+void __wrap_setup_aeskey(uint8_t keyslot, const void* keyy) {
+    if (keyslot == 0x11) stats.key_setups++;
+    __real_setup_aeskey(keyslot, keyy);
+}
+
+static void make_cia(void) {
+    static CiaStub stub;
+    CiaInfo info;
+
+    memset(&stub, 0, sizeof(stub));
+    BuildCiaHeader(&stub.header, TICKET_COMMON_SIZE);
+    stub.tmd.content_count[1] = N_CONTENTS;
+    for (u32 i = 0; i < N_CONTENTS; i++) {
+        TmdContentChunk* chunk = stub.content_list + i;
+        chunk->id[3] = 0x40 + i;
+        chunk->index[1] = i;
+        chunk->type[1] = content_crypto[i] ? 0x01 : 0x00;
+        for (u32 b = 0; b < 8; b++) chunk->size[7 - b] = (u8) ((u64) content_size[i] >> (8 * b));
+    }
+    FixCiaHeaderForTmd(&stub.header, &stub.tmd);
+    GetCiaInfo(&info, &stub.header);
+
+    image_size = info.offset_content + info.size_content;
+    image = calloc(1, image_size);
+    memcpy(image, &stub, info.offset_content);
+    u64 offset = info.offset_content;
+    for (u32 i = 0; i < N_CONTENTS; i++) {
+        u8 ctr[16] = { 0 };
+        ctr[1] = i;
+        plain[i] = malloc(content_size[i]);
+        ht_fill(plain[i], content_size[i], 0xC1A0 + i);
+        memcpy(image + offset, plain[i], content_size[i]);
+        if (content_crypto[i]) EncryptCiaContentSequential(image + offset, content_size[i], ctr, titlekey);
+        offset += content_size[i];
+    }
+}
+
+// image reads for a single ReadCiaContentImageBytes() call without any IV read, mirrors ReadCbcImageBytes()
+static u32 expected_reads(u64 offset, u64 count) {
+    u32 reads = 0;
+    if (offset % AES_BLOCK_SIZE) {
+        u64 fix = (((offset % AES_BLOCK_SIZE) + count) >= AES_BLOCK_SIZE) ? AES_BLOCK_SIZE - (offset % AES_BLOCK_SIZE) : count;
+        offset += fix;
+        count -= fix;
+        reads++;
+    }
+    if (count >= AES_BLOCK_SIZE) {
+        count %= AES_BLOCK_SIZE;
+        reads++;
+    }
+    return reads + (count ? 1 : 0);
+}
+
+// sequential scan in chunks, returns bad bytes, counts unexpected (IV) reads
+static u32 scan(const VirtualFile* vfile, u32 idx, u32 chunk, u32* extra_reads) {
+    static u8 buffer[CHUNK_SIZE];
+    u32 n_bad = 0;
+    u32 reads = 0;
+    memset(&stats, 0, sizeof(stats));
+    for (u64 pos = 0; pos < vfile->size; pos += chunk) {
+        u32 count = min(chunk, vfile->size - pos);
+        memset(buffer, 0, count);
+        if ((ReadVGameFile(vfile, buffer, pos, count) != 0) || (memcmp(buffer, plain[idx] + pos, count) != 0)) n_bad++;
+        reads += expected_reads(pos, count);
+    }
+    *extra_reads = stats.reads - reads;
+    return n_bad;
+}
+
+int main(void) {
+    VirtualDir vdir;
+    VirtualFile vfile;
+    VirtualFile contents[N_CONTENTS];
+    u32 n_contents = 0;
+    u32 extra;
+
+    make_cia();
+    CHECK(InitVGameDrive() == GAME_CIA, "mount");
+    CHECK(OpenVGameDir(&vdir, NULL), "root dir");
+    while (ReadVGameDir(&vfile, &vdir)) {
+        char name[64];
+        GetVGameFilename(name, &vfile, sizeof(name));
+        if (strstr(name, ".app") && (n_contents < N_CONTENTS)) contents[n_contents++] = vfile;
+    }
+    CHECK(n_contents == N_CONTENTS, "%lu contents", (unsigned long) n_contents);
+    if (n_contents != N_CONTENTS) return ht_done("vgamecia");
+
+    // aligned sequential scan: one image read per chunk, every byte read once, one key setup
+    double t0 = ht_now();
+    CHECK(!scan(&contents[0], 0, CHUNK_SIZE, &extra), "aligned scan");
+    double t1 = ht_now();
+    CHECK(!extra && (stats.bytes == content_size[0]) && (stats.key_setups <= 1),
+        "aligned scan: %lu reads, %lu extra, %llu bytes, %lu key setups", (unsigned long) stats.reads,
+        (unsigned long) extra, (unsigned long long) stats.bytes, (unsigned long) stats.key_setups);
+    printf("  %.1f MB in %ukB chunks: %lu image reads, %lu key setups, %.1f MB/s\n", content_size[0] / 1048576.0,
+        CHUNK_SIZE / 1024, (unsigned long) stats.reads, (unsigned long) stats.key_setups,
+        content_size[0] / 1048576.0 / (t1 - t0));
+
+    // unaligned chunks: partial blocks get read twice, but there is still no IV read
+    CHECK(!scan(&contents[1], 1, 1000, &extra), "unaligned scan");
+    CHECK(!extra && (stats.key_setups <= 1), "unaligned scan: %lu reads, %lu extra, %lu key setups",
+        (unsigned long) stats.reads, (unsigned long) extra, (unsigned long) stats.key_setups);
+    CHECK(!scan(&contents[1], 1, 37, &extra) && !extra, "unaligned scan, small chunks: %lu extra", (unsigned long) extra);
+
+    // unencrypted content reads straight through
+    CHECK(!scan(&contents[2], 2, 4096, &extra) && !extra, "plain content");
+
+    // the keyslot used by something else in between: set up again, still right
+    u8 other[16] = { 0 };
+    u8 buffer[0x800];
+    memset(&stats, 0, sizeof(stats));
+    CHECK((ReadVGameFile(&contents[0], buffer, 0x10000, 0x400) == 0) && !memcmp(buffer, plain[0] + 0x10000, 0x400),
+        "read");
+    setup_aeskey(0x11, other);
+    stats.key_setups = 0;
+    CHECK((ReadVGameFile(&contents[0], buffer, 0x10400, 0x400) == 0) && !memcmp(buffer, plain[0] + 0x10400, 0x400) &&
+        (stats.key_setups == 1), "read after keyslot change: %lu key setups", (unsigned long) stats.key_setups);
+
+    // random access and switching contents: one IV read each, right data
+    u32 n_bad = 0;
+    for (u32 i = 0; i < 64; i++) {
+        u32 idx = i % 2;
+        u32 size = content_size[idx];
+        u32 offset = (i * 0x9E3779B1u) % (size - sizeof(buffer));
+        u32 count = 1 + ((i * 0x85EBCA6Bu) % sizeof(buffer));
+        memset(&stats, 0, sizeof(stats));
+        if ((ReadVGameFile(&contents[idx], buffer, offset, count) != 0) || memcmp(buffer, plain[idx] + offset, count))
+            n_bad++;
+        else if (stats.reads > expected_reads(offset, count) + 1) n_bad++;
+    }
+    CHECK(!n_bad, "random reads: %lu bad", (unsigned long) n_bad);
+
+    DeinitVGameDrive();
+    for (u32 i = 0; i < N_CONTENTS; i++) free(plain[i]);
+    free(image);
+    return ht_done("vgamecia");
+}
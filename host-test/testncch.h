@@ -0,0 +1,105 @@
+#pragma once
+
+// synthetic NCCHs for the host side tests: ExtHeader, ExeFS (.code, banner, icon) and a RomFS with
+// IVFC levels, all hashes valid, no crypto
+#include "hosttest.h"
+#include "common.h"
+#include "sha.h"
+#include "ncch.h"
+#include "exefs.h"
+#include "romfs.h"
+
+#define IVFC_LOG    12 // 4kB hash blocks on all levels
+
+typedef struct {
+    u8* data;
+    u32 size;
+    u32 offset_exefs; // in byte
+    u32 offset_romfs;
+    u32 offset_lvl3; // relative to offset_romfs
+    u32 offset_lvl2;
+    u32 size_lvl3;
+} TestNcch;
+
+static void sha256_blocks(u8* hashes, const u8* data, u32 size) {
+    for (u32 pos = 0; pos < size; pos += 1 << IVFC_LOG)
+        sha_quick(hashes + ((pos >> IVFC_LOG) * 0x20), data + pos, 1 << IVFC_LOG, SHA256_MODE);
+}
+
+// lays out and hashes a complete NCCH, all hashes are over the decrypted data
+static void make_ncch(TestNcch* t, u32 size_lvl3, const char* name) {
+    static const char* exefs_names[] = { ".code", "banner", "icon" };
+    static const u32 exefs_sizes[] = { 300000, 10000, 0x36C0 };
+    const u32 blk = 1 << IVFC_LOG;
+
+    // layout: header, ExtHeader (+ access desc), ExeFS, RomFS
+    u32 size_exefs = 0x200;
+    for (u32 i = 0; i < countof(exefs_sizes); i++) size_exefs += align(exefs_sizes[i], NCCH_MEDIA_UNIT);
+    u32 size_lvl2 = (align(size_lvl3, blk) >> IVFC_LOG) * 0x20;
+    u32 size_lvl1 = (align(size_lvl2, blk) >> IVFC_LOG) * 0x20;
+    u32 size_master = (align(size_lvl1, blk) >> IVFC_LOG) * 0x20;
+    u32 offset_lvl3 = align(sizeof(RomFsIvfcHeader) + size_master, blk);
+    u32 offset_lvl1 = offset_lvl3 + align(size_lvl3, blk);
+    u32 offset_lvl2 = offset_lvl1 + align(size_lvl1, blk);
+    u32 size_romfs = align(offset_lvl2 + align(size_lvl2, blk), NCCH_MEDIA_UNIT);
+
+    t->offset_exefs = 0xA00;
+    t->offset_romfs = align(t->offset_exefs + size_exefs + 0x1234, 0x1000); // gap before the RomFS
+    t->offset_lvl3 = offset_lvl3;
+    t->offset_lvl2 = offset_lvl2;
+    t->size_lvl3 = size_lvl3;
+    t->size = t->offset_romfs + size_romfs;
+    t->data = calloc(t->size, 1);
+    ht_fill(t->data + 0x200, t->size - 0x200, size_lvl3);
+
+    // ExtHeader
+    NcchHeader* ncch = (NcchHeader*) (void*) t->data;
+    memset(ncch, 0, sizeof(NcchHeader));
+    ht_fill(ncch->signature, 0x100, 1);
+    memcpy(ncch->magic, "NCCH", 4);
+    ncch->size = t->size / NCCH_MEDIA_UNIT;
+    ncch->partitionId = ncch->programId = 0x0004000000123400ull;
+    ncch->version = 2;
+    ncch->flags[5] = 0x03; // CXI
+    ncch->flags[7] = 0x04; // no crypto
+    ncch->size_exthdr = 0x400;
+    memcpy(t->data + NCCH_EXTHDR_OFFSET, name, strlen(name));
+    sha_quick(ncch->hash_exthdr, t->data + NCCH_EXTHDR_OFFSET, 0x400, SHA256_MODE);
+
+    // ExeFS
+    ExeFsHeader* exefs = (ExeFsHeader*) (void*) (t->data + t->offset_exefs);
+    memset(exefs, 0, sizeof(ExeFsHeader));
+    for (u32 i = 0, offset = 0; i < countof(exefs_sizes); i++) {
+        ExeFsFileHeader* file = exefs->files + i;
+        strncpy(file->name, exefs_names[i], 8);
+        file->offset = offset;
+        file->size = exefs_sizes[i];
+        u8* data = t->data + t->offset_exefs + 0x200 + offset;
+        memset(data + file->size, 0, align(file->size, NCCH_MEDIA_UNIT) - file->size);
+        sha_quick(exefs->hashes[9 - i], data, file->size, SHA256_MODE);
+        offset += align(file->size, NCCH_MEDIA_UNIT);
+    }
+    ncch->offset_exefs = t->offset_exefs / NCCH_MEDIA_UNIT;
+    ncch->size_exefs = size_exefs / NCCH_MEDIA_UNIT;
+    ncch->size_exefs_hash = 1;
+    sha_quick(ncch->hash_exefs, exefs, 0x200, SHA256_MODE);
+
+    // RomFS, padding up to full hash blocks is zero
+    u8* romfs = t->data + t->offset_romfs;
+    RomFsIvfcHeader* ivfc = (RomFsIvfcHeader*) (void*) romfs;
+    memset(romfs, 0, offset_lvl3);
+    memset(romfs + offset_lvl3 + size_lvl3, 0, size_romfs - (offset_lvl3 + size_lvl3));
+    memcpy(ivfc->magic, (u8[]) { ROMFS_MAGIC }, 8);
+    ivfc->size_masterhash = size_master;
+    ivfc->size_lvl1 = size_lvl1;
+    ivfc->size_lvl2 = size_lvl2;
+    ivfc->size_lvl3 = size_lvl3;
+    ivfc->log_lvl1 = ivfc->log_lvl2 = ivfc->log_lvl3 = IVFC_LOG;
+    sha256_blocks(romfs + offset_lvl2, romfs + offset_lvl3, align(size_lvl3, blk));
+    sha256_blocks(romfs + offset_lvl1, romfs + offset_lvl2, align(size_lvl2, blk));
+    sha256_blocks(romfs + sizeof(RomFsIvfcHeader), romfs + offset_lvl1, align(size_lvl1, blk));
+    ncch->offset_romfs = t->offset_romfs / NCCH_MEDIA_UNIT;
+    ncch->size_romfs = size_romfs / NCCH_MEDIA_UNIT;
+    ncch->size_romfs_hash = align(sizeof(RomFsIvfcHeader) + size_master, NCCH_MEDIA_UNIT) / NCCH_MEDIA_UNIT;
+    sha_quick(ncch->hash_romfs, romfs, ncch->size_romfs_hash * NCCH_MEDIA_UNIT, SHA256_MODE);
+}